@@ -13,6 +13,7 @@
 #include "app_config.h"
 #include "mysql_common.h"
 #include "datamodel.h"
+#include "point_shards.h"
 
 #define INI_SECTION_NAME "app"
 
@@ -69,6 +70,16 @@ void app_config_free(app_config_t* config) {
         config->starting_points_file = NULL;
     };
     
+    if (config->external_dedup_directory != NULL) {
+        free(config->external_dedup_directory);
+        config->external_dedup_directory = NULL;
+    };
+    
+    if (config->str_adaptive_guard_band != NULL) {
+        free(config->str_adaptive_guard_band);
+        config->str_adaptive_guard_band = NULL;
+    };
+    
     db_context_free(config->context);
 }
 
@@ -88,9 +99,13 @@ int app_config_ini_parse_handler(void* config, const char* section, const char*
     } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "STR_POINT_DIGITS") == 0) {
         sscanf(value, "%zu", &(pconfig->str_point_digits));
     } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "POINT_HASH_COORD_DIGITS") == 0) {
-        sscanf(value, "%zu", &(pconfig->point_hash_coord_digits));
+        sscanf(value, "%zu", &(pconfig->point_hash_coord_bits));
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "POINT_HASH_GRID") == 0) {
+        pconfig->point_hash_grid = atoi(value);
     } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "MAX_POINT_CACHE") == 0) {
         sscanf(value, "%zu", &(pconfig->max_point_cache));
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "POINT_CACHE_BYTES") == 0) {
+        sscanf(value, "%zu", &(pconfig->point_cache_bytes));
     } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "PRINT_DIGITS") == 0) {
         sscanf(value, "%zu", &(pconfig->print_digits));
     } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "MAX_ITERATIONS") == 0) {
@@ -119,6 +134,26 @@ int app_config_ini_parse_handler(void* config, const char* section, const char*
         sscanf(value, "%zu", &(pconfig->starting_points_file_line_buffer));
     } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "BENCHMARK_TIME_SEC") == 0) {
         sscanf(value, "%zu", &(pconfig->benchmark_time_sec));
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "THREADS") == 0) {
+        sscanf(value, "%zu", &(pconfig->threads));
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "DEDUP_SHARDS") == 0) {
+        sscanf(value, "%zu", &(pconfig->dedup_shards));
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "DEDUP_ROUTING") == 0) {
+        pconfig->dedup_routing = strcmp(value, "tile") == 0 ? POINT_SHARDS_ROUTE_TILE : POINT_SHARDS_ROUTE_HASH;
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "EXTERNAL_DEDUP_DIRECTORY") == 0) {
+        pconfig->external_dedup_directory = strdup(value);
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "EXTERNAL_DEDUP_MEMORY") == 0) {
+        sscanf(value, "%zu", &(pconfig->external_dedup_memory));
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "ENUMERATE_OBJECTS") == 0) {
+        pconfig->enumerate_objects = atoi(value);
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "INCREMENTAL_ITERATIONS") == 0) {
+        pconfig->incremental_iterations = atoi(value);
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "ADAPTIVE_PRECISION_BITS") == 0) {
+        sscanf(value, "%zu", &(pconfig->adaptive_precision_bits));
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "ADAPTIVE_GUARD_BAND") == 0) {
+        pconfig->str_adaptive_guard_band = strdup(value);
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "RATIONAL_POINT_BITS") == 0) {
+        sscanf(value, "%zu", &(pconfig->rational_point_bits));
     } else {
         return 0;  /* unknown section/name, error */
     }
@@ -139,8 +174,10 @@ void app_config_printf(app_config_t* config) {
     printf("batch_id: %d\n", config->batch_id);
     printf("gmp_precision_bits: %zu\n", config->gmp_precision_bits);
     printf("str_point_digits: %zu\n", config->str_point_digits);
-    printf("point_hash_coord_digits: %zu\n", config->point_hash_coord_digits);
+    printf("point_hash_coord_bits: %zu\n", config->point_hash_coord_bits);
+    printf("point_hash_grid: %d\n", config->point_hash_grid);
     printf("max_point_cache: %zu\n", config->max_point_cache);
+    printf("point_cache_bytes: %zu\n", config->point_cache_bytes);
     printf("print_digits: %zu\n", config->print_digits);
     printf("max_iterations: %zu\n", config->max_iterations);
     printf("print_object_description_in_intersection_check: %d\n", config->print_object_description_in_intersection_check);
@@ -153,4 +190,14 @@ void app_config_printf(app_config_t* config) {
     printf("output_filename: %s\n", config->output_filename);
     printf("str_init_epsilon: %s\n", config->str_init_epsilon);
     printf("benchmark_time_sec: %zu\n", config->benchmark_time_sec);
+    printf("threads: %zu\n", config->threads);
+    printf("dedup_shards: %zu\n", config->dedup_shards);
+    printf("dedup_routing: %s\n", config->dedup_routing == POINT_SHARDS_ROUTE_TILE ? "tile" : "hash");
+    printf("external_dedup_directory: %s\n", config->external_dedup_directory != NULL ? config->external_dedup_directory : "");
+    printf("external_dedup_memory: %zu\n", config->external_dedup_memory);
+    printf("enumerate_objects: %d\n", config->enumerate_objects);
+    printf("incremental_iterations: %d\n", config->incremental_iterations);
+    printf("adaptive_precision_bits: %zu\n", config->adaptive_precision_bits);
+    printf("adaptive_guard_band: %s\n", config->str_adaptive_guard_band != NULL ? config->str_adaptive_guard_band : "");
+    printf("rational_point_bits: %zu\n", config->rational_point_bits);
 }
\ No newline at end of file
@@ -33,17 +33,26 @@ typedef struct app_config {
     // digits, which should be ~ ln(2^PRECISION_BITS)/ln(10).
     size_t str_point_digits;
     
-    // Number of characters to use for the memory cache for points.
-    // Should be the same or larger than DB_POINT_DECIMAL_DIGITS_PRECISION 
-    // for consistency. (for single x,y; total length is twice this).
-    size_t point_hash_coord_digits;
+    // Number of bits right of the binary point kept for each x,y value
+    // in the binary point keys of the memory cache. Values are rounded
+    // to a multiple of 2^-bits. Should be less than GMP_PRECISION_BITS.
+    size_t point_hash_coord_bits;
+    
+    // Whether or not to round point keys to a grid wider than STR_EPSILON,
+    // and check neighboring cells, so points closer than STR_EPSILON are
+    // merged as they're found.
+    int point_hash_grid;
     
     // Max number of points to cache in memory. Before making a trip to
     // the database the memory cache is checked to see if the point is 
-    // already known.
-    // (uses uthash, "unsigned" type)
+    // already known. When full, the new points are written to the
+    // database and the least used points are evicted.
     size_t max_point_cache;
     
+    // Memory budget of the cache in bytes. If set, max_point_cache is
+    // set from this once the size of a point is known.
+    size_t point_cache_bytes;
+    
     // Number of decimal digits to use when printing output. This is smaller than
     // the above to avoid extra clutter.
     size_t print_digits;
@@ -97,6 +106,54 @@ typedef struct app_config {
     // Abort if the application has been running longer than this many seconds.
     // Set to less than one to disable.
     size_t benchmark_time_sec;
+    
+    // Number of threads used to construct points for a task.
+    // Set to 1 (or less) to construct points on the main thread only.
+    size_t threads;
+    
+    // Number of shards the memory cache is split into when more than one
+    // thread is used. Each shard is owned by its own thread, the other
+    // threads send it points through queues. 0 to share one table.
+    size_t dedup_shards;
+    
+    // How points are sent to shards, POINT_SHARDS_ROUTE_HASH by the
+    // hash key or POINT_SHARDS_ROUTE_TILE by the unit square.
+    int dedup_routing;
+    
+    // If set, candidate points are written in sorted runs to files in
+    // this directory, and merged into unique points at the end of each
+    // task, see point_runs_t. Empty or NULL to keep them in memory.
+    char *external_dedup_directory;
+    
+    // Memory budget in bytes for the candidate points buffered, or read
+    // back, with external_dedup_directory.
+    size_t external_dedup_memory;
+    
+    // If set, each iteration builds tables of the distinct lines and
+    // circles from the working set, and intersects each pair of distinct
+    // objects once, instead of every pair of point pairs.
+    int enumerate_objects;
+    
+    // If set with enumerate_objects, only pairs of objects with at least
+    // one object built from a point new to the working set are intersected.
+    // The other pairs were intersected in an earlier iteration.
+    int incremental_iterations;
+    
+    // If set, intersections are calculated with scratch values of this
+    // many bits first, and only calculated again at gmp_precision_bits
+    // when a value compared with epsilon is within the guard band.
+    // 0 to calculate everything at gmp_precision_bits.
+    size_t adaptive_precision_bits;
+    
+    // Width of the guard band on each side of epsilon, for
+    // adaptive_precision_bits.
+    char *str_adaptive_guard_band;
+    
+    // If set, points with rational x,y values are kept exactly, and
+    // points read from the datastore with a fraction of at most this
+    // many bits in the denominator are taken as that fraction.
+    // See point_rational_init. 0 to turn off.
+    size_t rational_point_bits;
 } app_config_t;
 
 /*
@@ -0,0 +1,286 @@
+/*
+* MPFR values held inline, used by the intersection kernels in the
+* NUMERIC_BACKEND_MPFR build.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <mpfr.h>
+#include <stdlib.h>
+
+#include "global.h"
+#include "bigfloat.h"
+
+bigfloat_t g_bigfloat_epsilon;
+bigfloat_t g_bigfloat_epsilon_squared;
+
+/*
+* Sets v to a read only view of a.
+*/
+static inline void _view(mpfr_ptr v, bigfloat_t* a) {
+    mpfr_custom_init_set(v, a->kind, a->exp, BIGFLOAT_PRECISION, a->limbs);
+}
+
+/*
+* Sets v to a view of t for a result. Results go to a separate value
+* and are copied after, MPFR only checks for overlapping operands by
+* the mpfr_t they're passed as, and views of the same value would be
+* different mpfr_t.
+*/
+static inline void _result(mpfr_ptr v, bigfloat_t* t) {
+    mpfr_custom_init(t->limbs, BIGFLOAT_PRECISION);
+    mpfr_custom_init_set(v, MPFR_ZERO_KIND, 0, BIGFLOAT_PRECISION, t->limbs);
+}
+
+/*
+* Copies the result in view v of t to rop.
+*/
+static inline void _store(bigfloat_t* rop, mpfr_ptr v, bigfloat_t* t) {
+    t->kind = mpfr_custom_get_kind(v);
+    t->exp = t->kind == MPFR_REGULAR_KIND || t->kind == -MPFR_REGULAR_KIND ? mpfr_custom_get_exp(v) : 0;
+    *rop = *t;
+}
+
+/*
+* Sets g_bigfloat_epsilon and g_bigfloat_epsilon_squared from the mpf
+* values. Called by global_init.
+*/
+void global_bigfloat_init() {
+    bigfloat_set_mpf(&g_bigfloat_epsilon, g_epsilon);
+    bigfloat_set_mpf(&g_bigfloat_epsilon_squared, g_epsilon_squared);
+}
+
+/*
+* Sets a bigfloat value from a GMP value.
+*
+* @rop: Result.
+* @f: Value to convert.
+*/
+void bigfloat_set_mpf(bigfloat_t* rop, mpf_t f) {
+    bigfloat_t t;
+    mpfr_t r;
+    
+    _result(r, &t);
+    mpfr_set_f(r, f, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* Sets a GMP value from a bigfloat value.
+*
+* @rop: Result.
+* @a: Value to convert.
+*/
+void bigfloat_get_mpf(mpf_t rop, bigfloat_t* a) {
+    mpfr_t x;
+    
+    _view(x, a);
+    mpfr_get_f(rop, x, MPFR_RNDN);
+}
+
+/*
+* Sets a bigfloat value from an int.
+*
+* @rop: Result.
+* @v: Value.
+*/
+void bigfloat_set_si(bigfloat_t* rop, long v) {
+    bigfloat_t t;
+    mpfr_t r;
+    
+    _result(r, &t);
+    mpfr_set_si(r, v, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* Sets a bigfloat value from a double.
+*
+* @rop: Result.
+* @d: Value.
+*/
+void bigfloat_set_d(bigfloat_t* rop, double d) {
+    bigfloat_t t;
+    mpfr_t r;
+    
+    _result(r, &t);
+    mpfr_set_d(r, d, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* Converts a bigfloat value to the nearest double.
+*
+* @a: Value to convert.
+*
+* returns: value as a double.
+*/
+double bigfloat_get_d(bigfloat_t* a) {
+    mpfr_t x;
+    
+    _view(x, a);
+    
+    return mpfr_get_d(x, MPFR_RNDN);
+}
+
+/*
+* rop = a + b
+*/
+void bigfloat_add(bigfloat_t* rop, bigfloat_t* a, bigfloat_t* b) {
+    bigfloat_t t;
+    mpfr_t r, x, y;
+    
+    _result(r, &t);
+    _view(x, a);
+    _view(y, b);
+    mpfr_add(r, x, y, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* rop = a - b
+*/
+void bigfloat_sub(bigfloat_t* rop, bigfloat_t* a, bigfloat_t* b) {
+    bigfloat_t t;
+    mpfr_t r, x, y;
+    
+    _result(r, &t);
+    _view(x, a);
+    _view(y, b);
+    mpfr_sub(r, x, y, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* rop = -a
+*/
+void bigfloat_neg(bigfloat_t* rop, bigfloat_t* a) {
+    *rop = *a;
+    rop->kind = -rop->kind;
+}
+
+/*
+* rop = a * b
+*/
+void bigfloat_mul(bigfloat_t* rop, bigfloat_t* a, bigfloat_t* b) {
+    bigfloat_t t;
+    mpfr_t r, x, y;
+    
+    _result(r, &t);
+    _view(x, a);
+    _view(y, b);
+    mpfr_mul(r, x, y, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* rop = a * u
+*/
+void bigfloat_mul_ui(bigfloat_t* rop, bigfloat_t* a, unsigned long u) {
+    bigfloat_t t;
+    mpfr_t r, x;
+    
+    _result(r, &t);
+    _view(x, a);
+    mpfr_mul_ui(r, x, u, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* rop = a / b. b must not be zero.
+*/
+void bigfloat_div(bigfloat_t* rop, bigfloat_t* a, bigfloat_t* b) {
+    bigfloat_t t;
+    mpfr_t r, x, y;
+    
+    _result(r, &t);
+    _view(x, a);
+    _view(y, b);
+    mpfr_div(r, x, y, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* rop = sqrt(a). Negative values are treated as zero.
+*/
+void bigfloat_sqrt(bigfloat_t* rop, bigfloat_t* a) {
+    bigfloat_t t;
+    mpfr_t r, x;
+    
+    if (bigfloat_sgn(a) <= 0) {
+        bigfloat_set_si(rop, 0);
+        return;
+    }
+    
+    _result(r, &t);
+    _view(x, a);
+    mpfr_sqrt(r, x, MPFR_RNDN);
+    _store(rop, r, &t);
+}
+
+/*
+* Sign of a value.
+*
+* @a: Value.
+*
+* returns: -1, 0, or 1.
+*/
+int bigfloat_sgn(bigfloat_t* a) {
+    if (a->kind == MPFR_ZERO_KIND || a->kind == -MPFR_ZERO_KIND) {
+        return 0;
+    }
+    
+    return a->kind < 0 ? -1 : 1;
+}
+
+/*
+* Same as global_is_zero.
+*
+* @a: Value to compare.
+*
+* returns: 1 if the absolute value is less than g_epsilon, otherwise 0.
+*/
+int bigfloat_is_zero(bigfloat_t* a) {
+    mpfr_t x, e;
+    
+    _view(x, a);
+    _view(e, &g_bigfloat_epsilon);
+    
+    return mpfr_cmpabs(x, e) > 0 ? 0 : 1;
+}
+
+/*
+* Same as global_compare_zero.
+*
+* @a: Value to compare.
+*
+* returns: 0 if the absolute value is less than g_epsilon,
+*     -1 if the value is less than zero,
+*     or 1 if the value is greater than zero.
+*/
+int bigfloat_compare_zero(bigfloat_t* a) {
+    if (bigfloat_is_zero(a)) {
+        return 0;
+    }
+    
+    return bigfloat_sgn(a);
+}
+
+/*
+* Same as global_is_zero_squared.
+*
+* @a: Squared value to compare, must not be negative.
+*
+* returns: 1 if the value is less than g_epsilon squared, otherwise 0.
+*/
+int bigfloat_is_zero_squared(bigfloat_t* a) {
+    mpfr_t x, e;
+    
+    _view(x, a);
+    _view(e, &g_bigfloat_epsilon_squared);
+    
+    return mpfr_cmp(x, e) > 0 ? 0 : 1;
+}
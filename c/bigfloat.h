@@ -0,0 +1,161 @@
+/*
+* MPFR values held inline, used by the intersection kernels in the
+* NUMERIC_BACKEND_MPFR build.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __BIGFLOAT_H__
+#define __BIGFLOAT_H__
+
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <mpfr.h>
+
+// Precision in bits of a bigfloat value, set with -DBIGFLOAT_PRECISION=n.
+#ifndef BIGFLOAT_PRECISION
+#define BIGFLOAT_PRECISION 256
+#endif
+
+#define BIGFLOAT_LIMBS ((BIGFLOAT_PRECISION + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS)
+
+// MPFR value with its significand held inline, so values can live on
+// the stack or in a struct with no allocation, and can be copied. Each
+// operation sets up mpfr_t views of the values with the MPFR custom
+// interface. Results are rounded to nearest.
+typedef struct bigfloat {
+    // Kind of value, with the sign, see mpfr_custom_get_kind.
+    int kind;
+    
+    // Exponent, only used by regular values.
+    mpfr_exp_t exp;
+    
+    mp_limb_t limbs[BIGFLOAT_LIMBS];
+} bigfloat_t;
+
+// g_epsilon and g_epsilon_squared as bigfloat values.
+extern bigfloat_t g_bigfloat_epsilon;
+extern bigfloat_t g_bigfloat_epsilon_squared;
+
+/*
+* Sets g_bigfloat_epsilon and g_bigfloat_epsilon_squared from the mpf
+* values. Called by global_init.
+*/
+void global_bigfloat_init();
+
+/*
+* Sets a bigfloat value from a GMP value.
+*
+* @rop: Result.
+* @f: Value to convert.
+*/
+void bigfloat_set_mpf(bigfloat_t* rop, mpf_t f);
+
+/*
+* Sets a GMP value from a bigfloat value.
+*
+* @rop: Result.
+* @a: Value to convert.
+*/
+void bigfloat_get_mpf(mpf_t rop, bigfloat_t* a);
+
+/*
+* Sets a bigfloat value from an int.
+*
+* @rop: Result.
+* @v: Value.
+*/
+void bigfloat_set_si(bigfloat_t* rop, long v);
+
+/*
+* Sets a bigfloat value from a double.
+*
+* @rop: Result.
+* @d: Value.
+*/
+void bigfloat_set_d(bigfloat_t* rop, double d);
+
+/*
+* Converts a bigfloat value to the nearest double.
+*
+* @a: Value to convert.
+*
+* returns: value as a double.
+*/
+double bigfloat_get_d(bigfloat_t* a);
+
+/*
+* rop = a + b
+*/
+void bigfloat_add(bigfloat_t* rop, bigfloat_t* a, bigfloat_t* b);
+
+/*
+* rop = a - b
+*/
+void bigfloat_sub(bigfloat_t* rop, bigfloat_t* a, bigfloat_t* b);
+
+/*
+* rop = -a
+*/
+void bigfloat_neg(bigfloat_t* rop, bigfloat_t* a);
+
+/*
+* rop = a * b
+*/
+void bigfloat_mul(bigfloat_t* rop, bigfloat_t* a, bigfloat_t* b);
+
+/*
+* rop = a * u
+*/
+void bigfloat_mul_ui(bigfloat_t* rop, bigfloat_t* a, unsigned long u);
+
+/*
+* rop = a / b. b must not be zero.
+*/
+void bigfloat_div(bigfloat_t* rop, bigfloat_t* a, bigfloat_t* b);
+
+/*
+* rop = sqrt(a). Negative values are treated as zero.
+*/
+void bigfloat_sqrt(bigfloat_t* rop, bigfloat_t* a);
+
+/*
+* Sign of a value.
+*
+* @a: Value.
+*
+* returns: -1, 0, or 1.
+*/
+int bigfloat_sgn(bigfloat_t* a);
+
+/*
+* Same as global_is_zero.
+*
+* @a: Value to compare.
+*
+* returns: 1 if the absolute value is less than g_epsilon, otherwise 0.
+*/
+int bigfloat_is_zero(bigfloat_t* a);
+
+/*
+* Same as global_compare_zero.
+*
+* @a: Value to compare.
+*
+* returns: 0 if the absolute value is less than g_epsilon,
+*     -1 if the value is less than zero,
+*     or 1 if the value is greater than zero.
+*/
+int bigfloat_compare_zero(bigfloat_t* a);
+
+/*
+* Same as global_is_zero_squared.
+*
+* @a: Squared value to compare, must not be negative.
+*
+* returns: 1 if the value is less than g_epsilon squared, otherwise 0.
+*/
+int bigfloat_is_zero_squared(bigfloat_t* a);
+
+#endif
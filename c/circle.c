@@ -13,134 +13,239 @@
 #include <string.h>
 
 #include "global.h"
+#include "geometry_context.h"
+#include "numeric.h"
+#include "interval.h"
 #include "circle.h"
 #include "line.h"
 #include "point.h"
 
-// internal variables use for calculation.
-static int _p_init = 0;
-static mpf_t _t1;
-static mpf_t _t2;
-static mpf_t _t3;
-static mpf_t _t4;
-static mpf_t _t5;
-static mpf_t _t6;
-static mpf_t _t7;
-static mpf_t _t8;
-static mpf_t _t9;
-static mpf_t _ta;
-static mpf_t _tb;
-static mpf_t _tc;
-static mpf_t _td;
-static mpf_t _te;
-static mpf_t _tf;
-static mpf_t _tg;
-static mpf_t _th;
-static mpf_t _ti;
-static mpf_t _tj;
-static mpf_t _tk;
-static mpf_t _tm;
-static mpf_t _tn;
-static mpf_t _tp;
-static mpf_t _tq;
-static mpf_t _tr;
-static mpf_t _ts;
-static mpf_t _tt;
-static mpf_t _tu;
-static mpf_t _tv;
-static mpf_t _tw;
-static mpf_t _tx;
-static mpf_t _ty;
-static mpf_t _tz;
+/*
+* Interval arithmetic version of the discriminant check in
+* circle_intersection_line.
+*
+* returns: 1 if there is certainly no intersection,
+*     0 if the mpf calculation is needed.
+*/
+static int _filter_circle_x_line(circle_t* c, line_t* n) {
+    interval_t t1, t2, dist, disc;
+    
+    // dist = a * cx + b * cy - c
+    interval_mul(&t1, &n->ia, &c->icx);
+    interval_mul(&t2, &n->ib, &c->icy);
+    interval_add(&dist, &t1, &t2);
+    interval_sub(&dist, &dist, &n->ic);
+    
+    // disc = r^2 - dist^2
+    interval_sqr(&t1, &dist);
+    interval_sub(&disc, &c->ir2, &t1);
+    
+    return interval_is_negative(&disc);
+}
+
+/*
+* Interval arithmetic version of the discriminant check in
+* circle_intersection_circle.
+*
+* returns: 1 if there is certainly no intersection,
+*     0 if the mpf calculation is needed.
+*/
+static int _filter_circle_x_circle(circle_t* c1, circle_t* c2) {
+    interval_t dx, dy, d2, k, t1, t2, q;
+    
+    interval_sub(&dx, &c2->icx, &c1->icx);
+    interval_sub(&dy, &c2->icy, &c1->icy);
+    interval_sqr(&t1, &dx);
+    interval_sqr(&t2, &dy);
+    interval_add(&d2, &t1, &t2);
+    
+    // k = r1^2 - r2^2 + d^2
+    interval_sub(&k, &c1->ir2, &c2->ir2);
+    interval_add(&k, &k, &d2);
+    
+    // q = 4 * d^2 * r1^2 - k^2
+    interval_mul(&t1, &d2, &c1->ir2);
+    interval_add(&t1, &t1, &t1);
+    interval_add(&t1, &t1, &t1);
+    interval_sqr(&t2, &k);
+    interval_sub(&q, &t1, &t2);
+    
+    // Same origin is also no intersection, so a negative q
+    // never disagrees with the mpf calculation.
+    return interval_is_negative(&q);
+}
 
 /*
-* Initializes some static variables.
+* Updates the interval copies of the circle values.
+*
+* @c: Circle to update.
 */
-void global_circle_init() {
-    if (_p_init != 0) {
-        return;
+static void _circle_prepare(circle_t* c) {
+    interval_set_mpf(&c->icx, c->origin->x);
+    interval_set_mpf(&c->icy, c->origin->y);
+    interval_set_mpf(&c->ir2, c->radius_squared);
+    
+#ifdef NUMERIC_KERNELS
+    num_set_mpf(&c->num_cx, c->origin->x);
+    num_set_mpf(&c->num_cy, c->origin->y);
+    num_set_mpf(&c->num_r2, c->radius_squared);
+#endif
+}
+
+#ifdef NUMERIC_KERNELS
+/*
+* Numeric backend version of the calculation in circle_intersection_line,
+* using the numeric backend copies of the circle and line values.
+*
+* returns: The number of intersection points found.
+*/
+static int _circle_x_line_numeric(circle_t* c, line_t* n, point_t* p1, point_t* p2) {
+    num_t dist, disc, fx, fy, h, ox, oy, t1, t2;
+    int cmp;
+    
+    // dist = a * cx + b * cy - c;
+    num_mul(&t1, &n->num_a, &c->num_cx);
+    num_mul(&t2, &n->num_b, &c->num_cy);
+    num_add(&t1, &t1, &t2);
+    num_sub(&dist, &t1, &n->num_c);
+    
+    // disc = r^2 - dist^2;
+    num_mul(&t1, &dist, &dist);
+    num_sub(&disc, &c->num_r2, &t1);
+    
+    cmp = num_compare_zero(&disc);
+    
+    if (cmp < 0) {
+        // no intersection
+        return 0;
+    }
+    
+    // foot of the perpendicular = { cx - a * dist, cy - b * dist }
+    num_mul(&t1, &n->num_a, &dist);
+    num_sub(&fx, &c->num_cx, &t1);
+    num_mul(&t1, &n->num_b, &dist);
+    num_sub(&fy, &c->num_cy, &t1);
+    
+    if (cmp == 0) {
+        // one intersection, the line is tangent at the foot.
+        point_reset(p1);
+        num_get_mpf(p1->x, &fx);
+        num_get_mpf(p1->y, &fy);
+        
+        return 1;
     }
     
-    _p_init = 1;
-    
-    mpf_init(_t1);
-    mpf_init(_t2);
-    mpf_init(_t3);
-    mpf_init(_t4);
-    mpf_init(_t5);
-    mpf_init(_t6);
-    mpf_init(_t7);
-    mpf_init(_t8);
-    mpf_init(_t9);
-    mpf_init(_ta);
-    mpf_init(_tb);
-    mpf_init(_tc);
-    mpf_init(_td);
-    mpf_init(_te);
-    mpf_init(_tf);
-    mpf_init(_tg);
-    mpf_init(_th);
-    mpf_init(_ti);
-    mpf_init(_tj);
-    mpf_init(_tk);
-    mpf_init(_tm);
-    mpf_init(_tn);
-    mpf_init(_tp);
-    mpf_init(_tq);
-    mpf_init(_tr);
-    mpf_init(_ts);
-    mpf_init(_tt);
-    mpf_init(_tu);
-    mpf_init(_tv);
-    mpf_init(_tw);
-    mpf_init(_tx);
-    mpf_init(_ty);
-    mpf_init(_tz);
+    point_reset(p1);
+    point_reset(p2);
+    
+    // h = sqrt(disc), offset along the line = { -b * h, a * h }
+    num_sqrt(&h, &disc);
+    num_mul(&ox, &n->num_b, &h);
+    num_neg(&ox, &ox);
+    num_mul(&oy, &n->num_a, &h);
+    
+    // p1 = foot + offset, p2 = foot - offset
+    num_add(&t1, &fx, &ox);
+    num_get_mpf(p1->x, &t1);
+    num_add(&t1, &fy, &oy);
+    num_get_mpf(p1->y, &t1);
+    
+    num_sub(&t1, &fx, &ox);
+    num_get_mpf(p2->x, &t1);
+    num_sub(&t1, &fy, &oy);
+    num_get_mpf(p2->y, &t1);
+    
+    return 2;
 }
 
 /*
-* Frees memory used by static variables.
+* Numeric backend version of the calculation in circle_intersection_circle,
+* using the numeric backend copies of the circle values.
+*
+* returns: The number of intersection points found.
 */
-void global_circle_free() {
-    if (_p_init != 1) {
-        return;
+static int _circle_x_circle_numeric(circle_t* c1, circle_t* c2, point_t* p1, point_t* p2) {
+    num_t dx, dy, d2, k, q, inv, x3, y3, rx, ry, t1, t2;
+    int cmp;
+    
+    num_sub(&dx, &c2->num_cx, &c1->num_cx);
+    num_sub(&dy, &c2->num_cy, &c1->num_cy);
+    
+    // d^2 = dx^2 + dy^2
+    num_mul(&t1, &dx, &dx);
+    num_mul(&t2, &dy, &dy);
+    num_add(&d2, &t1, &t2);
+    
+    // check if circles have same origin.
+    if (num_is_zero_squared(&d2) == 1) {
+        return 0;
     }
     
-    _p_init = 0;
-    mpf_clear(_t1);
-    mpf_clear(_t2);
-    mpf_clear(_t3);
-    mpf_clear(_t4);
-    mpf_clear(_t5);
-    mpf_clear(_t6);
-    mpf_clear(_t7);
-    mpf_clear(_t8);
-    mpf_clear(_t9);
-    mpf_clear(_ta);
-    mpf_clear(_tb);
-    mpf_clear(_tc);
-    mpf_clear(_td);
-    mpf_clear(_te);
-    mpf_clear(_tf);
-    mpf_clear(_tg);
-    mpf_clear(_th);
-    mpf_clear(_ti);
-    mpf_clear(_tj);
-    mpf_clear(_tk);
-    mpf_clear(_tm);
-    mpf_clear(_tn);
-    mpf_clear(_tp);
-    mpf_clear(_tq);
-    mpf_clear(_tr);
-    mpf_clear(_ts);
-    mpf_clear(_tt);
-    mpf_clear(_tu);
-    mpf_clear(_tv);
-    mpf_clear(_tw);
-    mpf_clear(_tx);
-    mpf_clear(_ty);
-    mpf_clear(_tz);
+    // k = r1^2 - r2^2 + d^2
+    num_sub(&t1, &c1->num_r2, &c2->num_r2);
+    num_add(&k, &t1, &d2);
+    
+    // q = 4 * d^2 * r1^2 - k^2
+    num_mul(&t1, &d2, &c1->num_r2);
+    num_mul_ui(&t1, &t1, 4);
+    num_mul(&t2, &k, &k);
+    num_sub(&q, &t1, &t2);
+    
+    cmp = num_compare_zero(&q);
+    
+    if (cmp < 0) {
+        // one circle entirely outside or inside the other
+        return 0;
+    }
+    
+    // inv => 1 / (2 * d^2)
+    num_set_si(&t1, 1);
+    num_mul_ui(&t2, &d2, 2);
+    num_div(&inv, &t1, &t2);
+    
+    // t1 => a / d = k / (2 * d^2)
+    num_mul(&t1, &k, &inv);
+    
+    // p3 = origin + (a / d) * { dx, dy }
+    num_mul(&t2, &dx, &t1);
+    num_add(&x3, &c1->num_cx, &t2);
+    num_mul(&t2, &dy, &t1);
+    num_add(&y3, &c1->num_cy, &t2);
+    
+    if (cmp == 0) {
+        // Circles are tangent, there is only one intersection point.
+        point_reset(p1);
+        num_get_mpf(p1->x, &x3);
+        num_get_mpf(p1->y, &y3);
+        
+        return 1;
+    }
+    
+    // t1 => h / d = sqrt(q) / (2 * d^2)
+    num_sqrt(&t2, &q);
+    num_mul(&t1, &t2, &inv);
+    
+    // { rx, ry } = (h / d) * { -dy, dx }
+    num_mul(&rx, &dy, &t1);
+    num_neg(&rx, &rx);
+    num_mul(&ry, &dx, &t1);
+    
+    point_reset(p1);
+    point_reset(p2);
+    
+    num_add(&t1, &x3, &rx);
+    num_get_mpf(p1->x, &t1);
+    num_add(&t1, &y3, &ry);
+    num_get_mpf(p1->y, &t1);
+    
+    num_sub(&t1, &x3, &rx);
+    num_get_mpf(p2->x, &t1);
+    num_sub(&t1, &y3, &ry);
+    num_get_mpf(p2->y, &t1);
+    
+    return 2;
 }
+#endif
 
 /*
 * Allocates memory for a new circle.
@@ -153,8 +258,6 @@ circle_t* circle_alloc() {
     
     memset(p, 0, sizeof(circle_t));
     
-    p->origin = point_alloc();
-    
     return p;
 }
 
@@ -169,8 +272,7 @@ void circle_init(circle_t* c) {
         return;
     }
     
-    point_init(c->origin);
-    mpf_init(c->radius);
+    mpf_init(c->radius_squared);
     c->is_init = IS_INIT;
 }
 
@@ -185,8 +287,8 @@ void circle_free(circle_t* c) {
         return;
     }
     
-    point_free(c->origin);
-    mpf_clear(c->radius);
+    point_free(c->own_origin);
+    mpf_clear(c->radius_squared);
     c->is_init = 0;
     free(c);
 }
@@ -195,14 +297,34 @@ void circle_free(circle_t* c) {
 * Sets a circle's origin and radius.
 *
 * @c: Circle to set.
-* @origin: Origin point for the circle.
+* @origin: Origin point for the circle. Not copied, see circle_t.
 * @radius: Radius of the circle.
 */
 void circle_set(circle_t* c, point_t* origin, mpf_t radius) {
     assert(c->is_init == IS_INIT);
     
-    point_set(c->origin, origin->x, origin->y);
-    mpf_set(c->radius, radius);
+    c->origin = origin;
+    mpf_mul(c->radius_squared, radius, radius);
+    
+    _circle_prepare(c);
+}
+
+/*
+* Sets a circle's origin and squared radius. This is the
+* cheaper way to set a circle from the distance between two
+* points, since there's no square root.
+*
+* @c: Circle to set.
+* @origin: Origin point for the circle. Not copied, see circle_t.
+* @radius_squared: Radius of the circle, squared.
+*/
+void circle_set_radius_squared(circle_t* c, point_t* origin, mpf_t radius_squared) {
+    assert(c->is_init == IS_INIT);
+    
+    c->origin = origin;
+    mpf_set(c->radius_squared, radius_squared);
+    
+    _circle_prepare(c);
 }
 
 /*
@@ -216,153 +338,131 @@ void circle_set(circle_t* c, point_t* origin, mpf_t radius) {
 void circle_set_si(circle_t* c, intmax_t origin_x, intmax_t origin_y, intmax_t radius) {
     assert(c->is_init == IS_INIT);
     
-    point_set_si(c->origin, origin_x, origin_y);
-    mpf_set_si(c->radius, radius);
+    if (c->own_origin == NULL) {
+        c->own_origin = point_alloc();
+        point_init(c->own_origin);
+    }
+    
+    point_set_si(c->own_origin, origin_x, origin_y);
+    c->origin = c->own_origin;
+    mpf_set_si(c->radius_squared, radius);
+    mpf_mul(c->radius_squared, c->radius_squared, c->radius_squared);
+    
+    _circle_prepare(c);
 }
 
 /*
 * Finds the intersection of a circle and a line.
-* The point_t parameters must be NULL.
-* If an intersection is found, memory is allocated and the result
-* is stored in the point_t paramter.
+* If an intersection is found, the result is written to the point_t
+* paramter, which is owned by the caller. Nothing is allocated. Only
+* the points for the intersections found are changed.
 * There will be zero, one, or two intersections.
 *
+* @ctx: Context holding scratch values.
 * @c: Circle.
 * @n: Line.
-* @pp1: Double pointer to first calculated intersection point.
-* @pp2: Double pointer to second calculated intersection point.
+* @p1: Initialized point to store the first intersection.
+* @p2: Initialized point to store the second intersection.
 *
 * returns: The number of intersection points found.
 */
-int circle_intersection_line(circle_t* c, line_t* n, point_t** pp1, point_t** pp2) {
+int circle_intersection_line(geometry_context_t* ctx, circle_t* c, line_t* n, point_t* p1, point_t* p2) {
+    circle_scratch_t* s = &ctx->circle;
+    
     assert(c->is_init == IS_INIT);
     assert(n->is_init == IS_INIT);
-    assert(*pp1 == NULL);
-    assert(*pp2 == NULL);
+    assert(p1 != NULL);
+    assert(p2 != NULL);
     
     // http://paulbourke.net/geometry/circlesphere/source.cpp
     // from http://paulbourke.net/geometry/circlesphere/
-    // The original C# this is based on is included at the end of the function.
-    
-    point_t* p1;
-    point_t* p2;
-    
-    // _t1 = line.P2.X - line.P1.X;
-    // _t2 = line.P2.Y - line.P1.Y
-    mpf_sub(_t1, n->p2->x, n->p1->x);
-    mpf_sub(_t2, n->p2->y, n->p1->y);
-    
-    // _ta = (_t1)^2 + (_t2)^2;
-    mpf_mul(_t3, _t1, _t1);
-    mpf_mul(_t4, _t2, _t2);
-    mpf_add(_ta, _t3, _t4);
-    
-    // _tb = Context.TWO * (_t1 * (line.P1.X - this.Origin.X) + _t2 * (line.P1.Y - this.Origin.Y));
-    mpf_sub(_t5, n->p1->x, c->origin->x);
-    // _tb = Context.TWO * (_t1 * _t5 + _t2 * (line.P1.Y - this.Origin.Y));
-    mpf_sub(_t6, n->p1->y, c->origin->y);
-    // _tb = Context.TWO * (_t1 * _t5 + _t2 * _t6);
-    mpf_mul(_t7, _t1, _t5);
-    // _tb = Context.TWO * (_t7 + _t2 * _t6);
-    mpf_mul(_t8, _t2, _t6);
-    // _tb = Context.TWO * (_t7 + _t8);
-    mpf_add(_t9, _t7, _t8);
-    // _tb = Context.TWO * _t9;
-    mpf_mul(_tb, g_two, _t9);
-    
-    // _tc = (this.Origin.X)^2 + (this.Origin.Y)^2 + (line.P1.X)^2 + (line.P1.Y)^2 - Context.TWO * (this.Origin.X * line.P1.X + this.Origin.Y * line.P1.Y) - (this.Radius)^2;
-    mpf_mul(_td, c->origin->x, c->origin->x);
-    mpf_mul(_te, c->origin->y, c->origin->y);
-    mpf_mul(_tf, n->p1->x, n->p1->x);
-    mpf_mul(_tg, n->p1->y, n->p1->y);
-    mpf_mul(_th, c->radius, c->radius);
-    // _tc = _td + _te + _tf + _tg - Context.TWO * (this.Origin.X * line.P1.X + this.Origin.Y * line.P1.Y) - _th;
-    mpf_mul(_ti, c->origin->x, n->p1->x);
-    mpf_mul(_tj, c->origin->y, n->p1->y);
-    // _tc = _td + _te + _tf + _tg - Context.TWO * (_ti + _tj) - _th;
-    mpf_add(_tk, _ti, _tj);
-    // _tc = _td + _te + _tf + _tg - Context.TWO * _tk - _th;
-    mpf_mul(_tm, g_two, _tk);
-    // _tc = _td + _te + _tf + _tg - _tm - _th;
-    mpf_add(_tn, _td, _te);
-    // _tc = _tn + _tf + _tg - _tm - _th;
-    mpf_add(_tp, _tn, _tf);
-    // _tc = _tp + _tg - _tm - _th;
-    mpf_add(_tq, _tp, _tg);
-    // _tc = _tq - _tm - _th;
-    mpf_sub(_tr, _tq, _tm);
-    // _tc = _tr - _th;
-    mpf_sub(_tc, _tr, _th);
-    
-    // _tv = _tb * _tb - 4 * _ta * _tc;
-    mpf_mul(_ts, _tb, _tb);
-    mpf_mul(_tt, _ta, _tc);
-    mpf_mul_ui(_tu, _tt, 4);
-    mpf_sub(_tv, _ts, _tu);
-    
-    int cmp = global_compare_zero(_tv);
+    // The original C# this is based on is included at the end of the function,
+    // this version uses the prepared line coefficients instead.
+    
+    // Intersections need the mpf calculation for the coordinates,
+    // so the filter can only skip the no intersection case.
+    if (ctx->use_interval_filter) {
+        if (_filter_circle_x_line(c, n) == 1) {
+            ctx->filter_resolved++;
+            return 0;
+        }
+        
+        ctx->filter_fallback++;
+    }
+    
+#ifdef NUMERIC_KERNELS
+    return _circle_x_line_numeric(c, n, p1, p2);
+#endif
+    
+    if (ctx->low != NULL) {
+        int result = circle_intersection_line(ctx->low, c, n, p1, p2);
+        point_t* points[2] = { p1, p2 };
+        
+        if (geometry_context_low_done(ctx, points, result) == 1) {
+            return 0;
+        }
+    }
+    
+    // The line is prepared as a*x + b*y = c with a^2 + b^2 = 1,
+    // so (a, b) is the unit normal and (-b, a) is the unit direction
+    // from line.P1 towards line.P2.
+    
+    // t1 => dist = a * cx + b * cy - c;
+    // signed distance from the origin to the line.
+    mpf_mul(s->t2, n->a, c->origin->x);
+    mpf_mul(s->t3, n->b, c->origin->y);
+    mpf_add(s->t4, s->t2, s->t3);
+    mpf_sub(s->t1, s->t4, n->c);
+    
+    // t5 => disc = r^2 - dist^2;
+    mpf_mul(s->t2, s->t1, s->t1);
+    mpf_sub(s->t5, c->radius_squared, s->t2);
+    
+    global_guard_band_check(ctx, s->t5, c->radius_squared, s->t2);
+    
+    int cmp = global_compare_zero(s->t5);
     
     if (cmp < 0) {
         // no intersection
         return 0;
-    } else if (cmp == 0) {
-        // one intersection
-        
-        p1 = point_alloc();
-        point_init(p1);
-        
-        // _ty = -(_tb) / (Context.TWO * _ta);
-        mpf_mul(_tw, g_two, _ta);
-        mpf_div(_tx, _tb, _tw);
-        mpf_neg(_ty, _tx);
-        
-        // p1 = { line.P1.X + _ty * _t1, line.P1.Y + _ty * _t2 }
-        mpf_mul(_tz, _ty, _t1);
-        mpf_add(p1->x, n->p1->x, _tz);
+    }
+    
+    // t6, t7 => foot of the perpendicular from the origin to the line
+    // = { cx - a * dist, cy - b * dist }
+    mpf_mul(s->t2, n->a, s->t1);
+    mpf_sub(s->t6, c->origin->x, s->t2);
+    mpf_mul(s->t3, n->b, s->t1);
+    mpf_sub(s->t7, c->origin->y, s->t3);
+    
+    if (cmp == 0) {
+        // one intersection, the line is tangent at the foot.
         
-        // start re-using temp vars
-        mpf_mul(_t3, _ty, _t2);
-        mpf_add(p1->y, n->p1->y, _t3);
+        point_reset(p1);
         
-        *pp1 = p1;
+        point_set(p1, s->t6, s->t7);
         
         return 1;
     } else { 
         // cmp > 0
         // two intersections
-        p1 = point_alloc();
-        p2 = point_alloc();
-        point_init(p1);        
-        point_init(p2);
+        point_reset(p1);
+        point_reset(p2);
         
-        // _t4 = g_two * _ta
-        mpf_mul(_t4, g_two, _ta);
-
-        // _t7 = (-_tb + Math.Sqrt(_tv)) / _t4;
-        mpf_sqrt(_t5, _tv);
-        mpf_sub(_t6, _t5, _tb);
-        mpf_div(_t7, _t6, _t4);
+        // t8 => h = Math.Sqrt(disc);
+        mpf_sqrt(s->t8, s->t5);
         
-        // p1 { line.P1.X + _t7 * _t1, line.P1.Y + _t7 * _t2 }
-        mpf_mul(_t8, _t7, _t1);
-        mpf_add(p1->x, n->p1->x, _t8);
-        mpf_mul(_t9, _t7, _t2);
-        mpf_add(p1->y, n->p1->y, _t9);
-
-        // _tf = (-_tb - Math.Sqrt(_tv)) / _t4;
-        // _t5 = Math.Sqrt(_tv) // from above
-        mpf_add(_td, _tb, _t5);
-        mpf_neg(_te, _td);
-        mpf_div(_tf, _te, _t4);
+        // t9, ta => offset along the line = { -b * h, a * h }
+        mpf_mul(s->t9, n->b, s->t8);
+        mpf_neg(s->t9, s->t9);
+        mpf_mul(s->ta, n->a, s->t8);
         
-        // p2 = { line.P1.X + _tf * (_t1), line.P1.Y + _tf * (_t2) }
-        mpf_mul(_tg, _tf, _t1);
-        mpf_add(p2->x, n->p1->x, _tg);
-        mpf_mul(_th, _tf, _t2);
-        mpf_add(p2->y, n->p1->y, _th);
-            
-        *pp1 = p1;
-        *pp2 = p2;
+        // p1 = foot + offset
+        mpf_add(p1->x, s->t6, s->t9);
+        mpf_add(p1->y, s->t7, s->ta);
+        
+        // p2 = foot - offset
+        mpf_sub(p2->x, s->t6, s->t9);
+        mpf_sub(p2->y, s->t7, s->ta);
         
         return 2;
     }
@@ -445,158 +545,152 @@ int circle_intersection_line(circle_t* c, line_t* n, point_t** pp1, point_t** pp
 
 /*
 * Finds the intersection of a circle and a circle.
-* The point_t parameters must be NULL.
-* If an intersection is found, memory is allocated and the result
-* is stored in the point_t paramter.
+* If an intersection is found, the result is written to the point_t
+* paramter, which is owned by the caller. Nothing is allocated. Only
+* the points for the intersections found are changed.
 * There will be zero, one, or two intersections.
 *
+* @ctx: Context holding scratch values.
 * @c1: First circle.
 * @c2: Second circle.
-* @pp1: Double pointer to first calculated intersection point.
-* @pp2: Double pointer to second calculated intersection point.
+* @p1: Initialized point to store the first intersection.
+* @p2: Initialized point to store the second intersection.
 *
 * returns: the number of intersection points found.
 */
-int circle_intersection_circle(circle_t* c1, circle_t* c2, point_t** pp1, point_t** pp2) {
+int circle_intersection_circle(geometry_context_t* ctx, circle_t* c1, circle_t* c2, point_t* p1, point_t* p2) {
+    circle_scratch_t* s = &ctx->circle;
+    
     assert(c1->is_init == IS_INIT);
     assert(c2->is_init == IS_INIT);
-    assert(*pp1 == NULL);
-    assert(*pp2 == NULL);
+    assert(p1 != NULL);
+    assert(p2 != NULL);
     
-    // The original C# this is based on is included at the end of the function.
+    // The original C# this is based on is included at the end of the function,
+    // this version works from the squared radii.
     
-    point_t* p1;
-    point_t* p2;
-    int delta_sum_cmp;
-    int delta_difference_cmp;
+    int cmp;
     
-    // _t1 => radius_sum = c1->radius + c2->radius;
-    mpf_add(_t1, c1->radius, c2->radius);
+    // Intersections need the mpf calculation for the coordinates,
+    // so the filter can only skip the no intersection cases.
+    if (ctx->use_interval_filter) {
+        if (_filter_circle_x_circle(c1, c2) == 1) {
+            ctx->filter_resolved++;
+            return 0;
+        }
+        
+        ctx->filter_fallback++;
+    }
+    
+#ifdef NUMERIC_KERNELS
+    return _circle_x_circle_numeric(c1, c2, p1, p2);
+#endif
+    
+    if (ctx->low != NULL) {
+        int result = circle_intersection_circle(ctx->low, c1, c2, p1, p2);
+        point_t* points[2] = { p1, p2 };
+        
+        if (geometry_context_low_done(ctx, points, result) == 1) {
+            return 0;
+        }
+    }
     
-    // _t2 => radius_difference = Math.Abs(c1->radius - c2->radius);
-    mpf_sub(_t3, c1->radius, c2->radius);
-    mpf_abs(_t2, _t3);
+    // Working from the squared radii, the C# distance checks
+    // d > radius_sum and d < radius_difference are both covered by
+    // the sign of
+    // q = (radius_sum^2 - d^2) * (d^2 - radius_difference^2)
+    //   = 4 * d^2 * r1^2 - k^2, where k = r1^2 - r2^2 + d^2
+    // and no square root is needed until there are two intersections.
     
-    // _t3 => dx = c2->origin->x - c1->origin->x;
-    mpf_sub(_t3, c2->origin->x, c1->origin->x);
+    // t1 => dx = c2->origin->x - c1->origin->x;
+    mpf_sub(s->t1, c2->origin->x, c1->origin->x);
     
-    // _t4 => dy = c2->origin->y - c1->origin->y;
-    mpf_sub(_t4, c2->origin->y, c1->origin->y);
+    // t2 => dy = c2->origin->y - c1->origin->y;
+    mpf_sub(s->t2, c2->origin->y, c1->origin->y);
     
-    // _t5 => d = Measure.CheckedDistance(c1->origin, c2->origin);
-    point_distance(_t5, c1->origin, c2->origin);
+    // t3 => d^2 = dx^2 + dy^2
+    mpf_mul(s->t4, s->t1, s->t1);
+    mpf_mul(s->t5, s->t2, s->t2);
+    mpf_add(s->t3, s->t4, s->t5);
     
     // check if circles have same origin. 
-    if (global_is_zero(_t5) == 1) {
+    global_guard_band_check_squared(ctx, s->t3);
+    
+    if (global_is_zero_squared(s->t3) == 1) {
         return 0;
     }
     
-    // delta_sum_cmp = d ?? radius_sum
-    delta_sum_cmp = global_compare2(_t5, _t1);
+    // t4 => k = r1^2 - r2^2 + d^2
+    mpf_sub(s->t5, c1->radius_squared, c2->radius_squared);
+    mpf_add(s->t4, s->t5, s->t3);
     
-    if (delta_sum_cmp > 0) {
-        // d > radius_sum
-        // one circle entirely outside the other
-        return 0;
-    }
+    // t5 => q = 4 * d^2 * r1^2 - k^2
+    mpf_mul(s->t6, s->t3, c1->radius_squared);
+    mpf_mul_ui(s->t7, s->t6, 4);
+    mpf_mul(s->t8, s->t4, s->t4);
+    mpf_sub(s->t5, s->t7, s->t8);
     
-    // delta_difference_cmp = d ?? radius_difference
-    delta_difference_cmp = global_compare2(_t5, _t2);
+    global_guard_band_check(ctx, s->t5, s->t7, s->t8);
     
-    if (delta_difference_cmp < 0)
-    {
-        // d < radius_difference
-        // one circle entirely inside the other
+    cmp = global_compare_zero(s->t5);
+    
+    if (cmp < 0) {
+        // one circle entirely outside or inside the other
         return 0;
     }
     
     // If the circles intersect at two points, a line can be drawn
     // between these two points perpendicular to the line between
     // the two origins. Call the intersection of these two lines point p3 = (x3,y3).
-    // a = distance from first circle to p3
-    
-    // a = ((c1->radius * c1->radius) - (c2->radius * c2->radius) + (d * d)) / (Context.TWO * d);
-    
-    // _t6 = c1->radius * c1->radius
-    mpf_mul(_t6, c1->radius, c1->radius);
-    // _t7 = c2->radius * c2->radius
-    mpf_mul(_t7, c2->radius, c2->radius);
-    // _t8 = d * d 
-    mpf_mul(_t8, _t5, _t5);
-    
-    // a = (_t6 - _t7 + _t8) / (Context.TWO * d);
-    mpf_sub(_t9, _t6, _t7);
-    // a = (_t9 + _t8) / (Context.TWO * d);
-    mpf_add(_ta, _t9, _t8);
-    // a = _ta / (Context.TWO * d);
-    mpf_mul(_t9, g_two, _t5);
-    // _tb => a = _ta / _t9;
-    mpf_div(_tb, _ta, _t9);
-    
-    // _te => x3 = c1->origin->x + (dx * a / d);
-    // _tf => y3 = c1->origin->y + (dy * a / d);
-    mpf_mul(_tc, _t3, _tb);
-    mpf_div(_td, _tc, _t5);
-    mpf_add(_te, c1->origin->x, _td);
-    
-    mpf_mul(_tc, _t4, _tb);
-    mpf_div(_td, _tc, _t5);
-    mpf_add(_tf, c1->origin->y, _td);
-    
-    if (delta_sum_cmp == 0 || delta_difference_cmp == 0) {
+    // a = distance from first circle to p3 = k / (2 * d)
+    
+    // t6 => 1 / (2 * d^2)
+    mpf_mul(s->t7, g_two, s->t3);
+    mpf_ui_div(s->t6, 1, s->t7);
+    
+    // t7 => a / d = k / (2 * d^2)
+    mpf_mul(s->t7, s->t4, s->t6);
+    
+    // t8 => x3 = c1->origin->x + (dx * a / d);
+    // t9 => y3 = c1->origin->y + (dy * a / d);
+    mpf_mul(s->ta, s->t1, s->t7);
+    mpf_add(s->t8, c1->origin->x, s->ta);
+    mpf_mul(s->ta, s->t2, s->t7);
+    mpf_add(s->t9, c1->origin->y, s->ta);
+    
+    if (cmp == 0) {
         // Circles are tangent, there is only one intersection point.
         
-        p1 = point_alloc();
-        point_init(p1);
+        point_reset(p1);
         
-        point_set(p1, _te, _tf);
-        
-        *pp1 = p1;
+        point_set(p1, s->t8, s->t9);
 
         return 1;
     }
     
-    // last cases, two intersection points:
-    // d > Max(this.Radius, other.Radius)
-    // d < Max(this.Radius, other.Radius) && d > radius_difference
-    
-    // h = distance from p3 to an intersection
-    // _ti => h = Math.Sqrt((c1->radius * c1->radius) - (a * a));
-    // _tg => a * a
-    mpf_mul(_tg, _tb, _tb);
-    // found c1->radius squared above: _t6 = c1->radius * c1->radius
-    mpf_sub(_th, _t6, _tg);
-    // _ti = Math.Sqrt(_th)
-    mpf_sqrt(_ti, _th);
+    // h = distance from p3 to an intersection, h / d = sqrt(q) / (2 * d^2)
+    // tb => h / d
+    mpf_sqrt(s->ta, s->t5);
+    mpf_mul(s->tb, s->ta, s->t6);
 
     // This is the offset from p3 to the intersection points
-    // _tm => rx = -dy * (h / d);
-    mpf_neg(_tj, _t4);
-    mpf_mul(_tk, _tj, _ti);
-    mpf_div(_tm, _tk, _t5);
-    // _tn => ry = dx * (h / d);
-    mpf_mul(_tj, _t3, _ti);
-    mpf_div(_tn, _tj, _t5);
+    // tc => rx = -dy * (h / d);
+    mpf_mul(s->tc, s->t2, s->tb);
+    mpf_neg(s->tc, s->tc);
+    // td => ry = dx * (h / d);
+    mpf_mul(s->td, s->t1, s->tb);
 
     // p1 = new Point2(x3 + rx, y3 + ry);
     // p2 = new Point2(x3 - rx, y3 - ry);
     
-    mpf_add(_tp, _te, _tm);
-    mpf_add(_tq, _tf, _tn);
+    point_reset(p1);
+    point_reset(p2);
     
-    mpf_sub(_tr, _te, _tm);
-    mpf_sub(_ts, _tf, _tn);
+    mpf_add(p1->x, s->t8, s->tc);
+    mpf_add(p1->y, s->t9, s->td);
     
-    p1 = point_alloc();
-    p2 = point_alloc();
-    point_init(p1);
-    point_init(p2);
-    
-    point_set(p1, _tp, _tq);
-    point_set(p2, _tr, _ts);
-    
-    *pp1 = p1;
-    *pp2 = p2;
+    mpf_sub(p2->x, s->t8, s->tc);
+    mpf_sub(p2->y, s->t9, s->td);
     
     return 2;
     
@@ -693,7 +787,12 @@ int circle_intersection_circle(circle_t* c1, circle_t* c2, point_t** pp1, point_
 * @n_digits: Precision to be used by gmp_printf.
 */
 void circle_printf(circle_t* c, size_t n_digits) {
-    gmp_printf("{%.*Ff, %.*Ff} -> {%.*Ff}", n_digits, c->origin->x, n_digits, c->origin->y, n_digits, c->radius);
+    mpf_t radius;
+    
+    mpf_init(radius);
+    mpf_sqrt(radius, c->radius_squared);
+    gmp_printf("{%.*Ff, %.*Ff} -> {%.*Ff}", n_digits, c->origin->x, n_digits, c->origin->y, n_digits, radius);
+    mpf_clear(radius);
 }
 
 /*
@@ -704,5 +803,6 @@ void circle_printf(circle_t* c, size_t n_digits) {
 * @n_digits: Precision to be used by gmp_printf.
 */
 void circle_printfn(circle_t* c, size_t n_digits) {
-    gmp_printf("{%.*Ff, %.*Ff} -> {%.*Ff}\n", n_digits, c->origin->x, n_digits, c->origin->y, n_digits, c->radius);
+    circle_printf(c, n_digits);
+    printf("\n");
 }
\ No newline at end of file
@@ -12,32 +12,46 @@
 #include <gmp.h>
 #include <stdint.h>
 
+#include "geometry_context.h"
+#include "numeric.h"
+#include "interval.h"
 #include "point.h"
 #include "line.h"
 #include "circle.h"
 
 // Circle is defined by the origin point, and a radius.
+// Only the squared radius is kept, the kernels never need the radius
+// itself. The interval values, and the numeric backend values
+// with NUMERIC_KERNELS, are prepared by the set methods, so the circle must
+// not be changed except through those.
+// The origin is borrowed from the point given to circle_set, that
+// point must not be changed or freed while the circle is in use.
 typedef struct circle {
     // Origin of the circle.
     point_t* origin;
     
-    // Radius of the circle.
-    mpf_t radius;
+    // Point owned by the circle, used as the origin by circle_set_si.
+    point_t* own_origin;
+    
+    // Radius of the circle, squared.
+    mpf_t radius_squared;
+    
+    // Interval copies of origin x, origin y, and radius squared.
+    interval_t icx;
+    interval_t icy;
+    interval_t ir2;
+    
+#ifdef NUMERIC_KERNELS
+    // Numeric backend copies of origin x, origin y, and radius squared.
+    num_t num_cx;
+    num_t num_cy;
+    num_t num_r2;
+#endif
     
     // Whether or not this object has been initialized.
     int is_init;
 } circle_t;
 
-/*
-* Initializes some static variables.
-*/
-void global_circle_init();
-
-/*
-* Frees memory used by static variables.
-*/
-void global_circle_free();
-
 /*
 * Allocates memory for a new circle.
 *
@@ -63,11 +77,22 @@ void circle_free(circle_t* c);
 * Sets a circle's origin and radius.
 *
 * @c: Circle to set.
-* @origin: Origin point for the circle.
+* @origin: Origin point for the circle. Not copied, see circle_t.
 * @radius: Radius of the circle.
 */
 void circle_set(circle_t* c, point_t* origin, mpf_t radius);
 
+/*
+* Sets a circle's origin and squared radius. This is the
+* cheaper way to set a circle from the distance between two
+* points, since there's no square root.
+*
+* @c: Circle to set.
+* @origin: Origin point for the circle. Not copied, see circle_t.
+* @radius_squared: Radius of the circle, squared.
+*/
+void circle_set_radius_squared(circle_t* c, point_t* origin, mpf_t radius_squared);
+
 /*
 * Sets a circle's origin and radius via int.
 *
@@ -80,35 +105,37 @@ void circle_set_si(circle_t* c, intmax_t origin_x, intmax_t origin_y, intmax_t r
 
 /*
 * Finds the intersection of a circle and a line.
-* The point_t parameters must be NULL.
-* If an intersection is found, memory is allocated and the result
-* is stored in the point_t paramter.
+* If an intersection is found, the result is written to the point_t
+* paramter, which is owned by the caller. Nothing is allocated. Only
+* the points for the intersections found are changed.
 * There will be zero, one, or two intersections.
 *
+* @ctx: Context holding scratch values.
 * @c: Circle.
 * @n: Line.
-* @pp1: Double pointer to first calculated intersection point.
-* @pp2: Double pointer to second calculated intersection point.
+* @p1: Initialized point to store the first intersection.
+* @p2: Initialized point to store the second intersection.
 *
 * returns: The number of intersection points found.
 */
-int circle_intersection_line(circle_t* c, line_t* n, point_t** pp1, point_t** pp2);
+int circle_intersection_line(geometry_context_t* ctx, circle_t* c, line_t* n, point_t* p1, point_t* p2);
 
 /*
 * Finds the intersection of a circle and a circle.
-* The point_t parameters must be NULL.
-* If an intersection is found, memory is allocated and the result
-* is stored in the point_t paramter.
+* If an intersection is found, the result is written to the point_t
+* paramter, which is owned by the caller. Nothing is allocated. Only
+* the points for the intersections found are changed.
 * There will be zero, one, or two intersections.
 *
+* @ctx: Context holding scratch values.
 * @c1: First circle.
 * @c2: Second circle.
-* @pp1: Double pointer to first calculated intersection point.
-* @pp2: Double pointer to second calculated intersection point.
+* @p1: Initialized point to store the first intersection.
+* @p2: Initialized point to store the second intersection.
 *
 * returns: the number of intersection points found.
 */
-int circle_intersection_circle(circle_t* c1, circle_t* c2, point_t** pp1, point_t** pp2);
+int circle_intersection_circle(geometry_context_t* ctx, circle_t* c1, circle_t* c2, point_t* p1, point_t* p2);
 
 /*
 * Writes the line to stdout in "the usual way."
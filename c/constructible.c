@@ -18,12 +18,21 @@
 #include "mysql_common.h"
 #include "datamodel.h"
 #include "global.h"
+#include "geometry_context.h"
 #include "point.h"
+#include "point_table.h"
+#include "point_shards.h"
+#include "point_runs.h"
+#include "point_grid.h"
 #include "line.h"
 #include "circle.h"
+#include "numeric.h"
+#include "pair.h"
+#include "object_table.h"
 #include "test.h"
 #include "list.h"
 #include "ini.h"
+#include "work_pool.h"
 
 app_config_t* _app_config;
 
@@ -31,8 +40,20 @@ app_config_t* _app_config;
 uint8_t _current_iteration = 0;
 int8_t _v = 0;
 
-// global memory cache of known points
-point_t* _p_point_hash = NULL;
+// global memory cache of known points. One table shared by the worker
+// threads, or with DEDUP_SHARDS one table for each shard.
+point_table_t** _p_point_tables = NULL;
+size_t _p_point_table_count = 0;
+
+// Threads owning the tables, with DEDUP_SHARDS.
+point_shards_t* _p_point_shards = NULL;
+
+// Candidate points written to disk, with EXTERNAL_DEDUP_DIRECTORY.
+point_runs_t* _p_point_runs = NULL;
+
+// Points found so far, for the low precision pass, with
+// ADAPTIVE_PRECISION_BITS.
+point_grid_t* _p_point_grid = NULL;
 
 // Variables for watching elapsed time since last 
 // status update.
@@ -43,28 +64,182 @@ struct timespec _benchmark_time;
 struct timespec _checkpoint_time;
 time_t _total_elapsed;
 
-int add_to_known_and_free(db_context_t* context, point_t** p);
-int add_line_x_line(db_context_t* context, line_t*, line_t*);
-int add_circle_x_line(db_context_t* context, circle_t*, line_t*);
-int add_circle_x_circle(db_context_t* context, circle_t*, circle_t*);
+// Working set for the current task. The list nodes are copied to
+// an array so workers can find points by position.
+// Work pool chunks are (p2, p3) positions, or (p2, SELF_INTERSECTION_CHUNK)
+// for the self intersections of the pair (p1, p2).
+// With ENUMERATE_OBJECTS, chunks are [a, b) ranges of object pairs.
+#define SELF_INTERSECTION_CHUNK ((size_t)-1)
+
+// Number of object pairs in one chunk, with ENUMERATE_OBJECTS.
+#define OBJECT_PAIR_CHUNK 4096
 
-void empty_point_hash_and_free(point_t** pph) {
+typedef struct enumerate_job {
+    single_linked_list_t** nodes;
+    size_t node_count;
+    size_t node_capacity;
+    
+    // Position of the checked out point (p1) in nodes.
+    size_t p1_position;
+    
+    // Distinct lines and circles of the working set, with ENUMERATE_OBJECTS.
+    // Built once for each iteration.
+    object_table_t* objects;
+    uint8_t objects_iteration;
+    
+    // Points of the working set the objects were built from, sorted by
+    // point_id, without duplicates. There is one task for each point,
+    // the position of the task's point gives its share of the object pairs.
+    point_t** object_points;
+    size_t object_point_count;
+} enumerate_job_t;
+
+// State for one thread constructing points.
+typedef struct enumerate_worker {
+    enumerate_job_t* job;
     
-    point_t* head = *pph;
-    point_t* p1;
-    point_t* p2;
+    // scratch values for the geometry calculations
+    geometry_context_t* geometry;
+    
+    // Lines and circles generated from (p1, p2) and (p3, p4), reused
+    // for every pair the worker handles.
+    pair_t* left;
+    pair_t* right;
+    
+    // Points the intersection kernels write their results to. A result
+    // only leaves this array when it's a new point, see add_to_known.
+    point_t* results[PAIR_INTERSECTION_MAX];
+    
+    // When more than one thread is running, every worker adds points to
+    // the memory cache, or sends them to the shards. Only the main thread
+    // writes them to the database, after all workers are done.
+    int is_threaded;
+    
+    // Index of the worker thread, the producer index for the shards.
+    size_t index;
+    
+    // Squared distances between points, circles are built from these
+    // without taking the square root.
+    mpf_t d1, d2, dp13, dp24;
+    
+    // Number of times the inner p4 loop has run.
+    size_t loop4_count;
+    
+    // Number of pairs the self intersections have been found for.
+    size_t self_count;
+    
+    // Number of object pairs intersected, with ENUMERATE_OBJECTS.
+    size_t object_pair_count;
+    
+    // Number of points added to the database.
+    size_t newly_added_points;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} enumerate_worker_t;
+
+enumerate_worker_t* enumerate_worker_alloc();
+void enumerate_worker_init(enumerate_worker_t* worker, enumerate_job_t* job, int is_threaded);
+void enumerate_worker_free(enumerate_worker_t* worker);
+int enumerate_pair_self(enumerate_worker_t* worker, size_t p2_position);
+int enumerate_pair_chunk(enumerate_worker_t* worker, size_t p2_position, size_t p3_position);
+int enumerate_compare_point_id(const void* a, const void* b);
+void enumerate_object_tables(enumerate_worker_t* worker, uint8_t iteration, int reuse);
+size_t enumerate_object_share(size_t total, size_t task, size_t task_count);
+int enumerate_object_chunk(enumerate_worker_t* worker, size_t start, size_t end);
+void enumerate_pair_chunk_callback(void* worker_data, work_chunk_t* chunk);
+
+point_record_t* known_add(geometry_context_t* ctx, point_t* p);
+point_record_t* known_find(geometry_context_t* ctx, point_t* p);
+int known_low_find(void* data, point_t** points, int count);
+size_t known_point_count();
+point_record_t* known_next(size_t* table_index, size_t* position);
+int add_to_known(enumerate_worker_t* worker, point_t** p);
+int add_to_known_cache(enumerate_worker_t* worker, point_t** p);
+int known_runs_merge(enumerate_worker_t* worker);
+int add_results_to_known(enumerate_worker_t* worker, int count);
+int add_line_x_line(enumerate_worker_t* worker, line_t*, line_t*);
+int add_circle_x_line(enumerate_worker_t* worker, circle_t*, line_t*);
+int add_circle_x_circle(enumerate_worker_t* worker, circle_t*, circle_t*);
+int add_pair_x_pair(enumerate_worker_t* worker, pair_t*, pair_t*, int shared_index);
+int add_pair_self(enumerate_worker_t* worker, pair_t*);
+
+/*
+* Adds a point to the memory cache, see point_table_add. With shards,
+* the point goes in the table of its shard, see point_shards_add.
+*
+* returns: NULL if the point was added, otherwise the record equal to p.
+*/
+point_record_t* known_add(geometry_context_t* ctx, point_t* p) {
+    if (_p_point_shards == NULL) {
+        return point_table_add(ctx, _p_point_tables[0], p);
+    }
+    
+    return point_shards_add(_p_point_shards, ctx, p);
+}
+
+/*
+* Finds a point in the memory cache, see point_table_find.
+*
+* returns: Record equal to p, or NULL.
+*/
+point_record_t* known_find(geometry_context_t* ctx, point_t* p) {
+    if (_p_point_shards == NULL) {
+        return point_table_find(ctx, _p_point_tables[0], p);
+    }
+    
+    return point_shards_find(_p_point_shards, ctx, p);
+}
+
+/*
+* Method called by the low precision pass of an intersection, see
+* geometry_context_t.low_known.
+*/
+int known_low_find(void* data, point_t** points, int count) {
+    return point_grid_known((point_grid_t*)data, points, count);
+}
+
+/*
+* Number of points in the memory cache, over all the tables.
+*
+* returns: number of points.
+*/
+size_t known_point_count() {
+    size_t result = 0;
+    size_t i;
+    
+    for (i=0; i<_p_point_table_count; i++) {
+        result += point_table_count(_p_point_tables[i]);
+    }
+    
+    return result;
+}
+
+/*
+* Iterates the point records in the memory cache, over all the tables.
+*
+* @table_index: Set to 0 before the first call, updated by each call.
+* @position: Set to 0 before the first call, updated by each call.
+*
+* returns: Next record, or NULL after the last record.
+*/
+point_record_t* known_next(size_t* table_index, size_t* position) {
+    point_record_t* r;
     
-    HASH_ITER(hh, head, p1, p2) {
-        HASH_DEL(head, p1);
-        point_free(p1);
+    while (*table_index < _p_point_table_count) {
+        r = point_table_next(_p_point_tables[*table_index], position);
+        if (r != NULL) {
+            return r;
+        }
+        
+        (*table_index)++;
+        *position = 0;
     }
-    // need to reset the head or get a segmentation fault ...
-    *pph = NULL;
+    
+    return NULL;
 }
 
-int add_line_x_line(db_context_t* context, line_t* line_one, line_t* line_two) {
-    point_t* ip1 = NULL;
-    int newly_added_points = 0;
+int add_line_x_line(enumerate_worker_t* worker, line_t* line_one, line_t* line_two) {
     int result = 0;
     
     if (_app_config->print_object_description_in_intersection_check) {
@@ -74,21 +249,16 @@ int add_line_x_line(db_context_t* context, line_t* line_one, line_t* line_two) {
         line_printfn(line_two, _app_config->print_digits);
     }
     
-    result = line_intersection_line(line_one, line_two, &ip1);
+    result = line_intersection_line(worker->geometry, line_one, line_two, worker->results[0]);
     
     if (_app_config->print_number_intersections_found) {
         printf("%d intersections found.\n", result);
     }
     
-    newly_added_points += add_to_known_and_free(context, &ip1);
-    
-    return newly_added_points;
+    return add_results_to_known(worker, result);
 }
 
-int add_circle_x_line(db_context_t* context, circle_t* c1, line_t* line) {
-    point_t* ip1 = NULL;
-    point_t* ip2 = NULL;
-    int newly_added_points = 0;
+int add_circle_x_line(enumerate_worker_t* worker, circle_t* c1, line_t* line) {
     int result = 0;
     
     if (_app_config->print_object_description_in_intersection_check) {
@@ -98,22 +268,16 @@ int add_circle_x_line(db_context_t* context, circle_t* c1, line_t* line) {
         line_printfn(line, _app_config->print_digits);
     }
     
-    result = circle_intersection_line(c1, line, &ip1, &ip2);
+    result = circle_intersection_line(worker->geometry, c1, line, worker->results[0], worker->results[1]);
 
     if (_app_config->print_number_intersections_found) {
         printf("%d intersections found.\n", result);
     }
 
-    newly_added_points += add_to_known_and_free(context, &ip1);
-    newly_added_points += add_to_known_and_free(context, &ip2);
-    
-    return newly_added_points;
+    return add_results_to_known(worker, result);
 }
 
-int add_circle_x_circle(db_context_t* context, circle_t* c1, circle_t* c2) {
-    point_t* ip1 = NULL;
-    point_t* ip2 = NULL;
-    int newly_added_points = 0;
+int add_circle_x_circle(enumerate_worker_t* worker, circle_t* c1, circle_t* c2) {
     int result = 0;
     
     if (_app_config->print_object_description_in_intersection_check) {
@@ -123,26 +287,42 @@ int add_circle_x_circle(db_context_t* context, circle_t* c1, circle_t* c2) {
         circle_printfn(c2, _app_config->print_digits);
     }
     
-    result = circle_intersection_circle(c1, c2, &ip1, &ip2);
+    result = circle_intersection_circle(worker->geometry, c1, c2, worker->results[0], worker->results[1]);
 
     if (_app_config->print_number_intersections_found) {
         printf("%d intersections found.\n", result);
     }
 
-    newly_added_points += add_to_known_and_free(context, &ip1);
-    newly_added_points += add_to_known_and_free(context, &ip2);
+    return add_results_to_known(worker, result);
+}
+
+int add_pair_x_pair(enumerate_worker_t* worker, pair_t* left, pair_t* right, int shared_index) {
+    int result = 0;
+    
+    result = pair_intersection_pair(worker->geometry, left, right, shared_index, worker->results);
+    
+    return add_results_to_known(worker, result);
+}
+
+int add_pair_self(enumerate_worker_t* worker, pair_t* pair) {
+    int result = 0;
     
-    return newly_added_points;
+    result = pair_self_intersection(worker->geometry, pair, worker->results);
+    
+    return add_results_to_known(worker, result);
 }
 
 int db_point_cache_flush(db_context_t* context) {
-    point_t* p1;
-    point_t* p2;
+    point_record_t* r;
     int result = 0;
     size_t lookup_count;
     size_t iteration = 0;
+    size_t table_index = 0;
+    size_t position = 0;
+    size_t keep;
+    size_t evicted = 0;
     
-    lookup_count = HASH_COUNT(_p_point_hash);
+    lookup_count = known_point_count();
     if (lookup_count == 0) {
         return 0;
     }
@@ -154,7 +334,7 @@ int db_point_cache_flush(db_context_t* context) {
     mysql_autocommit(context->connection->con, 0);
     mysql_lock_table(context->connection, context->db_table_name_known);
     
-    HASH_ITER(hh, _p_point_hash, p1, p2) {
+    while ((r = known_next(&table_index, &position)) != NULL) {
         iteration++;
         
         clock_gettime(CLOCK_MONOTONIC, &_ts_current);
@@ -172,9 +352,9 @@ int db_point_cache_flush(db_context_t* context) {
             );
         }
         
-        if (p1->in_datastore == 0) {
+        if (r->point != NULL && r->point->in_datastore == 0) {
             
-            single_linked_list_add(&points, p1, sizeof(single_linked_list_t));
+            single_linked_list_add(&points, r->point, sizeof(single_linked_list_t));
             
             // Max number of points to write in one sql command
             if (points->index == 31) {
@@ -193,15 +373,27 @@ int db_point_cache_flush(db_context_t* context) {
         ;
     points = NULL;
     
-    lookup_count = HASH_COUNT(_p_point_hash);
+    // Only the records are needed once the points are written.
+    table_index = 0;
+    position = 0;
+    while ((r = known_next(&table_index, &position)) != NULL) {
+        if (r->point != NULL && r->point->in_datastore == 1) {
+            point_record_compact(r);
+        }
+    }
+    
+    // Every point is in the database now. Evict down to 3/4 full, so
+    // the points found most often stay cached and there's room for new
+    // points before the next flush.
+    lookup_count = known_point_count();
     if (lookup_count >= _app_config->max_point_cache) {
-        printf("known point hash full. Clearing and freeing contents.\n");
+        keep = _app_config->max_point_cache / 4 * 3 / _p_point_table_count;
         
-        HASH_ITER(hh, _p_point_hash, p1, p2) {
-            HASH_DEL(_p_point_hash, p1);
-            point_free(p1);
+        for (table_index=0; table_index<_p_point_table_count; table_index++) {
+            evicted += point_table_evict(_p_point_tables[table_index], keep);
         }
         
+        printf("known point cache full, evicted %zu of %zu points.\n", evicted, lookup_count);
     }
     
     db_context_commit(context);
@@ -214,63 +406,655 @@ int db_point_cache_flush(db_context_t* context) {
     return result;
 }
 
-// returns the number of added points
-int add_to_known_and_free(db_context_t* context, point_t** p) {
+/*
+* Adds a candidate point to the known points. With EXTERNAL_DEDUP_DIRECTORY
+* the point is copied to the worker's run buffer, and the caller keeps it.
+* It's added to the known points by known_runs_merge at the end of the task.
+* Otherwise see add_to_known_cache.
+*
+* returns: the number of points added to the database.
+*/
+int add_to_known(enumerate_worker_t* worker, point_t** p) {
+    if (*p == NULL) {
+        return 0;
+    }
+    
+    if (_p_point_runs != NULL) {
+        point_runs_add(_p_point_runs, worker->index, *p);
+        return 0;
+    }
+    
+    return add_to_known_cache(worker, p);
+}
+
+/*
+* Probes the known points for the point, and keeps it if it's new.
+* The known points are checked before anything is allocated, a point
+* that is already known is left with the caller.
+* If the point is kept (a record of it is added to the point table),
+* *p is set to NULL and the point is no longer owned by the caller. Otherwise the caller
+* still owns the point, and can reuse it.
+* Worker threads add to the point table at the same time, the main
+* thread flushes it to the database once they're done.
+*
+* returns: the number of points added to the database.
+*/
+int add_to_known_cache(enumerate_worker_t* worker, point_t** p) {
+    db_context_t* context = _app_config->context;
     point_t* ip = *p;
     int result = 0;
-    size_t lookup_count;
-    point_t* lookup_point;
-    int free_point = 1;
+    point_record_t* lookup_record;
     
     if (ip == NULL) {
         return 0;
     }
     
-    point_ensure_hash(ip);
+    if (worker->is_threaded == 0 && _app_config->max_point_cache == 0) {
+        return db_insert_known_set(context, ip);
+    }
     
-    if (_app_config->max_point_cache > 0) {
-        //printf("looking up point in cache: %s\n", ip->hash_key);
-        HASH_FIND_STR(_p_point_hash, ip->hash_key, lookup_point);
-        if (lookup_point != NULL) {
-            //printf("found point in memory\n");
-            point_free(ip);
-            *p = NULL;
+    if (worker->is_threaded == 1 && _p_point_shards != NULL) {
+        point_shards_push(_p_point_shards, worker->index, worker->geometry, ip);
+        
+        *p = NULL;
+        return 0;
+    }
+    
+    // Workers can't flush, the main thread does that when they're done.
+    if (worker->is_threaded == 0
+            && known_point_count() >= _app_config->max_point_cache) {
+        lookup_record = known_find(worker->geometry, ip);
+        if (lookup_record != NULL) {
             return 0;
         }
-            
-        lookup_count = HASH_COUNT(_p_point_hash);
         
-        if (lookup_count >= _app_config->max_point_cache) {
-            result = db_point_cache_flush(context);
+        result = db_point_cache_flush(context);
+    }
+    
+    lookup_record = known_add(worker->geometry, ip);
+    if (lookup_record != NULL) {
+        //printf("found point in memory\n");
+        return 0;
+    }
+    
+    *p = NULL;
+    
+    return result;
+}
+
+/*
+* Merges the candidate points in the run files, and adds each unique
+* point to the known points, see add_to_known_cache. Must be called on
+* the main thread, after the workers are done.
+*
+* returns: the number of points added to the database.
+*/
+int known_runs_merge(enumerate_worker_t* worker) {
+    point_t* p = NULL;
+    int result = 0;
+    
+    if (_p_point_runs == NULL) {
+        return 0;
+    }
+    
+    point_runs_merge(_p_point_runs, worker->geometry);
+    
+    while (1) {
+        if (p == NULL) {
+            p = point_take(worker->geometry);
+        }
+        
+        if (point_runs_next(_p_point_runs, p) == 0) {
+            break;
         }
         
-        //printf("add point to cache       : %s\n", ip->hash_key);
-        HASH_ADD_KEYPTR(
-            hh,
-            _p_point_hash,
-            ip->hash_key,
-            ip->hash_key_length,
-            ip);
+        result += add_to_known_cache(worker, &p);
+    }
+    
+    point_release(worker->geometry, p);
+    
+    return result;
+}
 
-        free_point = 0;
-    } else {
-        result = db_insert_known_set(context, ip);
+/*
+* Adds the first count points of worker->results to the known points.
+* A persistent point is only taken when a result is kept, to replace
+* it in the results array.
+*
+* returns: the number of points added to the database.
+*/
+int add_results_to_known(enumerate_worker_t* worker, int count) {
+    int result = 0;
+    int i;
+    
+    // Find the hash keys first, so the slots for all the results are
+    // loaded while the keys are compared.
+    if (_p_point_shards == NULL && _p_point_runs == NULL
+            && (worker->is_threaded == 1 || _app_config->max_point_cache > 0)) {
+        point_table_prefetch(_p_point_tables[0], worker->results, count);
     }
     
-    if (free_point > 0) {
-        point_free(ip);
-        *p = NULL;
+    for (i=0; i<count; i++) {
+        // Before add_to_known, which can take the point.
+        if (_p_point_grid != NULL) {
+            point_grid_add(_p_point_grid, worker->results[i]);
+        }
+        
+        result += add_to_known(worker, &worker->results[i]);
+        
+        if (worker->results[i] == NULL) {
+            worker->results[i] = point_take(worker->geometry);
+        }
     }
     
     return result;
 }
 
-void load_starting_points(single_linked_list_t** p_starting_set, char* filename, size_t line_buffer_size) {
+enumerate_worker_t* enumerate_worker_alloc() {
+    enumerate_worker_t* worker = malloc(sizeof(enumerate_worker_t));
+    int i;
+    global_exit_if_null(worker, "Fatal error calling malloc for enumerate_worker_t.\n");
+    memset(worker, 0, sizeof(enumerate_worker_t));
+    
+    worker->geometry = geometry_context_alloc();
+    worker->left = pair_alloc();
+    worker->right = pair_alloc();
+    
+    for (i=0; i<PAIR_INTERSECTION_MAX; i++) {
+        worker->results[i] = point_alloc();
+    }
+    
+    return worker;
+}
+
+void enumerate_worker_init(enumerate_worker_t* worker, enumerate_job_t* job, int is_threaded) {
+    int i;
+    
+    if (worker->is_init == IS_INIT) {
+        return;
+    }
+    
+    worker->job = job;
+    worker->is_threaded = is_threaded;
+    
+    geometry_context_init(worker->geometry);
+    if (_app_config->adaptive_precision_bits > 0) {
+        geometry_context_init_low(worker->geometry, _app_config->adaptive_precision_bits, _app_config->str_adaptive_guard_band);
+        worker->geometry->low_known = known_low_find;
+        worker->geometry->low_known_data = _p_point_grid;
+    }
+    pair_init(worker->left);
+    pair_init(worker->right);
+    
+    for (i=0; i<PAIR_INTERSECTION_MAX; i++) {
+        point_init(worker->results[i]);
+    }
+    
+    mpf_init(worker->d1);
+    mpf_init(worker->d2);
+    mpf_init(worker->dp13);
+    mpf_init(worker->dp24);
+    
+    worker->is_init = IS_INIT;
+}
+
+void enumerate_worker_free(enumerate_worker_t* worker) {
+    int i;
+    
+    if (worker == NULL) {
+        return;
+    }
+    
+    if (worker->is_init == IS_INIT) {
+        pair_free(worker->left);
+        pair_free(worker->right);
+        
+        for (i=0; i<PAIR_INTERSECTION_MAX; i++) {
+            point_free(worker->results[i]);
+            worker->results[i] = NULL;
+        }
+        
+        mpf_clear(worker->d1);
+        mpf_clear(worker->d2);
+        mpf_clear(worker->dp13);
+        mpf_clear(worker->dp24);
+        
+        worker->is_init = 0;
+    }
+    
+    geometry_context_free(worker->geometry);
+    free(worker);
+}
+
+/*
+* Constructs the self intersections of the pair (p1, p2), that is the
+* line and circles of the pair intersected with each other. Every pair
+* is the (p1, p2) pair of exactly one task, so over an iteration this
+* finds the self intersections of each pair once.
+*
+* returns: 0, for the same use as enumerate_pair_chunk.
+*/
+int enumerate_pair_self(enumerate_worker_t* worker, size_t p2_position) {
+    enumerate_job_t* job = worker->job;
+    point_t* p1, *p2;
+    pair_t* pair = worker->left;
+    
+    p1 = (point_t*)job->nodes[job->p1_position]->data;
+    p2 = (point_t*)job->nodes[p2_position]->data;
+    
+    point_distance_squared(worker->geometry, worker->d1, p1, p2);
+    
+    // skip if points are the same
+    if (global_is_zero_squared(worker->d1) == 1) {
+        return 0;
+    }
+    
+    worker->self_count++;
+    
+    pair_set(worker->geometry, pair, p1, p2, worker->d1);
+    
+    if (_app_config->print_object_description_in_intersection_check
+                || _app_config->print_number_intersections_found) {
+        // Separate calculations, to print each one.
+        
+        // (x1)
+        worker->newly_added_points += add_circle_x_line(worker, pair->circle1, pair->line);
+        
+        // (x2)
+        worker->newly_added_points += add_circle_x_line(worker, pair->circle2, pair->line);
+        
+        // (x3)
+        worker->newly_added_points += add_circle_x_circle(worker, pair->circle1, pair->circle2);
+    } else {
+        // (x1) - (x3)
+        worker->newly_added_points += add_pair_self(worker, pair);
+    }
+    
+    return 0;
+}
+
+/*
+* Constructs points from the pair (p1, p2) against every pair (p3, p4)
+* for the given p3. p1 is the checked out point of the current task.
+* Chunks can be run in any order, the points found are the same.
+*
+* returns: 1 if BENCHMARK_TIME_SEC is exceeded, otherwise 0.
+*     The time is only checked when not threaded.
+*/
+int enumerate_pair_chunk(enumerate_worker_t* worker, size_t p2_position, size_t p3_position) {
+    enumerate_job_t* job = worker->job;
+    single_linked_list_t* p1_node, *p2_node, *p3_node, *p4_node;
+    point_t* p1, *p2, *p3, *p4;
+    size_t p4_position, count;
+    int shared_index;
+    
+    // Lines and circles generated from the 4 points.
+    pair_t* left = worker->left;
+    pair_t* right = worker->right;
+    
+    p1_node = job->nodes[job->p1_position];
+    p2_node = job->nodes[p2_position];
+    p3_node = job->nodes[p3_position];
+    
+    p1 = (point_t*)p1_node->data;
+    p2 = (point_t*)p2_node->data;
+    p3 = (point_t*)p3_node->data;
+    
+    point_distance_squared(worker->geometry, worker->d1, p1, p2);
+    
+    // skip if points are the same
+    if (global_is_zero_squared(worker->d1) == 1) {
+        return 0;
+    }
+    
+    pair_set(worker->geometry, left, p1, p2, worker->d1);
+    
+    // Self intersections are found by enumerate_pair_self.
+    
+    for (p4_position = p3_position + 1; p4_position < job->node_count; p4_position++) {
+        p4_node = job->nodes[p4_position];
+        
+        worker->loop4_count++;
+        
+        if (p1_node->index == p3_node->index && p4_node->index <= p2_node->index) {
+            continue;
+        }
+        
+        // Status updates read from the database, so only done by the main thread.
+        if (worker->is_threaded == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &_ts_current);
+            _total_elapsed = _ts_current.tv_sec - _ts_start.tv_sec;
+            
+            // Check for benchmark to exit early.
+            if (_app_config->benchmark_time_sec > 0 
+                        && _ts_current.tv_sec > _benchmark_time.tv_sec) {
+                count = mysql_get_table_count(_app_config->context->connection, _app_config->context->db_table_name_known);
+                printf("%zu: p1=(%zu,%zu) p2=(%zu,%zu) p3=(%zu,%zu) p4=(%zu,%zu) working_set length=%zu, known_points=%zu\n"
+                "BENCHMARK_TIME_SEC exceeded, exiting.\n",
+                    _total_elapsed,
+                    (size_t)0,
+                    p1_node->index,
+                    p2_position - job->p1_position - 1,
+                    p2_node->index,
+                    p3_position - job->p1_position,
+                    p3_node->index,
+                    p4_position - p3_position - 1,
+                    p4_node->index,
+                    job->nodes[0]->index,
+                    count
+                    );
+                
+                return 1;
+            }
+            
+            // Check for status update.
+            if (_app_config->update_interval_sec > 0 
+                        && _ts_current.tv_sec > _next_status_update_time.tv_sec) {
+                clock_gettime(CLOCK_MONOTONIC, &_next_status_update_time);
+                _next_status_update_time.tv_sec += _app_config->update_interval_sec;
+                
+                count = mysql_get_table_count(_app_config->context->connection, _app_config->context->db_table_name_known);
+                printf("%zu: p1=(%zu,%zu) p2=(%zu,%zu) p3=(%zu,%zu) p4=(%zu,%zu) working_set length=%zu, known_points=%zu\n",
+                _total_elapsed,
+                (size_t)0,
+                p1_node->index,
+                p2_position - job->p1_position - 1,
+                p2_node->index,
+                p3_position - job->p1_position,
+                p3_node->index,
+                p4_position - p3_position - 1,
+                p4_node->index,
+                job->nodes[0]->index,
+                count
+                );
+            }
+            
+            // Check for checkpoint save.
+            if (_app_config->checkpoint_interval_sec > 0 
+                        && _ts_current.tv_sec > _checkpoint_time.tv_sec) {
+                clock_gettime(CLOCK_MONOTONIC, &_checkpoint_time);
+                _checkpoint_time.tv_sec += _app_config->checkpoint_interval_sec;
+                
+                printf("(checkpoint)\n");
+            }
+            
+            fflush(stdout);
+        }
+        
+        p4 = (point_t*)p4_node->data;
+        
+        point_distance_squared(worker->geometry, worker->d2, p3, p4);
+        
+        // skip if points are the same
+        if (global_is_zero_squared(worker->d2) == 1) {
+            continue;
+        }
+        
+        point_distance_squared(worker->geometry, worker->dp13, p1, p3);
+        point_distance_squared(worker->geometry, worker->dp24, p2, p4);
+        if (global_is_zero_squared(worker->dp13) == 1 && global_is_zero_squared(worker->dp24) == 1) {
+            continue;
+        }
+        
+        pair_set(worker->geometry, right, p3, p4, worker->d2);
+        
+        // All comparisons:
+        // (1) left_line    x right_line, (2) left_line x right_circle1,    (3) left_line x right_circle2
+        // (4) left_circle1 x right_line, (5) left_circle1 x right_circle1, (6) left_circle1 x right_circle2
+        // (7) left_circle2 x right_line, (8) left_circle2 x right_circle1, (9) left_circle2 x right_circle2
+        
+        if (_app_config->print_object_description_in_intersection_check
+                    || _app_config->print_number_intersections_found) {
+            // Separate calculations, to print each one.
+            
+            // (1)
+            worker->newly_added_points += add_line_x_line(worker, left->line, right->line);
+                
+            // (2)
+            worker->newly_added_points += add_circle_x_line(worker, right->circle1, left->line);
+            
+            // (3)
+            worker->newly_added_points += add_circle_x_line(worker, right->circle2, left->line);
+
+            // (4)
+            worker->newly_added_points += add_circle_x_line(worker, left->circle1, right->line);
+            
+            // (5)
+            worker->newly_added_points += add_circle_x_circle(worker, left->circle1, right->circle1);
+            
+            // (6)
+            worker->newly_added_points += add_circle_x_circle(worker, left->circle1, right->circle2);
+            
+            // (7)
+            worker->newly_added_points += add_circle_x_line(worker, left->circle2, right->line);
+            
+            // (8)
+            worker->newly_added_points += add_circle_x_circle(worker, left->circle2, right->circle1);
+                
+            // (9)
+            worker->newly_added_points += add_circle_x_circle(worker, left->circle2, right->circle2);
+        } else {
+            // (1) - (9)
+            
+            // Shared points are found by position. p4 is always after p3, and
+            // p3 = p1 only with p4 after p2, so these are the only cases.
+            if (p3_position == job->p1_position) {
+                shared_index = PAIR_SHARED_INDEX(0, 0);
+            } else if (p3_position == p2_position) {
+                shared_index = PAIR_SHARED_INDEX(1, 0);
+            } else if (p4_position == p2_position) {
+                shared_index = PAIR_SHARED_INDEX(1, 1);
+            } else {
+                shared_index = PAIR_SHARED_NONE;
+            }
+            
+            worker->newly_added_points += add_pair_x_pair(worker, left, right, shared_index);
+        }
+    }
+    
+    return 0;
+}
+
+/*
+* Sort function for points by point_id.
+*/
+int enumerate_compare_point_id(const void* a, const void* b) {
+    int64_t id1 = (*(point_t* const*)a)->point_id;
+    int64_t id2 = (*(point_t* const*)b)->point_id;
+    
+    return (id1 > id2) - (id1 < id2);
+}
+
+/*
+* Builds the tables of distinct lines and circles from the pairs of
+* points in the working set, and the sorted list of points.
+* Pairs are added by the iteration the newer point was added to the
+* working set, then by point_id, so the objects are numbered the same
+* by every client. With INCREMENTAL_ITERATIONS, objects from pairs of
+* points added before this iteration are marked as old.
+*
+* @iteration: Iteration of the current task.
+* @reuse: 1 if the table already has the objects of the previous
+*     iteration, only pairs with a point added in this iteration are added.
+*/
+void enumerate_object_tables(enumerate_worker_t* worker, uint8_t iteration, int reuse) {
+    enumerate_job_t* job = worker->job;
+    point_t* p1, *p2;
+    size_t p1_position, p2_position, count;
+    unsigned int origin;
+    
+    if (job->objects == NULL) {
+        job->objects = object_table_alloc();
+        // about 3 decimal digits for every 10 bits of the point keys.
+        object_table_init(job->objects, (_app_config->point_hash_coord_bits * 3) / 10);
+    }
+    
+    if (reuse == 0) {
+        object_table_clear(job->objects);
+    }
+    
+    job->object_points = realloc(job->object_points, sizeof(point_t*) * job->node_count);
+    global_exit_if_null(job->object_points, "Fatal error calling realloc for job.object_points.\n");
+    
+    for (p1_position = 0; p1_position < job->node_count; p1_position++) {
+        job->object_points[p1_position] = (point_t*)job->nodes[p1_position]->data;
+    }
+    
+    qsort(job->object_points, job->node_count, sizeof(point_t*), enumerate_compare_point_id);
+    
+    // Only count each point once, in case it's in the working set twice.
+    job->object_point_count = 0;
+    for (count = 0; count < job->node_count; count++) {
+        if (job->object_point_count == 0
+                    || job->object_points[job->object_point_count - 1]->point_id != job->object_points[count]->point_id) {
+            job->object_points[job->object_point_count] = job->object_points[count];
+            job->object_point_count++;
+        }
+    }
+    
+    for (origin = reuse ? iteration : 0; origin <= iteration; origin++) {
+        if (origin == iteration && _app_config->incremental_iterations) {
+            object_table_mark(job->objects);
+        }
+        
+        for (p1_position = 0; p1_position < job->object_point_count; p1_position++) {
+            p1 = job->object_points[p1_position];
+            
+            for (p2_position = p1_position + 1; p2_position < job->object_point_count; p2_position++) {
+                p2 = job->object_points[p2_position];
+                
+                if ((p1->iteration_origin > p2->iteration_origin ? p1->iteration_origin : p2->iteration_origin) != origin) {
+                    continue;
+                }
+                
+                point_distance_squared(worker->geometry, worker->d1, p1, p2);
+                
+                // skip if points are the same
+                if (global_is_zero_squared(worker->d1) == 1) {
+                    continue;
+                }
+                
+                object_table_add_pair(worker->geometry, job->objects, p1, p2, worker->d1);
+            }
+        }
+    }
+}
+
+/*
+* Splits the object pairs evenly across the tasks of an iteration.
+*
+* returns: first object pair of the task, total * task / task_count.
+*/
+size_t enumerate_object_share(size_t total, size_t task, size_t task_count) {
+    // total * task could overflow.
+    return (total / task_count) * task + ((total % task_count) * task) / task_count;
+}
+
+/*
+* Intersects the object pairs in [start, end), see object_table_pair_at
+* for the order. Chunks can be run in any order, the points found are
+* the same.
+*
+* returns: 1 if BENCHMARK_TIME_SEC is exceeded, otherwise 0.
+*     The time is only checked when not threaded.
+*/
+int enumerate_object_chunk(enumerate_worker_t* worker, size_t start, size_t end) {
+    object_table_t* objects = worker->job->objects;
+    object_table_entry_t* o1, *o2;
+    size_t i, j, index, count;
+    
+    if (start >= end) {
+        return 0;
+    }
+    
+    // Status updates read from the database, so only done by the main thread.
+    if (worker->is_threaded == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &_ts_current);
+        _total_elapsed = _ts_current.tv_sec - _ts_start.tv_sec;
+        
+        // Check for benchmark to exit early.
+        if (_app_config->benchmark_time_sec > 0 
+                    && _ts_current.tv_sec > _benchmark_time.tv_sec) {
+            count = mysql_get_table_count(_app_config->context->connection, _app_config->context->db_table_name_known);
+            printf("%zu: object pair %zu of %zu, objects=%zu, known_points=%zu\n"
+            "BENCHMARK_TIME_SEC exceeded, exiting.\n",
+                _total_elapsed,
+                start,
+                object_table_pair_count(objects),
+                objects->count,
+                count
+                );
+            
+            return 1;
+        }
+        
+        // Check for status update.
+        if (_app_config->update_interval_sec > 0 
+                    && _ts_current.tv_sec > _next_status_update_time.tv_sec) {
+            clock_gettime(CLOCK_MONOTONIC, &_next_status_update_time);
+            _next_status_update_time.tv_sec += _app_config->update_interval_sec;
+            
+            count = mysql_get_table_count(_app_config->context->connection, _app_config->context->db_table_name_known);
+            printf("%zu: object pair %zu of %zu, objects=%zu, known_points=%zu\n",
+                _total_elapsed,
+                start,
+                object_table_pair_count(objects),
+                objects->count,
+                count
+                );
+        }
+        
+        fflush(stdout);
+    }
+    
+    object_table_pair_at(objects, start, &i, &j);
+    
+    for (index = start; index < end; index++) {
+        worker->object_pair_count++;
+        
+        o1 = &objects->objects[i];
+        o2 = &objects->objects[j];
+        
+        if (o1->line != NULL && o2->line != NULL) {
+            worker->newly_added_points += add_line_x_line(worker, o1->line, o2->line);
+        } else if (o1->line != NULL) {
+            worker->newly_added_points += add_circle_x_line(worker, o2->circle, o1->line);
+        } else if (o2->line != NULL) {
+            worker->newly_added_points += add_circle_x_line(worker, o1->circle, o2->line);
+        } else {
+            worker->newly_added_points += add_circle_x_circle(worker, o1->circle, o2->circle);
+        }
+        
+        i++;
+        if (i == j) {
+            i = 0;
+            j++;
+        }
+    }
+    
+    return 0;
+}
+
+/*
+* Method called by work_pool for each (p2, p3) chunk, or range
+* of object pairs with ENUMERATE_OBJECTS.
+*/
+void enumerate_pair_chunk_callback(void* worker_data, work_chunk_t* chunk) {
+    if (_app_config->enumerate_objects) {
+        enumerate_object_chunk((enumerate_worker_t*)worker_data, chunk->a, chunk->b);
+    } else if (chunk->b == SELF_INTERSECTION_CHUNK) {
+        enumerate_pair_self((enumerate_worker_t*)worker_data, chunk->a);
+    } else {
+        enumerate_pair_chunk((enumerate_worker_t*)worker_data, chunk->a, chunk->b);
+    }
+}
+
+void load_starting_points(geometry_context_t* ctx, single_linked_list_t** p_starting_set, char* filename, size_t line_buffer_size) {
     
     size_t half_buffer_size = line_buffer_size / 2;
     ssize_t read_len;
     size_t buffer_len;
-    point_t* lookup_point;
+    point_record_t* lookup_record;
     
     char* line_buffer = malloc(sizeof(char) * line_buffer_size);
     global_exit_if_null(line_buffer, "Fatal error calling malloc for line_buffer.\n");
@@ -320,16 +1104,8 @@ void load_starting_points(single_linked_list_t** p_starting_set, char* filename,
         point_init(p1);
         point_set_str(p1, xbuff, ybuff);
         
-        point_ensure_hash(p1);
-        HASH_FIND_STR(_p_point_hash, p1->hash_key, lookup_point);
-        if (lookup_point == NULL) {
-            HASH_ADD_KEYPTR(
-                hh,
-                _p_point_hash,
-                p1->hash_key,
-                p1->hash_key_length,
-                p1);
-                
+        lookup_record = known_add(ctx, p1);
+        if (lookup_record == NULL) {
             single_linked_list_add(p_starting_set, p1, sizeof(single_linked_list_t));
         } else {
             point_free(p1);
@@ -352,12 +1128,61 @@ int main() {
     // init
     
     global_init(_app_config->gmp_precision_bits, _app_config->str_init_epsilon);
-    global_point_init(_app_config->str_point_digits, _app_config->point_hash_coord_digits);
-    global_line_init();
-    global_circle_init();
+    global_point_init(_app_config->str_point_digits, _app_config->point_hash_coord_bits, _app_config->point_hash_grid);
     global_datamodel_init();
+    point_rational_init(_app_config->rational_point_bits);
+    
+    if (_app_config->adaptive_precision_bits > 0) {
+#ifdef NUMERIC_KERNELS
+        global_error_printf("ADAPTIVE_PRECISION_BITS isn't supported by the %s numeric backend, set it to 0.\n", NUMERIC_BACKEND_NAME);
+        exit(1);
+#endif
+        
+        if (_app_config->str_adaptive_guard_band == NULL) {
+            global_error_printf("ADAPTIVE_GUARD_BAND must be set with ADAPTIVE_PRECISION_BITS.\n");
+            exit(1);
+        }
+        
+        if (_app_config->adaptive_precision_bits >= _app_config->gmp_precision_bits) {
+            global_error_printf("ADAPTIVE_PRECISION_BITS must be less than GMP_PRECISION_BITS.\n");
+            exit(1);
+        }
+        
+        if (global_guard_band_valid(_app_config->adaptive_precision_bits, _app_config->str_adaptive_guard_band) == 0) {
+            global_error_printf("ADAPTIVE_GUARD_BAND must be more than 2^(%d - ADAPTIVE_PRECISION_BITS).\n", GUARD_BAND_MARGIN_BITS + 1);
+            exit(1);
+        }
+    }
+    
+    if (_app_config->point_cache_bytes > 0) {
+        // Most of the cache is compacted records, only the points
+        // added since the last flush are full points.
+        _app_config->max_point_cache = _app_config->point_cache_bytes / point_table_point_bytes();
+        printf("point cache of %zu bytes holds %zu points of %zu bytes\n",
+            _app_config->point_cache_bytes,
+            _app_config->max_point_cache,
+            point_table_point_bytes());
+    }
+    
+    if (_app_config->adaptive_precision_bits > 0) {
+        _p_point_grid = point_grid_alloc();
+        point_grid_init(_p_point_grid, _app_config->max_point_cache, _app_config->adaptive_precision_bits, _app_config->str_adaptive_guard_band);
+    }
+    
+    _p_point_table_count = 1;
+    if (_app_config->threads > 1 && _app_config->dedup_shards > 0) {
+        _p_point_table_count = _app_config->dedup_shards;
+    }
+    
+    _p_point_tables = malloc(sizeof(point_table_t*) * _p_point_table_count);
+    global_exit_if_null(_p_point_tables, "Fatal error calling malloc for point tables.\n");
+    for (size_t i=0; i<_p_point_table_count; i++) {
+        _p_point_tables[i] = point_table_alloc();
+        point_table_init(_p_point_tables[i], POINT_TABLE_START_CAPACITY);
+    }
     
     // verify
+    printf("numeric backend: %s\n", NUMERIC_BACKEND_NAME);
     test_run();
     
     // done initializing.
@@ -367,21 +1192,18 @@ int main() {
     // reused variable, return value for functions
     int result;
     
-    // reused count variable, and counters for the 4 point loops
-    size_t count, p1_count, p2_count, p3_count, p4_count;
+    // reused count variable
+    size_t count;
     
     // count the number of points added each iteration
     size_t newly_added_points = 0;
     
-    // The four points used in the four point loops.
-    point_t* p1, *p2, *p3, *p4;
-    
-    // Distances between points.
-    mpf_t d1, d2, dp13, dp24;
+    // The first point, and position of the second and third points.
+    point_t* p1;
+    size_t p2_position, p3_position;
     
-    // Lines and circles generated from the 4 points.
-    line_t* left_line, *right_line;
-    circle_t* left_circle1, *left_circle2, *right_circle1, *right_circle2;
+    // Range of object pairs for the task, with ENUMERATE_OBJECTS.
+    size_t object_start = 0, object_end = 0, object_position;
     
     // Setup a preliminary list to load initial starting points.
     // Duplicates will be ignored.
@@ -393,19 +1215,58 @@ int main() {
     // node to iterate starting set.
     single_linked_list_t* n1;
     
-    // Iterate the working_set 4 times, one for each point.
-    single_linked_list_t* p1_node, *p2_node, *p3_node, *p4_node;
+    // Node of the checked out point.
+    single_linked_list_t* p1_node;
     
     size_t loop4_count = 0;
+    size_t self_count = 0;
+    size_t object_pair_count = 0;
     
     // Current assigned work.
     run_status_t* current_job = NULL;
     
-    //      
-    mpf_init(d1);
-    mpf_init(d2);
-    mpf_init(dp13);
-    mpf_init(dp24);
+    // Working set of the current task, shared by the workers.
+    enumerate_job_t job;
+    memset(&job, 0, sizeof(enumerate_job_t));
+    
+    // Worker for the main thread. Used to construct points when
+    // THREADS is 1, otherwise only used to merge points from the
+    // worker threads.
+    enumerate_worker_t* main_worker = enumerate_worker_alloc();
+    enumerate_worker_init(main_worker, &job, 0);
+    
+    // Worker threads, if enabled.
+    size_t thread_count = _app_config->threads > 1 ? _app_config->threads : 0;
+    enumerate_worker_t** workers = NULL;
+    work_pool_t* pool = NULL;
+    
+    if (thread_count > 0) {
+        workers = malloc(sizeof(enumerate_worker_t*) * thread_count);
+        global_exit_if_null(workers, "Fatal error calling malloc for workers.\n");
+        
+        for (count=0; count<thread_count; count++) {
+            workers[count] = enumerate_worker_alloc();
+            enumerate_worker_init(workers[count], &job, 1);
+            workers[count]->index = count;
+        }
+        
+        pool = work_pool_alloc();
+        work_pool_init(pool, thread_count);
+        
+        if (_app_config->dedup_shards > 0) {
+            _p_point_shards = point_shards_alloc();
+            point_shards_init(_p_point_shards, _p_point_tables, _p_point_table_count, thread_count, _app_config->dedup_routing);
+        }
+    }
+    
+    if (_app_config->external_dedup_directory != NULL
+            && strlen(_app_config->external_dedup_directory) > 0) {
+        _p_point_runs = point_runs_alloc();
+        point_runs_init(_p_point_runs,
+            _app_config->external_dedup_directory,
+            thread_count > 0 ? thread_count : 1,
+            _app_config->external_dedup_memory);
+    }
     
     // database connection; connect or exit.
     db_context_connect(_app_config->context);
@@ -432,7 +1293,7 @@ int main() {
         // else, this is root, do initial seed.
         // load starting points
         printf("Loading starting points from file.\n");
-        load_starting_points(&starting_set,
+        load_starting_points(main_worker->geometry, &starting_set,
             _app_config->starting_points_file,
             _app_config->starting_points_file_line_buffer);
 
@@ -514,8 +1375,14 @@ int main() {
         newly_added_points = 0;
         
         // Load working set into memory.
+        // Points already in the working set are kept, only points
+        // added since the last load are read.
         int64_t after_id = 0;
-        after_id = working_set == NULL ? 0 : working_set->index;
+        for (n1 = working_set; n1 != NULL; n1 = n1->next) {
+            if (((point_t*)n1->data)->point_id >= after_id) {
+                after_id = ((point_t*)n1->data)->point_id + 1;
+            }
+        }
         db_get_working_set(_app_config->context, &working_set, after_id);
         
         // Do work.
@@ -530,13 +1397,23 @@ int main() {
         * 5) find the intersections.
         *
         * In code below:
-        * 2) The double for loop iterates over working_set and sets p1, p2.
+        * 2) p1 is the checked out point, the (p2, p3) pairs after p1 are
+        *     split into chunks, see enumerate_pair_chunk. With THREADS
+        *     more than 1, the chunks are run by a work stealing pool.
         * 3) p1,p2 are used to build left_line, left_circle1, left_circle2.
         * 4) Pairs from working_set is iterated again to give p3,p4.
         *     p3,p4 are used to build right_line, right_circle1, right_circle2.
         * 5) The 9 possible combinations of lines and circles are checked 
-        *     for intersecting points.       
+        *     for intersecting points. The self intersections of each
+        *     (p1, p2) pair are found in a separate pass before this,
+        *     see enumerate_pair_self.       
         *     A hash of points already known is tracked in known_points.
+        *     With ENUMERATE_OBJECTS, (2) - (4) are done once per iteration
+        *     to build tables of the distinct objects, see
+        *     enumerate_object_tables, and each task intersects its share
+        *     of the pairs of distinct objects instead. With
+        *     INCREMENTAL_ITERATIONS, only pairs with an object from a
+        *     point new in this iteration are intersected.
         * 6) At the end of the iteration:
         * 6.1) working_set is emptied.
         * 6.2) the (unique) points from known_points are moved to working_set.
@@ -554,231 +1431,174 @@ int main() {
             }
         }
         
-        // Inner loop where the points are constructed.
-        p1_count=0;
-        p1 = (point_t*)p1_node->data;
+        // Copy the working set to an array so the (p2, p3) pairs
+        // can be split into chunks.
+        job.node_count = working_set->index + 1;
+        if (job.node_count > job.node_capacity) {
+            job.node_capacity = job.node_count;
+            job.nodes = realloc(job.nodes, sizeof(single_linked_list_t*) * job.node_capacity);
+            global_exit_if_null(job.nodes, "Fatal error calling realloc for job.nodes.\n");
+        }
+        
+        for (n1 = working_set, count = 0; n1 != NULL && count < job.node_count; n1 = n1->next, count++) {
+            job.nodes[count] = n1;
+            if (n1 == p1_node) {
+                job.p1_position = count;
+            }
+        }
         
-        for (p2_node = p1_node->next, p2_count=0; p2_node != NULL; p2_node = p2_node->next, p2_count++) {   
-            p2 = (point_t*)p2_node->data;
+        if (_app_config->enumerate_objects) {
+            // The working set is the same for every task of an iteration.
+            if (job.objects == NULL || job.objects_iteration != current_job->iteration) {
+                // With INCREMENTAL_ITERATIONS, the objects of the previous
+                // iteration are kept, and only the new pairs are intersected.
+                result = _app_config->incremental_iterations
+                    && job.objects != NULL
+                    && job.objects_iteration + 1 == current_job->iteration;
+                
+                enumerate_object_tables(main_worker, current_job->iteration, result);
+                job.objects_iteration = current_job->iteration;
+                
+                printf("object table: %zu lines, %zu circles, %zu new objects, %zu object pairs.\n",
+                    job.objects->line_count,
+                    job.objects->circle_count,
+                    job.objects->count - job.objects->old_count,
+                    object_table_pair_count(job.objects));
+            }
             
-            point_distance(d1, p1, p2);
+            // Tasks are one per point of the working set, the task for p1
+            // takes the matching share of the object pairs.
+            point_t** task_point = bsearch(&p1_node->data,
+                job.object_points,
+                job.object_point_count,
+                sizeof(point_t*),
+                enumerate_compare_point_id);
             
-            // skip if points are the same
-            if (global_is_zero(d1) == 1) {
-                continue;
+            if (task_point == NULL) {
+                global_error_printf("Could not find point_id=%ld in object tables.\n", current_job->point_id);
+                goto EXIT_LOOP;
             }
             
-            left_line = line_alloc();
-            left_circle1 = circle_alloc();
-            left_circle2 = circle_alloc();
+            count = object_table_pair_count(job.objects);
+            object_start = enumerate_object_share(count, task_point - job.object_points, job.object_point_count);
+            object_end = enumerate_object_share(count, task_point - job.object_points + 1, job.object_point_count);
+        }
+        
+        // Inner loop where the points are constructed.
+        if (thread_count == 0 && _app_config->enumerate_objects) {
+            main_worker->newly_added_points = 0;
+            
+            for (object_position = object_start; object_position < object_end; object_position += OBJECT_PAIR_CHUNK) {
+                count = object_position + OBJECT_PAIR_CHUNK < object_end ? object_position + OBJECT_PAIR_CHUNK : object_end;
+                if (enumerate_object_chunk(main_worker, object_position, count) == 1) {
+                    goto EXIT_LOOP;
+                }
+            }
             
-            line_init(left_line);
-            circle_init(left_circle1);
-            circle_init(left_circle2);
+            newly_added_points += main_worker->newly_added_points;
+        } else if (thread_count == 0) {
+            main_worker->newly_added_points = 0;
             
-            line_set(left_line, p1, p2);
-            circle_set(left_circle1, p1, d1);
-            circle_set(left_circle2, p2, d1);
+            for (p2_position = job.p1_position + 1; p2_position < job.node_count; p2_position++) {
+                enumerate_pair_self(main_worker, p2_position);
+            }
             
-            // Self intersections for left points (three total)
+            for (p2_position = job.p1_position + 1; p2_position < job.node_count; p2_position++) {
+                for (p3_position = job.p1_position; p3_position < job.node_count; p3_position++) {
+                    if (enumerate_pair_chunk(main_worker, p2_position, p3_position) == 1) {
+                        goto EXIT_LOOP;
+                    }
+                }
+            }
             
-            // (x1)
-            newly_added_points += add_circle_x_line(_app_config->context, left_circle1, left_line);
+            newly_added_points += main_worker->newly_added_points;
+        } else {
+            if (_app_config->enumerate_objects) {
+                for (object_position = object_start; object_position < object_end; object_position += OBJECT_PAIR_CHUNK) {
+                    count = object_position + OBJECT_PAIR_CHUNK < object_end ? object_position + OBJECT_PAIR_CHUNK : object_end;
+                    work_pool_add(pool, object_position, count);
+                }
+            } else {
+                for (p2_position = job.p1_position + 1; p2_position < job.node_count; p2_position++) {
+                    work_pool_add(pool, p2_position, SELF_INTERSECTION_CHUNK);
+                }
+                
+                for (p2_position = job.p1_position + 1; p2_position < job.node_count; p2_position++) {
+                    for (p3_position = job.p1_position; p3_position < job.node_count; p3_position++) {
+                        work_pool_add(pool, p2_position, p3_position);
+                    }
+                }
+            }
             
-            // (x2)
-            newly_added_points += add_circle_x_line(_app_config->context, left_circle2, left_line);
+            if (_p_point_shards != NULL) {
+                point_shards_start(_p_point_shards);
+            }
             
-            // (x3)
-            newly_added_points += add_circle_x_circle(_app_config->context, left_circle1, left_circle2);
+            work_pool_run(pool, enumerate_pair_chunk_callback, (void**)workers);
+            count = pool->chunk_total;
             
-            // first pair covered, onto the second pair
-            for (p3_node = p1_node, p3_count=0; p3_node != NULL; p3_node = p3_node->next, p3_count++) {
+            // Workers don't touch the database, status updates are done here.
+            result = 0;
+            while (work_pool_is_done(pool) == 0) {
+                usleep(100000);
                 
-                p3 = (point_t*)p3_node->data;
+                clock_gettime(CLOCK_MONOTONIC, &_ts_current);
+                _total_elapsed = _ts_current.tv_sec - _ts_start.tv_sec;
                 
-                for (p4_node = p3_node->next, p4_count=0; p4_node != NULL; p4_node = p4_node->next, p4_count++) {
-                    
-                    loop4_count++;
-                    
-                    if (p1_node->index == p3_node->index && p4_node->index <= p2_node->index) {
-                        continue;
-                    }
-                    
-                    clock_gettime(CLOCK_MONOTONIC, &_ts_current);
-                    _total_elapsed = _ts_current.tv_sec - _ts_start.tv_sec;
-                    
-                    // Check for benchmark to exit early.
-                    if (_app_config->benchmark_time_sec > 0 
-                                && _ts_current.tv_sec > _benchmark_time.tv_sec) {
-                        count = mysql_get_table_count(_app_config->context->connection, _app_config->context->db_table_name_known);
-                        printf("%zu: p1=(%zu,%zu) p2=(%zu,%zu) p3=(%zu,%zu) p4=(%zu,%zu) working_set length=%zu, known_points=%zu\n"
-                        "BENCHMARK_TIME_SEC exceeded, exiting.\n",
-                            _total_elapsed,
-                            p1_count,
-                            p1_node->index,
-                            p2_count,
-                            p2_node->index,
-                            p3_count,
-                            p3_node->index,
-                            p4_count,
-                            p4_node->index,
-                            working_set->index,
-                            count
-                            );
-                        goto EXIT_LOOP;
-                    }
+                if (result == 0
+                            && _app_config->benchmark_time_sec > 0 
+                            && _ts_current.tv_sec > _benchmark_time.tv_sec) {
+                    printf("%zu: p1=(%zu,%zu) chunk %zu of %zu, working_set length=%zu\n"
+                    "BENCHMARK_TIME_SEC exceeded, exiting.\n",
+                        _total_elapsed,
+                        job.p1_position,
+                        p1_node->index,
+                        work_pool_chunk_done(pool),
+                        count,
+                        working_set->index
+                        );
+                    work_pool_stop(pool);
+                    result = 1;
+                }
+                
+                if (_app_config->update_interval_sec > 0 
+                            && _ts_current.tv_sec > _next_status_update_time.tv_sec) {
+                    clock_gettime(CLOCK_MONOTONIC, &_next_status_update_time);
+                    _next_status_update_time.tv_sec += _app_config->update_interval_sec;
                     
-                    // Check for status update.
-                    if (_app_config->update_interval_sec > 0 
-                                && _ts_current.tv_sec > _next_status_update_time.tv_sec) {
-                        //printf("_ts_current.tv_sec: %zu\n", _ts_current.tv_sec);
-                        
-                        clock_gettime(CLOCK_MONOTONIC, &_next_status_update_time);
-                        _next_status_update_time.tv_sec += _app_config->update_interval_sec;
-                        
-                        //printf("_next_status_update_time.tv_sec: %zu\n", _next_status_update_time.tv_sec);
-                        
-                        count = mysql_get_table_count(_app_config->context->connection, _app_config->context->db_table_name_known);
-                        printf("%zu: p1=(%zu,%zu) p2=(%zu,%zu) p3=(%zu,%zu) p4=(%zu,%zu) working_set length=%zu, known_points=%zu\n",
+                    printf("%zu: p1=(%zu,%zu) chunk %zu of %zu, working_set length=%zu, known_points=%zu\n",
                         _total_elapsed,
-                        p1_count,
+                        job.p1_position,
                         p1_node->index,
-                        p2_count,
-                        p2_node->index,
-                        p3_count,
-                        p3_node->index,
-                        p4_count,
-                        p4_node->index,
+                        work_pool_chunk_done(pool),
+                        count,
                         working_set->index,
-                        count
+                        mysql_get_table_count(_app_config->context->connection, _app_config->context->db_table_name_known)
                         );
-                    }
-                    
-                    // Check for checkpoint save.
-                    if (_app_config->checkpoint_interval_sec > 0 
-                                && _ts_current.tv_sec > _checkpoint_time.tv_sec) {
-                        clock_gettime(CLOCK_MONOTONIC, &_checkpoint_time);
-                        _checkpoint_time.tv_sec += _app_config->checkpoint_interval_sec;
-                        
-                        printf("(checkpoint)\n");
-                        //count = mysql_get_table_count(_app_config->context->connection, _app_config->context->db_table_name_known);
-                        //
-                        //_save_context->current_iteration = _current_iteration;
-                        //_save_context->p1_count = p1_count;
-                        //_save_context->p1_index = p1_node->index;
-                        //_save_context->p2_count = p2_count;
-                        //_save_context->p2_index = p2_node->index;
-                        //_save_context->p3_count = p3_count;
-                        //_save_context->p3_index = p3_node->index;
-                        //_save_context->p4_count = p4_count;
-                        //_save_context->p4_index = p4_node->index;
-                        //
-                        //printf("%zu: p1=(%zu,%zu) p2=(%zu,%zu) p3=(%zu,%zu) p4=(%zu,%zu) working_set length=%zu, known_points=%zu\n",
-                        //    _total_elapsed,
-                        //    _save_context->p1_count,
-                        //    _save_context->p1_index,
-                        //    _save_context->p2_count,
-                        //    _save_context->p2_index,
-                        //    _save_context->p3_count,
-                        //    _save_context->p3_index,
-                        //    _save_context->p4_count,
-                        //    _save_context->p4_index,
-                        //    working_set->index,
-                        //    count
-                        //    );
-                        //
-                        ////db_save_status(con, _save_context);
-
-                        //mysql_commit(_app_config->context->connection->con);
-                    }
-                    
-                    fflush(stdout);
-                    
-                    p4 = (point_t*)p4_node->data;
-                    
-                    point_distance(d2, p3, p4);
-                    
-                    // skip if points are the same
-                    if (global_is_zero(d2) == 1) {
-                        continue;
-                    }
-                    
-                    point_distance(dp13, p1, p3);
-                    point_distance(dp24, p2, p4);
-                    if (global_is_zero(dp13) == 1 && global_is_zero(dp24) == 1) {
-                        continue;
-                    }
-                    
-                    right_line = line_alloc();
-                    right_circle1 = circle_alloc();
-                    right_circle2 = circle_alloc();
-                    
-                    line_init(right_line);
-                    circle_init(right_circle1);
-                    circle_init(right_circle2);
-                    
-                    line_set(right_line, p3, p4);
-                    circle_set(right_circle1, p3, d2);
-                    circle_set(right_circle2, p4, d2);
-                    
-                    // All comparisons:
-                    // (1) left_line    x right_line, (2) left_line x right_circle1,    (3) left_line x right_circle2
-                    // (4) left_circle1 x right_line, (5) left_circle1 x right_circle1, (6) left_circle1 x right_circle2
-                    // (7) left_circle2 x right_line, (8) left_circle2 x right_circle1, (9) left_circle2 x right_circle2
-                    
-                    // (1)
-                    newly_added_points += add_line_x_line(_app_config->context, left_line, right_line);
-                        
-                    // (2)
-                    newly_added_points += add_circle_x_line(_app_config->context, right_circle1, left_line);
-                    
-                    // (3)
-                    newly_added_points += add_circle_x_line(_app_config->context, right_circle2, left_line);
-
-                    // (4)
-                    newly_added_points += add_circle_x_line(_app_config->context, left_circle1, right_line);
-                    
-                    // (5)
-                    newly_added_points += add_circle_x_circle(_app_config->context, left_circle1, right_circle1);
-                    
-                    // (6)
-                    newly_added_points += add_circle_x_circle(_app_config->context, left_circle1, right_circle2);
-                    
-                    // (7)
-                    newly_added_points += add_circle_x_line(_app_config->context, left_circle2, right_line);
-                    
-                    // (8)
-                    newly_added_points += add_circle_x_circle(_app_config->context, left_circle2, right_circle1);
-                        
-                    // (9)
-                    newly_added_points += add_circle_x_circle(_app_config->context, left_circle2, right_circle2);
-
-                    // And self intersections for right points (three total)
-                    
-                    // (x1)
-                    newly_added_points += add_circle_x_line(_app_config->context, right_circle1, right_line);
-                    
-                    // (x2)
-                    newly_added_points += add_circle_x_line(_app_config->context, right_circle2, right_line);
-                    
-                    // (x3)
-                    newly_added_points += add_circle_x_circle(_app_config->context, right_circle1, right_circle2);
-                    
-                    // done with right pair
-                    
-                    line_free(right_line);
-                    circle_free(right_circle1);
-                    circle_free(right_circle2);
                 }
+                
+                fflush(stdout);
+            }
+            
+            work_pool_join(pool);
+            
+            if (_p_point_shards != NULL) {
+                point_shards_stop(_p_point_shards, main_worker->geometry);
             }
             
-            // done with left pair
+            // Workers don't flush the point table, that's done here
+            // now that they're finished.
+            if (known_point_count() >= _app_config->max_point_cache) {
+                newly_added_points += db_point_cache_flush(_app_config->context);
+            }
             
-            line_free(left_line);
-            circle_free(left_circle1);
-            circle_free(left_circle2);
+            if (result == 1) {
+                goto EXIT_LOOP;
+            }
         }
         
+        newly_added_points += known_runs_merge(main_worker);
+        
         db_point_cache_flush(_app_config->context);
         
         // Done with work.
@@ -802,7 +1622,18 @@ int main() {
     
 EXIT_LOOP:
 
+    known_runs_merge(main_worker);
+    
     db_point_cache_flush(_app_config->context);
+    
+    loop4_count = main_worker->loop4_count;
+    self_count = main_worker->self_count;
+    object_pair_count = main_worker->object_pair_count;
+    for (count=0; count<thread_count; count++) {
+        loop4_count += workers[count]->loop4_count;
+        self_count += workers[count]->self_count;
+        object_pair_count += workers[count]->object_pair_count;
+    }
 
     clock_gettime(CLOCK_MONOTONIC, &_ts_current);
     _total_elapsed = _ts_current.tv_sec - _ts_start.tv_sec;
@@ -812,11 +1643,75 @@ EXIT_LOOP:
     // show results
     
     if (_app_config->max_point_cache > 0) {
-        size_t lookup_count = HASH_COUNT(_p_point_hash);
+        size_t lookup_count = known_point_count();
         printf("number of points cached in memory: %zu\n", lookup_count);
+        
+        size_t cache_hits = main_worker->geometry->point_table_hits;
+        size_t cache_misses = main_worker->geometry->point_table_misses;
+        size_t cache_evicted = 0;
+        for (count=0; count<thread_count; count++) {
+            cache_hits += workers[count]->geometry->point_table_hits;
+            cache_misses += workers[count]->geometry->point_table_misses;
+        }
+        if (_p_point_shards != NULL) {
+            for (count=0; count<_p_point_shards->shard_count; count++) {
+                cache_hits += _p_point_shards->owners[count].geometry->point_table_hits;
+                cache_misses += _p_point_shards->owners[count].geometry->point_table_misses;
+            }
+        }
+        for (count=0; count<_p_point_table_count; count++) {
+            cache_evicted += _p_point_tables[count]->evicted;
+        }
+        printf("point cache hits: %zu, misses: %zu, evictions: %zu\n", cache_hits, cache_misses, cache_evicted);
+    }
+    
+    if (_p_point_shards != NULL) {
+        point_shards_printf(_p_point_shards);
+    }
+    
+    if (_p_point_runs != NULL) {
+        point_runs_printf(_p_point_runs);
     }
     
     printf("loop4_count: %zu\n", loop4_count);
+    printf("self intersection pairs: %zu\n", self_count);
+    printf("object pairs: %zu\n", object_pair_count);
+    
+    size_t filter_resolved = main_worker->geometry->filter_resolved;
+    size_t filter_fallback = main_worker->geometry->filter_fallback;
+    for (count=0; count<thread_count; count++) {
+        filter_resolved += workers[count]->geometry->filter_resolved;
+        filter_fallback += workers[count]->geometry->filter_fallback;
+    }
+    printf("intersections decided by interval filter: %zu, by mpf: %zu\n", filter_resolved, filter_fallback);
+    
+    if (_app_config->adaptive_precision_bits > 0) {
+        size_t low_precision_count = main_worker->geometry->low_precision_count;
+        size_t low_precision_flagged = main_worker->geometry->low_precision_flagged;
+        size_t low_precision_near = main_worker->geometry->low_precision_near;
+        size_t low_precision_new = main_worker->geometry->low_precision_new;
+        for (count=0; count<thread_count; count++) {
+            low_precision_count += workers[count]->geometry->low_precision_count;
+            low_precision_flagged += workers[count]->geometry->low_precision_flagged;
+            low_precision_near += workers[count]->geometry->low_precision_near;
+            low_precision_new += workers[count]->geometry->low_precision_new;
+        }
+        printf("intersections at %zu bits: %zu, calculated again at full precision for the guard band: %zu, near a known point: %zu, new points: %zu\n",
+            _app_config->adaptive_precision_bits,
+            low_precision_count,
+            low_precision_flagged,
+            low_precision_near,
+            low_precision_new);
+        printf("points in the low precision grid: %zu\n", point_grid_count(_p_point_grid));
+    }
+    
+    if (point_rational_bits() > 0) {
+        size_t rational_intersections = main_worker->geometry->rational_intersections;
+        for (count=0; count<thread_count; count++) {
+            rational_intersections += workers[count]->geometry->rational_intersections;
+        }
+        printf("rational intersections calculated exactly: %zu\n", rational_intersections);
+    }
     printf("primary run time: %zu seconds.\n", _total_elapsed);
     
     if (_app_config->client_id == ROOT_CLIENT_ID) {
@@ -832,14 +1727,9 @@ EXIT_LOOP:
         free(current_job);
     }
         
-    do {
-        if (starting_set != NULL) {
-            point_free(starting_set->data);
-            starting_set->data = NULL;
-        }
-
-        result = single_linked_list_remove(&starting_set);
-    } while (1 == result);
+    // The starting points belong to the point table.
+    while (1 == single_linked_list_remove(&starting_set))
+        ;
     
     do {
         if (working_set != NULL) {
@@ -850,15 +1740,38 @@ EXIT_LOOP:
         result = single_linked_list_remove(&working_set);
     } while (1 == result);
     
-    empty_point_hash_and_free(&_p_point_hash);
+    point_shards_free(_p_point_shards);
+    point_runs_free(_p_point_runs);
+    point_grid_free(_p_point_grid);
+    
+    for (count=0; count<_p_point_table_count; count++) {
+        point_table_free(_p_point_tables[count]);
+    }
+    free(_p_point_tables);
 
-    mpf_clear(d1);
-    mpf_clear(d2);
+    if (job.nodes != NULL) {
+        free(job.nodes);
+    }
+    
+    object_table_free(job.objects);
+    
+    if (job.object_points != NULL) {
+        free(job.object_points);
+    }
+    
+    for (count=0; count<thread_count; count++) {
+        enumerate_worker_free(workers[count]);
+    }
+    
+    if (workers != NULL) {
+        free(workers);
+    }
+    
+    work_pool_free(pool);
+    enumerate_worker_free(main_worker);
     
     global_free();
     global_point_free();
-    global_line_free();
-    global_circle_free();
     global_datamodel_free();
     
     app_config_free(_app_config); // calls db_context_free which also closes connection
@@ -184,7 +184,7 @@ int db_insert_known_set(db_context_t* context, point_t* p) {
     size_t row_count = 0;
     size_t char_count = 0;
     
-    point_ensure_hash(p);
+    point_ensure_str(p);
     
     memset(_buffer, 0, COMMAND_BUFFER_SIZE);
     char_count = sprintf(_buffer, 
@@ -330,7 +330,7 @@ int db_insert_many_known_set(db_context_t* context, single_linked_list_t* points
     for (node = points; node != NULL; node = node->next) {
         //printf("node ...\n");
         point_t* p = (point_t*)node->data;
-        point_ensure_hash(p);
+        point_ensure_str(p);
         
         bind[bind_index].buffer_type = MYSQL_TYPE_STRING;
         bind[bind_index].buffer = (char *)(p->str_x);
@@ -515,11 +515,12 @@ void db_update_run_status(db_context_t* context, run_status_t* status) {
 */
 size_t db_get_working_set(db_context_t* context, single_linked_list_t** working_set, int64_t after) {
     int64_t point_id;
+    int iteration_origin;
     size_t char_count = 0;
     
     memset(_buffer, 0, COMMAND_BUFFER_SIZE);
     char_count = sprintf(_buffer, 
-        "SELECT `x`,`y`,`id` FROM `%s` "
+        "SELECT `x`,`y`,`id`,`iteration_origin` FROM `%s` "
         "WHERE `id` >= %ld "
         "ORDER BY `x`,`y`;",
         context->db_table_name_working,
@@ -550,11 +551,14 @@ size_t db_get_working_set(db_context_t* context, single_linked_list_t** working_
     {
         point_t* p1 = point_alloc();
         point_init(p1);
-        point_set_str(p1, row[0], row[1]);
+        point_set_str_rounded(p1, row[0], row[1]);
         
         sscanf(row[2], "%ld", &point_id);
         p1->point_id = point_id;
         
+        sscanf(row[3], "%d", &iteration_origin);
+        p1->iteration_origin = (uint8_t)iteration_origin;
+        
         single_linked_list_add(working_set, p1, sizeof(single_linked_list_t));
         row_count++;
     }
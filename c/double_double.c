@@ -0,0 +1,326 @@
+/*
+* Double-double arithmetic, used by the intersection kernels in the
+* NUMERIC_BACKEND_DD build.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <math.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+
+#include "global.h"
+#include "double_double.h"
+
+// Limbs of an mpf value read by dd_set_mpf, enough for the 106 bits
+// of a double-double wherever the top limb starts.
+#define DD_MPF_LIMBS 3
+
+dd_t g_dd_epsilon;
+dd_t g_dd_epsilon_squared;
+
+/*
+* s + e = a + b exactly.
+*/
+static inline void _two_sum(double a, double b, double* s, double* e) {
+    double bb;
+    
+    *s = a + b;
+    bb = *s - a;
+    *e = (a - (*s - bb)) + (b - bb);
+}
+
+/*
+* s + e = a + b exactly, for |a| >= |b|.
+*/
+static inline void _quick_two_sum(double a, double b, double* s, double* e) {
+    *s = a + b;
+    *e = b - (*s - a);
+}
+
+/*
+* rop = a + d
+*/
+static void _add_d(dd_t* rop, dd_t* a, double d) {
+    double s, e;
+    
+    _two_sum(a->hi, d, &s, &e);
+    e += a->lo;
+    _quick_two_sum(s, e, &rop->hi, &rop->lo);
+}
+
+/*
+* returns: 1 if a is greater than b, otherwise 0.
+*/
+static inline int _greater(dd_t* a, dd_t* b) {
+    if (a->hi != b->hi) {
+        return a->hi > b->hi ? 1 : 0;
+    }
+    
+    return a->lo > b->lo ? 1 : 0;
+}
+
+/*
+* Sets g_dd_epsilon and g_dd_epsilon_squared from the mpf values.
+* Called by global_init.
+*/
+void global_dd_init() {
+    dd_set_mpf(&g_dd_epsilon, g_epsilon);
+    dd_set_mpf(&g_dd_epsilon_squared, g_epsilon_squared);
+}
+
+/*
+* Sets a double-double value from a GMP value. Only the top three
+* limbs are used.
+*
+* @rop: Result.
+* @f: Value to convert.
+*/
+void dd_set_mpf(dd_t* rop, mpf_t f) {
+    int size = f->_mp_size < 0 ? -f->_mp_size : f->_mp_size;
+    int low = size > DD_MPF_LIMBS ? size - DD_MPF_LIMBS : 0;
+    int i;
+    
+    rop->hi = 0;
+    rop->lo = 0;
+    
+    // Limb i has weight B^(exp - size + i). Each half limb is exact
+    // as a double, and each is added exactly, from the top down.
+    for (i=size - 1; i>=low; i--) {
+        long shift = GMP_NUMB_BITS * (f->_mp_exp - size + i);
+        
+        _add_d(rop, rop, ldexp((double)(f->_mp_d[i] >> 32), shift + 32));
+        _add_d(rop, rop, ldexp((double)(f->_mp_d[i] & 0xffffffffUL), shift));
+    }
+    
+    if (f->_mp_size < 0) {
+        dd_neg(rop, rop);
+    }
+}
+
+/*
+* Sets a GMP value from a double-double value.
+*
+* @rop: Result.
+* @a: Value to convert.
+*/
+void dd_get_mpf(mpf_t rop, dd_t* a) {
+    // mpf_set_d fills at most two limbs, so lo is held in a value on
+    // the stack instead of an initialized mpf_t.
+    mp_limb_t limbs[3];
+    __mpf_struct lo;
+    
+    lo._mp_prec = 2;
+    lo._mp_size = 0;
+    lo._mp_exp = 0;
+    lo._mp_d = limbs;
+    
+    mpf_set_d(rop, a->hi);
+    mpf_set_d(&lo, a->lo);
+    mpf_add(rop, rop, &lo);
+}
+
+/*
+* Sets a double-double value from an int.
+*
+* @rop: Result.
+* @v: Value.
+*/
+void dd_set_si(dd_t* rop, long v) {
+    // Values past 2^53 are split in two exact halves.
+    double high = ldexp((double)(v >> 32), 32);
+    
+    _quick_two_sum(high, (double)(v & 0xffffffffL), &rop->hi, &rop->lo);
+}
+
+/*
+* Sets a double-double value from a double.
+*
+* @rop: Result.
+* @d: Value.
+*/
+void dd_set_d(dd_t* rop, double d) {
+    rop->hi = d;
+    rop->lo = 0;
+}
+
+/*
+* Converts a double-double value to the nearest double.
+*
+* @a: Value to convert.
+*
+* returns: value as a double.
+*/
+double dd_get_d(dd_t* a) {
+    return a->hi;
+}
+
+/*
+* rop = a + b
+*/
+void dd_add(dd_t* rop, dd_t* a, dd_t* b) {
+    double s, e, t, f;
+    
+    _two_sum(a->hi, b->hi, &s, &e);
+    _two_sum(a->lo, b->lo, &t, &f);
+    e += t;
+    _quick_two_sum(s, e, &s, &e);
+    e += f;
+    _quick_two_sum(s, e, &rop->hi, &rop->lo);
+}
+
+/*
+* rop = a - b
+*/
+void dd_sub(dd_t* rop, dd_t* a, dd_t* b) {
+    dd_t nb;
+    
+    nb.hi = -b->hi;
+    nb.lo = -b->lo;
+    
+    dd_add(rop, a, &nb);
+}
+
+/*
+* rop = -a
+*/
+void dd_neg(dd_t* rop, dd_t* a) {
+    rop->hi = -a->hi;
+    rop->lo = -a->lo;
+}
+
+/*
+* rop = a * b
+*/
+void dd_mul(dd_t* rop, dd_t* a, dd_t* b) {
+    double p = a->hi * b->hi;
+    
+    // fma gives the rounding error of the product of the high parts.
+    double e = fma(a->hi, b->hi, -p);
+    
+    e += a->hi * b->lo + a->lo * b->hi;
+    _quick_two_sum(p, e, &rop->hi, &rop->lo);
+}
+
+/*
+* rop = a * u
+*/
+void dd_mul_ui(dd_t* rop, dd_t* a, unsigned long u) {
+    dd_t b;
+    
+    dd_set_si(&b, (long)u);
+    dd_mul(rop, a, &b);
+}
+
+/*
+* rop = a / b. b must not be zero.
+*/
+void dd_div(dd_t* rop, dd_t* a, dd_t* b) {
+    dd_t r, t;
+    double q1, q2, q3;
+    
+    // Long division, one double of the quotient at a time.
+    q1 = a->hi / b->hi;
+    dd_set_d(&t, q1);
+    dd_mul(&t, b, &t);
+    dd_sub(&r, a, &t);
+    
+    q2 = r.hi / b->hi;
+    dd_set_d(&t, q2);
+    dd_mul(&t, b, &t);
+    dd_sub(&r, &r, &t);
+    
+    q3 = r.hi / b->hi;
+    
+    _quick_two_sum(q1, q2, &rop->hi, &rop->lo);
+    _add_d(rop, rop, q3);
+}
+
+/*
+* rop = sqrt(a), by one Newton step from the double square root.
+* Negative values are treated as zero.
+*/
+void dd_sqrt(dd_t* rop, dd_t* a) {
+    dd_t r2, t;
+    double r;
+    
+    if (a->hi <= 0) {
+        rop->hi = 0;
+        rop->lo = 0;
+        return;
+    }
+    
+    // r = sqrt(a) to 53 bits, then r + (a - r^2) / (2 * r) doubles the
+    // correct bits. a - r^2 is small, so one double of it is enough.
+    r = sqrt(a->hi);
+    r2.hi = r * r;
+    r2.lo = fma(r, r, -r2.hi);
+    dd_sub(&t, a, &r2);
+    
+    dd_set_d(rop, r);
+    _add_d(rop, rop, t.hi / (2 * r));
+}
+
+/*
+* Sign of a value.
+*
+* @a: Value.
+*
+* returns: -1, 0, or 1.
+*/
+int dd_sgn(dd_t* a) {
+    if (a->hi < 0) {
+        return -1;
+    }
+    
+    return a->hi > 0 ? 1 : 0;
+}
+
+/*
+* Same as global_is_zero.
+*
+* @a: Value to compare.
+*
+* returns: 1 if the absolute value is less than g_epsilon, otherwise 0.
+*/
+int dd_is_zero(dd_t* a) {
+    dd_t m;
+    
+    if (a->hi < 0) {
+        dd_neg(&m, a);
+    } else {
+        m = *a;
+    }
+    
+    return _greater(&m, &g_dd_epsilon) ? 0 : 1;
+}
+
+/*
+* Same as global_compare_zero.
+*
+* @a: Value to compare.
+*
+* returns: 0 if the absolute value is less than g_epsilon,
+*     -1 if the value is less than zero,
+*     or 1 if the value is greater than zero.
+*/
+int dd_compare_zero(dd_t* a) {
+    if (dd_is_zero(a)) {
+        return 0;
+    }
+    
+    return dd_sgn(a);
+}
+
+/*
+* Same as global_is_zero_squared.
+*
+* @a: Squared value to compare, must not be negative.
+*
+* returns: 1 if the value is less than g_epsilon squared, otherwise 0.
+*/
+int dd_is_zero_squared(dd_t* a) {
+    return _greater(a, &g_dd_epsilon_squared) ? 0 : 1;
+}
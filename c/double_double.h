@@ -0,0 +1,152 @@
+/*
+* Double-double arithmetic, used by the intersection kernels in the
+* NUMERIC_BACKEND_DD build.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __DOUBLE_DOUBLE_H__
+#define __DOUBLE_DOUBLE_H__
+
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+
+// Value as the unevaluated sum hi + lo of two doubles, with |lo| at
+// most half an ulp of hi, giving about 106 bits of precision. Values
+// are held inline, there is nothing to allocate or free.
+typedef struct dd {
+    double hi;
+    double lo;
+} dd_t;
+
+// Bits of precision of a double-double value.
+#define DD_PRECISION_BITS 106
+
+// g_epsilon and g_epsilon_squared as double-double values.
+extern dd_t g_dd_epsilon;
+extern dd_t g_dd_epsilon_squared;
+
+/*
+* Sets g_dd_epsilon and g_dd_epsilon_squared from the mpf values.
+* Called by global_init.
+*/
+void global_dd_init();
+
+/*
+* Sets a double-double value from a GMP value. Only the top three
+* limbs are used.
+*
+* @rop: Result.
+* @f: Value to convert.
+*/
+void dd_set_mpf(dd_t* rop, mpf_t f);
+
+/*
+* Sets a GMP value from a double-double value.
+*
+* @rop: Result.
+* @a: Value to convert.
+*/
+void dd_get_mpf(mpf_t rop, dd_t* a);
+
+/*
+* Sets a double-double value from an int.
+*
+* @rop: Result.
+* @v: Value.
+*/
+void dd_set_si(dd_t* rop, long v);
+
+/*
+* Sets a double-double value from a double.
+*
+* @rop: Result.
+* @d: Value.
+*/
+void dd_set_d(dd_t* rop, double d);
+
+/*
+* Converts a double-double value to the nearest double.
+*
+* @a: Value to convert.
+*
+* returns: value as a double.
+*/
+double dd_get_d(dd_t* a);
+
+/*
+* rop = a + b
+*/
+void dd_add(dd_t* rop, dd_t* a, dd_t* b);
+
+/*
+* rop = a - b
+*/
+void dd_sub(dd_t* rop, dd_t* a, dd_t* b);
+
+/*
+* rop = -a
+*/
+void dd_neg(dd_t* rop, dd_t* a);
+
+/*
+* rop = a * b
+*/
+void dd_mul(dd_t* rop, dd_t* a, dd_t* b);
+
+/*
+* rop = a * u
+*/
+void dd_mul_ui(dd_t* rop, dd_t* a, unsigned long u);
+
+/*
+* rop = a / b. b must not be zero.
+*/
+void dd_div(dd_t* rop, dd_t* a, dd_t* b);
+
+/*
+* rop = sqrt(a), by one Newton step from the double square root.
+* Negative values are treated as zero.
+*/
+void dd_sqrt(dd_t* rop, dd_t* a);
+
+/*
+* Sign of a value.
+*
+* @a: Value.
+*
+* returns: -1, 0, or 1.
+*/
+int dd_sgn(dd_t* a);
+
+/*
+* Same as global_is_zero.
+*
+* @a: Value to compare.
+*
+* returns: 1 if the absolute value is less than g_epsilon, otherwise 0.
+*/
+int dd_is_zero(dd_t* a);
+
+/*
+* Same as global_compare_zero.
+*
+* @a: Value to compare.
+*
+* returns: 0 if the absolute value is less than g_epsilon,
+*     -1 if the value is less than zero,
+*     or 1 if the value is greater than zero.
+*/
+int dd_compare_zero(dd_t* a);
+
+/*
+* Same as global_is_zero_squared.
+*
+* @a: Squared value to compare, must not be negative.
+*
+* returns: 1 if the value is less than g_epsilon squared, otherwise 0.
+*/
+int dd_is_zero_squared(dd_t* a);
+
+#endif
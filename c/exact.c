@@ -0,0 +1,992 @@
+/*
+* Program to construct points exactly, with coordinates in towers of
+* quadratic extensions of the rationals.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <assert.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <gmp.h>
+
+#include "global.h"
+#include "geometry_context.h"
+#include "point.h"
+#include "line.h"
+#include "circle.h"
+#include "quadratic.h"
+#include "ini.h"
+
+/*
+* constructible keeps points in the datastore as decimal strings, so
+* the exact value of a point can't be kept between iterations. This
+* program runs the first iterations in memory instead, starting from
+* STARTING_POINTS_FILE:
+* 1) Every point is an x,y pair in its own tower Q(sqrt(a), sqrt(b), ...),
+*    see quadratic.h. Each intersection adds at most one square root.
+* 2) Objects and intersections are the same as constructible, every
+*    pair of points gives a line and two circles.
+* 3) Points are sorted by their mpf value, and points closer than
+*    STR_EPSILON are compared exactly. Two points are the same point
+*    only if they're equal, after merging their towers.
+*
+* The same iterations are run with the mpf kernels and point_equals,
+* the number of points and the time spent in the kernels are printed
+* for both.
+*/
+
+#define INI_SECTION_NAME "exact"
+#define INI_APP_SECTION_NAME "app"
+
+// Number of temporary elements used by the exact kernels.
+#define EXACT_TEMPS 16
+
+typedef struct exact_config {
+    size_t gmp_precision_bits;
+    size_t str_point_digits;
+    size_t point_hash_coord_bits;
+    char* str_init_epsilon;
+    char* starting_points_file;
+    size_t starting_points_file_line_buffer;
+    
+    // Number of iterations to run, EXACT_ITERATIONS.
+    size_t iterations;
+} exact_config_t;
+
+// Point with exact coordinates.
+typedef struct exact_point {
+    // Tower of x and y. The points of an intersection share it.
+    quad_tower_t* tower;
+    
+    quad_number_t x;
+    quad_number_t y;
+    
+    // Values of x and y, to sort and find nearby points.
+    mpf_t fx;
+    mpf_t fy;
+    
+    // Set if an equal point is kept instead.
+    int is_duplicate;
+} exact_point_t;
+
+// Line a*x + b*y = c, or circle with origin (a, b) and radius squared c.
+typedef struct exact_object {
+    int is_circle;
+    quad_tower_t* tower;
+    quad_number_t a;
+    quad_number_t b;
+    quad_number_t c;
+} exact_object_t;
+
+static exact_config_t _config;
+static quad_context_t* _ctx;
+static geometry_context_t* _geometry;
+
+// Every tower, freed at exit. Points and objects share towers.
+static quad_tower_t** _towers = NULL;
+static size_t _tower_count = 0;
+static size_t _tower_capacity = 0;
+
+// Tower used to compare points from different towers.
+static quad_tower_t* _compare_tower;
+
+// Square roots of the levels of the last merged tower, see _join.
+static quad_number_t _map[QUAD_MAX_DEPTH];
+
+static quad_number_t _t[EXACT_TEMPS];
+
+// Intersections not found because the tower would be too deep.
+static size_t _skipped = 0;
+
+// Point comparisons not decided because the tower would be too deep.
+static size_t _undecided = 0;
+
+/*
+* Handler called by ini parser.
+*/
+static int _ini_parse_handler(void* config, const char* section, const char* name, const char* value) {
+    exact_config_t* pconfig = (exact_config_t*)config;
+    
+    if (strcmp(section, INI_APP_SECTION_NAME) == 0 && strcmp(name, "GMP_PRECISION_BITS") == 0) {
+        sscanf(value, "%zu", &(pconfig->gmp_precision_bits));
+    } else if (strcmp(section, INI_APP_SECTION_NAME) == 0 && strcmp(name, "STR_POINT_DIGITS") == 0) {
+        sscanf(value, "%zu", &(pconfig->str_point_digits));
+    } else if (strcmp(section, INI_APP_SECTION_NAME) == 0 && strcmp(name, "POINT_HASH_COORD_DIGITS") == 0) {
+        sscanf(value, "%zu", &(pconfig->point_hash_coord_bits));
+    } else if (strcmp(section, INI_APP_SECTION_NAME) == 0 && strcmp(name, "STR_EPSILON") == 0) {
+        pconfig->str_init_epsilon = strdup(value);
+    } else if (strcmp(section, INI_APP_SECTION_NAME) == 0 && strcmp(name, "STARTING_POINTS_FILE") == 0) {
+        pconfig->starting_points_file = strdup(value);
+    } else if (strcmp(section, INI_APP_SECTION_NAME) == 0 && strcmp(name, "STARTING_POINTS_FILE_LINE_BUFFER") == 0) {
+        sscanf(value, "%zu", &(pconfig->starting_points_file_line_buffer));
+    } else if (strcmp(section, INI_SECTION_NAME) == 0 && strcmp(name, "EXACT_ITERATIONS") == 0) {
+        sscanf(value, "%zu", &(pconfig->iterations));
+    }
+    
+    return 1;
+}
+
+/*
+* Seconds between two times.
+*/
+static double _seconds(struct timespec* start, struct timespec* end) {
+    return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1000000000.0;
+}
+
+/*
+* Allocates a new tower with no levels, it's freed at exit.
+*/
+static quad_tower_t* _tower_new() {
+    if (_tower_count == _tower_capacity) {
+        _tower_capacity = _tower_capacity == 0 ? 1024 : _tower_capacity * 2;
+        _towers = realloc(_towers, sizeof(quad_tower_t*) * _tower_capacity);
+        global_exit_if_null(_towers, "Fatal error calling realloc for towers.\n");
+    }
+    
+    quad_tower_t* t = quad_tower_alloc();
+    quad_tower_init(t);
+    _towers[_tower_count++] = t;
+    
+    return t;
+}
+
+/*
+* Frees the last tower from _tower_new, when nothing uses it.
+*/
+static void _tower_drop_last() {
+    assert(_tower_count > 0);
+    
+    _tower_count--;
+    quad_tower_free(_towers[_tower_count]);
+}
+
+/*
+* Finds a tower with the levels of two towers.
+*
+* @t1: First tower.
+* @t2: Second tower.
+* @scratch: Tower set to the merged tower, if neither tower has the
+*     levels of the other. A new tower is used if this is NULL.
+* @use_map: Set to 1 if elements of t2 must be moved to the result with
+*     quad_map and _map, otherwise set to 0. Elements of t1 can always
+*     be used as they are.
+*
+* returns: t1, t2, or the merged tower. NULL if the merged tower would
+*     be too deep.
+*/
+static quad_tower_t* _join(quad_tower_t* t1, quad_tower_t* t2, quad_tower_t* scratch, int* use_map) {
+    *use_map = 0;
+    
+    if (t2->depth == 0 || quad_tower_equal(t1, t2)) {
+        return t1;
+    }
+    
+    // Elements of t1 are rational.
+    if (t1->depth == 0) {
+        return t2;
+    }
+    
+    if (scratch == NULL) {
+        scratch = _tower_new();
+    }
+    
+    quad_tower_copy(scratch, t1);
+    if (quad_tower_merge(_ctx, scratch, t2, _map) == 0) {
+        return NULL;
+    }
+    
+    *use_map = 1;
+    
+    return scratch;
+}
+
+/*
+* Sets r to an element of t2, see _join.
+*/
+static void _move(quad_tower_t* t, quad_number_t* r, quad_number_t* x, int use_map) {
+    if (use_map) {
+        quad_map(_ctx, t, r, x, _map);
+    } else {
+        quad_set(r, x);
+    }
+}
+
+/*
+* Allocates a new point.
+*
+* @t: Tower of x and y.
+* @x: x value.
+* @y: y value.
+*
+* returns: pointer to new point.
+*/
+static exact_point_t* _point_new(quad_tower_t* t, quad_number_t* x, quad_number_t* y) {
+    exact_point_t* p = malloc(sizeof(exact_point_t));
+    global_exit_if_null(p, "Fatal error calling malloc for exact_point_t.\n");
+    
+    p->tower = t;
+    p->is_duplicate = 0;
+    
+    quad_init(&p->x);
+    quad_init(&p->y);
+    quad_set(&p->x, x);
+    quad_set(&p->y, y);
+    
+    mpf_init(p->fx);
+    mpf_init(p->fy);
+    quad_get_mpf(_ctx, t, p->fx, &p->x);
+    quad_get_mpf(_ctx, t, p->fy, &p->y);
+    
+    return p;
+}
+
+/*
+* Frees a point.
+*/
+static void _point_free(exact_point_t* p) {
+    quad_clear(&p->x);
+    quad_clear(&p->y);
+    mpf_clear(p->fx);
+    mpf_clear(p->fy);
+    free(p);
+}
+
+/*
+* Appends a point to an array, growing the array if needed.
+*/
+static void _append(void*** items, size_t* count, size_t* capacity, void* item) {
+    if (*count == *capacity) {
+        *capacity = *capacity == 0 ? 1024 : *capacity * 2;
+        *items = realloc(*items, sizeof(void*) * *capacity);
+        global_exit_if_null(*items, "Fatal error calling realloc for points.\n");
+    }
+    
+    (*items)[(*count)++] = item;
+}
+
+/*
+* Sets the line and two circles of a pair of points.
+*
+* @p1: First point.
+* @p2: Second point.
+* @objects: Array of three objects to set.
+*
+* returns: 1 if the objects were set, 0 if the tower would be too deep.
+*/
+static int _objects_from_pair(exact_point_t* p1, exact_point_t* p2, exact_object_t* objects) {
+    quad_number_t *x1 = &_t[0], *y1 = &_t[1], *x2 = &_t[2], *y2 = &_t[3];
+    quad_number_t *dx = &_t[4], *dy = &_t[5], *t1 = &_t[6];
+    int use_map;
+    quad_tower_t* t = _join(p1->tower, p2->tower, NULL, &use_map);
+    int i;
+    
+    if (t == NULL) {
+        return 0;
+    }
+    
+    quad_set(x1, &p1->x);
+    quad_set(y1, &p1->y);
+    _move(t, x2, &p2->x, use_map);
+    _move(t, y2, &p2->y, use_map);
+    
+    quad_sub(t, dx, x2, x1);
+    quad_sub(t, dy, y2, y1);
+    
+    for (i=0; i<3; i++) {
+        objects[i].tower = t;
+        objects[i].is_circle = i > 0;
+    }
+    
+    // a = y2 - y1, b = x1 - x2, c = a * x1 + b * y1
+    quad_set(&objects[0].a, dy);
+    quad_neg(t, &objects[0].b, dx);
+    quad_mul(_ctx, t, &objects[0].c, &objects[0].a, x1);
+    quad_mul(_ctx, t, t1, &objects[0].b, y1);
+    quad_add(t, &objects[0].c, &objects[0].c, t1);
+    
+    // radius squared = dx^2 + dy^2
+    quad_mul(_ctx, t, t1, dx, dx);
+    quad_mul(_ctx, t, &objects[1].c, dy, dy);
+    quad_add(t, &objects[1].c, &objects[1].c, t1);
+    quad_set(&objects[2].c, &objects[1].c);
+    
+    quad_set(&objects[1].a, x1);
+    quad_set(&objects[1].b, y1);
+    quad_set(&objects[2].a, x2);
+    quad_set(&objects[2].b, y2);
+    
+    return 1;
+}
+
+/*
+* Adds the points of an intersection, x + sign * ox, y + sign * oy.
+*
+* @t: Tower of the intersection.
+* @found: Array to add the points to.
+* @x: x value.
+* @y: y value.
+* @ox: x offset, NULL for one point at x, y.
+* @oy: y offset.
+*/
+static void _add_points(quad_tower_t* t, void*** found, size_t* count, size_t* capacity,
+        quad_number_t* x, quad_number_t* y, quad_number_t* ox, quad_number_t* oy) {
+    quad_number_t *px = &_t[14], *py = &_t[15];
+    
+    if (ox == NULL) {
+        _append(found, count, capacity, _point_new(t, x, y));
+        return;
+    }
+    
+    quad_add(t, px, x, ox);
+    quad_add(t, py, y, oy);
+    _append(found, count, capacity, _point_new(t, px, py));
+    
+    quad_sub(t, px, x, ox);
+    quad_sub(t, py, y, oy);
+    _append(found, count, capacity, _point_new(t, px, py));
+}
+
+/*
+* Finds the intersections of two objects exactly.
+*
+* @o1: First object.
+* @o2: Second object.
+* @found: Array to add the points to.
+*
+* returns: number of points found.
+*/
+static int _intersect(exact_object_t* o1, exact_object_t* o2, void*** found, size_t* count, size_t* capacity) {
+    quad_number_t *a1 = &_t[0], *b1 = &_t[1], *c1 = &_t[2];
+    quad_number_t *a2 = &_t[3], *b2 = &_t[4], *c2 = &_t[5];
+    quad_number_t *t1 = &_t[6], *t2 = &_t[7], *t3 = &_t[8], *t4 = &_t[9];
+    quad_number_t *t5 = &_t[10], *t6 = &_t[11], *t7 = &_t[12], *t8 = &_t[13];
+    quad_number_t* swap;
+    quad_tower_t* t;
+    quad_tower_t* joined;
+    int use_map;
+    int sign;
+    size_t start_count = *count;
+    
+    joined = _join(o1->tower, o2->tower, NULL, &use_map);
+    if (joined == NULL) {
+        _skipped++;
+        return 0;
+    }
+    
+    // The intersection can add a level, the points get a new tower.
+    t = _tower_new();
+    quad_tower_copy(t, joined);
+    
+    quad_set(a1, &o1->a);
+    quad_set(b1, &o1->b);
+    quad_set(c1, &o1->c);
+    _move(t, a2, &o2->a, use_map);
+    _move(t, b2, &o2->b, use_map);
+    _move(t, c2, &o2->c, use_map);
+    
+    // circle and line, the circle is first
+    if (o1->is_circle == 0 && o2->is_circle) {
+        swap = a1; a1 = a2; a2 = swap;
+        swap = b1; b1 = b2; b2 = swap;
+        swap = c1; c1 = c2; c2 = swap;
+    }
+    
+    if (o1->is_circle == 0 && o2->is_circle == 0) {
+        // det = a1 * b2 - a2 * b1, zero for parallel lines
+        quad_mul(_ctx, t, t1, a1, b2);
+        quad_mul(_ctx, t, t2, a2, b1);
+        quad_sub(t, t1, t1, t2);
+    
+        if (quad_is_zero(t1) == 0) {
+            // x = (c1 * b2 - c2 * b1) / det, y = (a1 * c2 - a2 * c1) / det
+            quad_mul(_ctx, t, t2, c1, b2);
+            quad_mul(_ctx, t, t3, c2, b1);
+            quad_sub(t, t2, t2, t3);
+            quad_div(_ctx, t, t2, t2, t1);
+    
+            quad_mul(_ctx, t, t3, a1, c2);
+            quad_mul(_ctx, t, t4, a2, c1);
+            quad_sub(t, t3, t3, t4);
+            quad_div(_ctx, t, t3, t3, t1);
+    
+            _add_points(t, found, count, capacity, t2, t3, NULL, NULL);
+        }
+    } else if (o1->is_circle && o2->is_circle) {
+        // circle (a1, b1) r1^2 = c1, circle (a2, b2) r2^2 = c2
+        // dx = a2 - a1, dy = b2 - b1, d2 = dx^2 + dy^2
+        quad_sub(t, t1, a2, a1);
+        quad_sub(t, t2, b2, b1);
+        quad_mul(_ctx, t, t3, t1, t1);
+        quad_mul(_ctx, t, t4, t2, t2);
+        quad_add(t, t3, t3, t4);
+    
+        // Circles with the same origin are the same circle or don't meet.
+        if (quad_is_zero(t3) == 0) {
+            // k = r1^2 - r2^2 + d2, q = 4 * d2 * r1^2 - k^2
+            quad_sub(t, t4, c1, c2);
+            quad_add(t, t4, t4, t3);
+            quad_mul(_ctx, t, t5, t3, c1);
+            quad_add(t, t5, t5, t5);
+            quad_add(t, t5, t5, t5);
+            quad_mul(_ctx, t, t6, t4, t4);
+            quad_sub(t, t5, t5, t6);
+    
+            sign = quad_sgn(_ctx, t, t5);
+    
+            if (sign >= 0) {
+                // base = (a1, b1) + (k / (2 * d2)) * (dx, dy)
+                quad_add(t, t3, t3, t3);
+                quad_div(_ctx, t, t4, t4, t3);
+                quad_mul(_ctx, t, t6, t4, t1);
+                quad_add(t, t6, t6, a1);
+                quad_mul(_ctx, t, t7, t4, t2);
+                quad_add(t, t7, t7, b1);
+    
+                if (sign == 0) {
+                    _add_points(t, found, count, capacity, t6, t7, NULL, NULL);
+                } else if (quad_tower_sqrt(_ctx, t, t8, t5)) {
+                    // offset = (sqrt(q) / (2 * d2)) * (-dy, dx)
+                    quad_div(_ctx, t, t8, t8, t3);
+                    quad_mul(_ctx, t, t4, t8, t2);
+                    quad_neg(t, t4, t4);
+                    quad_mul(_ctx, t, t5, t8, t1);
+    
+                    _add_points(t, found, count, capacity, t6, t7, t4, t5);
+                } else {
+                    _skipped++;
+                }
+            }
+        }
+    } else {
+        // circle (a1, b1) r^2 = c1, line a2 * x + b2 * y = c2
+        // e = a2 * a1 + b2 * b1 - c2, n2 = a2^2 + b2^2
+        quad_mul(_ctx, t, t1, a2, a1);
+        quad_mul(_ctx, t, t2, b2, b1);
+        quad_add(t, t1, t1, t2);
+        quad_sub(t, t1, t1, c2);
+        quad_mul(_ctx, t, t2, a2, a2);
+        quad_mul(_ctx, t, t3, b2, b2);
+        quad_add(t, t2, t2, t3);
+    
+        // disc = r^2 * n2 - e^2
+        quad_mul(_ctx, t, t3, c1, t2);
+        quad_mul(_ctx, t, t4, t1, t1);
+        quad_sub(t, t3, t3, t4);
+    
+        sign = quad_sgn(_ctx, t, t3);
+    
+        if (sign >= 0) {
+            // foot = (a1, b1) - (e / n2) * (a2, b2)
+            quad_div(_ctx, t, t1, t1, t2);
+            quad_mul(_ctx, t, t5, t1, a2);
+            quad_sub(t, t5, a1, t5);
+            quad_mul(_ctx, t, t6, t1, b2);
+            quad_sub(t, t6, b1, t6);
+    
+            if (sign == 0) {
+                _add_points(t, found, count, capacity, t5, t6, NULL, NULL);
+            } else if (quad_tower_sqrt(_ctx, t, t4, t3)) {
+                // offset = (sqrt(disc) / n2) * (-b2, a2)
+                quad_div(_ctx, t, t4, t4, t2);
+                quad_mul(_ctx, t, t7, t4, b2);
+                quad_neg(t, t7, t7);
+                quad_mul(_ctx, t, t8, t4, a2);
+    
+                _add_points(t, found, count, capacity, t5, t6, t7, t8);
+            } else {
+                _skipped++;
+            }
+        }
+    }
+    
+    if (*count == start_count) {
+        _tower_drop_last();
+    }
+    
+    return (int)(*count - start_count);
+}
+
+/*
+* Compares two points exactly.
+*
+* returns: 1 if the points are equal, otherwise 0.
+*/
+static int _exact_equal(exact_point_t* p1, exact_point_t* p2) {
+    quad_number_t *x2 = &_t[0], *y2 = &_t[1];
+    quad_tower_t* t;
+    int use_map;
+    
+    t = _join(p1->tower, p2->tower, _compare_tower, &use_map);
+    if (t == NULL) {
+        _undecided++;
+        return 0;
+    }
+    
+    _move(t, x2, &p2->x, use_map);
+    _move(t, y2, &p2->y, use_map);
+    
+    return quad_equal(t, &p1->x, x2) && quad_equal(t, &p1->y, y2);
+}
+
+/*
+* Sort function for points, by mpf x value then y value.
+*/
+static int _exact_point_compare(const void* a, const void* b) {
+    exact_point_t* p1 = *(exact_point_t**)a;
+    exact_point_t* p2 = *(exact_point_t**)b;
+    int result = mpf_cmp(p1->fx, p2->fx);
+    
+    return result != 0 ? result : mpf_cmp(p1->fy, p2->fy);
+}
+
+/*
+* Sort function for mpf points, by x value then y value.
+*/
+static int _point_compare(const void* a, const void* b) {
+    point_t* p1 = *(point_t**)a;
+    point_t* p2 = *(point_t**)b;
+    int result = mpf_cmp(p1->x, p2->x);
+    
+    return result != 0 ? result : mpf_cmp(p1->y, p2->y);
+}
+
+/*
+* Removes duplicate points. Points with x values within STR_EPSILON
+* are compared exactly.
+*
+* @points: Array of points, duplicates are freed.
+* @count: Number of points, set to the number of distinct points.
+*
+* returns: the number of distinct pairs of points closer than STR_EPSILON.
+*/
+static size_t _exact_dedup(exact_point_t** points, size_t* count) {
+    size_t i, j, kept = 0, near = 0;
+    mpf_t diff;
+    mpf_init(diff);
+    
+    qsort(points, *count, sizeof(exact_point_t*), _exact_point_compare);
+    
+    for (i=0; i<*count; i++) {
+        if (points[i]->is_duplicate) {
+            continue;
+        }
+    
+        for (j=i+1; j<*count; j++) {
+            mpf_sub(diff, points[j]->fx, points[i]->fx);
+            if (global_is_zero(diff) == 0) {
+                break;
+            }
+    
+            if (points[j]->is_duplicate) {
+                continue;
+            }
+    
+            mpf_sub(diff, points[j]->fy, points[i]->fy);
+            if (global_is_zero(diff) == 0) {
+                continue;
+            }
+    
+            if (_exact_equal(points[i], points[j])) {
+                points[j]->is_duplicate = 1;
+            } else {
+                near++;
+            }
+        }
+    }
+    
+    for (i=0; i<*count; i++) {
+        if (points[i]->is_duplicate) {
+            _point_free(points[i]);
+        } else {
+            points[kept++] = points[i];
+        }
+    }
+    
+    *count = kept;
+    
+    mpf_clear(diff);
+    
+    return near;
+}
+
+/*
+* Removes duplicate mpf points, with point_equals.
+*
+* @points: Array of points, duplicates are freed.
+* @count: Number of points, set to the number of distinct points.
+*/
+static void _mpf_dedup(point_t** points, size_t* count) {
+    size_t i, j, kept = 0;
+    mpf_t diff;
+    mpf_init(diff);
+    
+    qsort(points, *count, sizeof(point_t*), _point_compare);
+    
+    for (i=0; i<*count; i++) {
+        if (points[i] == NULL) {
+            continue;
+        }
+    
+        for (j=i+1; j<*count; j++) {
+            if (points[j] == NULL) {
+                continue;
+            }
+    
+            mpf_sub(diff, points[j]->x, points[i]->x);
+            if (global_is_zero(diff) == 0) {
+                break;
+            }
+    
+            if (point_equals(_geometry, points[i], points[j])) {
+                point_free(points[j]);
+                points[j] = NULL;
+            }
+        }
+    }
+    
+    for (i=0; i<*count; i++) {
+        if (points[i] != NULL) {
+            points[kept++] = points[i];
+        }
+    }
+    
+    *count = kept;
+    
+    mpf_clear(diff);
+}
+
+/*
+* Runs one iteration with the exact kernels.
+*
+* @points: Array of distinct points, the new points are added.
+* @count: Number of points.
+* @capacity: Size of the array.
+* @seconds: Set to the time spent finding intersections.
+*
+* returns: the number of distinct pairs of points closer than STR_EPSILON.
+*/
+static size_t _exact_iteration(exact_point_t*** points, size_t* count, size_t* capacity, double* seconds) {
+    size_t point_count = *count;
+    size_t object_count = 0;
+    size_t i, j;
+    struct timespec start, end;
+    exact_object_t* objects;
+    int k;
+    
+    objects = malloc(sizeof(exact_object_t) * 3 * (point_count * (point_count - 1) / 2 + 1));
+    global_exit_if_null(objects, "Fatal error calling malloc for objects.\n");
+    
+    for (i=0; i<point_count; i++) {
+        for (j=i+1; j<point_count; j++) {
+            exact_object_t* o = &objects[object_count];
+            for (k=0; k<3; k++) {
+                quad_init(&o[k].a);
+                quad_init(&o[k].b);
+                quad_init(&o[k].c);
+            }
+    
+            if (_objects_from_pair((*points)[i], (*points)[j], o)) {
+                object_count += 3;
+            } else {
+                _skipped += 3;
+                for (k=0; k<3; k++) {
+                    quad_clear(&o[k].a);
+                    quad_clear(&o[k].b);
+                    quad_clear(&o[k].c);
+                }
+            }
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    for (i=0; i<object_count; i++) {
+        for (j=i+1; j<object_count; j++) {
+            _intersect(&objects[i], &objects[j], (void***)points, count, capacity);
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *seconds = _seconds(&start, &end);
+    
+    for (i=0; i<object_count; i++) {
+        quad_clear(&objects[i].a);
+        quad_clear(&objects[i].b);
+        quad_clear(&objects[i].c);
+    }
+    free(objects);
+    
+    return _exact_dedup(*points, count);
+}
+
+/*
+* Runs one iteration with the mpf kernels.
+*
+* @points: Array of distinct points, the new points are added.
+* @count: Number of points.
+* @capacity: Size of the array.
+* @seconds: Set to the time spent finding intersections.
+*/
+static void _mpf_iteration(point_t*** points, size_t* count, size_t* capacity, double* seconds) {
+    size_t point_count = *count;
+    size_t line_count = 0, circle_count = 0;
+    size_t i, j;
+    struct timespec start, end;
+    size_t pair_count = point_count * (point_count - 1) / 2 + 1;
+    line_t** lines = malloc(sizeof(line_t*) * pair_count);
+    circle_t** circles = malloc(sizeof(circle_t*) * pair_count * 2);
+    point_t* p1 = point_alloc();
+    point_t* p2 = point_alloc();
+    mpf_t d2;
+    int found;
+    
+    global_exit_if_null(lines, "Fatal error calling malloc for lines.\n");
+    global_exit_if_null(circles, "Fatal error calling malloc for circles.\n");
+    
+    point_init(p1);
+    point_init(p2);
+    mpf_init(d2);
+    
+    for (i=0; i<point_count; i++) {
+        for (j=i+1; j<point_count; j++) {
+            lines[line_count] = line_alloc();
+            line_init(lines[line_count]);
+            line_set(_geometry, lines[line_count], (*points)[i], (*points)[j]);
+            line_count++;
+    
+            point_distance_squared(_geometry, d2, (*points)[i], (*points)[j]);
+    
+            circles[circle_count] = circle_alloc();
+            circle_init(circles[circle_count]);
+            circle_set_radius_squared(circles[circle_count], (*points)[i], d2);
+            circle_count++;
+    
+            circles[circle_count] = circle_alloc();
+            circle_init(circles[circle_count]);
+            circle_set_radius_squared(circles[circle_count], (*points)[j], d2);
+            circle_count++;
+        }
+    }
+    
+#define MPF_ADD_FOUND(n) \
+    if ((n) > 0) _append((void***)points, count, capacity, point_clone(p1)); \
+    if ((n) > 1) _append((void***)points, count, capacity, point_clone(p2));
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    for (i=0; i<line_count; i++) {
+        for (j=i+1; j<line_count; j++) {
+            found = line_intersection_line(_geometry, lines[i], lines[j], p1);
+            MPF_ADD_FOUND(found);
+        }
+    
+        for (j=0; j<circle_count; j++) {
+            found = circle_intersection_line(_geometry, circles[j], lines[i], p1, p2);
+            MPF_ADD_FOUND(found);
+        }
+    }
+    
+    for (i=0; i<circle_count; i++) {
+        for (j=i+1; j<circle_count; j++) {
+            found = circle_intersection_circle(_geometry, circles[i], circles[j], p1, p2);
+            MPF_ADD_FOUND(found);
+        }
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    *seconds = _seconds(&start, &end);
+    
+#undef MPF_ADD_FOUND
+    
+    for (i=0; i<line_count; i++) {
+        line_free(lines[i]);
+    }
+    
+    for (i=0; i<circle_count; i++) {
+        circle_free(circles[i]);
+    }
+    
+    free(lines);
+    free(circles);
+    point_free(p1);
+    point_free(p2);
+    mpf_clear(d2);
+    
+    _mpf_dedup(*points, count);
+}
+
+/*
+* Reads the starting points, they must be exact decimals.
+*/
+static void _load_starting_points(exact_point_t*** exact_points, size_t* exact_count, size_t* exact_capacity,
+        point_t*** mpf_points, size_t* mpf_count, size_t* mpf_capacity) {
+    size_t buffer_len = _config.starting_points_file_line_buffer;
+    ssize_t read_len;
+    quad_number_t x, y;
+    point_t* p = point_alloc();
+    
+    char* line_buffer = malloc(sizeof(char) * buffer_len);
+    global_exit_if_null(line_buffer, "Fatal error calling malloc for line_buffer.\n");
+    
+    FILE *fp = fopen(_config.starting_points_file, "r");
+    if (fp == NULL) {
+        global_error_printf("Could not open '%s' for reading\n", _config.starting_points_file);
+        exit(1);
+    }
+    
+    point_init(p);
+    quad_init(&x);
+    quad_init(&y);
+    
+    while ((read_len = getline(&line_buffer, &buffer_len, fp)) != -1) {
+        if (line_buffer[0] == ';' || line_buffer[0] == '\n') {
+            continue;
+        }
+    
+        char* comma = strchr(line_buffer, (int)',');
+        if (comma == NULL) {
+            global_error_printf("Error parsing line: %s\n", line_buffer);
+            continue;
+        }
+    
+        *comma = '\0';
+        point_set_str(p, line_buffer, comma + 1);
+    
+        if (p->is_rational == 0) {
+            global_error_printf("Starting point is not an exact decimal: %s\n", line_buffer);
+            exit(1);
+        }
+    
+        quad_set_q(&x, p->qx);
+        quad_set_q(&y, p->qy);
+        _append((void***)exact_points, exact_count, exact_capacity, _point_new(_tower_new(), &x, &y));
+    
+        point_t* mpf_point = point_alloc();
+        point_init(mpf_point);
+        point_set(mpf_point, p->x, p->y);
+        _append((void***)mpf_points, mpf_count, mpf_capacity, mpf_point);
+    }
+    
+    fclose(fp);
+    free(line_buffer);
+    point_free(p);
+    quad_clear(&x);
+    quad_clear(&y);
+}
+
+int main() {
+    exact_point_t** exact_points = NULL;
+    size_t exact_count = 0, exact_capacity = 0;
+    point_t** mpf_points = NULL;
+    size_t mpf_count = 0, mpf_capacity = 0;
+    size_t iteration, i, near;
+    double exact_seconds, mpf_seconds;
+    double exact_total = 0, mpf_total = 0;
+    int max_depth;
+    
+    memset(&_config, 0, sizeof(exact_config_t));
+    _config.iterations = 2;
+    _config.starting_points_file_line_buffer = 1024;
+    
+    if (ini_parse("config.ini", _ini_parse_handler, &_config) < 0) {
+        fprintf(stderr, "Can't load 'config.ini'\n");
+        exit(1);
+    }
+    
+    global_init(_config.gmp_precision_bits, _config.str_init_epsilon);
+    global_point_init(_config.str_point_digits, _config.point_hash_coord_bits, 0);
+    
+    _geometry = geometry_context_alloc();
+    geometry_context_init(_geometry);
+    
+    _ctx = quad_context_alloc();
+    quad_context_init(_ctx);
+    
+    _compare_tower = quad_tower_alloc();
+    quad_tower_init(_compare_tower);
+    
+    for (i=0; i<QUAD_MAX_DEPTH; i++) {
+        quad_init(&_map[i]);
+    }
+    
+    for (i=0; i<EXACT_TEMPS; i++) {
+        quad_init(&_t[i]);
+    }
+    
+    // Exact decimals for the starting points, the mpf points
+    // are set without the fractions.
+    point_rational_init(64);
+    _load_starting_points(&exact_points, &exact_count, &exact_capacity, &mpf_points, &mpf_count, &mpf_capacity);
+    point_rational_init(0);
+    
+    if (exact_count < 2) {
+        printf("Couldn't find starting points to load. Exiting.\n");
+        exit(1);
+    }
+    
+    printf("starting points: %zu\n", exact_count);
+    
+    for (iteration=1; iteration<=_config.iterations; iteration++) {
+        near = _exact_iteration(&exact_points, &exact_count, &exact_capacity, &exact_seconds);
+        _mpf_iteration(&mpf_points, &mpf_count, &mpf_capacity, &mpf_seconds);
+    
+        exact_total += exact_seconds;
+        mpf_total += mpf_seconds;
+    
+        max_depth = 0;
+        for (i=0; i<exact_count; i++) {
+            if (exact_points[i]->tower->depth > max_depth) {
+                max_depth = exact_points[i]->tower->depth;
+            }
+        }
+    
+        printf("iteration %zu\n", iteration);
+        printf("    exact points: %zu, kernels %.3f s, max tower depth %d\n", exact_count, exact_seconds, max_depth);
+        printf("    mpf points: %zu, kernels %.3f s\n", mpf_count, mpf_seconds);
+        printf("    distinct exact points closer than STR_EPSILON: %zu\n", near);
+        printf("    intersections skipped, tower too deep: %zu\n", _skipped);
+        printf("    comparisons not decided, tower too deep: %zu\n", _undecided);
+    }
+    
+    if (mpf_total > 0) {
+        printf("exact kernels took %.2f times as long as the mpf kernels\n", exact_total / mpf_total);
+    }
+    
+    for (i=0; i<exact_count; i++) {
+        _point_free(exact_points[i]);
+    }
+    
+    for (i=0; i<mpf_count; i++) {
+        point_free(mpf_points[i]);
+    }
+    
+    for (i=0; i<_tower_count; i++) {
+        quad_tower_free(_towers[i]);
+    }
+    
+    for (i=0; i<QUAD_MAX_DEPTH; i++) {
+        quad_clear(&_map[i]);
+    }
+    
+    for (i=0; i<EXACT_TEMPS; i++) {
+        quad_clear(&_t[i]);
+    }
+    
+    free(exact_points);
+    free(mpf_points);
+    free(_towers);
+    quad_tower_free(_compare_tower);
+    quad_context_free(_ctx);
+    geometry_context_free(_geometry);
+    global_point_free();
+    global_free();
+    
+    free(_config.str_init_epsilon);
+    free(_config.starting_points_file);
+    
+    return 0;
+}
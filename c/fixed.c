@@ -0,0 +1,427 @@
+/*
+* Fixed point arithmetic on a compile time number of limbs, used by
+* the intersection kernels in the NUMERIC_BACKEND_FIXED build.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <assert.h>
+#include <math.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "fixed.h"
+#include "point.h"
+
+// Bits of the square root a double gives, a little less than 53 to
+// allow for rounding in fixed_get_d.
+#define SQRT_SEED_BITS 48
+
+fixed_t g_fixed_epsilon;
+fixed_t g_fixed_epsilon_squared;
+
+// Newton iterations needed by fixed_sqrt, set by global_fixed_init.
+static int _sqrt_iterations = 0;
+
+// Values below this use the division form in fixed_sqrt, their
+// reciprocal square root doesn't fit.
+#define SQRT_RECIPROCAL_MIN 0x1p-100
+
+/*
+* returns: 1 if the value is negative, otherwise 0.
+*/
+static inline int _is_negative(const fixed_t* a) {
+    return (int)(a->limbs[FIXED_LIMBS - 1] >> (GMP_NUMB_BITS - 1));
+}
+
+/*
+* Sets the magnitude of a value.
+*
+* returns: 1 if the value is negative, otherwise 0.
+*/
+static int _magnitude(mp_limb_t* rop, fixed_t* a) {
+    if (_is_negative(a)) {
+        mpn_neg(rop, a->limbs, FIXED_LIMBS);
+        return 1;
+    }
+    
+    memcpy(rop, a->limbs, sizeof(mp_limb_t) * FIXED_LIMBS);
+    return 0;
+}
+
+/*
+* Sets a value from its magnitude, or exits if the magnitude
+* doesn't fit.
+*/
+static void _set_magnitude(fixed_t* rop, mp_limb_t* magnitude, int negative) {
+    if (magnitude[FIXED_LIMBS - 1] >> (GMP_NUMB_BITS - 1)) {
+        global_error_printf("Fixed point value is too large.\n");
+        exit(1);
+    }
+    
+    if (negative) {
+        mpn_neg(rop->limbs, magnitude, FIXED_LIMBS);
+    } else {
+        memcpy(rop->limbs, magnitude, sizeof(mp_limb_t) * FIXED_LIMBS);
+    }
+}
+
+/*
+* Sets g_fixed_epsilon and g_fixed_epsilon_squared from the mpf values.
+* Called by global_init.
+*/
+void global_fixed_init() {
+    int bits;
+    
+    fixed_set_mpf(&g_fixed_epsilon, g_epsilon);
+    fixed_set_mpf(&g_fixed_epsilon_squared, g_epsilon_squared);
+    
+#ifdef NUMERIC_BACKEND_FIXED
+    if (fixed_sgn(&g_fixed_epsilon_squared) == 0) {
+        global_error_printf("STR_EPSILON squared is too small for FIXED_LIMBS = %d.\n", FIXED_LIMBS);
+        exit(1);
+    }
+#endif
+    
+    // Each iteration doubles the correct bits.
+    _sqrt_iterations = 1;
+    for (bits = SQRT_SEED_BITS; bits < GMP_NUMB_BITS * FIXED_FRACTION_LIMBS; bits *= 2) {
+        _sqrt_iterations++;
+    }
+}
+
+/*
+* Sets a fixed point value from a GMP value, truncated.
+*
+* @rop: Result.
+* @f: Value to convert.
+*/
+void fixed_set_mpf(fixed_t* rop, mpf_t f) {
+    mp_limb_t magnitude[FIXED_LIMBS];
+    signed char sign = point_set_fixed(magnitude, FIXED_LIMBS, f);
+    
+    _set_magnitude(rop, magnitude, sign < 0);
+}
+
+/*
+* Sets a GMP value from a fixed point value.
+*
+* @rop: Result.
+* @a: Value to convert.
+*/
+void fixed_get_mpf(mpf_t rop, fixed_t* a) {
+    mp_limb_t magnitude[FIXED_LIMBS];
+    int negative = _magnitude(magnitude, a);
+    
+    point_get_fixed(rop, magnitude, FIXED_LIMBS, negative ? -1 : 1);
+}
+
+/*
+* Sets a fixed point value from an int.
+*
+* @rop: Result.
+* @v: Value.
+*/
+void fixed_set_si(fixed_t* rop, long v) {
+    mp_limb_t magnitude[FIXED_LIMBS];
+    
+    memset(magnitude, 0, sizeof(mp_limb_t) * FIXED_LIMBS);
+    magnitude[FIXED_FRACTION_LIMBS] = v < 0 ? -(mp_limb_t)v : (mp_limb_t)v;
+    
+    _set_magnitude(rop, magnitude, v < 0);
+}
+
+/*
+* Sets a fixed point value from a double, truncated.
+*
+* @rop: Result.
+* @d: Value.
+*/
+void fixed_set_d(fixed_t* rop, double d) {
+    mp_limb_t magnitude[FIXED_LIMBS];
+    double m = fabs(d);
+    int i;
+    
+    if (m >= ldexp(1.0, GMP_NUMB_BITS - 1)) {
+        global_error_printf("Fixed point value is too large.\n");
+        exit(1);
+    }
+    
+    // Take one limb at a time from the top, the rest of m moves up
+    // into the next limb. Each step is exact.
+    for (i=FIXED_LIMBS - 1; i>=0; i--) {
+        magnitude[i] = (mp_limb_t)m;
+        m = ldexp(m - (double)magnitude[i], GMP_NUMB_BITS);
+    }
+    
+    _set_magnitude(rop, magnitude, d < 0);
+}
+
+/*
+* Converts a fixed point value to the nearest double, about.
+*
+* @a: Value to convert.
+*
+* returns: value as a double.
+*/
+double fixed_get_d(fixed_t* a) {
+    mp_limb_t magnitude[FIXED_LIMBS];
+    int negative = _magnitude(magnitude, a);
+    double d;
+    int i = FIXED_LIMBS - 1;
+    
+    while (i > 0 && magnitude[i] == 0) {
+        i--;
+    }
+    
+    // Limbs below the top two non zero ones don't change the result.
+    d = (double)magnitude[i];
+    
+    if (i > 0) {
+        d += ldexp((double)magnitude[i - 1], -GMP_NUMB_BITS);
+    }
+    
+    d = ldexp(d, GMP_NUMB_BITS * (i - FIXED_FRACTION_LIMBS));
+    
+    return negative ? -d : d;
+}
+
+/*
+* rop = a + b
+*/
+void fixed_add(fixed_t* rop, fixed_t* a, fixed_t* b) {
+    mpn_add_n(rop->limbs, a->limbs, b->limbs, FIXED_LIMBS);
+}
+
+/*
+* rop = a - b
+*/
+void fixed_sub(fixed_t* rop, fixed_t* a, fixed_t* b) {
+    mpn_sub_n(rop->limbs, a->limbs, b->limbs, FIXED_LIMBS);
+}
+
+/*
+* rop = -a
+*/
+void fixed_neg(fixed_t* rop, fixed_t* a) {
+    mpn_neg(rop->limbs, a->limbs, FIXED_LIMBS);
+}
+
+/*
+* rop = a * b
+*/
+void fixed_mul(fixed_t* rop, fixed_t* a, fixed_t* b) {
+    mp_limb_t ma[FIXED_LIMBS];
+    mp_limb_t mb[FIXED_LIMBS];
+    mp_limb_t product[2 * FIXED_LIMBS];
+    const mp_limb_t* pa = a->limbs;
+    const mp_limb_t* pb = b->limbs;
+    int negative = 0;
+    
+    // Only negative values are copied to take their magnitude.
+    if (_is_negative(a)) {
+        mpn_neg(ma, a->limbs, FIXED_LIMBS);
+        pa = ma;
+        negative = 1;
+    }
+    
+    if (a == b) {
+        pb = pa;
+        negative = 0;
+    } else if (_is_negative(b)) {
+        mpn_neg(mb, b->limbs, FIXED_LIMBS);
+        pb = mb;
+        negative ^= 1;
+    }
+    
+    if (a == b) {
+        mpn_sqr(product, pa, FIXED_LIMBS);
+    } else {
+        mpn_mul_n(product, pa, pb, FIXED_LIMBS);
+    }
+    
+    // The product has twice the fraction limbs, the low ones are dropped.
+    // The one limb above the result must be empty.
+    if (product[2 * FIXED_LIMBS - 1] != 0) {
+        global_error_printf("Fixed point value is too large.\n");
+        exit(1);
+    }
+    
+    _set_magnitude(rop, product + FIXED_FRACTION_LIMBS, negative);
+}
+
+/*
+* rop = a * u
+*/
+void fixed_mul_ui(fixed_t* rop, fixed_t* a, unsigned long u) {
+    // Multiplying modulo 2^(limb bits * FIXED_LIMBS) is the same for two's
+    // complement values, as long as the result fits.
+    mpn_mul_1(rop->limbs, a->limbs, FIXED_LIMBS, u);
+}
+
+/*
+* rop = a / b. b must not be zero.
+*/
+void fixed_div(fixed_t* rop, fixed_t* a, fixed_t* b) {
+    mp_limb_t ma[FIXED_LIMBS];
+    mp_limb_t mb[FIXED_LIMBS];
+    mp_limb_t numerator[FIXED_LIMBS + FIXED_FRACTION_LIMBS];
+    mp_limb_t quotient[FIXED_LIMBS + FIXED_FRACTION_LIMBS + 1];
+    mp_limb_t remainder[FIXED_LIMBS];
+    int negative = _magnitude(ma, a) ^ _magnitude(mb, b);
+    mp_size_t bn = FIXED_LIMBS;
+    mp_size_t qn;
+    mp_size_t i;
+    
+    while (bn > 0 && mb[bn - 1] == 0) {
+        bn--;
+    }
+    
+    assert(bn > 0);
+    
+    // a * 2^(fraction bits) / b keeps the fraction limbs of the quotient.
+    memset(numerator, 0, sizeof(mp_limb_t) * FIXED_FRACTION_LIMBS);
+    memcpy(numerator + FIXED_FRACTION_LIMBS, ma, sizeof(mp_limb_t) * FIXED_LIMBS);
+    
+    mpn_tdiv_qr(quotient, remainder, 0, numerator, FIXED_LIMBS + FIXED_FRACTION_LIMBS, mb, bn);
+    
+    qn = FIXED_LIMBS + FIXED_FRACTION_LIMBS - bn + 1;
+    
+    for (i=qn; i<FIXED_LIMBS; i++) {
+        quotient[i] = 0;
+    }
+    
+    for (i=FIXED_LIMBS; i<qn; i++) {
+        if (quotient[i] != 0) {
+            global_error_printf("Fixed point value is too large.\n");
+            exit(1);
+        }
+    }
+    
+    _set_magnitude(rop, quotient, negative);
+}
+
+/*
+* rop = sqrt(a), by Newton iteration from the double square root.
+* Negative values are treated as zero.
+*/
+void fixed_sqrt(fixed_t* rop, fixed_t* a) {
+    fixed_t x;
+    fixed_t y;
+    fixed_t t;
+    fixed_t three;
+    double d;
+    int i;
+    
+    if (fixed_sgn(a) <= 0) {
+        memset(rop->limbs, 0, sizeof(mp_limb_t) * FIXED_LIMBS);
+        return;
+    }
+    
+    d = fixed_get_d(a);
+    
+    if (d < SQRT_RECIPROCAL_MIN) {
+        fixed_set_d(&x, sqrt(d));
+        
+        for (i=0; i<_sqrt_iterations; i++) {
+            // x = (x + a / x) / 2, both terms are positive.
+            fixed_div(&t, a, &x);
+            fixed_add(&t, &t, &x);
+            mpn_rshift(x.limbs, t.limbs, FIXED_LIMBS, 1);
+        }
+        
+        *rop = x;
+        return;
+    }
+    
+    // Newton iteration on y = 1/sqrt(a) only needs multiplies,
+    // y = y * (3 - a * y^2) / 2. The last step below also doubles the
+    // correct bits, so it takes the place of one iteration.
+    fixed_set_si(&three, 3);
+    fixed_set_d(&y, 1.0 / sqrt(d));
+    
+    for (i=0; i<_sqrt_iterations - 2; i++) {
+        fixed_mul(&t, &y, &y);
+        fixed_mul(&t, &t, a);
+        fixed_sub(&t, &three, &t);
+        fixed_mul(&t, &t, &y);
+        mpn_rshift(y.limbs, t.limbs, FIXED_LIMBS, 1);
+    }
+    
+    // x = a * y, then one more step x = x + y * (a - x^2) / 2.
+    fixed_mul(&x, a, &y);
+    fixed_mul(&t, &x, &x);
+    fixed_sub(&t, a, &t);
+    fixed_mul(&t, &t, &y);
+    
+    if (fixed_sgn(&t) < 0) {
+        fixed_neg(&t, &t);
+        mpn_rshift(t.limbs, t.limbs, FIXED_LIMBS, 1);
+        fixed_sub(rop, &x, &t);
+    } else {
+        mpn_rshift(t.limbs, t.limbs, FIXED_LIMBS, 1);
+        fixed_add(rop, &x, &t);
+    }
+}
+
+/*
+* Sign of a value.
+*
+* @a: Value.
+*
+* returns: -1, 0, or 1.
+*/
+int fixed_sgn(fixed_t* a) {
+    if (_is_negative(a)) {
+        return -1;
+    }
+    
+    return mpn_zero_p(a->limbs, FIXED_LIMBS) ? 0 : 1;
+}
+
+/*
+* Same as global_is_zero.
+*
+* @a: Value to compare.
+*
+* returns: 1 if the absolute value is less than g_epsilon, otherwise 0.
+*/
+int fixed_is_zero(fixed_t* a) {
+    mp_limb_t magnitude[FIXED_LIMBS];
+    
+    _magnitude(magnitude, a);
+    
+    return mpn_cmp(magnitude, g_fixed_epsilon.limbs, FIXED_LIMBS) > 0 ? 0 : 1;
+}
+
+/*
+* Same as global_compare_zero.
+*
+* @a: Value to compare.
+*
+* returns: 0 if the absolute value is less than g_epsilon,
+*     -1 if the value is less than zero,
+*     or 1 if the value is greater than zero.
+*/
+int fixed_compare_zero(fixed_t* a) {
+    if (fixed_is_zero(a)) {
+        return 0;
+    }
+    
+    return fixed_sgn(a);
+}
+
+/*
+* Same as global_is_zero_squared.
+*
+* @a: Squared value to compare, must not be negative.
+*
+* returns: 1 if the value is less than g_epsilon squared, otherwise 0.
+*/
+int fixed_is_zero_squared(fixed_t* a) {
+    return mpn_cmp(a->limbs, g_fixed_epsilon_squared.limbs, FIXED_LIMBS) > 0 ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/*
+* Fixed point arithmetic on a compile time number of limbs, used by
+* the intersection kernels in the NUMERIC_BACKEND_FIXED build.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __FIXED_H__
+#define __FIXED_H__
+
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+
+// Number of limbs in a fixed point value, set with -DFIXED_LIMBS=n.
+// One limb holds the integer part, the rest the fraction, so 4 limbs
+// give 192 fraction bits, about GMP_PRECISION_BITS = 200.
+#ifndef FIXED_LIMBS
+#define FIXED_LIMBS 4
+#endif
+
+#define FIXED_FRACTION_LIMBS (FIXED_LIMBS - 1)
+
+// Fixed point value in two's complement, least significant limb first,
+// with FIXED_FRACTION_LIMBS limbs after the binary point. The limbs are
+// held inline, so values can live on the stack or in a struct with no
+// allocation, and every operation works on the same number of limbs
+// with no normalization.
+//
+// Values must stay within +/- 2^63. Going outside that while converting,
+// multiplying, or dividing is a fatal error. Results are truncated
+// towards zero.
+typedef struct fixed {
+    mp_limb_t limbs[FIXED_LIMBS];
+} fixed_t;
+
+// g_epsilon and g_epsilon_squared as fixed point values.
+extern fixed_t g_fixed_epsilon;
+extern fixed_t g_fixed_epsilon_squared;
+
+/*
+* Sets g_fixed_epsilon and g_fixed_epsilon_squared from the mpf values.
+* Called by global_init.
+*/
+void global_fixed_init();
+
+/*
+* Sets a fixed point value from a GMP value, truncated.
+*
+* @rop: Result.
+* @f: Value to convert.
+*/
+void fixed_set_mpf(fixed_t* rop, mpf_t f);
+
+/*
+* Sets a GMP value from a fixed point value.
+*
+* @rop: Result.
+* @a: Value to convert.
+*/
+void fixed_get_mpf(mpf_t rop, fixed_t* a);
+
+/*
+* Sets a fixed point value from an int.
+*
+* @rop: Result.
+* @v: Value.
+*/
+void fixed_set_si(fixed_t* rop, long v);
+
+/*
+* Sets a fixed point value from a double, truncated.
+*
+* @rop: Result.
+* @d: Value.
+*/
+void fixed_set_d(fixed_t* rop, double d);
+
+/*
+* Converts a fixed point value to the nearest double, about.
+*
+* @a: Value to convert.
+*
+* returns: value as a double.
+*/
+double fixed_get_d(fixed_t* a);
+
+/*
+* rop = a + b
+*/
+void fixed_add(fixed_t* rop, fixed_t* a, fixed_t* b);
+
+/*
+* rop = a - b
+*/
+void fixed_sub(fixed_t* rop, fixed_t* a, fixed_t* b);
+
+/*
+* rop = -a
+*/
+void fixed_neg(fixed_t* rop, fixed_t* a);
+
+/*
+* rop = a * b
+*/
+void fixed_mul(fixed_t* rop, fixed_t* a, fixed_t* b);
+
+/*
+* rop = a * u
+*/
+void fixed_mul_ui(fixed_t* rop, fixed_t* a, unsigned long u);
+
+/*
+* rop = a / b. b must not be zero.
+*/
+void fixed_div(fixed_t* rop, fixed_t* a, fixed_t* b);
+
+/*
+* rop = sqrt(a), by Newton iteration from the double square root.
+* Negative values are treated as zero.
+*/
+void fixed_sqrt(fixed_t* rop, fixed_t* a);
+
+/*
+* Sign of a value.
+*
+* @a: Value.
+*
+* returns: -1, 0, or 1.
+*/
+int fixed_sgn(fixed_t* a);
+
+/*
+* Same as global_is_zero.
+*
+* @a: Value to compare.
+*
+* returns: 1 if the absolute value is less than g_epsilon, otherwise 0.
+*/
+int fixed_is_zero(fixed_t* a);
+
+/*
+* Same as global_compare_zero.
+*
+* @a: Value to compare.
+*
+* returns: 0 if the absolute value is less than g_epsilon,
+*     -1 if the value is less than zero,
+*     or 1 if the value is greater than zero.
+*/
+int fixed_compare_zero(fixed_t* a);
+
+/*
+* Same as global_is_zero_squared.
+*
+* @a: Squared value to compare, must not be negative.
+*
+* returns: 1 if the value is less than g_epsilon squared, otherwise 0.
+*/
+int fixed_is_zero_squared(fixed_t* a);
+
+#endif
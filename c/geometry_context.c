@@ -0,0 +1,270 @@
+/*
+* Scratch values used by the point, line, circle, and pair calculations.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <stdio.h> // recommended to include stdio before gmp
+#include <stdlib.h>
+#include <string.h>
+#include <gmp.h>
+
+#include "global.h"
+#include "geometry_context.h"
+#include "point.h"
+
+// Number of mpf_t values in a scratch struct.
+#define SCRATCH_COUNT(s) (sizeof(s) / sizeof(mpf_t))
+
+/*
+* Initializes every value in a scratch struct.
+*
+* @t: First value of scratch struct.
+* @count: Number of values in the struct.
+*/
+static void _scratch_init(mpf_t* t, size_t count) {
+    for (size_t i=0; i<count; i++) {
+        mpf_init(t[i]);
+    }
+}
+
+/*
+* Sets the precision of every value in a scratch struct.
+*
+* @t: First value of scratch struct.
+* @count: Number of values in the struct.
+* @precision: Precision in bits.
+*/
+static void _scratch_set_prec(mpf_t* t, size_t count, mp_bitcnt_t precision) {
+    for (size_t i=0; i<count; i++) {
+        mpf_set_prec(t[i], precision);
+    }
+}
+
+/*
+* Clears every value in a scratch struct.
+*
+* @t: First value of scratch struct.
+* @count: Number of values in the struct.
+*/
+static void _scratch_clear(mpf_t* t, size_t count) {
+    for (size_t i=0; i<count; i++) {
+        mpf_clear(t[i]);
+    }
+}
+
+/*
+* Initializes every value of the rational scratch struct.
+*
+* @s: Scratch struct.
+*/
+static void _rational_scratch_init(rational_scratch_t* s) {
+    mpq_t* t = (mpq_t*)s;
+    
+    for (size_t i=0; i<sizeof(rational_scratch_t) / sizeof(mpq_t); i++) {
+        mpq_init(t[i]);
+    }
+}
+
+/*
+* Clears every value of the rational scratch struct.
+*
+* @s: Scratch struct.
+*/
+static void _rational_scratch_clear(rational_scratch_t* s) {
+    mpq_t* t = (mpq_t*)s;
+    
+    for (size_t i=0; i<sizeof(rational_scratch_t) / sizeof(mpq_t); i++) {
+        mpq_clear(t[i]);
+    }
+}
+
+/*
+* Allocates memory for a new context.
+*
+* returns: pointer to new context.
+*/
+geometry_context_t* geometry_context_alloc() {
+    geometry_context_t* ctx = malloc(sizeof(geometry_context_t));
+    global_exit_if_null(ctx, "Fatal error calling malloc for geometry_context_t.\n");
+    memset(ctx, 0, sizeof(geometry_context_t));
+    
+    return ctx;
+}
+
+/*
+* Initializes new context. Must be called before use, and
+* after global_init (scratch values use the default GMP precision).
+*
+* @ctx: Context to initialize.
+*/
+void geometry_context_init(geometry_context_t* ctx) {
+    if (ctx->is_init == IS_INIT) {
+        return;
+    }
+    
+    _scratch_init((mpf_t*)&ctx->global, SCRATCH_COUNT(ctx->global));
+    _scratch_init((mpf_t*)&ctx->point, SCRATCH_COUNT(ctx->point));
+    _scratch_init((mpf_t*)&ctx->line, SCRATCH_COUNT(ctx->line));
+    _scratch_init((mpf_t*)&ctx->circle, SCRATCH_COUNT(ctx->circle));
+    _scratch_init((mpf_t*)&ctx->pair, SCRATCH_COUNT(ctx->pair));
+    _rational_scratch_init(&ctx->rational);
+    
+    ctx->use_interval_filter = 1;
+    ctx->filter_resolved = 0;
+    ctx->filter_fallback = 0;
+    ctx->rational_intersections = 0;
+    ctx->point_table_hits = 0;
+    ctx->point_table_misses = 0;
+    
+    ctx->is_init = IS_INIT;
+}
+
+/*
+* Sets up a low precision context for the context, see
+* geometry_context_t.low. Must be called after geometry_context_init.
+* The guard band should be checked with global_guard_band_valid.
+*
+* @ctx: Context.
+* @precision: Precision in bits of the low precision scratch values.
+* @str_guard_band: Width of the guard band on each side of g_epsilon.
+*/
+void geometry_context_init_low(geometry_context_t* ctx, mp_bitcnt_t precision, char* str_guard_band) {
+    geometry_context_t* low;
+    long band_exp;
+    
+    if (ctx->low != NULL) {
+        return;
+    }
+    
+    low = geometry_context_alloc();
+    geometry_context_init(low);
+    
+    _scratch_set_prec((mpf_t*)&low->global, SCRATCH_COUNT(low->global), precision);
+    _scratch_set_prec((mpf_t*)&low->point, SCRATCH_COUNT(low->point), precision);
+    _scratch_set_prec((mpf_t*)&low->line, SCRATCH_COUNT(low->line), precision);
+    _scratch_set_prec((mpf_t*)&low->circle, SCRATCH_COUNT(low->circle), precision);
+    _scratch_set_prec((mpf_t*)&low->pair, SCRATCH_COUNT(low->pair), precision);
+    
+    // The owning context runs the filter before either pass.
+    low->use_interval_filter = 0;
+    low->is_low_precision = 1;
+    
+    mpf_init_set_str(low->guard_band_high, str_guard_band, 10);
+    
+    // 2^(band_exp - 1) <= band, so terms less than
+    // 2^(band_exp - 1 + precision - GUARD_BAND_MARGIN_BITS) round by
+    // less than the band.
+    mpf_get_d_2exp(&band_exp, low->guard_band_high);
+    low->guard_band_max_exp = band_exp - 1 + (long)precision - GUARD_BAND_MARGIN_BITS;
+    
+    // low = max(0, epsilon - band), high = epsilon + band
+    mpf_init(low->guard_band_low);
+    mpf_sub(low->guard_band_low, g_epsilon, low->guard_band_high);
+    if (mpf_sgn(low->guard_band_low) < 0) {
+        mpf_set_ui(low->guard_band_low, 0);
+    }
+    
+    mpf_add(low->guard_band_high, low->guard_band_high, g_epsilon);
+    
+    mpf_init(low->guard_band_low_squared);
+    mpf_mul(low->guard_band_low_squared, low->guard_band_low, low->guard_band_low);
+    
+    mpf_init(low->guard_band_high_squared);
+    mpf_mul(low->guard_band_high_squared, low->guard_band_high, low->guard_band_high);
+    
+    ctx->low = low;
+}
+
+/*
+* Called after a calculation in the low precision context. Counts it,
+* and whether it has to be done again at full precision.
+* A result with no value in the guard band is used if it found no
+* intersections, or if geometry_context_t.low_known finds every point
+* is already known. A point that isn't known yet is calculated again,
+* so the points kept have every bit of the full precision.
+*
+* @ctx: Context that owns the low precision context.
+* @points: Points found at low precision.
+* @count: Number of intersections found at low precision.
+*
+* returns: 1 if the low precision result can be used, 0 if the
+*     calculation has to be done again with ctx.
+*/
+int geometry_context_low_done(geometry_context_t* ctx, struct point** points, int count) {
+    int known = 0;
+    
+    ctx->low_precision_count++;
+    
+    if (ctx->low->guard_band_flagged) {
+        ctx->low->guard_band_flagged = 0;
+        ctx->low_precision_flagged++;
+        return 0;
+    }
+    
+    if (count == 0) {
+        return 1;
+    }
+    
+    if (ctx->low_known != NULL) {
+        known = ctx->low_known(ctx->low_known_data, points, count);
+    }
+    
+    if (known == 1) {
+        return 1;
+    }
+    
+    if (known < 0) {
+        ctx->low_precision_near++;
+    } else {
+        ctx->low_precision_new++;
+    }
+    
+    return 0;
+}
+
+/*
+* Frees resources used by the context.
+*
+* @ctx: Context to free.
+*/
+void geometry_context_free(geometry_context_t* ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    
+    if (ctx->is_init == IS_INIT) {
+        _scratch_clear((mpf_t*)&ctx->global, SCRATCH_COUNT(ctx->global));
+        _scratch_clear((mpf_t*)&ctx->point, SCRATCH_COUNT(ctx->point));
+        _scratch_clear((mpf_t*)&ctx->line, SCRATCH_COUNT(ctx->line));
+        _scratch_clear((mpf_t*)&ctx->circle, SCRATCH_COUNT(ctx->circle));
+        _scratch_clear((mpf_t*)&ctx->pair, SCRATCH_COUNT(ctx->pair));
+        _rational_scratch_clear(&ctx->rational);
+        
+        while (ctx->free_point_count > 0) {
+            ctx->free_point_count--;
+            point_free(ctx->free_points[ctx->free_point_count]);
+        }
+        free(ctx->free_points);
+        ctx->free_points = NULL;
+        
+        free(ctx->probe_key);
+        ctx->probe_key = NULL;
+        
+
+        geometry_context_free(ctx->low);
+        ctx->low = NULL;
+        
+        if (ctx->is_low_precision) {
+            mpf_clear(ctx->guard_band_low);
+            mpf_clear(ctx->guard_band_high);
+            mpf_clear(ctx->guard_band_low_squared);
+            mpf_clear(ctx->guard_band_high_squared);
+        }
+        
+        ctx->is_init = 0;
+    }
+    
+    free(ctx);
+}
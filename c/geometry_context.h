@@ -0,0 +1,277 @@
+/*
+* Scratch values used by the point, line, circle, and pair calculations.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __GEOMETRY_CONTEXT_H__
+#define __GEOMETRY_CONTEXT_H__
+
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+
+struct point;
+struct geometry_context;
+
+/*
+* Looks up the points found by a calculation in the low precision
+* context among the known points, see geometry_context_t.low_known.
+*
+* @data: geometry_context_t.low_known_data.
+* @points: Points found at low precision.
+* @count: Number of points.
+*
+* returns: 1 if every point is a known point, -1 if a point is within
+*     the guard band of a known point without being that point,
+*     otherwise 0.
+*/
+typedef int (*geometry_low_known_t)(void* data, struct point** points, int count);
+
+// Each of the scratch structs below must only contain mpf_t members,
+// they are initialized and cleared as an array of mpf_t.
+
+// Scratch values used by global.c
+typedef struct global_scratch {
+    mpf_t t1;
+    mpf_t t2;
+} global_scratch_t;
+
+// Scratch values used by point.c
+typedef struct point_scratch {
+    mpf_t t1;
+    mpf_t t2;
+    mpf_t t3;
+    mpf_t t4;
+    mpf_t t5;
+    mpf_t t6;
+} point_scratch_t;
+
+// Scratch values used by line.c
+typedef struct line_scratch {
+    mpf_t t1;
+    mpf_t t2;
+    mpf_t t3;
+    mpf_t t4;
+    mpf_t t5;
+    mpf_t t6;
+    mpf_t t7;
+    mpf_t t8;
+    mpf_t t9;
+    mpf_t ta;
+    mpf_t tb;
+    mpf_t tc;
+} line_scratch_t;
+
+// Scratch values used by circle.c
+typedef struct circle_scratch {
+    mpf_t t1;
+    mpf_t t2;
+    mpf_t t3;
+    mpf_t t4;
+    mpf_t t5;
+    mpf_t t6;
+    mpf_t t7;
+    mpf_t t8;
+    mpf_t t9;
+    mpf_t ta;
+    mpf_t tb;
+    mpf_t tc;
+    mpf_t td;
+    mpf_t te;
+    mpf_t tf;
+    mpf_t tg;
+    mpf_t th;
+    mpf_t ti;
+    mpf_t tj;
+    mpf_t tk;
+    mpf_t tm;
+    mpf_t tn;
+    mpf_t tp;
+    mpf_t tq;
+    mpf_t tr;
+    mpf_t ts;
+    mpf_t tt;
+    mpf_t tu;
+    mpf_t tv;
+    mpf_t tw;
+    mpf_t tx;
+    mpf_t ty;
+    mpf_t tz;
+} circle_scratch_t;
+
+// Scratch values used by pair.c. The arrays are indexed by
+// (left point * 2 + right point), see pair_intersection_pair.
+typedef struct pair_scratch {
+    // Origin differences, right point - left point.
+    mpf_t dx[4];
+    mpf_t dy[4];
+    
+    // Squared distances between the origins.
+    mpf_t d2[4];
+    
+    // Signed distances from a line, the right points from the left
+    // line are 0 and 1, the left points from the right line are 2 and 3.
+    mpf_t dist[4];
+    
+    // left r^2 - right r^2, and 4 * left r^2.
+    mpf_t delta;
+    mpf_t four_r2;
+    
+    mpf_t t1;
+    mpf_t t2;
+    mpf_t t3;
+    mpf_t t4;
+    mpf_t t5;
+    mpf_t t6;
+} pair_scratch_t;
+
+// Scratch values used by the exact rational calculations, see
+// point_set_q. Like the structs above, but only mpq_t members.
+typedef struct rational_scratch {
+    mpq_t t1;
+    mpq_t t2;
+    mpq_t t3;
+    mpq_t t4;
+    mpq_t t5;
+} rational_scratch_t;
+
+// Holds every temporary used by the geometry calculations. Each module
+// gets its own scratch values, since e.g. the circle calculations call
+// into point and global while holding their own intermediate values.
+//
+// A context must only be used by one thread at a time. Each thread
+// doing calculations should have its own context.
+typedef struct geometry_context {
+    global_scratch_t global;
+    point_scratch_t point;
+    line_scratch_t line;
+    circle_scratch_t circle;
+    pair_scratch_t pair;
+    rational_scratch_t rational;
+    
+    // Set to 0 to skip the interval arithmetic filter and always
+    // use the mpf calculation. Default 1.
+    int use_interval_filter;
+    
+    // Number of intersection calculations decided by the interval
+    // filter, and the number that needed the mpf calculation.
+    size_t filter_resolved;
+    size_t filter_fallback;
+    
+    // Context with the same scratch values at a lower precision, or
+    // NULL. When set, the mpf intersection calculations are done with
+    // it first. They're only done again with this context if a value
+    // they compare with g_epsilon is within the guard band, see
+    // global_guard_band_check, or if a point they found isn't a known
+    // point, see low_known and geometry_context_low_done. Otherwise
+    // they return 0, there are no intersections or they're all known.
+    struct geometry_context* low;
+    
+    // Looks up the points found in the low precision context, called
+    // with low_known_data. NULL to calculate every intersection found
+    // at low precision again.
+    geometry_low_known_t low_known;
+    void* low_known_data;
+    
+    // Set for the low precision context, and set while a calculation
+    // in it has a value within the guard band.
+    int is_low_precision;
+    int guard_band_flagged;
+    
+    // Set for the low precision context. Absolute values compared with
+    // g_epsilon between guard_band_low and guard_band_high are within
+    // the guard band, and squared values between the squared bounds.
+    // Terms of 2^guard_band_max_exp or more round by more than the band
+    // at the low precision, see GUARD_BAND_MARGIN_BITS.
+    mpf_t guard_band_low;
+    mpf_t guard_band_high;
+    mpf_t guard_band_low_squared;
+    mpf_t guard_band_high_squared;
+    long guard_band_max_exp;
+    
+    // Number of intersection calculations done in the low precision
+    // context. Of those, the number done again at full precision
+    // because a value was within the guard band (flagged), because a
+    // point was within the guard band of a known point (near), and
+    // because a point wasn't known yet (new).
+    size_t low_precision_count;
+    size_t low_precision_flagged;
+    size_t low_precision_near;
+    size_t low_precision_new;
+    
+    // Number of intersections of rational points calculated exactly,
+    // see point_rational_init.
+    size_t rational_intersections;
+    
+    // Number of points found in a point table (hits), and the number
+    // added because they weren't there (misses), see point_table_add.
+    size_t point_table_hits;
+    size_t point_table_misses;
+    
+    // Points given back with point_release, handed out again by
+    // point_take. Most intersection points are already known and
+    // thrown away right after they're found, so the calculations
+    // can reuse these instead of allocating new points.
+    struct point** free_points;
+    size_t free_point_count;
+    
+    // Hash keys of neighboring grid cells, used by point_hash_cells.
+    // Allocated the first time it's needed.
+    mp_limb_t* probe_key;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} geometry_context_t;
+
+/*
+* Allocates memory for a new context.
+*
+* returns: pointer to new context.
+*/
+geometry_context_t* geometry_context_alloc();
+
+/*
+* Initializes new context. Must be called before use, and
+* after global_init (scratch values use the default GMP precision).
+*
+* @ctx: Context to initialize.
+*/
+void geometry_context_init(geometry_context_t* ctx);
+
+/*
+* Sets up a low precision context for the context, see
+* geometry_context_t.low. Must be called after geometry_context_init.
+* The guard band should be checked with global_guard_band_valid.
+*
+* @ctx: Context.
+* @precision: Precision in bits of the low precision scratch values.
+* @str_guard_band: Width of the guard band on each side of g_epsilon.
+*/
+void geometry_context_init_low(geometry_context_t* ctx, mp_bitcnt_t precision, char* str_guard_band);
+
+/*
+* Called after a calculation in the low precision context. Counts it,
+* and whether it has to be done again at full precision.
+* A result with no value in the guard band is used if it found no
+* intersections, or if geometry_context_t.low_known finds every point
+* is already known. A point that isn't known yet is calculated again,
+* so the points kept have every bit of the full precision.
+*
+* @ctx: Context that owns the low precision context.
+* @points: Points found at low precision.
+* @count: Number of intersections found at low precision.
+*
+* returns: 1 if the low precision result can be used, 0 if the
+*     calculation has to be done again with ctx.
+*/
+int geometry_context_low_done(geometry_context_t* ctx, struct point** points, int count);
+
+/*
+* Frees resources used by the context.
+*
+* @ctx: Context to free.
+*/
+void geometry_context_free(geometry_context_t* ctx);
+
+#endif
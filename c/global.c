@@ -13,22 +13,26 @@
 
 #include "console.h"
 #include "global.h"
+#include "interval.h"
+#include "fixed.h"
+#include "double_double.h"
+#include "numeric.h"
 
 mpf_t g_one;
 mpf_t g_two;
 mpf_t g_zero;
+mpf_t g_root_three_over_two;
 
 mpf_t g_epsilon;
+mpf_t g_m_epsilon;
+mpf_t g_epsilon_squared;
 
-// internal variables use for calculation.
 static int _p_init = 0;
-static mpf_t _t1;
-static mpf_t _t2;
 
 /*
 * Set the precision of GMP. By default, this is called with PRECISION_BITS.
 * This only affects variables instantiated after this call.
-* Initializes some static variables.
+* Initializes the global constants.
 */
 void global_init(mp_bitcnt_t precision, char* str_epsilon) {
     if (_p_init != 0) {
@@ -39,19 +43,33 @@ void global_init(mp_bitcnt_t precision, char* str_epsilon) {
     
     mpf_set_default_prec(precision);
     
-    mpf_init(_t1);
-    mpf_init(_t2);
-    
     mpf_init_set_ui(g_zero, 0);
     mpf_init_set_ui(g_one, 1);
     mpf_init_set_ui(g_two, 2);
     
+    mpf_init(g_root_three_over_two);
+    mpf_sqrt_ui(g_root_three_over_two, 3);
+    mpf_div_ui(g_root_three_over_two, g_root_three_over_two, 2);
+    
     mpf_init_set_str(g_epsilon, str_epsilon, 10);
+    
+    mpf_init(g_m_epsilon);
+    mpf_neg(g_m_epsilon, g_epsilon);
+    
+    mpf_init(g_epsilon_squared);
+    mpf_mul(g_epsilon_squared, g_epsilon, g_epsilon);
+    
+    global_interval_init();
+    global_fixed_init();
+    global_dd_init();
+    
+#ifdef NUMERIC_BACKEND_MPFR
+    global_bigfloat_init();
+#endif
 }
 
 /*
 * Frees any memory used by the global constants defined here.
-* Frees memory used by static variables.
 */
 void global_free() {
     if (_p_init != 1) {
@@ -59,13 +77,56 @@ void global_free() {
     }
     
     _p_init = 0;
-    mpf_clear(_t1);
-    mpf_clear(_t2);
     
     mpf_clear(g_zero);
     mpf_clear(g_one);
     mpf_clear(g_two);
+    mpf_clear(g_root_three_over_two);
     mpf_clear(g_epsilon);
+    mpf_clear(g_m_epsilon);
+    mpf_clear(g_epsilon_squared);
+}
+
+/*
+* Checks a guard band against the rounding of the low precision pass, see
+* GUARD_BAND_MARGIN_BITS. The band must be wider than the rounding of
+* values less than 2, so that values found from terms of that size can be
+* compared with g_epsilon, and with known points, at low precision.
+* Precision over DD_PRECISION_BITS is counted as DD_PRECISION_BITS, the
+* known points looked up by the low precision pass are kept as double-double
+* values, see point_grid_t.
+*
+* @precision: Precision in bits of the low precision pass.
+* @str_guard_band: Width of the band.
+*
+* returns: 1 if the guard band can be used with the precision, otherwise 0.
+*/
+int global_guard_band_valid(mp_bitcnt_t precision, char* str_guard_band) {
+    mpf_t band;
+    mpf_t rounding;
+    int result = 1;
+    
+    if (precision > DD_PRECISION_BITS) {
+        precision = DD_PRECISION_BITS;
+    }
+    
+    mpf_init_set_str(band, str_guard_band, 10);
+    mpf_init(rounding);
+    
+    // rounding => 2^(1 + GUARD_BAND_MARGIN_BITS - precision)
+    mpf_set_ui(rounding, 2);
+    if (precision > GUARD_BAND_MARGIN_BITS) {
+        mpf_div_2exp(rounding, rounding, precision - GUARD_BAND_MARGIN_BITS);
+    }
+    
+    if (mpf_cmp(band, rounding) <= 0) {
+        result = 0;
+    }
+    
+    mpf_clear(band);
+    mpf_clear(rounding);
+    
+    return result;
 }
 
 /*
@@ -76,11 +137,11 @@ void global_free() {
 * returns: 1 if the absolute value is less than g_epsilon, otherwise 0.
 */
 int global_is_zero(mpf_t f) {
-    mpf_abs(_t1, f);
+    // Compare against both g_epsilon and -g_epsilon instead of taking
+    // the absolute value, so no temporary is needed.
     
     // Compare op1 and op2. Return a positive value if op1 > op2, zero if op1 = op2, and a negative value if op1 < op2.
-    int result = mpf_cmp(_t1, g_epsilon);
-    if (result > 0) {
+    if (mpf_cmp(f, g_epsilon) > 0 || mpf_cmp(f, g_m_epsilon) < 0) {
         // absolute value is greater than g_epsilon, so it's not zero.
         return 0;
     }
@@ -99,19 +160,38 @@ int global_is_zero(mpf_t f) {
 *     or 1 if the value is greater than g_zero.
 */
 int global_compare_zero(mpf_t f) {
-    mpf_abs(_t1, f);
-    int result = mpf_cmp(_t1, g_epsilon);
-    if (result < 1) {
-        // absolute value is less than or equal to g_epsilon, so it's "zero"
+    if (mpf_cmp(f, g_epsilon) > 0) {
+        return 1;
+    }
+    
+    if (mpf_cmp(f, g_m_epsilon) < 0) {
+        return -1;
+    }
+    
+    // absolute value is less than or equal to g_epsilon, so it's "zero"
+    return 0;
+}
+
+/*
+* Check if a squared distance is less than g_epsilon squared, which
+* is the same as checking the distance with global_is_zero.
+*
+* @f: Squared value to compare, must not be negative.
+*
+* returns: 1 if the value is less than g_epsilon squared, otherwise 0.
+*/
+int global_is_zero_squared(mpf_t f) {
+    if (mpf_cmp(f, g_epsilon_squared) > 0) {
         return 0;
     }
     
-    return mpf_sgn(f);
+    return 1;
 }
 
 /*
 * Compare two values, within range of g_epsilon.
 *
+* @ctx: Context holding scratch values.
 * @f1: First value to compare.
 * @f2: Second value to compare.
 *
@@ -120,16 +200,84 @@ int global_compare_zero(mpf_t f) {
 *     -1 if f1 is less than f2,
 *     or 1 if f1 is greater than f2.
 */
-int global_compare2(mpf_t f1, mpf_t f2) {
-    mpf_sub(_t1, f1, f2);
-    mpf_abs(_t2, _t1);
-    int result = mpf_cmp(_t2, g_epsilon);
+int global_compare2(geometry_context_t* ctx, mpf_t f1, mpf_t f2) {
+    global_scratch_t* s = &ctx->global;
+    
+    mpf_sub(s->t1, f1, f2);
+    mpf_abs(s->t2, s->t1);
+    int result = mpf_cmp(s->t2, g_epsilon);
     if (result < 1) {
         // absolute value of difference is less than or equal to g_epsilon, so it's "zero"
         return 0;
     }
     
-    return mpf_sgn(_t1);
+    return mpf_sgn(s->t1);
+}
+
+/*
+* In a low precision context, flags the calculation to be done again
+* at full precision if a value it compares with g_epsilon is within
+* the guard band, since the comparison could go the other way at full
+* precision. It's also flagged if the terms the value is the difference
+* of are too large for their rounding to stay within the guard band, see
+* geometry_context_t.guard_band_max_exp, or if the difference cancels
+* more than GUARD_BAND_CANCEL_BITS bits. Does nothing in other contexts.
+*
+* @ctx: Context holding scratch values.
+* @f: Value compared with global_is_zero or global_compare_zero.
+* @a: First term, f = a - b.
+* @b: Second term.
+*/
+void global_guard_band_check(geometry_context_t* ctx, mpf_t f, mpf_t a, mpf_t b) {
+    global_scratch_t* s = &ctx->global;
+    long exp_a, exp_b, exp_f;
+    
+    if (ctx->is_low_precision == 0) {
+        return;
+    }
+    
+    // |a| < 2^exp_a, |b| < 2^exp_b
+    mpf_get_d_2exp(&exp_a, a);
+    mpf_get_d_2exp(&exp_b, b);
+    
+    if (exp_a > ctx->guard_band_max_exp || exp_b > ctx->guard_band_max_exp) {
+        ctx->guard_band_flagged = 1;
+        return;
+    }
+    
+    mpf_abs(s->t1, f);
+    
+    if (mpf_cmp(s->t1, ctx->guard_band_low) >= 0 && mpf_cmp(s->t1, ctx->guard_band_high) <= 0) {
+        ctx->guard_band_flagged = 1;
+        return;
+    }
+    
+    // A value past the band is used to find the point.
+    if (mpf_cmp(s->t1, ctx->guard_band_high) > 0) {
+        mpf_get_d_2exp(&exp_f, f);
+        
+        if (exp_a - exp_f > GUARD_BAND_CANCEL_BITS || exp_b - exp_f > GUARD_BAND_CANCEL_BITS) {
+            ctx->guard_band_flagged = 1;
+        }
+    }
+}
+
+/*
+* Same as global_guard_band_check, for a value compared with
+* global_is_zero_squared. The value is a sum of squares, which has no
+* cancellation, so only the band is checked.
+*
+* @ctx: Context holding scratch values.
+* @f: Squared value, must not be negative.
+*/
+void global_guard_band_check_squared(geometry_context_t* ctx, mpf_t f) {
+    if (ctx->is_low_precision == 0) {
+        return;
+    }
+    
+    if (mpf_cmp(f, ctx->guard_band_low_squared) >= 0 && mpf_cmp(f, ctx->guard_band_high_squared) <= 0) {
+        ctx->guard_band_flagged = 1;
+    }
 }
 
 /*
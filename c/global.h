@@ -12,6 +12,8 @@
 #include <gmp.h>
 #include <stdarg.h>
 
+#include "geometry_context.h"
+
 // For the data structures defined in this project, they
 // should be malloc'd and then memset to zero. Once they are
 // initialized, the is_init property is set to this value.
@@ -33,22 +35,60 @@ extern mpf_t g_one;
 // Global constant, initialized to the number 2
 extern mpf_t g_two;
 
+// Global constant, initialized to sqrt(3) / 2
+extern mpf_t g_root_three_over_two;
+
 // absolute values less than this will be considered zero
 extern mpf_t g_epsilon;
 
+// Global constant, negative g_epsilon
+extern mpf_t g_m_epsilon;
+
+// Global constant, g_epsilon squared
+extern mpf_t g_epsilon_squared;
+
 /*
 * Set the precision of GMP. By default, this is called with PRECISION_BITS.
 * This only affects variables instantiated after this call.
-* Initializes some static variables.
+* Initializes the global constants.
 */
 void global_init(mp_bitcnt_t, char* str_epsilon);
 
 /*
 * Frees any memory used by the global constants defined here.
-* Frees memory used by static variables.
 */
 void global_free();
 
+// Rounding of the low precision pass of the intersection calculations.
+// A value found from terms less than 2^e is taken to be within
+// 2^(e + GUARD_BAND_MARGIN_BITS - precision) of its value at full
+// precision, which leaves room for the rounding of the dozen or so
+// operations of a calculation and a cancellation of up to
+// GUARD_BAND_CANCEL_BITS bits.
+#define GUARD_BAND_MARGIN_BITS 16
+
+// Most bits a value checked by global_guard_band_check can lose to
+// cancellation before the calculation is flagged. The point is found by
+// dividing by the value or from its square root, so a larger loss would
+// leave the point further from its full precision value.
+#define GUARD_BAND_CANCEL_BITS 8
+
+/*
+* Checks a guard band against the rounding of the low precision pass, see
+* GUARD_BAND_MARGIN_BITS. The band must be wider than the rounding of
+* values less than 2, so that values found from terms of that size can be
+* compared with g_epsilon, and with known points, at low precision.
+* Precision over DD_PRECISION_BITS is counted as DD_PRECISION_BITS, the
+* known points looked up by the low precision pass are kept as double-double
+* values, see point_grid_t.
+*
+* @precision: Precision in bits of the low precision pass.
+* @str_guard_band: Width of the band.
+*
+* returns: 1 if the guard band can be used with the precision, otherwise 0.
+*/
+int global_guard_band_valid(mp_bitcnt_t precision, char* str_guard_band);
+
 /*
 * Check if a value is less than g_epsilon.
 *
@@ -69,9 +109,20 @@ int global_is_zero(mpf_t f);
 */
 int global_compare_zero(mpf_t f);
 
+/*
+* Check if a squared distance is less than g_epsilon squared, which
+* is the same as checking the distance with global_is_zero.
+*
+* @f: Squared value to compare, must not be negative.
+*
+* returns: 1 if the value is less than g_epsilon squared, otherwise 0.
+*/
+int global_is_zero_squared(mpf_t f);
+
 /*
 * Compare two values, within range of g_epsilon.
 *
+* @ctx: Context holding scratch values.
 * @f1: First value to compare.
 * @f2: Second value to compare.
 *
@@ -80,7 +131,33 @@ int global_compare_zero(mpf_t f);
 *     -1 if f1 is less than f2,
 *     or 1 if f1 is greater than f2.
 */
-int global_compare2(mpf_t f1, mpf_t f2);
+int global_compare2(geometry_context_t* ctx, mpf_t f1, mpf_t f2);
+
+/*
+* In a low precision context, flags the calculation to be done again
+* at full precision if a value it compares with g_epsilon is within
+* the guard band, since the comparison could go the other way at full
+* precision. It's also flagged if the terms the value is the difference
+* of are too large for their rounding to stay within the guard band, see
+* geometry_context_t.guard_band_max_exp, or if the difference cancels
+* more than GUARD_BAND_CANCEL_BITS bits. Does nothing in other contexts.
+*
+* @ctx: Context holding scratch values.
+* @f: Value compared with global_is_zero or global_compare_zero.
+* @a: First term, f = a - b.
+* @b: Second term.
+*/
+void global_guard_band_check(geometry_context_t* ctx, mpf_t f, mpf_t a, mpf_t b);
+
+/*
+* Same as global_guard_band_check, for a value compared with
+* global_is_zero_squared. The value is a sum of squares, which has no
+* cancellation, so only the band is checked.
+*
+* @ctx: Context holding scratch values.
+* @f: Squared value, must not be negative.
+*/
+void global_guard_band_check_squared(geometry_context_t* ctx, mpf_t f);
 
 /*
 * Prints an error message to stderr in red text.
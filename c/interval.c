@@ -0,0 +1,173 @@
+/*
+* Double precision interval arithmetic, used as a fast filter
+* before the GMP calculations.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <math.h>
+
+#include "global.h"
+#include "interval.h"
+
+double g_interval_guard;
+
+// Results of + - * / sqrt are rounded to nearest, so moving one
+// double outward is enough to contain the exact value.
+#define ROUND_DOWN(x) nextafter((x), -INFINITY)
+#define ROUND_UP(x) nextafter((x), INFINITY)
+
+/*
+* Sets g_interval_guard from g_epsilon. Called by global_init.
+*/
+void global_interval_init() {
+    interval_t e;
+    
+    interval_set_mpf(&e, g_epsilon);
+    g_interval_guard = ROUND_UP(2.0 * e.hi);
+}
+
+/*
+* Sets the interval to contain a GMP value.
+*
+* @rop: Result.
+* @f: Value to convert.
+*/
+void interval_set_mpf(interval_t* rop, mpf_t f) {
+    // mpf_get_d truncates, so the exact value is less than one
+    // double away (towards infinity) from d.
+    double d = mpf_get_d(f);
+    
+    if (mpf_cmp_d(f, d) == 0) {
+        rop->lo = d;
+        rop->hi = d;
+    } else {
+        rop->lo = ROUND_DOWN(d);
+        rop->hi = ROUND_UP(d);
+    }
+}
+
+/*
+* rop = a + b
+*/
+void interval_add(interval_t* rop, interval_t* a, interval_t* b) {
+    rop->lo = ROUND_DOWN(a->lo + b->lo);
+    rop->hi = ROUND_UP(a->hi + b->hi);
+}
+
+/*
+* rop = a - b
+*/
+void interval_sub(interval_t* rop, interval_t* a, interval_t* b) {
+    double lo = ROUND_DOWN(a->lo - b->hi);
+    
+    rop->hi = ROUND_UP(a->hi - b->lo);
+    rop->lo = lo;
+}
+
+/*
+* rop = a * b
+*/
+void interval_mul(interval_t* rop, interval_t* a, interval_t* b) {
+    double p1 = a->lo * b->lo;
+    double p2 = a->lo * b->hi;
+    double p3 = a->hi * b->lo;
+    double p4 = a->hi * b->hi;
+    
+    rop->lo = ROUND_DOWN(fmin(fmin(p1, p2), fmin(p3, p4)));
+    rop->hi = ROUND_UP(fmax(fmax(p1, p2), fmax(p3, p4)));
+}
+
+/*
+* rop = a * a. Tighter than interval_mul, the result is never negative.
+*/
+void interval_sqr(interval_t* rop, interval_t* a) {
+    double lo;
+    double hi;
+    
+    if (a->lo >= 0) {
+        lo = a->lo * a->lo;
+        hi = a->hi * a->hi;
+    } else if (a->hi <= 0) {
+        lo = a->hi * a->hi;
+        hi = a->lo * a->lo;
+    } else {
+        lo = 0;
+        hi = fmax(a->lo * a->lo, a->hi * a->hi);
+    }
+    
+    rop->lo = lo > 0 ? ROUND_DOWN(lo) : 0;
+    rop->hi = ROUND_UP(hi);
+}
+
+/*
+* rop = sqrt(a). Negative values are treated as zero.
+*/
+void interval_sqrt(interval_t* rop, interval_t* a) {
+    rop->lo = a->lo > 0 ? ROUND_DOWN(sqrt(a->lo)) : 0;
+    rop->hi = a->hi > 0 ? ROUND_UP(sqrt(a->hi)) : 0;
+}
+
+/*
+* rop = |a|
+*/
+void interval_abs(interval_t* rop, interval_t* a) {
+    double lo;
+    double hi;
+    
+    if (a->lo >= 0) {
+        lo = a->lo;
+        hi = a->hi;
+    } else if (a->hi <= 0) {
+        lo = -a->hi;
+        hi = -a->lo;
+    } else {
+        lo = 0;
+        hi = fmax(-a->lo, a->hi);
+    }
+    
+    rop->lo = lo;
+    rop->hi = hi;
+}
+
+/*
+* Checks if the exact value is certainly less than -g_interval_guard.
+*
+* @a: Interval to check.
+*
+* returns: 1 if certain, 0 if the mpf calculation is needed.
+*/
+int interval_is_negative(interval_t* a) {
+    // NaN compares false, so falls back to mpf.
+    return a->hi < -g_interval_guard;
+}
+
+/*
+* Checks if the exact value is certainly greater than g_interval_guard.
+*
+* @a: Interval to check.
+*
+* returns: 1 if certain, 0 if the mpf calculation is needed.
+*/
+int interval_is_positive(interval_t* a) {
+    return a->lo > g_interval_guard;
+}
+
+/*
+* Checks if the exact value is certainly within g_epsilon/2 of zero.
+* Only (nearly) exact calculations can pass this check, since the
+* interval has to be narrower than g_epsilon.
+*
+* @a: Interval to check.
+*
+* returns: 1 if certain, 0 if the mpf calculation is needed.
+*/
+int interval_is_zero(interval_t* a) {
+    // g_interval_guard is 2*g_epsilon
+    double half_epsilon = g_interval_guard / 4;
+    
+    return a->lo > -half_epsilon && a->hi < half_epsilon;
+}
@@ -0,0 +1,103 @@
+/*
+* Double precision interval arithmetic, used as a fast filter
+* before the GMP calculations.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __INTERVAL_H__
+#define __INTERVAL_H__
+
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+
+// Closed interval [lo, hi] that contains the exact value.
+// Every operation rounds the bounds outward, so the exact result
+// of the same calculation on the exact inputs is always inside
+// the interval. Overflow or NaN gives an interval that never
+// passes any of the certain comparisons below.
+typedef struct interval {
+    double lo;
+    double hi;
+} interval_t;
+
+// Boundary used when certifying a result against g_epsilon. This is
+// 2*g_epsilon rounded up, the extra g_epsilon covers the (much smaller)
+// rounding error of the mpf calculation, so anything the filter
+// decides is what the mpf calculation would have decided.
+extern double g_interval_guard;
+
+/*
+* Sets g_interval_guard from g_epsilon. Called by global_init.
+*/
+void global_interval_init();
+
+/*
+* Sets the interval to contain a GMP value.
+*
+* @rop: Result.
+* @f: Value to convert.
+*/
+void interval_set_mpf(interval_t* rop, mpf_t f);
+
+/*
+* rop = a + b
+*/
+void interval_add(interval_t* rop, interval_t* a, interval_t* b);
+
+/*
+* rop = a - b
+*/
+void interval_sub(interval_t* rop, interval_t* a, interval_t* b);
+
+/*
+* rop = a * b
+*/
+void interval_mul(interval_t* rop, interval_t* a, interval_t* b);
+
+/*
+* rop = a * a. Tighter than interval_mul, the result is never negative.
+*/
+void interval_sqr(interval_t* rop, interval_t* a);
+
+/*
+* rop = sqrt(a). Negative values are treated as zero.
+*/
+void interval_sqrt(interval_t* rop, interval_t* a);
+
+/*
+* rop = |a|
+*/
+void interval_abs(interval_t* rop, interval_t* a);
+
+/*
+* Checks if the exact value is certainly less than -g_interval_guard.
+*
+* @a: Interval to check.
+*
+* returns: 1 if certain, 0 if the mpf calculation is needed.
+*/
+int interval_is_negative(interval_t* a);
+
+/*
+* Checks if the exact value is certainly greater than g_interval_guard.
+*
+* @a: Interval to check.
+*
+* returns: 1 if certain, 0 if the mpf calculation is needed.
+*/
+int interval_is_positive(interval_t* a);
+
+/*
+* Checks if the exact value is certainly within g_epsilon/2 of zero.
+* Only (nearly) exact calculations can pass this check, since the
+* interval has to be narrower than g_epsilon.
+*
+* @a: Interval to check.
+*
+* returns: 1 if certain, 0 if the mpf calculation is needed.
+*/
+int interval_is_zero(interval_t* a);
+
+#endif
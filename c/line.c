@@ -13,70 +13,124 @@
 #include <string.h>
 
 #include "global.h"
+#include "geometry_context.h"
+#include "numeric.h"
+#include "interval.h"
 #include "line.h"
 #include "point.h"
 
-// internal variables use for calculation.
-static int _p_init = 0;
-static mpf_t _t1;
-static mpf_t _t2;
-static mpf_t _t3;
-static mpf_t _t4;
-static mpf_t _t5;
-static mpf_t _t6;
-static mpf_t _t7;
-static mpf_t _t8;
-static mpf_t _t9;
-static mpf_t _ta;
-static mpf_t _tb;
-static mpf_t _tc;
+/*
+* Interval arithmetic version of the determinant check in
+* line_intersection_line.
+*
+* returns: 1 if the lines are certainly parallel (no intersection),
+*     0 if the mpf calculation is needed.
+*/
+static int _filter_line_x_line(line_t* n1, line_t* n2) {
+    interval_t t1, t2, det;
+    
+    // det = a1 * b2 - a2 * b1;
+    interval_mul(&t1, &n1->ia, &n2->ib);
+    interval_mul(&t2, &n2->ia, &n1->ib);
+    interval_sub(&det, &t1, &t2);
+    
+    return interval_is_zero(&det);
+}
 
 /*
-* Initializes some static variables.
+* Calculates the coefficients of the line from its points.
+*
+* @ctx: Context holding scratch values.
+* @n: Line to update.
 */
-void global_line_init() {
-    if (_p_init != 0) {
-        return;
+static void _line_prepare(geometry_context_t* ctx, line_t* n) {
+    line_scratch_t* s = &ctx->line;
+    
+    n->is_rational = 0;
+    if (n->p1->is_rational && n->p2->is_rational) {
+        // qa = y2 - y1, qb = x1 - x2, qc = qa * x1 + qb * y1
+        mpq_sub(n->qa, n->p2->qy, n->p1->qy);
+        mpq_sub(n->qb, n->p1->qx, n->p2->qx);
+        mpq_mul(ctx->rational.t1, n->qa, n->p1->qx);
+        mpq_mul(ctx->rational.t2, n->qb, n->p1->qy);
+        mpq_add(n->qc, ctx->rational.t1, ctx->rational.t2);
+        n->is_rational = 1;
     }
     
-    _p_init = 1;
-    
-    mpf_init(_t1);
-    mpf_init(_t2);
-    mpf_init(_t3);
-    mpf_init(_t4);
-    mpf_init(_t5);
-    mpf_init(_t6);
-    mpf_init(_t7);
-    mpf_init(_t8);
-    mpf_init(_t9);
-    mpf_init(_ta);
-    mpf_init(_tb);
-    mpf_init(_tc);
+    // a = y2 - y1, b = x1 - x2
+    mpf_sub(n->a, n->p2->y, n->p1->y);
+    mpf_sub(n->b, n->p1->x, n->p2->x);
+    
+    // t3 = sqrt(a^2 + b^2)
+    mpf_mul(s->t1, n->a, n->a);
+    mpf_mul(s->t2, n->b, n->b);
+    mpf_add(s->t3, s->t1, s->t2);
+    
+    // Points are the same, there isn't a line to describe.
+    if (mpf_sgn(s->t3) == 0) {
+        mpf_set_ui(n->c, 0);
+    } else {
+        mpf_sqrt(s->t3, s->t3);
+        
+        mpf_div(n->a, n->a, s->t3);
+        mpf_div(n->b, n->b, s->t3);
+        
+        // c = a * x1 + b * y1
+        mpf_mul(s->t1, n->a, n->p1->x);
+        mpf_mul(s->t2, n->b, n->p1->y);
+        mpf_add(n->c, s->t1, s->t2);
+    }
+    
+    interval_set_mpf(&n->ia, n->a);
+    interval_set_mpf(&n->ib, n->b);
+    interval_set_mpf(&n->ic, n->c);
+    
+#ifdef NUMERIC_KERNELS
+    num_set_mpf(&n->num_a, n->a);
+    num_set_mpf(&n->num_b, n->b);
+    num_set_mpf(&n->num_c, n->c);
+#endif
 }
 
+#ifdef NUMERIC_KERNELS
 /*
-* Frees memory used by static variables.
+* Numeric backend version of the calculation in line_intersection_line,
+* using the numeric backend copies of the coefficients.
+*
+* returns: The number of intersection points found.
 */
-void global_line_free() {
-    if (_p_init != 1) {
-        return;
+static int _line_x_line_numeric(line_t* n1, line_t* n2, point_t* p) {
+    num_t det, t1, t2, v;
+    
+    // det = a1 * b2 - a2 * b1;
+    num_mul(&t1, &n1->num_a, &n2->num_b);
+    num_mul(&t2, &n2->num_a, &n1->num_b);
+    num_sub(&det, &t1, &t2);
+    
+    if (num_is_zero(&det) == 1) {
+        // no intersection
+        return 0;
     }
     
-    _p_init = 0;
-    mpf_clear(_t1);
-    mpf_clear(_t2);
-    mpf_clear(_t3);
-    mpf_clear(_t4);
-    mpf_clear(_t5);
-    mpf_clear(_t6);
-    mpf_clear(_t7);
-    mpf_clear(_t8);
-    mpf_clear(_t9);
-    mpf_clear(_ta);
-    mpf_clear(_tb);
-    mpf_clear(_tc);
+    point_reset(p);
+    
+    // p->x = (c1 * b2 - c2 * b1) / det;
+    num_mul(&t1, &n1->num_c, &n2->num_b);
+    num_mul(&t2, &n2->num_c, &n1->num_b);
+    num_sub(&t1, &t1, &t2);
+    num_div(&v, &t1, &det);
+    num_get_mpf(p->x, &v);
+    
+    // p->y = (a1 * c2 - a2 * c1) / det;
+    num_mul(&t1, &n1->num_a, &n2->num_c);
+    num_mul(&t2, &n2->num_a, &n1->num_c);
+    num_sub(&t1, &t1, &t2);
+    num_div(&v, &t1, &det);
+    num_get_mpf(p->y, &v);
+    
+    return 1;
 }
+#endif
 
 /*
 * Allocates memory for a new line.
@@ -108,6 +162,12 @@ void line_init(line_t* n) {
     
     point_init(n->p1);
     point_init(n->p2);
+    mpf_init(n->a);
+    mpf_init(n->b);
+    mpf_init(n->c);
+    mpq_init(n->qa);
+    mpq_init(n->qb);
+    mpq_init(n->qc);
     n->is_init = IS_INIT;
 }
 
@@ -124,110 +184,132 @@ void line_free(line_t* n) {
     
     point_free(n->p1);
     point_free(n->p2);
+    mpf_clear(n->a);
+    mpf_clear(n->b);
+    mpf_clear(n->c);
+    mpq_clear(n->qa);
+    mpq_clear(n->qb);
+    mpq_clear(n->qc);
     n->is_init = 0;
     free(n);
 }
 
 /*
-* Sets a lines's points.
+* Sets a lines's points, and calculates the coefficients.
 *
+* @ctx: Context holding scratch values.
 * @n: Point that will get new point values.
 * @p1: First point.
 * @p2: Second point.
 */
-void line_set(line_t* n, point_t* p1, point_t* p2) {
+void line_set(geometry_context_t* ctx, line_t* n, point_t* p1, point_t* p2) {
     assert(n->is_init == IS_INIT);
     
-    point_set(n->p1, p1->x, p1->y);
-    point_set(n->p2, p2->x, p2->y);
+    point_copy(n->p1, p1);
+    point_copy(n->p2, p2);
+    
+    _line_prepare(ctx, n);
 }
 
 /*
-* Sets a lines's points via int.
+* Sets a lines's points via int, and calculates the coefficients.
 *
+* @ctx: Context holding scratch values.
 * @n: Point that will get new point values.
 * @p1x: First point x value.
 * @p1y: First point y value.
 * @p2x: Second point x value.
 * @p2y: Second point y value.
 */
-void line_set_si(line_t* n, intmax_t x1, intmax_t y1, intmax_t x2, intmax_t y2) {
+void line_set_si(geometry_context_t* ctx, line_t* n, intmax_t x1, intmax_t y1, intmax_t x2, intmax_t y2) {
     assert(n->is_init == IS_INIT);
     
     point_set_si(n->p1, x1, y1);
     point_set_si(n->p2, x2, y2);
+    
+    _line_prepare(ctx, n);
 }
 
 /*
 * Finds the intersection of two infinite lines. If a point is found,
-* memory is allocated and the result is stored at the point_t paramter.
-* The point_t parameter must be NULL.
+* the result is written to the point_t paramter, which is owned by the
+* caller. Nothing is allocated. The point is only changed when an
+* intersection is found.
 * There will be zero or one intersections.
 *
+* @ctx: Context holding scratch values.
 * @n1: First line.
 * @n2: Second line.
-* @p: Double pointer to calculated intersection point.
+* @p: Initialized point to store the intersection.
 *
 * returns: The number of intersection points found. 
 */
-int line_intersection_line(line_t* n1, line_t* n2, point_t** pp) {
+int line_intersection_line(geometry_context_t* ctx, line_t* n1, line_t* n2, point_t* p) {
+    line_scratch_t* s = &ctx->line;
+    
     assert(n1->is_init == IS_INIT);
     assert(n2->is_init == IS_INIT);
-    assert(*pp == NULL);
+    assert(p != NULL);
     
     // See:
     // http://mathworld.wolfram.com/Line-LineIntersection.html
     
     // The original C# this is based on is included at the end of the function.
     
-    point_t* p;
+    // An intersection needs the mpf calculation for the coordinates,
+    // so the filter can only skip parallel lines.
+    if (ctx->use_interval_filter) {
+        if (_filter_line_x_line(n1, n2) == 1) {
+            ctx->filter_resolved++;
+            return 0;
+        }
+        
+        ctx->filter_fallback++;
+    }
     
-    // _t1 = n1->p2->y - n1->p1->y;
-    mpf_sub(_t1, n1->p2->y, n1->p1->y);
-    // _t2 = n1->p1->x - n1->p2->x;
-    mpf_sub(_t2, n1->p1->x, n1->p2->x);
+    if (n1->is_rational && n2->is_rational) {
+        return line_intersection_line_rational(ctx, n1, n2, p);
+    }
     
-    // _t5 = _t1 * n1->p1->x + _t2 * n1->p1->y;
-    mpf_mul(_t3, _t1, n1->p1->x);
-    mpf_mul(_t4, _t2, n1->p1->y);
-    mpf_add(_t5, _t3, _t4);
+#ifdef NUMERIC_KERNELS
+    return _line_x_line_numeric(n1, n2, p);
+#endif
     
-    // _t3 = n2->p2->y - n2->p1->y;
-    mpf_sub(_t3, n2->p2->y, n2->p1->y);
-    // _t4 = n2->p1->x - n2->p2->x;
-    mpf_sub(_t4, n2->p1->x, n2->p2->x);
+    if (ctx->low != NULL) {
+        int result = line_intersection_line(ctx->low, n1, n2, p);
+        
+        if (geometry_context_low_done(ctx, &p, result) == 1) {
+            return 0;
+        }
+    }
+    
+    // Using the prepared coefficients, a1*x + b1*y = c1 and a2*x + b2*y = c2.
     
-    // _t6 = _t3 * n2->p1->x + _t4 * n2->p1->y;
-    mpf_mul(_t7, _t3, n2->p1->x);
-    mpf_mul(_t8, _t4, n2->p1->y);
-    mpf_add(_t6, _t7, _t8);
+    // t1 => det = a1 * b2 - a2 * b1;
+    mpf_mul(s->t2, n1->a, n2->b);
+    mpf_mul(s->t3, n2->a, n1->b);
+    mpf_sub(s->t1, s->t2, s->t3);
     
-    // _t9 = _t1 * _t4 - _t3 * _t2;
-    mpf_mul(_t7, _t1, _t4);
-    mpf_mul(_t8, _t3, _t2);
-    mpf_sub(_t9, _t7, _t8);
+    global_guard_band_check(ctx, s->t1, s->t2, s->t3);
     
-    if (global_is_zero(_t9) == 1) {
+    if (global_is_zero(s->t1) == 1) {
         // no intersection
         return 0;
     }
     
-    p = point_alloc();
-    point_init(p);
-    
-    // p->x = (_t4 * _t5 - _t2 * _t6) / _t9;
-    mpf_mul(_t7, _t4, _t5);
-    mpf_mul(_t8, _t2, _t6);
-    mpf_sub(_ta, _t7, _t8);
-    mpf_div(p->x, _ta, _t9);
+    point_reset(p);
     
-    // p->y = (_t1 * _t6 - _t3 * _t5) / _t9;
-    mpf_mul(_t7, _t1, _t6);
-    mpf_mul(_t8, _t3, _t5);
-    mpf_sub(_ta, _t7, _t8);
-    mpf_div(p->y, _ta, _t9);
+    // p->x = (c1 * b2 - c2 * b1) / det;
+    mpf_mul(s->t2, n1->c, n2->b);
+    mpf_mul(s->t3, n2->c, n1->b);
+    mpf_sub(s->t4, s->t2, s->t3);
+    mpf_div(p->x, s->t4, s->t1);
     
-    *pp = p;
+    // p->y = (a1 * c2 - a2 * c1) / det;
+    mpf_mul(s->t2, n1->a, n2->c);
+    mpf_mul(s->t3, n2->a, n1->c);
+    mpf_sub(s->t4, s->t2, s->t3);
+    mpf_div(p->y, s->t4, s->t1);
     
     return 1;
     
@@ -273,6 +355,64 @@ int line_intersection_line(line_t* n1, line_t* n2, point_t** pp) {
     */
 }
 
+/*
+* Finds the intersection of two rational lines exactly, the point
+* is set to the exact fractions with point_set_q. Whether the lines
+* are parallel is decided the same way as in line_intersection_line,
+* so the same intersections are found.
+* The point is only changed when an intersection is found.
+*
+* @ctx: Context holding scratch values.
+* @n1: First line, is_rational must be set.
+* @n2: Second line, is_rational must be set.
+* @p: Initialized point to store the intersection.
+*
+* returns: The number of intersection points found.
+*/
+int line_intersection_line_rational(geometry_context_t* ctx, line_t* n1, line_t* n2, point_t* p) {
+    line_scratch_t* s = &ctx->line;
+    rational_scratch_t* q = &ctx->rational;
+    
+    assert(n1->is_rational == 1);
+    assert(n2->is_rational == 1);
+    
+    // t1 => det = a1 * b2 - a2 * b1, with the normalized coefficients.
+    mpf_mul(s->t2, n1->a, n2->b);
+    mpf_mul(s->t3, n2->a, n1->b);
+    mpf_sub(s->t1, s->t2, s->t3);
+    
+    if (global_is_zero(s->t1) == 1) {
+        // no intersection
+        return 0;
+    }
+    
+    // The same calculation exactly, with the coefficients that
+    // aren't normalized.
+    
+    // q->t1 => det = qa1 * qb2 - qa2 * qb1;
+    mpq_mul(q->t2, n1->qa, n2->qb);
+    mpq_mul(q->t3, n2->qa, n1->qb);
+    mpq_sub(q->t1, q->t2, q->t3);
+    
+    // q->t4 => x = (qc1 * qb2 - qc2 * qb1) / det;
+    mpq_mul(q->t2, n1->qc, n2->qb);
+    mpq_mul(q->t3, n2->qc, n1->qb);
+    mpq_sub(q->t4, q->t2, q->t3);
+    mpq_div(q->t4, q->t4, q->t1);
+    
+    // q->t5 => y = (qa1 * qc2 - qa2 * qc1) / det;
+    mpq_mul(q->t2, n1->qa, n2->qc);
+    mpq_mul(q->t3, n2->qa, n1->qc);
+    mpq_sub(q->t5, q->t2, q->t3);
+    mpq_div(q->t5, q->t5, q->t1);
+    
+    point_reset(p);
+    point_set_q(p, q->t4, q->t5);
+    ctx->rational_intersections++;
+    
+    return 1;
+}
+
 /*
 * Writes the line to stdout in "the usual way."
 *
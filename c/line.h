@@ -12,9 +12,14 @@
 #include <gmp.h>
 #include <stdint.h>
 
+#include "geometry_context.h"
+#include "numeric.h"
+#include "interval.h"
 #include "point.h"
 
-// Line is defined by two points.
+// Line is defined by two points. The set methods also prepare the
+// coefficients of a*x + b*y = c, normalized so a^2 + b^2 = 1, so the
+// points must not be changed except through those.
 typedef struct line {
     // First point.
     point_t* p1;
@@ -22,20 +27,35 @@ typedef struct line {
     // Second point.
     point_t* p2;
     
+    // Coefficients of a*x + b*y = c.
+    mpf_t a;
+    mpf_t b;
+    mpf_t c;
+    
+    // Interval copies of the coefficients.
+    interval_t ia;
+    interval_t ib;
+    interval_t ic;
+    
+#ifdef NUMERIC_KERNELS
+    // Numeric backend copies of the coefficients.
+    num_t num_a;
+    num_t num_b;
+    num_t num_c;
+#endif
+    
+    // Whether both points are rational, see point_set_q. The line is
+    // then also qa*x + qb*y = qc exactly, with qa = y2 - y1 and
+    // qb = x1 - x2, not normalized.
+    int is_rational;
+    mpq_t qa;
+    mpq_t qb;
+    mpq_t qc;
+    
     // Whether or not this object has been initialized.
     int is_init;
 } line_t;
 
-/*
-* Initializes some static variables.
-*/
-void global_line_init();
-
-/*
-* Frees memory used by static variables.
-*/
-void global_line_free();
-
 /*
 * Allocates memory for a new line.
 *
@@ -58,38 +78,58 @@ void line_init(line_t* n);
 void line_free(line_t* n);
 
 /*
-* Sets a lines's points.
+* Sets a lines's points, and calculates the coefficients.
 *
+* @ctx: Context holding scratch values.
 * @n: Point that will get new point values.
 * @p1: First point.
 * @p2: Second point.
 */
-void line_set(line_t* n, point_t* p1, point_t* p2);
+void line_set(geometry_context_t* ctx, line_t* n, point_t* p1, point_t* p2);
 
 /*
-* Sets a lines's points via int.
+* Sets a lines's points via int, and calculates the coefficients.
 *
+* @ctx: Context holding scratch values.
 * @n: Point that will get new point values.
 * @p1x: First point x value.
 * @p1y: First point y value.
 * @p2x: Second point x value.
 * @p2y: Second point y value.
 */
-void line_set_si(line_t* n, intmax_t p1x, intmax_t p1y, intmax_t p2x, intmax_t p2y);
+void line_set_si(geometry_context_t* ctx, line_t* n, intmax_t p1x, intmax_t p1y, intmax_t p2x, intmax_t p2y);
 
 /*
 * Finds the intersection of two infinite lines. If a point is found,
-* memory is allocated and the result is stored at the point_t paramter.
-* The point_t parameter must be NULL.
+* the result is written to the point_t paramter, which is owned by the
+* caller. Nothing is allocated. The point is only changed when an
+* intersection is found.
 * There will be zero or one intersections.
 *
+* @ctx: Context holding scratch values.
 * @n1: First line.
 * @n2: Second line.
-* @p: Double pointer to calculated intersection point.
+* @p: Initialized point to store the intersection.
 *
 * returns: The number of intersection points found. 
 */
-int line_intersection_line(line_t* n1, line_t* n2, point_t** p);
+int line_intersection_line(geometry_context_t* ctx, line_t* n1, line_t* n2, point_t* p);
+
+/*
+* Finds the intersection of two rational lines exactly, the point
+* is set to the exact fractions with point_set_q. Whether the lines
+* are parallel is decided the same way as in line_intersection_line,
+* so the same intersections are found.
+* The point is only changed when an intersection is found.
+*
+* @ctx: Context holding scratch values.
+* @n1: First line, is_rational must be set.
+* @n2: Second line, is_rational must be set.
+* @p: Initialized point to store the intersection.
+*
+* returns: The number of intersection points found.
+*/
+int line_intersection_line_rational(geometry_context_t* ctx, line_t* n1, line_t* n2, point_t* p);
 
 /*
 * Writes the line to stdout in "the usual way."
@@ -0,0 +1,112 @@
+/*
+* Numeric backend of the intersection kernels, chosen at build time.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __NUMERIC_H__
+#define __NUMERIC_H__
+
+// Points, lines, and circles always hold mpf values. Building with one
+// of the flags below also keeps a copy of the line and circle values as
+// num_t, and the intersection kernels run on those instead of mpf, with
+// the results converted back to mpf points.
+//
+// -DNUMERIC_BACKEND_FIXED   fixed point on FIXED_LIMBS limbs, see fixed.h
+// -DNUMERIC_BACKEND_DD      double-double, see double_double.h
+// -DNUMERIC_BACKEND_MPFR    MPFR on BIGFLOAT_PRECISION bits, see bigfloat.h
+//
+// Without any of them the kernels use mpf. Each backend has the same
+// operations, named num_* here, and num_t values are held inline and
+// can be copied.
+
+#if defined(NUMERIC_BACKEND_FIXED) + defined(NUMERIC_BACKEND_DD) + defined(NUMERIC_BACKEND_MPFR) > 1
+#error "Only one NUMERIC_BACKEND can be set."
+#endif
+
+#if defined(NUMERIC_BACKEND_FIXED)
+
+#include "fixed.h"
+
+#define NUMERIC_KERNELS
+#define NUMERIC_BACKEND_NAME "fixed"
+
+typedef fixed_t num_t;
+
+#define num_set_mpf fixed_set_mpf
+#define num_get_mpf fixed_get_mpf
+#define num_set_si fixed_set_si
+#define num_set_d fixed_set_d
+#define num_get_d fixed_get_d
+#define num_add fixed_add
+#define num_sub fixed_sub
+#define num_neg fixed_neg
+#define num_mul fixed_mul
+#define num_mul_ui fixed_mul_ui
+#define num_div fixed_div
+#define num_sqrt fixed_sqrt
+#define num_sgn fixed_sgn
+#define num_is_zero fixed_is_zero
+#define num_compare_zero fixed_compare_zero
+#define num_is_zero_squared fixed_is_zero_squared
+
+#elif defined(NUMERIC_BACKEND_DD)
+
+#include "double_double.h"
+
+#define NUMERIC_KERNELS
+#define NUMERIC_BACKEND_NAME "dd"
+
+typedef dd_t num_t;
+
+#define num_set_mpf dd_set_mpf
+#define num_get_mpf dd_get_mpf
+#define num_set_si dd_set_si
+#define num_set_d dd_set_d
+#define num_get_d dd_get_d
+#define num_add dd_add
+#define num_sub dd_sub
+#define num_neg dd_neg
+#define num_mul dd_mul
+#define num_mul_ui dd_mul_ui
+#define num_div dd_div
+#define num_sqrt dd_sqrt
+#define num_sgn dd_sgn
+#define num_is_zero dd_is_zero
+#define num_compare_zero dd_compare_zero
+#define num_is_zero_squared dd_is_zero_squared
+
+#elif defined(NUMERIC_BACKEND_MPFR)
+
+#include "bigfloat.h"
+
+#define NUMERIC_KERNELS
+#define NUMERIC_BACKEND_NAME "mpfr"
+
+typedef bigfloat_t num_t;
+
+#define num_set_mpf bigfloat_set_mpf
+#define num_get_mpf bigfloat_get_mpf
+#define num_set_si bigfloat_set_si
+#define num_set_d bigfloat_set_d
+#define num_get_d bigfloat_get_d
+#define num_add bigfloat_add
+#define num_sub bigfloat_sub
+#define num_neg bigfloat_neg
+#define num_mul bigfloat_mul
+#define num_mul_ui bigfloat_mul_ui
+#define num_div bigfloat_div
+#define num_sqrt bigfloat_sqrt
+#define num_sgn bigfloat_sgn
+#define num_is_zero bigfloat_is_zero
+#define num_compare_zero bigfloat_compare_zero
+#define num_is_zero_squared bigfloat_is_zero_squared
+
+#else
+
+#define NUMERIC_BACKEND_NAME "mpf"
+
+#endif
+
+#endif
@@ -0,0 +1,354 @@
+/*
+* Tables of distinct lines and circles constructed from a set of points.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <assert.h>
+#include <math.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "object_table.h"
+
+// Number of digits to allow left of the decimal point for each key value,
+// plus the sign, decimal point, and separator.
+#define KEY_VALUE_EXTRA_DIGITS 24
+
+// Starting number of objects to allocate space for.
+#define OBJECT_TABLE_START_CAPACITY 64
+
+/*
+* Adds the key to the table, unless it's already there.
+*
+* returns: 1 if the key was added, 0 if it was already known.
+*/
+static int _add_key(object_table_t* table) {
+    object_table_key_t* entry;
+    size_t key_length = strlen(table->key_buffer);
+    
+    HASH_FIND(hh, table->keys, table->key_buffer, key_length, entry);
+    if (entry != NULL) {
+        return 0;
+    }
+    
+    entry = malloc(sizeof(object_table_key_t));
+    global_exit_if_null(entry, "Fatal error calling malloc for object_table_key_t.\n");
+    memset(entry, 0, sizeof(object_table_key_t));
+    
+    entry->key = strdup(table->key_buffer);
+    global_exit_if_null(entry->key, "Fatal error calling strdup for object table key.\n");
+    entry->key_length = key_length;
+    
+    HASH_ADD_KEYPTR(hh, table->keys, entry->key, entry->key_length, entry);
+    
+    return 1;
+}
+
+/*
+* Adds an object to the end of the table.
+*/
+static void _add_object(object_table_t* table, line_t* n, circle_t* c) {
+    if (table->count == table->capacity) {
+        table->capacity = table->capacity == 0 ? OBJECT_TABLE_START_CAPACITY : table->capacity * 2;
+        table->objects = realloc(table->objects, sizeof(object_table_entry_t) * table->capacity);
+        global_exit_if_null(table->objects, "Fatal error calling realloc for object table.\n");
+    }
+    
+    table->objects[table->count].line = n;
+    table->objects[table->count].circle = c;
+    table->count++;
+}
+
+/*
+* Number of pairs of n objects.
+*
+* returns: n * (n - 1) / 2.
+*/
+static size_t _pair_count(size_t n) {
+    if (n < 2) {
+        return 0;
+    }
+    
+    return n % 2 == 0 ? (n / 2) * (n - 1) : n * ((n - 1) / 2);
+}
+
+/*
+* Allocates memory for a new object table.
+*
+* returns: pointer to new object table.
+*/
+object_table_t* object_table_alloc() {
+    object_table_t* table = malloc(sizeof(object_table_t));
+    global_exit_if_null(table, "Fatal error calling malloc for object_table_t.\n");
+    
+    memset(table, 0, sizeof(object_table_t));
+    
+    return table;
+}
+
+/*
+* Initializes new object table. Must be called before use.
+*
+* @table: Object table to initialize.
+* @key_digits: Number of digits used for each value in the keys,
+*     values that agree to this many digits are the same object.
+*/
+void object_table_init(object_table_t* table, size_t key_digits) {
+    if (table->is_init == IS_INIT) {
+        return;
+    }
+    
+    table->key_digits = key_digits;
+    table->key_buffer_length = 3 * (key_digits + KEY_VALUE_EXTRA_DIGITS) + 1;
+    table->key_buffer = malloc(table->key_buffer_length);
+    global_exit_if_null(table->key_buffer, "Fatal error calling malloc for object table key buffer.\n");
+    
+    mpf_init(table->a);
+    mpf_init(table->b);
+    mpf_init(table->c);
+    
+    table->is_init = IS_INIT;
+}
+
+/*
+* Frees resources used by the object table.
+*
+* @table: Object table to free.
+*/
+void object_table_free(object_table_t* table) {
+    if (table == NULL) {
+        return;
+    }
+    
+    if (table->is_init == IS_INIT) {
+        object_table_clear(table);
+        
+        if (table->next_line != NULL) {
+            line_free(table->next_line);
+            table->next_line = NULL;
+        }
+        
+        free(table->objects);
+        free(table->key_buffer);
+        
+        mpf_clear(table->a);
+        mpf_clear(table->b);
+        mpf_clear(table->c);
+        
+        table->is_init = 0;
+    }
+    
+    free(table);
+}
+
+/*
+* Removes all objects from the table.
+*
+* @table: Object table to clear.
+*/
+void object_table_clear(object_table_t* table) {
+    object_table_key_t* k1;
+    object_table_key_t* k2;
+    size_t i;
+    
+    assert(table->is_init == IS_INIT);
+    
+    for (i=0; i<table->count; i++) {
+        if (table->objects[i].line != NULL) {
+            line_free(table->objects[i].line);
+        } else {
+            circle_free(table->objects[i].circle);
+        }
+    }
+    table->count = 0;
+    table->line_count = 0;
+    table->circle_count = 0;
+    table->old_count = 0;
+    
+    HASH_ITER(hh, table->keys, k1, k2) {
+        HASH_DEL(table->keys, k1);
+        free(k1->key);
+        free(k1);
+    }
+    table->keys = NULL;
+}
+
+/*
+* Adds the line through two points, unless the table already has it.
+*
+* @ctx: Context holding scratch values.
+* @table: Object table to add to.
+* @p1: First point.
+* @p2: Second point. Must not be the same as p1.
+*
+* returns: 1 if the line was added, 0 if it was already known.
+*/
+int object_table_add_line(geometry_context_t* ctx, object_table_t* table, point_t* p1, point_t* p2) {
+    line_t* n;
+    
+    assert(table->is_init == IS_INIT);
+    
+    if (table->next_line == NULL) {
+        table->next_line = line_alloc();
+        line_init(table->next_line);
+    }
+    
+    n = table->next_line;
+    line_set(ctx, n, p1, p2);
+    
+    // The same line is found with either sign, pick the one with a > 0,
+    // or a = 0 and b > 0. Values within epsilon of zero are written
+    // as zero so there's no "-0.000".
+    mpf_set(table->a, n->a);
+    mpf_set(table->b, n->b);
+    mpf_set(table->c, n->c);
+    
+    if (global_is_zero(table->a) == 1) {
+        mpf_set(table->a, g_zero);
+        
+        if (mpf_sgn(table->b) < 0) {
+            mpf_neg(table->b, table->b);
+            mpf_neg(table->c, table->c);
+        }
+    } else if (mpf_sgn(table->a) < 0) {
+        mpf_neg(table->a, table->a);
+        mpf_neg(table->b, table->b);
+        mpf_neg(table->c, table->c);
+    }
+    
+    if (global_is_zero(table->b) == 1) {
+        mpf_set(table->b, g_zero);
+    }
+    if (global_is_zero(table->c) == 1) {
+        mpf_set(table->c, g_zero);
+    }
+    
+    gmp_snprintf(table->key_buffer, table->key_buffer_length, "L%.*Ff,%.*Ff,%.*Ff",
+        (int)table->key_digits, table->a,
+        (int)table->key_digits, table->b,
+        (int)table->key_digits, table->c);
+    
+    if (_add_key(table) == 0) {
+        return 0;
+    }
+    
+    _add_object(table, n, NULL);
+    table->line_count++;
+    table->next_line = NULL;
+    
+    return 1;
+}
+
+/*
+* Adds a circle, unless the table already has it.
+*
+* @table: Object table to add to.
+* @origin: Origin of the circle. The point_id is used in the key.
+* @radius_squared: Radius of the circle, squared.
+*
+* returns: 1 if the circle was added, 0 if it was already known.
+*/
+int object_table_add_circle(object_table_t* table, point_t* origin, mpf_t radius_squared) {
+    circle_t* c;
+    
+    assert(table->is_init == IS_INIT);
+    
+    gmp_snprintf(table->key_buffer, table->key_buffer_length, "C%ld,%.*Ff",
+        (long)origin->point_id,
+        (int)table->key_digits, radius_squared);
+    
+    if (_add_key(table) == 0) {
+        return 0;
+    }
+    
+    c = circle_alloc();
+    circle_init(c);
+    circle_set_radius_squared(c, origin, radius_squared);
+    
+    _add_object(table, NULL, c);
+    table->circle_count++;
+    
+    return 1;
+}
+
+/*
+* Adds the line and circles constructed from two points, skipping
+* any already in the table.
+*
+* @ctx: Context holding scratch values.
+* @table: Object table to add to.
+* @p1: First point.
+* @p2: Second point. Must not be the same as p1.
+* @distance_squared: Squared distance between the points.
+*
+* returns: The number of objects added.
+*/
+int object_table_add_pair(geometry_context_t* ctx, object_table_t* table, point_t* p1, point_t* p2, mpf_t distance_squared) {
+    int result = 0;
+    
+    result += object_table_add_line(ctx, table, p1, p2);
+    result += object_table_add_circle(table, p1, distance_squared);
+    result += object_table_add_circle(table, p2, distance_squared);
+    
+    return result;
+}
+
+/*
+* Marks the objects currently in the table as old. Only pairs with at
+* least one object added after this are counted as new pairs.
+*
+* @table: Object table.
+*/
+void object_table_mark(object_table_t* table) {
+    table->old_count = table->count;
+}
+
+/*
+* Number of unordered pairs of distinct objects in the table, with
+* at least one object added after the last object_table_mark. This
+* is all the pairs if object_table_mark hasn't been called since
+* the table was cleared.
+*
+* @table: Object table.
+*
+* returns: (n * (n - 1) - m * (m - 1)) / 2, where n is count and m is old_count.
+*/
+size_t object_table_pair_count(object_table_t* table) {
+    return _pair_count(table->count) - _pair_count(table->old_count);
+}
+
+/*
+* Finds the objects of a new pair. Pairs are ordered by the second object,
+* then the first: (0, 1), (0, 2), (1, 2), (0, 3), ..., (n-2, n-1).
+* The first new pair is (0, old_count).
+*
+* @table: Object table.
+* @index: Index of the pair, less than object_table_pair_count.
+* @i: Set to the index of the first object.
+* @j: Set to the index of the second object, always more than i.
+*/
+void object_table_pair_at(object_table_t* table, size_t index, size_t* i, size_t* j) {
+    size_t column;
+    
+    assert(index < object_table_pair_count(table));
+    
+    // The pairs (0, j) .. (j-1, j) start at j * (j - 1) / 2.
+    index += _pair_count(table->old_count);
+    column = (size_t)((1.0 + sqrt(1.0 + 8.0 * (double)index)) / 2.0);
+    
+    // correct for rounding
+    while (column > 1 && _pair_count(column) > index) {
+        column--;
+    }
+    while (_pair_count(column + 1) <= index) {
+        column++;
+    }
+    
+    *i = index - _pair_count(column);
+    *j = column;
+}
@@ -0,0 +1,175 @@
+/*
+* Tables of distinct lines and circles constructed from a set of points.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __OBJECT_TABLE_H__
+#define __OBJECT_TABLE_H__
+
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+
+#include "geometry_context.h"
+#include "point.h"
+#include "line.h"
+#include "circle.h"
+#include "uthash.h"
+
+// Key of an object already in the table.
+typedef struct object_table_key {
+    char* key;
+    size_t key_length;
+    
+    // makes this structure hashable
+    UT_hash_handle hh;
+} object_table_key_t;
+
+// Object in the table, only one of line or circle is set.
+typedef struct object_table_entry {
+    line_t* line;
+    circle_t* circle;
+} object_table_entry_t;
+
+// Distinct lines and circles. Several pairs of points can give the
+// same object: collinear points give the same line, and points the
+// same distance from a center give the same circle. Each object is
+// only kept once.
+// Lines are keyed by the normalized coefficients (a, b, c), with the
+// sign chosen so a > 0, or a = 0 and b > 0. Circles are keyed by the
+// point_id of the origin and the squared radius.
+// Objects are numbered in the order they are added.
+typedef struct object_table {
+    object_table_entry_t* objects;
+    size_t count;
+    size_t capacity;
+    
+    size_t line_count;
+    size_t circle_count;
+    
+    // Objects before this position were added before the last call
+    // to object_table_mark. Pairs of only these objects are old, and
+    // not counted by object_table_pair_count.
+    size_t old_count;
+    
+    // Keys of the objects in the table.
+    object_table_key_t* keys;
+    
+    // Number of digits used for each value in the keys.
+    size_t key_digits;
+    
+    // Buffer to build keys.
+    char* key_buffer;
+    size_t key_buffer_length;
+    
+    // Line waiting to be added, reused when it turns out to be a duplicate.
+    line_t* next_line;
+    
+    // Scratch values for the line key.
+    mpf_t a, b, c;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} object_table_t;
+
+/*
+* Allocates memory for a new object table.
+*
+* returns: pointer to new object table.
+*/
+object_table_t* object_table_alloc();
+
+/*
+* Initializes new object table. Must be called before use.
+*
+* @table: Object table to initialize.
+* @key_digits: Number of digits used for each value in the keys,
+*     values that agree to this many digits are the same object.
+*/
+void object_table_init(object_table_t* table, size_t key_digits);
+
+/*
+* Frees resources used by the object table.
+*
+* @table: Object table to free.
+*/
+void object_table_free(object_table_t* table);
+
+/*
+* Removes all objects from the table.
+*
+* @table: Object table to clear.
+*/
+void object_table_clear(object_table_t* table);
+
+/*
+* Adds the line through two points, unless the table already has it.
+*
+* @ctx: Context holding scratch values.
+* @table: Object table to add to.
+* @p1: First point.
+* @p2: Second point. Must not be the same as p1.
+*
+* returns: 1 if the line was added, 0 if it was already known.
+*/
+int object_table_add_line(geometry_context_t* ctx, object_table_t* table, point_t* p1, point_t* p2);
+
+/*
+* Adds a circle, unless the table already has it.
+*
+* @table: Object table to add to.
+* @origin: Origin of the circle. The point_id is used in the key.
+* @radius_squared: Radius of the circle, squared.
+*
+* returns: 1 if the circle was added, 0 if it was already known.
+*/
+int object_table_add_circle(object_table_t* table, point_t* origin, mpf_t radius_squared);
+
+/*
+* Adds the line and circles constructed from two points, skipping
+* any already in the table.
+*
+* @ctx: Context holding scratch values.
+* @table: Object table to add to.
+* @p1: First point.
+* @p2: Second point. Must not be the same as p1.
+* @distance_squared: Squared distance between the points.
+*
+* returns: The number of objects added.
+*/
+int object_table_add_pair(geometry_context_t* ctx, object_table_t* table, point_t* p1, point_t* p2, mpf_t distance_squared);
+
+/*
+* Marks the objects currently in the table as old. Only pairs with at
+* least one object added after this are counted as new pairs.
+*
+* @table: Object table.
+*/
+void object_table_mark(object_table_t* table);
+
+/*
+* Number of unordered pairs of distinct objects in the table, with
+* at least one object added after the last object_table_mark. This
+* is all the pairs if object_table_mark hasn't been called since
+* the table was cleared.
+*
+* @table: Object table.
+*
+* returns: (n * (n - 1) - m * (m - 1)) / 2, where n is count and m is old_count.
+*/
+size_t object_table_pair_count(object_table_t* table);
+
+/*
+* Finds the objects of a new pair. Pairs are ordered by the second object,
+* then the first: (0, 1), (0, 2), (1, 2), (0, 3), ..., (n-2, n-1).
+* The first new pair is (0, old_count).
+*
+* @table: Object table.
+* @index: Index of the pair, less than object_table_pair_count.
+* @i: Set to the index of the first object.
+* @j: Set to the index of the second object, always more than i.
+*/
+void object_table_pair_at(object_table_t* table, size_t index, size_t* i, size_t* j);
+
+#endif
@@ -0,0 +1,951 @@
+/*
+* Pair of points, and the line and circles constructed from them.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <assert.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "geometry_context.h"
+#include "numeric.h"
+#include "interval.h"
+#include "point.h"
+#include "line.h"
+#include "circle.h"
+#include "pair.h"
+
+/*
+* Uses the next caller owned point in the results.
+*
+* returns: the point to write the result to.
+*/
+static point_t* _add_point(point_t** points, int* count) {
+    point_t* p;
+    
+    assert(*count < PAIR_INTERSECTION_MAX);
+    p = points[*count];
+    assert(p != NULL);
+    (*count)++;
+    
+    point_reset(p);
+    
+    return p;
+}
+
+/*
+* Intersection of a circle and a line, from the signed distance of
+* the circle origin to the line. Same calculation as
+* circle_intersection_line.
+*
+* @ox: Circle origin x.
+* @oy: Circle origin y.
+* @r2: Circle radius squared.
+* @n: Line.
+* @dist: Signed distance from the origin to the line.
+*/
+static void _circle_x_line(geometry_context_t* ctx, mpf_t ox, mpf_t oy, mpf_t r2, line_t* n, mpf_t dist, point_t** points, int* count) {
+    pair_scratch_t* s = &ctx->pair;
+    point_t* p1;
+    point_t* p2;
+    int cmp;
+    
+    // t1 => disc = r^2 - dist^2;
+    mpf_mul(s->t2, dist, dist);
+    mpf_sub(s->t1, r2, s->t2);
+    
+    global_guard_band_check(ctx, s->t1, r2, s->t2);
+    
+    cmp = global_compare_zero(s->t1);
+    
+    if (cmp < 0) {
+        // no intersection
+        return;
+    }
+    
+    // t2, t3 => foot of the perpendicular from the origin to the line
+    // = { ox - a * dist, oy - b * dist }
+    mpf_mul(s->t4, n->a, dist);
+    mpf_sub(s->t2, ox, s->t4);
+    mpf_mul(s->t4, n->b, dist);
+    mpf_sub(s->t3, oy, s->t4);
+    
+    if (cmp == 0) {
+        // one intersection, the line is tangent at the foot.
+        p1 = _add_point(points, count);
+        point_set(p1, s->t2, s->t3);
+        return;
+    }
+    
+    // t4 => h = sqrt(disc)
+    mpf_sqrt(s->t4, s->t1);
+    
+    // t5, t6 => offset along the line = { -b * h, a * h }
+    mpf_mul(s->t5, n->b, s->t4);
+    mpf_neg(s->t5, s->t5);
+    mpf_mul(s->t6, n->a, s->t4);
+    
+    p1 = _add_point(points, count);
+    mpf_add(p1->x, s->t2, s->t5);
+    mpf_add(p1->y, s->t3, s->t6);
+    
+    p2 = _add_point(points, count);
+    mpf_sub(p2->x, s->t2, s->t5);
+    mpf_sub(p2->y, s->t3, s->t6);
+}
+
+/*
+* Intersection of a left circle and a right circle. Same calculation
+* as circle_intersection_circle, using the shared origin difference
+* and s->delta, s->four_r2.
+*
+* @ox: Left circle origin x.
+* @oy: Left circle origin y.
+* @i: Index into the scratch arrays for this combination.
+*/
+static void _circle_x_circle(geometry_context_t* ctx, mpf_t ox, mpf_t oy, int i, point_t** points, int* count) {
+    pair_scratch_t* s = &ctx->pair;
+    point_t* p1;
+    point_t* p2;
+    int cmp;
+    
+    // check if circles have same origin.
+    global_guard_band_check_squared(ctx, s->d2[i]);
+    
+    if (global_is_zero_squared(s->d2[i]) == 1) {
+        return;
+    }
+    
+    // t1 => k = r1^2 - r2^2 + d^2
+    mpf_add(s->t1, s->delta, s->d2[i]);
+    
+    // t2 => q = 4 * r1^2 * d^2 - k^2
+    mpf_mul(s->t3, s->four_r2, s->d2[i]);
+    mpf_mul(s->t4, s->t1, s->t1);
+    mpf_sub(s->t2, s->t3, s->t4);
+    
+    global_guard_band_check(ctx, s->t2, s->t3, s->t4);
+    
+    cmp = global_compare_zero(s->t2);
+    
+    if (cmp < 0) {
+        // one circle entirely outside or inside the other
+        return;
+    }
+    
+    // t3 => 1 / (2 * d^2)
+    mpf_mul(s->t4, g_two, s->d2[i]);
+    mpf_ui_div(s->t3, 1, s->t4);
+    
+    // t4 => a / d = k / (2 * d^2)
+    mpf_mul(s->t4, s->t1, s->t3);
+    
+    // t5, t6 => p3 = origin + (a / d) * { dx, dy }
+    mpf_mul(s->t5, s->dx[i], s->t4);
+    mpf_add(s->t5, ox, s->t5);
+    mpf_mul(s->t6, s->dy[i], s->t4);
+    mpf_add(s->t6, oy, s->t6);
+    
+    if (cmp == 0) {
+        // Circles are tangent, there is only one intersection point.
+        p1 = _add_point(points, count);
+        point_set(p1, s->t5, s->t6);
+        return;
+    }
+    
+    // t4 => h / d = sqrt(q) / (2 * d^2)
+    mpf_sqrt(s->t1, s->t2);
+    mpf_mul(s->t4, s->t1, s->t3);
+    
+    // t1, t2 => { rx, ry } = (h / d) * { -dy, dx }
+    mpf_mul(s->t1, s->dy[i], s->t4);
+    mpf_neg(s->t1, s->t1);
+    mpf_mul(s->t2, s->dx[i], s->t4);
+    
+    p1 = _add_point(points, count);
+    mpf_add(p1->x, s->t5, s->t1);
+    mpf_add(p1->y, s->t6, s->t2);
+    
+    p2 = _add_point(points, count);
+    mpf_sub(p2->x, s->t5, s->t1);
+    mpf_sub(p2->y, s->t6, s->t2);
+}
+
+#ifdef NUMERIC_KERNELS
+/*
+* Sets the next caller owned point in the results from numeric backend values.
+*/
+static void _add_point_numeric(point_t** points, int* count, num_t* x, num_t* y) {
+    point_t* p = _add_point(points, count);
+    
+    num_get_mpf(p->x, x);
+    num_get_mpf(p->y, y);
+}
+
+/*
+* Numeric backend version of _circle_x_line.
+*/
+static void _circle_x_line_numeric(num_t* ox, num_t* oy, num_t* r2, line_t* n, num_t* dist, point_t** points, int* count) {
+    num_t disc, fx, fy, h, rx, ry, t1, t2;
+    int cmp;
+    
+    // disc = r^2 - dist^2;
+    num_mul(&t1, dist, dist);
+    num_sub(&disc, r2, &t1);
+    
+    cmp = num_compare_zero(&disc);
+    
+    if (cmp < 0) {
+        // no intersection
+        return;
+    }
+    
+    // foot of the perpendicular = { ox - a * dist, oy - b * dist }
+    num_mul(&t1, &n->num_a, dist);
+    num_sub(&fx, ox, &t1);
+    num_mul(&t1, &n->num_b, dist);
+    num_sub(&fy, oy, &t1);
+    
+    if (cmp == 0) {
+        // one intersection, the line is tangent at the foot.
+        _add_point_numeric(points, count, &fx, &fy);
+        return;
+    }
+    
+    // h = sqrt(disc), offset along the line = { -b * h, a * h }
+    num_sqrt(&h, &disc);
+    num_mul(&rx, &n->num_b, &h);
+    num_neg(&rx, &rx);
+    num_mul(&ry, &n->num_a, &h);
+    
+    num_add(&t1, &fx, &rx);
+    num_add(&t2, &fy, &ry);
+    _add_point_numeric(points, count, &t1, &t2);
+    
+    num_sub(&t1, &fx, &rx);
+    num_sub(&t2, &fy, &ry);
+    _add_point_numeric(points, count, &t1, &t2);
+}
+
+/*
+* Numeric backend version of _circle_x_circle.
+*
+* @ox: Left circle origin x.
+* @oy: Left circle origin y.
+* @dx: Right origin x - left origin x.
+* @dy: Right origin y - left origin y.
+* @d2: Squared distance between the origins.
+* @delta: left r^2 - right r^2.
+* @four_r2: 4 * left r^2.
+*/
+static void _circle_x_circle_numeric(num_t* ox, num_t* oy, num_t* dx, num_t* dy, num_t* d2, num_t* delta, num_t* four_r2, point_t** points, int* count) {
+    num_t k, q, inv, x3, y3, rx, ry, t1, t2;
+    int cmp;
+    
+    // check if circles have same origin.
+    if (num_is_zero_squared(d2) == 1) {
+        return;
+    }
+    
+    // k = r1^2 - r2^2 + d^2
+    num_add(&k, delta, d2);
+    
+    // q = 4 * r1^2 * d^2 - k^2
+    num_mul(&t1, four_r2, d2);
+    num_mul(&t2, &k, &k);
+    num_sub(&q, &t1, &t2);
+    
+    cmp = num_compare_zero(&q);
+    
+    if (cmp < 0) {
+        // one circle entirely outside or inside the other
+        return;
+    }
+    
+    // inv => 1 / (2 * d^2)
+    num_set_si(&t1, 1);
+    num_mul_ui(&t2, d2, 2);
+    num_div(&inv, &t1, &t2);
+    
+    // t1 => a / d = k / (2 * d^2)
+    num_mul(&t1, &k, &inv);
+    
+    // p3 = origin + (a / d) * { dx, dy }
+    num_mul(&t2, dx, &t1);
+    num_add(&x3, ox, &t2);
+    num_mul(&t2, dy, &t1);
+    num_add(&y3, oy, &t2);
+    
+    if (cmp == 0) {
+        // Circles are tangent, there is only one intersection point.
+        _add_point_numeric(points, count, &x3, &y3);
+        return;
+    }
+    
+    // t1 => h / d = sqrt(q) / (2 * d^2)
+    num_sqrt(&t2, &q);
+    num_mul(&t1, &t2, &inv);
+    
+    // { rx, ry } = (h / d) * { -dy, dx }
+    num_mul(&rx, dy, &t1);
+    num_neg(&rx, &rx);
+    num_mul(&ry, dx, &t1);
+    
+    num_add(&t1, &x3, &rx);
+    num_add(&t2, &y3, &ry);
+    _add_point_numeric(points, count, &t1, &t2);
+    
+    num_sub(&t1, &x3, &rx);
+    num_sub(&t2, &y3, &ry);
+    _add_point_numeric(points, count, &t1, &t2);
+}
+
+/*
+* Numeric backend version of the calculation in pair_intersection_pair,
+* after the interval filter. Every operand is on the stack, the inputs
+* are the numeric backend copies in the lines and circles.
+*
+* @need: Which of the nine intersections to calculate, see
+*     pair_intersection_pair.
+*
+* returns: The number of intersection points found.
+*/
+static int _pair_x_pair_numeric(pair_t* left, pair_t* right, int shared_index, int need, point_t** points) {
+    circle_t* lc[2] = { left->circle1, left->circle2 };
+    circle_t* rc[2] = { right->circle1, right->circle2 };
+    line_t* ln = left->line;
+    line_t* rn = right->line;
+    num_t dx[4], dy[4], d2[4], dist[4];
+    num_t delta, four_r2, t1, t2, t3, t4, x, y;
+    int ls = shared_index >> 1;
+    int rs = shared_index & 1;
+    int other_index = (1 - ls) * 2 + (1 - rs);
+    int count = 0;
+    int i, j;
+    
+    // Shared values, see pair_intersection_pair.
+    for (i=0; i<4; i++) {
+        num_sub(&dx[i], &rc[i & 1]->num_cx, &lc[i >> 1]->num_cx);
+        num_sub(&dy[i], &rc[i & 1]->num_cy, &lc[i >> 1]->num_cy);
+    }
+    
+    for (j=0; j<2; j++) {
+        // right point j from the left line.
+        num_mul(&t1, &ln->num_a, &dx[j]);
+        num_mul(&t2, &ln->num_b, &dy[j]);
+        num_add(&dist[j], &t1, &t2);
+        
+        // left point j from the right line, sign flipped.
+        num_mul(&t1, &rn->num_a, &dx[j * 2]);
+        num_mul(&t2, &rn->num_b, &dy[j * 2]);
+        num_add(&t3, &t1, &t2);
+        num_neg(&dist[2 + j], &t3);
+    }
+    
+    if (shared_index != PAIR_SHARED_NONE) {
+        num_t* sx = &lc[ls]->num_cx;
+        num_t* sy = &lc[ls]->num_cy;
+        
+        // Left circle at A x right line, S - 2 * ((S - A) . u) * u.
+        i = (1 - ls) * 2 + rs;
+        num_mul(&t1, &rn->num_a, &dy[i]);
+        num_mul(&t2, &rn->num_b, &dx[i]);
+        num_sub(&t3, &t1, &t2);
+        num_mul_ui(&t3, &t3, 2);
+        
+        num_mul(&t1, &rn->num_b, &t3);
+        num_add(&x, sx, &t1);
+        num_mul(&t1, &rn->num_a, &t3);
+        num_sub(&y, sy, &t1);
+        _add_point_numeric(points, &count, &x, &y);
+        
+        // Right circle at B x left line.
+        i = ls * 2 + (1 - rs);
+        num_mul(&t1, &ln->num_b, &dx[i]);
+        num_mul(&t2, &ln->num_a, &dy[i]);
+        num_sub(&t3, &t1, &t2);
+        num_mul_ui(&t3, &t3, 2);
+        
+        num_mul(&t1, &ln->num_b, &t3);
+        num_add(&x, sx, &t1);
+        num_mul(&t1, &ln->num_a, &t3);
+        num_sub(&y, sy, &t1);
+        _add_point_numeric(points, &count, &x, &y);
+        
+        // Circles at A and B meet again at S reflected across AB,
+        // 2 * (A + (w . d / d . d) * d) - S.
+        i = (1 - ls) * 2 + rs;
+        num_mul(&t1, &dx[other_index], &dx[other_index]);
+        num_mul(&t2, &dy[other_index], &dy[other_index]);
+        num_add(&t3, &t1, &t2);
+        
+        if (num_is_zero_squared(&t3) == 0) {
+            num_mul(&t1, &dx[i], &dx[other_index]);
+            num_mul(&t2, &dy[i], &dy[other_index]);
+            num_add(&t4, &t1, &t2);
+            num_div(&t4, &t4, &t3);
+            num_mul_ui(&t4, &t4, 2);
+            
+            num_mul(&t1, &dx[other_index], &t4);
+            num_mul_ui(&t2, &lc[1 - ls]->num_cx, 2);
+            num_add(&t1, &t1, &t2);
+            num_sub(&x, &t1, sx);
+            num_mul(&t1, &dy[other_index], &t4);
+            num_mul_ui(&t2, &lc[1 - ls]->num_cy, 2);
+            num_add(&t1, &t1, &t2);
+            num_sub(&y, &t1, sy);
+            _add_point_numeric(points, &count, &x, &y);
+        }
+    }
+    
+    // Left line x right line.
+    if (need & 1) {
+        // t1 => det = a1 * b2 - a2 * b1;
+        num_mul(&t2, &ln->num_a, &rn->num_b);
+        num_mul(&t3, &rn->num_a, &ln->num_b);
+        num_sub(&t1, &t2, &t3);
+        
+        if (num_is_zero(&t1) == 0) {
+            // t2 => t
+            num_div(&t2, &dist[2], &t1);
+            num_neg(&t2, &t2);
+            
+            num_mul(&t3, &ln->num_b, &t2);
+            num_sub(&x, &lc[0]->num_cx, &t3);
+            num_mul(&t3, &ln->num_a, &t2);
+            num_add(&y, &lc[0]->num_cy, &t3);
+            _add_point_numeric(points, &count, &x, &y);
+        }
+    }
+    
+    for (j=0; j<2; j++) {
+        if (need & (1 << (1 + j))) {
+            _circle_x_line_numeric(&rc[j]->num_cx, &rc[j]->num_cy, &rc[j]->num_r2, ln, &dist[j], points, &count);
+        }
+        
+        if (need & (1 << (3 + j))) {
+            _circle_x_line_numeric(&lc[j]->num_cx, &lc[j]->num_cy, &lc[j]->num_r2, rn, &dist[2 + j], points, &count);
+        }
+    }
+    
+    if (need >> 5) {
+        // Every left circle has the same radius, and every right circle.
+        num_sub(&delta, &lc[0]->num_r2, &rc[0]->num_r2);
+        num_mul_ui(&four_r2, &lc[0]->num_r2, 4);
+        
+        for (i=0; i<4; i++) {
+            if (need & (1 << (5 + i))) {
+                num_mul(&t1, &dx[i], &dx[i]);
+                num_mul(&t2, &dy[i], &dy[i]);
+                num_add(&d2[i], &t1, &t2);
+                
+                _circle_x_circle_numeric(&lc[i >> 1]->num_cx, &lc[i >> 1]->num_cy, &dx[i], &dy[i], &d2[i], &delta, &four_r2, points, &count);
+            }
+        }
+    }
+    
+    return count;
+}
+#endif
+
+/*
+* Sets the next caller owned point in the results to 2 * p1 - p2,
+* p2 reflected through p1, which is where the line through the points
+* meets the circle at p1 through p2. Exact if both points are rational.
+*
+* @ctx: Context holding scratch values.
+*/
+static void _add_reflection(geometry_context_t* ctx, point_t* p1, point_t* p2, point_t** points, int* count) {
+    pair_scratch_t* s = &ctx->pair;
+    rational_scratch_t* q = &ctx->rational;
+    point_t* p = _add_point(points, count);
+    
+    if (p1->is_rational && p2->is_rational) {
+        mpq_add(q->t1, p1->qx, p1->qx);
+        mpq_sub(q->t1, q->t1, p2->qx);
+        mpq_add(q->t2, p1->qy, p1->qy);
+        mpq_sub(q->t2, q->t2, p2->qy);
+        point_set_q(p, q->t1, q->t2);
+        ctx->rational_intersections++;
+        return;
+    }
+    
+    mpf_mul_ui(s->t1, p1->x, 2);
+    mpf_sub(p->x, s->t1, p2->x);
+    mpf_mul_ui(s->t1, p1->y, 2);
+    mpf_sub(p->y, s->t1, p2->y);
+}
+
+/*
+* Allocates memory for a new pair.
+*
+* returns: pointer to new pair.
+*/
+pair_t* pair_alloc() {
+    pair_t* pair = malloc(sizeof(pair_t));
+    global_exit_if_null(pair, "Fatal error calling malloc for pair_t.\n");
+    
+    memset(pair, 0, sizeof(pair_t));
+    
+    pair->line = line_alloc();
+    pair->circle1 = circle_alloc();
+    pair->circle2 = circle_alloc();
+    
+    return pair;
+}
+
+/*
+* Initializes new pair. Must be called before use.
+*
+* @pair: Pair to initialize.
+*/
+void pair_init(pair_t* pair) {
+    if (pair->is_init == IS_INIT)
+    {
+        return;
+    }
+    
+    line_init(pair->line);
+    circle_init(pair->circle1);
+    circle_init(pair->circle2);
+    pair->is_init = IS_INIT;
+}
+
+/*
+* Frees resources used by the pair.
+*
+* @pair: Pair to free.
+*/
+void pair_free(pair_t* pair) {
+    if (pair->is_init != IS_INIT)
+    {
+        return;
+    }
+    
+    line_free(pair->line);
+    circle_free(pair->circle1);
+    circle_free(pair->circle2);
+    pair->is_init = 0;
+    free(pair);
+}
+
+/*
+* Sets the pair's line and circles.
+*
+* @ctx: Context holding scratch values.
+* @pair: Pair to set.
+* @p1: First point.
+* @p2: Second point.
+* @distance_squared: Squared distance between the points.
+*/
+void pair_set(geometry_context_t* ctx, pair_t* pair, point_t* p1, point_t* p2, mpf_t distance_squared) {
+    assert(pair->is_init == IS_INIT);
+    
+    line_set(ctx, pair->line, p1, p2);
+    circle_set_radius_squared(pair->circle1, p1, distance_squared);
+    circle_set_radius_squared(pair->circle2, p2, distance_squared);
+}
+
+/*
+* Finds the self intersections of a pair, the line and circles of the
+* pair intersected with each other. These are known exactly:
+* the line meets circle1 at p2 and 2 * p1 - p2, the line meets
+* circle2 at p1 and 2 * p2 - p1, and the circles meet at the
+* midpoint +/- (sqrt(3) / 2) * perp(p2 - p1). No comparisons with
+* g_epsilon are needed. The line results are exact for rational points.
+* The results are written to the caller owned points in the points
+* array, nothing is allocated.
+*
+* @ctx: Context holding scratch values.
+* @pair: Pair to intersect with itself. Points must not be the same.
+* @points: Array of PAIR_SELF_INTERSECTION_COUNT initialized points.
+*
+* returns: PAIR_SELF_INTERSECTION_COUNT.
+*/
+int pair_self_intersection(geometry_context_t* ctx, pair_t* pair, point_t** points) {
+    pair_scratch_t* s = &ctx->pair;
+    point_t* p1 = pair->circle1->origin;
+    point_t* p2 = pair->circle2->origin;
+    point_t* p;
+    int count = 0;
+    
+    assert(pair->is_init == IS_INIT);
+    
+    // line x circle1
+    p = _add_point(points, &count);
+    point_copy(p, p2);
+    
+    _add_reflection(ctx, p1, p2, points, &count);
+    
+    // line x circle2
+    p = _add_point(points, &count);
+    point_copy(p, p1);
+    
+    _add_reflection(ctx, p2, p1, points, &count);
+    
+    // circle1 x circle2
+    
+    // t1, t2 => midpoint
+    mpf_add(s->t1, p1->x, p2->x);
+    mpf_div_2exp(s->t1, s->t1, 1);
+    mpf_add(s->t2, p1->y, p2->y);
+    mpf_div_2exp(s->t2, s->t2, 1);
+    
+    // t3, t4 => (sqrt(3) / 2) * { -(y2 - y1), x2 - x1 }
+    mpf_sub(s->t5, p1->y, p2->y);
+    mpf_mul(s->t3, s->t5, g_root_three_over_two);
+    mpf_sub(s->t5, p2->x, p1->x);
+    mpf_mul(s->t4, s->t5, g_root_three_over_two);
+    
+    p = _add_point(points, &count);
+    mpf_add(p->x, s->t1, s->t3);
+    mpf_add(p->y, s->t2, s->t4);
+    
+    p = _add_point(points, &count);
+    mpf_sub(p->x, s->t1, s->t3);
+    mpf_sub(p->y, s->t2, s->t4);
+    
+    return count;
+}
+
+/*
+* The mpf calculation of pair_intersection_pair, after the shared
+* point and the interval filter have set which intersections are needed.
+*
+* @ctx: Context holding scratch values.
+* @left: First pair.
+* @right: Second pair.
+* @shared_index: PAIR_SHARED_NONE, or PAIR_SHARED_INDEX of the
+*     shared point.
+* @need: Bits of the intersections to calculate, see pair_intersection_pair.
+* @points: Array of PAIR_INTERSECTION_MAX initialized points.
+*
+* returns: The number of intersection points found.
+*/
+static int _pair_x_pair(geometry_context_t* ctx, pair_t* left, pair_t* right, int shared_index, int need, point_t** points) {
+    pair_scratch_t* s = &ctx->pair;
+    circle_t* lc[2] = { left->circle1, left->circle2 };
+    circle_t* rc[2] = { right->circle1, right->circle2 };
+    line_t* ln = left->line;
+    line_t* rn = right->line;
+    int count = 0;
+    int i, j;
+    int ls = shared_index >> 1;
+    int rs = shared_index & 1;
+    int other_index = (1 - ls) * 2 + (1 - rs);
+    point_t* p;
+    
+    // Shared values. The origin differences give the signed distances
+    // to the lines as well, since the line constant is c = a * x1 + b * y1:
+    // a * x + b * y - c = a * (x - x1) + b * (y - y1).
+    for (i=0; i<4; i++) {
+        mpf_sub(s->dx[i], rc[i & 1]->origin->x, lc[i >> 1]->origin->x);
+        mpf_sub(s->dy[i], rc[i & 1]->origin->y, lc[i >> 1]->origin->y);
+    }
+    
+    for (j=0; j<2; j++) {
+        // right point j from the left line.
+        mpf_mul(s->t1, ln->a, s->dx[j]);
+        mpf_mul(s->t2, ln->b, s->dy[j]);
+        mpf_add(s->dist[j], s->t1, s->t2);
+        
+        // left point j from the right line, the differences are
+        // measured from the left point so the sign is flipped.
+        mpf_mul(s->t1, rn->a, s->dx[j * 2]);
+        mpf_mul(s->t2, rn->b, s->dy[j * 2]);
+        mpf_add(s->t3, s->t1, s->t2);
+        mpf_neg(s->dist[2 + j], s->t3);
+    }
+    
+    if (shared_index != PAIR_SHARED_NONE) {
+        point_t* ps = lc[ls]->origin;
+        
+        // A circle with origin C through S meets a line through S with unit
+        // direction u = { -b, a } again at S - 2 * ((S - C) . u) * u.
+        
+        // Left circle at A x right line, S - A = dx[(1 - ls) * 2 + rs].
+        i = (1 - ls) * 2 + rs;
+        mpf_mul(s->t1, rn->a, s->dy[i]);
+        mpf_mul(s->t2, rn->b, s->dx[i]);
+        mpf_sub(s->t3, s->t1, s->t2);
+        mpf_mul_ui(s->t3, s->t3, 2);
+        
+        p = _add_point(points, &count);
+        mpf_mul(s->t1, rn->b, s->t3);
+        mpf_add(p->x, ps->x, s->t1);
+        mpf_mul(s->t1, rn->a, s->t3);
+        mpf_sub(p->y, ps->y, s->t1);
+        
+        // Right circle at B x left line, S - B = -dx[ls * 2 + (1 - rs)].
+        i = ls * 2 + (1 - rs);
+        mpf_mul(s->t1, ln->b, s->dx[i]);
+        mpf_mul(s->t2, ln->a, s->dy[i]);
+        mpf_sub(s->t3, s->t1, s->t2);
+        mpf_mul_ui(s->t3, s->t3, 2);
+        
+        p = _add_point(points, &count);
+        mpf_mul(s->t1, ln->b, s->t3);
+        mpf_add(p->x, ps->x, s->t1);
+        mpf_mul(s->t1, ln->a, s->t3);
+        mpf_sub(p->y, ps->y, s->t1);
+        
+        // Circles at A and B both pass through S, and meet again at S
+        // reflected across the line AB. With d = B - A and w = S - A,
+        // the reflection is 2 * (A + (w . d / d . d) * d) - S.
+        i = (1 - ls) * 2 + rs;
+        mpf_mul(s->t1, s->dx[other_index], s->dx[other_index]);
+        mpf_mul(s->t2, s->dy[other_index], s->dy[other_index]);
+        mpf_add(s->t3, s->t1, s->t2);
+        
+        // A and B are the same point, the circles are the same circle.
+        global_guard_band_check_squared(ctx, s->t3);
+        
+        if (global_is_zero_squared(s->t3) == 0) {
+            mpf_mul(s->t1, s->dx[i], s->dx[other_index]);
+            mpf_mul(s->t2, s->dy[i], s->dy[other_index]);
+            mpf_add(s->t4, s->t1, s->t2);
+            mpf_div(s->t4, s->t4, s->t3);
+            mpf_mul_ui(s->t4, s->t4, 2);
+            
+            // 2 * A + t4 * d - S
+            p = _add_point(points, &count);
+            mpf_mul(s->t1, s->dx[other_index], s->t4);
+            mpf_mul_ui(s->t2, lc[1 - ls]->origin->x, 2);
+            mpf_add(s->t1, s->t1, s->t2);
+            mpf_sub(p->x, s->t1, ps->x);
+            mpf_mul(s->t1, s->dy[other_index], s->t4);
+            mpf_mul_ui(s->t2, lc[1 - ls]->origin->y, 2);
+            mpf_add(s->t1, s->t1, s->t2);
+            mpf_sub(p->y, s->t1, ps->y);
+        }
+    }
+    
+    // Left line x right line. A point on the left line is l1 + t * { -b1, a1 },
+    // which is on the right line when t = -(distance of l1 from the right line) / det.
+    if (need & 1) {
+        // t1 => det = a1 * b2 - a2 * b1;
+        mpf_mul(s->t2, ln->a, rn->b);
+        mpf_mul(s->t3, rn->a, ln->b);
+        mpf_sub(s->t1, s->t2, s->t3);
+        
+        global_guard_band_check(ctx, s->t1, s->t2, s->t3);
+        
+        if (global_is_zero(s->t1) == 0) {
+            point_t* p = _add_point(points, &count);
+            
+            // t2 => t
+            mpf_div(s->t2, s->dist[2], s->t1);
+            mpf_neg(s->t2, s->t2);
+            
+            mpf_mul(s->t3, ln->b, s->t2);
+            mpf_sub(p->x, lc[0]->origin->x, s->t3);
+            mpf_mul(s->t3, ln->a, s->t2);
+            mpf_add(p->y, lc[0]->origin->y, s->t3);
+        }
+    }
+    
+    for (j=0; j<2; j++) {
+        if (need & (1 << (1 + j))) {
+            _circle_x_line(ctx, rc[j]->origin->x, rc[j]->origin->y, rc[j]->radius_squared, ln, s->dist[j], points, &count);
+        }
+        
+        if (need & (1 << (3 + j))) {
+            _circle_x_line(ctx, lc[j]->origin->x, lc[j]->origin->y, lc[j]->radius_squared, rn, s->dist[2 + j], points, &count);
+        }
+    }
+    
+    if (need >> 5) {
+        // Every left circle has the same radius, and every right circle.
+        mpf_sub(s->delta, lc[0]->radius_squared, rc[0]->radius_squared);
+        mpf_mul_ui(s->four_r2, lc[0]->radius_squared, 4);
+        
+        for (i=0; i<4; i++) {
+            if (need & (1 << (5 + i))) {
+                mpf_mul(s->t1, s->dx[i], s->dx[i]);
+                mpf_mul(s->t2, s->dy[i], s->dy[i]);
+                mpf_add(s->d2[i], s->t1, s->t2);
+                
+                _circle_x_circle(ctx, lc[i >> 1]->origin->x, lc[i >> 1]->origin->y, i, points, &count);
+            }
+        }
+    }
+    
+    return count;
+}
+
+/*
+* Finds the intersections of the line and circles of one pair with
+* the line and circles of another pair, nine intersections in all.
+* This gives the same points as calling line_intersection_line,
+* circle_intersection_line, and circle_intersection_circle on each
+* combination, but the values shared between them are only
+* calculated once.
+* The results are written to the caller owned points, starting at the
+* beginning of the points array. Nothing is allocated.
+*
+* When the pairs share a point S, some results are known without
+* the general calculation. The lines meet at S, the circles with
+* origin S are concentric, and the other circle of each pair passes
+* through S. The shared point itself is not returned, and the second
+* intersection of the circles through S is found in closed form.
+*
+* @ctx: Context holding scratch values.
+* @left: First pair.
+* @right: Second pair.
+* @shared_index: PAIR_SHARED_NONE, or PAIR_SHARED_INDEX of the
+*     shared point.
+* @points: Array of PAIR_INTERSECTION_MAX initialized points.
+*
+* returns: The number of intersection points found.
+*/
+int pair_intersection_pair(geometry_context_t* ctx, pair_t* left, pair_t* right, int shared_index, point_t** points) {
+    assert(left->is_init == IS_INIT);
+    assert(right->is_init == IS_INIT);
+    
+    // Left points are l1 = left->circle1->origin, l2 = left->circle2->origin,
+    // right points are r1, r2 the same way. Each circle-circle combination
+    // (left li, right rj) uses index i = li * 2 + rj into the scratch arrays.
+    circle_t* lc[2] = { left->circle1, left->circle2 };
+    circle_t* rc[2] = { right->circle1, right->circle2 };
+    line_t* ln = left->line;
+    line_t* rn = right->line;
+    
+    // Which of the nine intersections need the mpf calculation:
+    // bit 0 is the lines, bits 1-2 the right circles with the left
+    // line, bits 3-4 the left circles with the right line, and
+    // bits 5-8 the circles by index + 5.
+    int need = 0x1ff;
+    int count = 0;
+    int i, j;
+    
+    // For a shared point S = l(ls) = r(rs), the other points are
+    // A = l(1 - ls) and B = r(1 - rs).
+    int ls = shared_index >> 1;
+    int rs = shared_index & 1;
+    int other_index = (1 - ls) * 2 + (1 - rs);
+    
+    if (shared_index != PAIR_SHARED_NONE) {
+        // lines meet at S
+        need &= ~1;
+        
+        // circles with origin S are concentric
+        need &= ~(1 << (5 + shared_index));
+        
+        // closed form below for circles through S
+        need &= ~(1 << (1 + (1 - rs)));
+        need &= ~(1 << (3 + (1 - ls)));
+        need &= ~(1 << (5 + other_index));
+    }
+    
+    int candidates = need;
+    
+    // The interval filter follows the same steps as the mpf calculation
+    // below, see _filter_line_x_line, _filter_circle_x_line, and
+    // _filter_circle_x_circle for the separate versions.
+    if (ctx->use_interval_filter) {
+        interval_t idx[4], idy[4], t1, t2, t3;
+        
+        for (i=0; i<4; i++) {
+            interval_sub(&idx[i], &rc[i & 1]->icx, &lc[i >> 1]->icx);
+            interval_sub(&idy[i], &rc[i & 1]->icy, &lc[i >> 1]->icy);
+        }
+        
+        // det = a1 * b2 - a2 * b1;
+        interval_mul(&t1, &ln->ia, &rn->ib);
+        interval_mul(&t2, &rn->ia, &ln->ib);
+        interval_sub(&t3, &t1, &t2);
+        if (interval_is_zero(&t3)) {
+            need &= ~1;
+        }
+        
+        for (j=0; j<2; j++) {
+            // right circle j from the left line, dist = a * dx + b * dy
+            interval_mul(&t1, &ln->ia, &idx[j]);
+            interval_mul(&t2, &ln->ib, &idy[j]);
+            interval_add(&t3, &t1, &t2);
+            interval_sqr(&t1, &t3);
+            interval_sub(&t2, &rc[j]->ir2, &t1);
+            if (interval_is_negative(&t2)) {
+                need &= ~(1 << (1 + j));
+            }
+            
+            // left circle j from the right line, the sign of dist
+            // doesn't matter for dist^2.
+            interval_mul(&t1, &rn->ia, &idx[j * 2]);
+            interval_mul(&t2, &rn->ib, &idy[j * 2]);
+            interval_add(&t3, &t1, &t2);
+            interval_sqr(&t1, &t3);
+            interval_sub(&t2, &lc[j]->ir2, &t1);
+            if (interval_is_negative(&t2)) {
+                need &= ~(1 << (3 + j));
+            }
+        }
+        
+        for (i=0; i<4; i++) {
+            interval_t d2, k, q;
+            
+            interval_sqr(&t1, &idx[i]);
+            interval_sqr(&t2, &idy[i]);
+            interval_add(&d2, &t1, &t2);
+            
+            // k = r1^2 - r2^2 + d^2
+            interval_sub(&k, &lc[i >> 1]->ir2, &rc[i & 1]->ir2);
+            interval_add(&k, &k, &d2);
+            
+            // q = 4 * d^2 * r1^2 - k^2
+            interval_mul(&t1, &d2, &lc[i >> 1]->ir2);
+            interval_add(&t1, &t1, &t1);
+            interval_add(&t1, &t1, &t1);
+            interval_sqr(&t2, &k);
+            interval_sub(&q, &t1, &t2);
+            if (interval_is_negative(&q)) {
+                need &= ~(1 << (5 + i));
+            }
+        }
+        
+        // Shared point results are neither.
+        need &= candidates;
+        
+        for (i=0; i<9; i++) {
+            if (need & (1 << i)) {
+                ctx->filter_fallback++;
+            } else if (candidates & (1 << i)) {
+                ctx->filter_resolved++;
+            }
+        }
+        
+        if (need == 0 && shared_index == PAIR_SHARED_NONE) {
+            return 0;
+        }
+    }
+    
+    // Lines through rational points meet at a rational point,
+    // which is found exactly instead.
+    if ((need & 1) && ln->is_rational && rn->is_rational) {
+        need &= ~1;
+        count = line_intersection_line_rational(ctx, ln, rn, points[0]);
+        
+        if (need == 0 && shared_index == PAIR_SHARED_NONE) {
+            return count;
+        }
+    }
+    
+#ifdef NUMERIC_KERNELS
+    return count + _pair_x_pair_numeric(left, right, shared_index, need, points + count);
+#endif
+    
+    if (ctx->low != NULL) {
+        int low_count = _pair_x_pair(ctx->low, left, right, shared_index, need, points + count);
+        
+        if (geometry_context_low_done(ctx, points + count, low_count) == 1) {
+            return count;
+        }
+    }
+    
+    return count + _pair_x_pair(ctx, left, right, shared_index, need, points + count);
+}
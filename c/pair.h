@@ -0,0 +1,128 @@
+/*
+* Pair of points, and the line and circles constructed from them.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __PAIR_H__
+#define __PAIR_H__
+
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+
+#include "geometry_context.h"
+#include "point.h"
+#include "line.h"
+#include "circle.h"
+
+// Most points pair_intersection_pair can find, two for each of
+// the eight circle intersections plus one for the lines.
+#define PAIR_INTERSECTION_MAX 17
+
+// Number of points pair_self_intersection finds.
+#define PAIR_SELF_INTERSECTION_COUNT 6
+
+// Pairs passed to pair_intersection_pair don't share a point.
+#define PAIR_SHARED_NONE -1
+
+// Pairs passed to pair_intersection_pair share a point, the left
+// pair's point (0 for p1, 1 for p2) is the right pair's point
+// (0 for p3, 1 for p4).
+#define PAIR_SHARED_INDEX(left, right) ((left) * 2 + (right))
+
+// The objects constructed from two points p1 and p2: the line through
+// both points, and the circles at each point through the other point.
+// Both circles have the same radius, the distance between the points.
+typedef struct pair {
+    // Line from p1 to p2.
+    line_t* line;
+    
+    // Circle with origin p1.
+    circle_t* circle1;
+    
+    // Circle with origin p2.
+    circle_t* circle2;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} pair_t;
+
+/*
+* Allocates memory for a new pair.
+*
+* returns: pointer to new pair.
+*/
+pair_t* pair_alloc();
+
+/*
+* Initializes new pair. Must be called before use.
+*
+* @pair: Pair to initialize.
+*/
+void pair_init(pair_t* pair);
+
+/*
+* Frees resources used by the pair.
+*
+* @pair: Pair to free.
+*/
+void pair_free(pair_t* pair);
+
+/*
+* Sets the pair's line and circles.
+*
+* @ctx: Context holding scratch values.
+* @pair: Pair to set.
+* @p1: First point.
+* @p2: Second point.
+* @distance_squared: Squared distance between the points.
+*/
+void pair_set(geometry_context_t* ctx, pair_t* pair, point_t* p1, point_t* p2, mpf_t distance_squared);
+
+/*
+* Finds the self intersections of a pair, the line and circles of the
+* pair intersected with each other. These are known exactly:
+* the line meets circle1 at p2 and 2 * p1 - p2, the line meets
+* circle2 at p1 and 2 * p2 - p1, and the circles meet at the
+* midpoint +/- (sqrt(3) / 2) * perp(p2 - p1). No comparisons with
+* g_epsilon are needed.
+* The results are written to the caller owned points in the points
+* array, nothing is allocated.
+*
+* @ctx: Context holding scratch values.
+* @pair: Pair to intersect with itself. Points must not be the same.
+* @points: Array of PAIR_SELF_INTERSECTION_COUNT initialized points.
+*
+* returns: PAIR_SELF_INTERSECTION_COUNT.
+*/
+int pair_self_intersection(geometry_context_t* ctx, pair_t* pair, point_t** points);
+
+/*
+* Finds the intersections of the line and circles of one pair with
+* the line and circles of another pair, nine intersections in all.
+* This gives the same points as calling line_intersection_line,
+* circle_intersection_line, and circle_intersection_circle on each
+* combination, but the values shared between them are only
+* calculated once.
+* The results are written to the caller owned points, starting at the
+* beginning of the points array. Nothing is allocated.
+*
+* When the pairs share a point S, some results are known without
+* the general calculation. The lines meet at S, the circles with
+* origin S are concentric, and the other circle of each pair passes
+* through S. The shared point itself is not returned, and the second
+* intersection of the circles through S is found in closed form.
+*
+* @ctx: Context holding scratch values.
+* @left: First pair.
+* @right: Second pair.
+* @shared_index: PAIR_SHARED_NONE, or PAIR_SHARED_INDEX of the
+*     shared point.
+* @points: Array of PAIR_INTERSECTION_MAX initialized points.
+*
+* returns: The number of intersection points found.
+*/
+int pair_intersection_pair(geometry_context_t* ctx, pair_t* left, pair_t* right, int shared_index, point_t** points);
+
+#endif
@@ -6,58 +6,128 @@
 * MIT License, see /LICENSE for details.
 */
 #include <assert.h>
+#include <ctype.h>
 #include <stdio.h> // recommended to include stdio before gmp
 #include <gmp.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "global.h"
+#include "geometry_context.h"
 #include "point.h"
-#include "uthash.h"
 
-// internal variables use for calculation.
 static int _p_init = 0;
-static mpf_t _t1;
-static mpf_t _t2;
-static mpf_t _t3;
-static mpf_t _t4;
-static mpf_t _t5;
+
+// Context used by point_sort_function, uthash doesn't pass any
+// state to the sort method.
+static geometry_context_t* _sort_context = NULL;
 
 static size_t _str_point_digits;
-static size_t _hash_coord_digits;
-static size_t _hash_all_digits;
+static size_t _hash_coord_bits;
+
+// Whether points within g_epsilon are found in neighboring cells,
+// see point_hash_cells.
+static int _hash_grid;
+
+// Number of bits below the last kept bit in each hash key value.
+static size_t _hash_shift;
+
+// Limbs right of the binary point in each hash key value. There's
+// always at least POINT_GRID_MARGIN_BITS more than _hash_coord_bits,
+// for rounding and to find how close the value is to the cell edge.
+static size_t _hash_frac_limbs;
 
-#define LEFT_DIGITS_TOTAL 10
+// Limbs in each hash key value, the fraction limbs and one limb
+// for the integer part. The high bit of the integer limb is the sign.
+static size_t _hash_coord_limbs;
+
+// Limbs in each x,y value of a point_record_t, the fraction limbs and
+// one limb for the integer part. Without the hash grid this is the
+// same as _hash_coord_limbs.
+static size_t _record_coord_limbs;
+
+// Most bits in the denominator of a fraction found by
+// point_set_str_rounded, 0 if exact rational points are off.
+static size_t _rational_bits = 0;
 
 /*
 * Sets the hash key for the point.
 */
 static void _set_hash_id(point_t*);
 
+/*
+* Sets str_x and str_y for the point.
+*/
+static void _set_str(point_t*);
+
+/*
+* Sets a hash key value to the neighboring cell.
+*/
+static void _set_hash_neighbor(mp_limb_t*, int, signed char);
+
+/*
+* Mixes the limbs of a hash key into a hash value.
+*/
+static unsigned _hash_limbs(mp_limb_t*, size_t);
+
 /*
 * Initializes some static variables.
 *
 * @str_point_digits: number of digits to use for each axis when storing point as string.
+* @point_hash_coord_bits: number of bits right of the binary point kept
+*                         for each x/y value in the hash key.
+* @use_hash_grid: 1 to use the hash grid, so points closer than g_epsilon
+*                 are found by point_hash_cells. This can lower the number
+*                 of bits used. Must be called after global_init.
 */
-void global_point_init(size_t str_point_digits, size_t point_hash_coord_digits) {
+void global_point_init(size_t str_point_digits, size_t point_hash_coord_bits, int use_hash_grid) {
+    long epsilon_exp;
+    
     if (_p_init != 0) {
         return;
     }
     
     _p_init = 1;
     
-    mpf_init(_t1);
-    mpf_init(_t2);
-    mpf_init(_t3);
-    mpf_init(_t4);
-    mpf_init(_t5);
+    _sort_context = geometry_context_alloc();
+    geometry_context_init(_sort_context);
     
     _str_point_digits = str_point_digits;
-    _hash_coord_digits = point_hash_coord_digits;
+    _hash_coord_bits = point_hash_coord_bits;
+    _hash_grid = use_hash_grid;
+    _record_coord_limbs = 0;
+    
+    if (_hash_grid) {
+        // g_epsilon < 2^epsilon_exp, so cells of 2^(epsilon_exp + POINT_GRID_MARGIN_BITS)
+        // are more than 2^POINT_GRID_MARGIN_BITS times g_epsilon.
+        mpf_get_d_2exp(&epsilon_exp, g_epsilon);
+        epsilon_exp = -epsilon_exp;
+        
+        if (epsilon_exp < 0) {
+            epsilon_exp = 0;
+        }
+        
+        // Records keep at least one limb below g_epsilon.
+        _record_coord_limbs = ((size_t)epsilon_exp + 2 * GMP_NUMB_BITS - 1) / GMP_NUMB_BITS + 1;
+        
+        epsilon_exp -= POINT_GRID_MARGIN_BITS;
+        if (epsilon_exp < 0) {
+            epsilon_exp = 0;
+        }
+        if ((size_t)epsilon_exp < _hash_coord_bits) {
+            _hash_coord_bits = (size_t)epsilon_exp;
+        }
+    }
+    
+    _hash_frac_limbs = ((_hash_coord_bits + POINT_GRID_MARGIN_BITS) / GMP_NUMB_BITS) + 1;
+    _hash_coord_limbs = _hash_frac_limbs + 1;
+    _hash_shift = (GMP_NUMB_BITS * _hash_frac_limbs) - _hash_coord_bits;
     
-    // 5 extra for comma, decimal point, and signs
-    _hash_all_digits = (2*_hash_coord_digits)+5+LEFT_DIGITS_TOTAL;
+    if (_hash_grid == 0) {
+        _record_coord_limbs = _hash_coord_limbs;
+    }
 }
 
 /*
@@ -69,11 +139,52 @@ void global_point_free() {
     }
     
     _p_init = 0;
-    mpf_clear(_t1);
-    mpf_clear(_t2);
-    mpf_clear(_t3);
-    mpf_clear(_t4);
-    mpf_clear(_t5);
+    
+    geometry_context_free(_sort_context);
+    _sort_context = NULL;
+}
+
+/*
+* Turns on exact rational points. Points set from integers or decimal
+* strings keep their exact value as a fraction, and intersections of
+* rational points that are rational are calculated exactly. Points
+* that are both rational are compared exactly instead of with g_epsilon.
+*
+* @max_denominator_bits: Most bits in the denominator of a fraction found
+*     by point_set_str_rounded. 0 to leave exact rational points off.
+*/
+void point_rational_init(size_t max_denominator_bits) {
+    _rational_bits = max_denominator_bits;
+}
+
+/*
+* Most bits in the denominator of a fraction found by
+* point_set_str_rounded, see point_rational_init.
+*
+* returns: number of bits, 0 if exact rational points are off.
+*/
+size_t point_rational_bits() {
+    return _rational_bits;
+}
+
+/*
+* Whether or not the hash grid is used, see global_point_init.
+*
+* returns: 1 if the hash grid is used, otherwise 0.
+*/
+int point_hash_grid() {
+    return _hash_grid;
+}
+
+/*
+* Number of bits right of the binary point kept for each x/y value
+* in the hash key. With the hash grid this can be less than the
+* number given to global_point_init.
+*
+* returns: number of bits.
+*/
+size_t point_hash_coord_bits() {
+    return _hash_coord_bits;
 }
 
 /*
@@ -86,19 +197,11 @@ point_t* point_alloc() {
     global_exit_if_null(p, "Fatal error calling malloc for point_t.\n");
     memset(p, 0, sizeof(point_t));
     
-    p->str_x = malloc(sizeof(char)*(_str_point_digits+1));
-    global_exit_if_null(p->str_x, "Fatal error calling malloc for point_t->str_x.\n");
-    memset(p->str_x, 0, sizeof(char)*(_str_point_digits+1));
-    
-    p->str_y = malloc(sizeof(char)*(_str_point_digits+1));
-    global_exit_if_null(p->str_y, "Fatal error calling malloc for point_t->str_y.\n");
-    memset(p->str_y, 0, sizeof(char)*(_str_point_digits+1));
-    
-    p->hash_key = malloc(sizeof(char)*(_hash_all_digits+1));
-    global_exit_if_null(p->hash_key, "Fatal error calling malloc for point_t->hash_key.\n");
-    memset(p->hash_key, 0, sizeof(char)*(_hash_all_digits+1));
+    // The character buffers are allocated when first needed,
+    // most points are never hashed or written.
     
     p->hash_dirty = 1;
+    p->str_dirty = 1;
     
     return p;
 }
@@ -137,6 +240,10 @@ void point_free(point_t* p) {
     
     mpf_clear(p->x);
     mpf_clear(p->y);
+    if (p->q_init) {
+        mpq_clear(p->qx);
+        mpq_clear(p->qy);
+    }
     free(p->str_x);
     free(p->str_y);
     free(p->hash_key);
@@ -150,8 +257,94 @@ void point_free(point_t* p) {
 }
 
 /*
-* Copies the x,y values from one point to another.
-* This updates the point's hash key.
+* Takes a point from the context's free list, or allocates and
+* initializes a new point if the list is empty. The value of the
+* point is not set.
+*
+* @ctx: Context holding the free list.
+*
+* returns: initialized point.
+*/
+point_t* point_take(geometry_context_t* ctx) {
+    point_t* p;
+    
+    if (ctx->free_point_count == 0) {
+        p = point_alloc();
+        point_init(p);
+        
+        return p;
+    }
+    
+    ctx->free_point_count--;
+    p = ctx->free_points[ctx->free_point_count];
+    
+    point_reset(p);
+    
+    return p;
+}
+
+/*
+* Gives a point from point_take (or point_alloc) back to the context's
+* free list, to be reused by point_take. The point must not be in a hash.
+* If the list is full the point is freed.
+*
+* @ctx: Context holding the free list.
+* @p: Point to release.
+*/
+void point_release(geometry_context_t* ctx, point_t* p) {
+    if (p == NULL) {
+        return;
+    }
+    
+    if (ctx->free_points == NULL) {
+        ctx->free_points = malloc(sizeof(point_t*) * POINT_FREE_LIST_MAX);
+        global_exit_if_null(ctx->free_points, "Fatal error calling malloc for free_points.\n");
+    }
+    
+    if (ctx->free_point_count == POINT_FREE_LIST_MAX) {
+        point_free(p);
+        return;
+    }
+    
+    ctx->free_points[ctx->free_point_count] = p;
+    ctx->free_point_count++;
+}
+
+/*
+* Clears the datastore fields of a point so it can hold a new value,
+* such as an intersection kernel result. The x,y values are left as is,
+* the hash key and strings are updated when next needed.
+*
+* @p: Point to reset.
+*/
+void point_reset(point_t* p) {
+    p->point_id = 0;
+    p->iteration_origin = 0;
+    p->in_datastore = 0;
+    p->is_rational = 0;
+    p->hash_dirty = 1;
+    p->str_dirty = 1;
+}
+
+/*
+* Makes sure qx and qy are initialized.
+*
+* @p: Point.
+*/
+static void _ensure_q(point_t* p) {
+    if (p->q_init) {
+        return;
+    }
+    
+    mpq_init(p->qx);
+    mpq_init(p->qy);
+    p->q_init = 1;
+}
+
+/*
+* Copies the x,y values from one point to another, and the exact
+* values if it's rational.
+* The hash key and strings are only updated when next needed.
 *
 * @copy_to: Point that will get new x,y values.
 * @copy_from: Point x,y values are copied from.
@@ -165,11 +358,15 @@ void point_copy(point_t* copy_to, point_t* copy_from) {
     mpf_set(copy_to->x, copy_from->x);
     mpf_set(copy_to->y, copy_from->y);
     
-    copy_to->hash_dirty = 1;
-    
-    // don't bother copying character buffers, will be recalculated below.
+    copy_to->is_rational = copy_from->is_rational;
+    if (copy_from->is_rational) {
+        _ensure_q(copy_to);
+        mpq_set(copy_to->qx, copy_from->qx);
+        mpq_set(copy_to->qy, copy_from->qy);
+    }
     
-    _set_hash_id(copy_to);
+    copy_to->hash_dirty = 1;
+    copy_to->str_dirty = 1;
 }
 
 
@@ -183,21 +380,14 @@ void point_copy(point_t* copy_to, point_t* copy_from) {
 point_t* point_clone(point_t* p) {
     point_t* pnew = point_alloc();
     point_init(pnew);
-    mpf_set(pnew->x, p->x);
-    mpf_set(pnew->y, p->y);
-    
-    pnew->hash_dirty = 1;
-    
-    // don't bother copying character buffers, will be recalculated below.
-    
-    _set_hash_id(pnew);
+    point_copy(pnew, p);
     
     return pnew;
 }
 
 /*
 * Sets a point's x,y values via GMP parameter.
-* This updates the point's hash key.
+* The hash key and strings are only updated when next needed.
 *
 * @p: Point that will get new x,y values.
 * @x: x value.
@@ -210,14 +400,15 @@ void point_set(point_t* p, mpf_t x, mpf_t y) {
     mpf_set(p->x, x);
     mpf_set(p->y, y);
     
+    p->is_rational = 0;
     p->hash_dirty = 1;
-    
-    _set_hash_id(p);
+    p->str_dirty = 1;
 }
 
 /*
 * Sets a point's x,y values via int.
-* This updates the point's hash key.
+* The hash key and strings are only updated when next needed.
+* With exact rational points, the values are kept exactly.
 *
 * @p: Point that will get new x,y values.
 * @x: x value.
@@ -230,29 +421,337 @@ void point_set_si(point_t* p, intmax_t x, intmax_t y) {
     mpf_set_si(p->x, x);
     mpf_set_si(p->y, y);
     
+    p->is_rational = 0;
+    if (_rational_bits > 0) {
+        _ensure_q(p);
+        mpq_set_si(p->qx, x, 1);
+        mpq_set_si(p->qy, y, 1);
+        p->is_rational = 1;
+    }
+    
     p->hash_dirty = 1;
+    p->str_dirty = 1;
+}
+
+/*
+* Sets a fraction to the exact value of a decimal string.
+*
+* @q: Set to the value.
+* @str: Decimal value, whitespace is ignored.
+* @frac_digits: Set to the number of digits right of the decimal point.
+*
+* returns: 1 if the string was read, otherwise 0.
+*/
+static int _set_q_decimal(mpq_t q, const char* str, size_t* frac_digits) {
+    size_t len = strlen(str);
+    char* digits = malloc(len + 1);
+    size_t count = 0;
+    size_t frac = 0;
+    int in_frac = 0;
+    int result;
+    size_t i;
     
-    _set_hash_id(p);
+    global_exit_if_null(digits, "Fatal error calling malloc for decimal digits.\n");
+    
+    // The value is the digits without the decimal point, over
+    // 10^(digits right of the decimal point).
+    for (i=0; i<len; i++) {
+        if (str[i] == '.') {
+            in_frac = 1;
+        } else if (isspace((unsigned char)str[i]) == 0) {
+            digits[count++] = str[i];
+            
+            if (in_frac) {
+                frac++;
+            }
+        }
+    }
+    digits[count] = '\0';
+    
+    result = mpz_set_str(mpq_numref(q), digits, 10);
+    free(digits);
+    
+    if (result != 0) {
+        return 0;
+    }
+    
+    mpz_ui_pow_ui(mpq_denref(q), 10, frac);
+    mpq_canonicalize(q);
+    *frac_digits = frac;
+    
+    return 1;
+}
+
+/*
+* Finds the fraction with the smallest denominator within 1 / scale of
+* a value, from the continued fraction convergents of the value.
+*
+* @q: Value, set to the fraction if one is found.
+* @scale: Inverse of the rounding of the value.
+* @scale_bits: Bits of scale, scale >= 2^scale_bits.
+*
+* returns: 1 if a fraction with at most _rational_bits bits in the
+*     denominator is found, and at least POINT_RATIONAL_MARGIN_BITS of
+*     the rounding are left over. Otherwise 0 and q is not changed.
+*/
+static int _find_fraction_within(mpq_t q, mpz_t scale, size_t scale_bits) {
+    mpz_t n, d, a, r, h, h1, h2, k, k1, k2, t1, t2;
+    int found = 0;
+    
+    mpz_inits(n, d, a, r, h, h1, h2, k, k1, k2, t1, t2, NULL);
+    
+    mpz_abs(n, mpq_numref(q));
+    mpz_set(d, mpq_denref(q));
+    
+    // Convergents h / k, with h1 / k1 and h2 / k2 the two before.
+    mpz_set_ui(h1, 1);
+    mpz_set_ui(h2, 0);
+    mpz_set_ui(k1, 0);
+    mpz_set_ui(k2, 1);
+    
+    while (mpz_sgn(d) != 0) {
+        mpz_fdiv_qr(a, r, n, d);
+        mpz_set(n, d);
+        mpz_set(d, r);
+        
+        mpz_mul(h, a, h1);
+        mpz_add(h, h, h2);
+        mpz_mul(k, a, k1);
+        mpz_add(k, k, k2);
+        
+        if (mpz_sizeinbase(k, 2) > _rational_bits
+            || 2 * mpz_sizeinbase(k, 2) + POINT_RATIONAL_MARGIN_BITS > scale_bits) {
+            break;
+        }
+        
+        // |h / k - value| <= 1 / scale, value = num / den
+        // => |h * den - k * num| * scale <= k * den
+        mpz_mul(t1, h, mpq_denref(q));
+        mpz_abs(t2, mpq_numref(q));
+        mpz_mul(t2, t2, k);
+        mpz_sub(t1, t1, t2);
+        mpz_abs(t1, t1);
+        mpz_mul(t1, t1, scale);
+        mpz_mul(t2, k, mpq_denref(q));
+        
+        if (mpz_cmp(t1, t2) <= 0) {
+            found = 1;
+            break;
+        }
+        
+        mpz_swap(h2, h1);
+        mpz_swap(h1, h);
+        mpz_swap(k2, k1);
+        mpz_swap(k1, k);
+    }
+    
+    if (found) {
+        if (mpq_sgn(q) < 0) {
+            mpz_neg(h, h);
+        }
+        
+        mpz_set(mpq_numref(q), h);
+        mpz_set(mpq_denref(q), k);
+    }
+    
+    mpz_clears(n, d, a, r, h, h1, h2, k, k1, k2, t1, t2, NULL);
+    
+    return found;
+}
+
+/*
+* Finds the fraction with the smallest denominator within 10^-digits of
+* a value, see _find_fraction_within.
+*
+* @q: Value, set to the fraction if one is found.
+* @digits: Digits the value was rounded to.
+*
+* returns: 1 if a fraction is found, otherwise 0 and q is not changed.
+*/
+static int _find_fraction(mpq_t q, size_t digits) {
+    mpz_t scale;
+    int found;
+    
+    mpz_init(scale);
+    mpz_ui_pow_ui(scale, 10, digits);
+    
+    // 10^digits > 2^(digits * 3.32)
+    found = _find_fraction_within(q, scale, (digits * 332) / 100);
+    
+    mpz_clear(scale);
+    
+    return found;
+}
+
+/*
+* Finds the fraction with the smallest denominator within the rounding
+* of an mpf value at the default precision, see _find_fraction_within.
+*
+* @q: Set to the fraction if one is found.
+* @f: Value.
+*
+* returns: 1 if a fraction is found, otherwise 0.
+*/
+static int _find_fraction_mpf(mpq_t q, mpf_t f) {
+    mpz_t scale;
+    long exp;
+    size_t bits = 0;
+    int found;
+    
+    mpq_set_f(q, f);
+    
+    // |f| < 2^exp, a value less than 1 is rounded as if it were 1.
+    // Allow for rounding by two bits more than the precision, once
+    // when f was set and once when it was copied, see point_set_fixed.
+    mpf_get_d_2exp(&exp, f);
+    if (exp < 0) {
+        exp = 0;
+    }
+    
+    if (mpf_get_default_prec() > (mp_bitcnt_t)exp + 2) {
+        bits = mpf_get_default_prec() - (mp_bitcnt_t)exp - 2;
+    }
+    
+    mpz_init(scale);
+    mpz_setbit(scale, bits);
+    
+    found = _find_fraction_within(q, scale, bits);
+    
+    mpz_clear(scale);
+    
+    return found;
 }
 
 /*
 * Sets a point's x,y values from string.
-* This updates the point's hash key.
+* The hash key and strings are only updated when next needed.
 *
 * @p: Point that will get new x,y values.
 * @x: x value.
 * @y: y value.
 */
 void point_set_str(point_t* p, const char *x, const char *y) {
+    size_t digits;
+    
     assert(p != NULL);
     assert(p->is_init == IS_INIT);
     
     mpf_set_str(p->x, x, 10);
     mpf_set_str(p->y, y, 10);
     
+    p->is_rational = 0;
     p->hash_dirty = 1;
+    p->str_dirty = 1;
     
-    _set_hash_id(p);
+    if (_rational_bits > 0) {
+        _ensure_q(p);
+        
+        if (_set_q_decimal(p->qx, x, &digits) && _set_q_decimal(p->qy, y, &digits)) {
+            point_set_q(p, p->qx, p->qy);
+        }
+    }
+}
+
+/*
+* Sets a point's x,y values from strings rounded to a number of
+* digits, such as the strings of point_ensure_str read back from the
+* datastore. With exact rational points, if both values are within
+* the rounding of a fraction with a small enough denominator, the
+* point is set to the fractions, see POINT_RATIONAL_MARGIN_BITS.
+* The hash key and strings are only updated when next needed.
+*
+* @p: Point that will get new x,y values.
+* @x: x value.
+* @y: y value.
+*/
+void point_set_str_rounded(point_t* p, const char *x, const char *y) {
+    size_t x_digits, y_digits;
+    
+    assert(p != NULL);
+    assert(p->is_init == IS_INIT);
+    
+    mpf_set_str(p->x, x, 10);
+    mpf_set_str(p->y, y, 10);
+    
+    p->is_rational = 0;
+    p->hash_dirty = 1;
+    p->str_dirty = 1;
+    
+    if (_rational_bits == 0) {
+        return;
+    }
+    
+    _ensure_q(p);
+    
+    if (_set_q_decimal(p->qx, x, &x_digits) == 0 || _set_q_decimal(p->qy, y, &y_digits) == 0) {
+        return;
+    }
+    
+    if (_find_fraction(p->qx, x_digits) && _find_fraction(p->qy, y_digits)) {
+        point_set_q(p, p->qx, p->qy);
+    }
+}
+
+/*
+* Sets a point to fractions, if both x,y values are within their
+* rounding at the default mpf precision of a fraction with a small
+* enough denominator, the same as point_set_str_rounded. Used for
+* values kept at the mpf precision, such as the records of
+* point_runs_t. The hash key and strings are only updated when next
+* needed.
+*
+* @p: Point with values rounded from fractions.
+*
+* returns: 1 if the point was set to fractions, otherwise 0.
+*/
+int point_find_rational(point_t* p) {
+    assert(p != NULL);
+    assert(p->is_init == IS_INIT);
+    
+    if (_rational_bits == 0) {
+        return 0;
+    }
+    
+    _ensure_q(p);
+    
+    if (_find_fraction_mpf(p->qx, p->x) == 0 || _find_fraction_mpf(p->qy, p->y) == 0) {
+        return 0;
+    }
+    
+    point_set_q(p, p->qx, p->qy);
+    
+    return 1;
+}
+
+/*
+* Sets a point to exact rational x,y values. The mpf values are
+* set from the fractions, so equal fractions always have the same
+* hash key. The hash key and strings are only updated when next needed.
+*
+* @p: Point that will get new x,y values.
+* @x: x value.
+* @y: y value.
+*/
+void point_set_q(point_t* p, mpq_t x, mpq_t y) {
+    assert(p != NULL);
+    assert(p->is_init == IS_INIT);
+    
+    _ensure_q(p);
+    
+    // x and y can be p's own values.
+    if (x != p->qx) {
+        mpq_set(p->qx, x);
+    }
+    if (y != p->qy) {
+        mpq_set(p->qy, y);
+    }
+    
+    mpf_set_q(p->x, p->qx);
+    mpf_set_q(p->y, p->qy);
+    
+    p->is_rational = 1;
+    p->hash_dirty = 1;
+    p->str_dirty = 1;
 }
 
 /*
@@ -267,46 +766,702 @@ void point_ensure_hash(point_t* p) {
 }
 
 /*
-* Sets the hash key for the point.
+* Sets the point's str_x and str_y. This is required
+* to be called before using the strings.
 *
-* @p: Point to set hash key.
+* @p: Point to update strings.
 */
-static void _set_hash_id(point_t* p) {
+void point_ensure_str(point_t* p) {
+    assert(p != NULL);
+    _set_str(p);
+}
+
+/*
+* Sets a fixed point value to the magnitude of v, with one integer
+* limb and the rest fraction limbs. Bits below the last limb are
+* dropped.
+*
+* @limbs: Fixed point value, least significant limb first.
+* @limb_count: Number of limbs, at least 2.
+* @v: Value.
+*
+* returns: sign of v.
+*/
+signed char point_set_fixed(mp_limb_t* limbs, size_t limb_count, mpf_t v) {
+    mp_size_t n = v->_mp_size < 0 ? -v->_mp_size : v->_mp_size;
+    mp_size_t frac_limbs = (mp_size_t)limb_count - 1;
+    mp_size_t i, j;
     
-    if (p->hash_dirty == 0) {
+    memset(limbs, 0, sizeof(mp_limb_t) * limb_count);
+    
+    // Limb i of v has weight B^(exp - n + i), limb j of the fixed
+    // point value has weight B^(j - frac_limbs).
+    for (i=0; i<n; i++) {
+        j = i + v->_mp_exp - n + frac_limbs;
+        
+        if (j < 0) {
+            continue;
+        }
+        
+        if (j >= (mp_size_t)limb_count) {
+            global_error_printf("Point value is too large for a fixed point value.\n");
+            exit(1);
+        }
+        
+        limbs[j] = v->_mp_d[i];
+    }
+    
+    return (signed char)mpf_sgn(v);
+}
+
+/*
+* Sets an mpf value from a fixed point value, see point_set_fixed.
+*
+* @rop: Set to the value.
+* @limbs: Fixed point value.
+* @limb_count: Number of limbs.
+* @sign: Sign of the value.
+*/
+void point_get_fixed(mpf_t rop, mp_limb_t* limbs, size_t limb_count, signed char sign) {
+    mp_size_t high = (mp_size_t)limb_count;
+    mp_size_t low = 0;
+    mp_size_t n;
+    
+    // The mpf limbs are set directly, the reverse of point_set_fixed.
+    // Zero limbs at either end are dropped, the top limb of an mpf
+    // value is never zero.
+    while (high > 0 && limbs[high - 1] == 0) {
+        high--;
+    }
+    
+    while (low < high && limbs[low] == 0) {
+        low++;
+    }
+    
+    n = high - low;
+    
+    if (n == 0) {
+        rop->_mp_size = 0;
+        rop->_mp_exp = 0;
+        return;
+    }
+    
+    // Keep as many limbs as the mpf value has room for.
+    if (n > rop->_mp_prec + 1) {
+        low = high - (rop->_mp_prec + 1);
+        n = high - low;
+    }
+    
+    memcpy(rop->_mp_d, limbs + low, sizeof(mp_limb_t) * n);
+    rop->_mp_size = sign < 0 ? -n : n;
+    rop->_mp_exp = high - ((mp_size_t)limb_count - 1);
+}
+
+/*
+* Allocates a record of a point. The record owns the point after this.
+*
+* @p: Point with the hash key set, see point_ensure_hash.
+*
+* returns: pointer to new record.
+*/
+point_record_t* point_record_alloc(point_t* p) {
+    point_record_t* r;
+    
+    assert(p != NULL);
+    assert(p->hash_dirty == 0);
+    
+    r = malloc(point_record_size());
+    global_exit_if_null(r, "Fatal error calling malloc for point_record_t.\n");
+    
+    r->point = p;
+    r->point_id = p->point_id;
+    r->hash_value = p->hash_value;
+    r->clock_count = 0;
+    r->sign[0] = 0;
+    r->sign[1] = 0;
+    r->flags = p->is_rational ? POINT_RECORD_RATIONAL : 0;
+    r->q = NULL;
+    
+    if (p->is_rational) {
+        r->q = malloc(sizeof(mpq_t) * 2);
+        global_exit_if_null(r->q, "Fatal error calling malloc for point record fractions.\n");
+        
+        mpq_init(r->q[0]);
+        mpq_init(r->q[1]);
+        mpq_set(r->q[0], p->qx);
+        mpq_set(r->q[1], p->qy);
+    }
+    
+    if (_hash_grid == 0) {
+        memcpy(r->limbs, p->hash_key, sizeof(mp_limb_t) * 2 * _record_coord_limbs);
+    } else {
+        r->sign[0] = point_set_fixed(r->limbs, _record_coord_limbs, p->x);
+        r->sign[1] = point_set_fixed(r->limbs + _record_coord_limbs, _record_coord_limbs, p->y);
+    }
+    
+    return r;
+}
+
+/*
+* Frees the record, and the full point if it still has one.
+*
+* @r: Record to free.
+*/
+void point_record_free(point_record_t* r) {
+    if (r == NULL) {
+        return;
+    }
+    
+    point_free(r->point);
+    
+    if (r->q != NULL) {
+        mpq_clear(r->q[0]);
+        mpq_clear(r->q[1]);
+        free(r->q);
+    }
+    
+    free(r);
+}
+
+/*
+* Frees the full point of a record, keeping only the record.
+* The point must have been written to the datastore.
+*
+* @r: Record to compact.
+*/
+void point_record_compact(point_record_t* r) {
+    assert(r != NULL);
+    
+    if (r->point == NULL) {
         return;
     }
     
-    // Make sure that the value is not negative zero.
+    assert(r->point->in_datastore == 1);
+    
+    r->point_id = r->point->point_id;
+    point_free(r->point);
+    r->point = NULL;
+}
+
+/*
+* Compares a record to a point. A rational point is only the same as
+* a rational record if it has the record's fractions. Otherwise without
+* the hash grid the record is the same point if it has the key, and
+* with the hash grid the record's values are compared to the point as
+* in point_equals. The full point isn't used, so this is the same
+* before and after the record is compacted.
+*
+* @ctx: Context holding scratch values.
+* @r: Record.
+* @p: Point.
+* @key: Key of the cell being searched, p's key or a neighbor's.
+*
+* returns: 1 if they're the same point, otherwise 0.
+*/
+int point_record_equals(geometry_context_t* ctx, point_record_t* r, point_t* p, mp_limb_t* key) {
+    point_scratch_t* s = &ctx->point;
+    
+    assert(r != NULL);
+    assert(p != NULL);
+    
+    // Rational points are the same point only if they're equal.
+    if ((r->flags & POINT_RECORD_RATIONAL) && p->is_rational) {
+        return mpq_equal(r->q[0], p->qx) && mpq_equal(r->q[1], p->qy) ? 1 : 0;
+    }
+    
+    if (_hash_grid == 0) {
+        return memcmp(r->limbs, key, sizeof(mp_limb_t) * 2 * _record_coord_limbs) == 0 ? 1 : 0;
+    }
+    
+    // Same as point_distance, with the record's values in t5 and t6.
+    point_get_fixed(s->t5, r->limbs, _record_coord_limbs, r->sign[0]);
+    point_get_fixed(s->t6, r->limbs + _record_coord_limbs, _record_coord_limbs, r->sign[1]);
+    
+    mpf_sub(s->t1, s->t5, p->x);
+    mpf_mul(s->t2, s->t1, s->t1);
+    mpf_sub(s->t3, s->t6, p->y);
+    mpf_mul(s->t4, s->t3, s->t3);
+    mpf_add(s->t6, s->t2, s->t4);
+    mpf_sqrt(s->t6, s->t6);
+    
+    return global_is_zero(s->t6);
+}
+
+/*
+* Number of bytes in each record, including the limbs.
+*
+* returns: number of bytes.
+*/
+size_t point_record_size() {
+    return offsetof(point_record_t, limbs) + sizeof(mp_limb_t) * 2 * _record_coord_limbs;
+}
+
+/*
+* Number of limbs in the sort key of each x,y value, see point_sort_key.
+*
+* returns: number of limbs.
+*/
+size_t point_sort_key_limbs() {
+    return _hash_coord_limbs;
+}
+
+/*
+* Sets the sort key of a point, the cell of x then the cell of y.
+* The hash key values are sign and magnitude, a sort key value is the
+* cell plus 2^(bits - 1) so that comparing values as unsigned numbers
+* (mpn_cmp) orders them the same as the cells.
+*
+* @p: Point.
+* @key: Sort key, 2 * point_sort_key_limbs long.
+*/
+void point_sort_key(point_t* p, mp_limb_t* key) {
+    mp_limb_t sign_bit = (mp_limb_t)1 << (GMP_NUMB_BITS - 1);
+    mp_limb_t* value;
+    mp_limb_t* hash_value;
+    int i;
+    
+    _set_hash_id(p);
+    
+    for (i=0; i<2; i++) {
+        value = key + i * _hash_coord_limbs;
+        hash_value = p->hash_key + i * _hash_coord_limbs;
+        
+        memcpy(value, hash_value, sizeof(mp_limb_t) * _hash_coord_limbs);
+        
+        if ((value[_hash_coord_limbs - 1] & sign_bit) == 0) {
+            value[_hash_coord_limbs - 1] |= sign_bit;
+        } else {
+            // 2^(bits - 1) - magnitude, the magnitude is less than
+            // 2^(bits - 1) so this is never negative.
+            value[_hash_coord_limbs - 1] &= ~sign_bit;
+            mpn_neg(value, value, _hash_coord_limbs);
+            value[_hash_coord_limbs - 1] += sign_bit;
+        }
+    }
+}
+
+/*
+* Number of cells from one sort key value to another.
+*
+* @a: Sort key value, point_sort_key_limbs long.
+* @b: Sort key value.
+*
+* returns: b - a in cells, -2 if it's -2 or less, 2 if it's 2 or more.
+*/
+int point_sort_key_step(mp_limb_t* a, mp_limb_t* b) {
+    mp_limb_t difference[_hash_coord_limbs];
+    size_t index = _hash_shift / GMP_NUMB_BITS;
+    mp_limb_t bit = (mp_limb_t)1 << (_hash_shift % GMP_NUMB_BITS);
+    int cmp = mpn_cmp(b, a, _hash_coord_limbs);
+    size_t i;
+    
+    if (cmp == 0) {
+        return 0;
+    }
+    
+    if (cmp > 0) {
+        mpn_sub_n(difference, b, a, _hash_coord_limbs);
+    } else {
+        mpn_sub_n(difference, a, b, _hash_coord_limbs);
+    }
+    
+    // One cell is the single bit at _hash_shift.
+    for (i=0; i<_hash_coord_limbs; i++) {
+        if (difference[i] != (i == index ? bit : 0)) {
+            return cmp > 0 ? 2 : -2;
+        }
+    }
+    
+    return cmp > 0 ? 1 : -1;
+}
+
+/*
+* Sets the key of a neighboring grid cell.
+*
+* @key: Key buffer, set to the key of p with the cell moved.
+* @p: Point the cell is next to.
+* @dx: Direction of the cell for x, see point_t.hash_near, or 0.
+* @dy: Direction of the cell for y, or 0.
+*
+* returns: Hash of the key.
+*/
+static unsigned _set_neighbor_key(mp_limb_t* key, point_t* p, signed char dx, signed char dy) {
+    memcpy(key, p->hash_key, p->hash_key_length);
+    
+    if (dx != 0) {
+        _set_hash_neighbor(key, mpf_sgn(p->x), dx);
+    }
+    if (dy != 0) {
+        _set_hash_neighbor(key + _hash_coord_limbs, mpf_sgn(p->y), dy);
+    }
+    
+    return _hash_limbs(key, 2 * _hash_coord_limbs);
+}
+
+/*
+* Finds the hash keys of the cells a point equal to p could be in.
+* The first cell is always p's own key. Without the hash grid that's
+* the only cell. With the hash grid, the neighboring cells p is close
+* to are included, points in these are compared with point_equals.
+* This finds points within g_epsilon of p even when they round to a
+* different key.
+*
+* @ctx: Context holding scratch values. Neighbor keys are stored in
+*     the context and are only valid until the next call.
+* @p: Point to find.
+* @keys: Set to the key of each cell, POINT_HASH_MAX_CELLS long.
+* @hash_values: Set to the hash of each key, POINT_HASH_MAX_CELLS long.
+*
+* returns: Number of cells, from 1 to POINT_HASH_MAX_CELLS.
+*/
+int point_hash_cells(geometry_context_t* ctx, point_t* p, mp_limb_t** keys, unsigned* hash_values) {
+    signed char dx, dy;
+    size_t key_limbs;
+    int count = 1;
+    
+    assert(p != NULL);
+    _set_hash_id(p);
+    
+    keys[0] = p->hash_key;
+    hash_values[0] = p->hash_value;
+    
+    if (_hash_grid == 0) {
+        return count;
+    }
+    
+    dx = p->hash_near[0];
+    dy = p->hash_near[1];
+    
+    if (dx == 0 && dy == 0) {
+        return count;
+    }
+    
+    key_limbs = 2 * _hash_coord_limbs;
+    
+    if (ctx->probe_key == NULL) {
+        ctx->probe_key = malloc(sizeof(mp_limb_t) * key_limbs * (POINT_HASH_MAX_CELLS - 1));
+        global_exit_if_null(ctx->probe_key, "Fatal error calling malloc for probe_key.\n");
+    }
+    
+    if (dx != 0) {
+        keys[count] = ctx->probe_key + (key_limbs * (count - 1));
+        hash_values[count] = _set_neighbor_key(keys[count], p, dx, 0);
+        count++;
+    }
+    if (dy != 0) {
+        keys[count] = ctx->probe_key + (key_limbs * (count - 1));
+        hash_values[count] = _set_neighbor_key(keys[count], p, 0, dy);
+        count++;
+    }
+    if (dx != 0 && dy != 0) {
+        keys[count] = ctx->probe_key + (key_limbs * (count - 1));
+        hash_values[count] = _set_neighbor_key(keys[count], p, dx, dy);
+        count++;
+    }
+    
+    return count;
+}
+
+/*
+* Hash of the tile a point is in. Tiles are the unit squares of the
+* plane, the sign and integer part of the x,y values in the hash key,
+* so points close together are almost always in the same tile.
+*
+* @p: Point, point_ensure_hash must have been called.
+*
+* returns: hash of the tile.
+*/
+unsigned point_hash_tile(point_t* p) {
+    assert(p->hash_dirty == 0);
+    
+    return point_hash_tile_key(p->hash_key);
+}
+
+/*
+* Hash of the tile of a hash key, see point_hash_tile. With the hash
+* grid this is the tile of the cell, so it can be used for the keys
+* of the neighboring cells from point_hash_cells.
+*
+* @key: Hash key.
+*
+* returns: hash of the tile.
+*/
+unsigned point_hash_tile_key(mp_limb_t* key) {
+    mp_limb_t tile[2];
+    
+    tile[0] = key[_hash_coord_limbs - 1];
+    tile[1] = key[(2 * _hash_coord_limbs) - 1];
+    
+    return _hash_limbs(tile, 2);
+}
+
+/*
+* Makes sure that neither value is negative zero, which
+* would be written as "-0.000...".
+*
+* @p: Point to check.
+*/
+static void _set_zero_sign(point_t* p) {
     if (global_is_zero(p->x) == 1) {
         mpf_set(p->x, g_zero);
     }
     if (global_is_zero(p->y) == 1) {
         mpf_set(p->y, g_zero);
     }
+}
+
+/*
+* Checks if a fixed point value is within 2^-POINT_GRID_MARGIN_BITS of
+* a cell edge, from the bits just below the last kept bit.
+*
+* returns: -1 if close to the lower edge, 1 if close to the upper edge, otherwise 0.
+*/
+static signed char _near_edge(mp_limb_t* key) {
+    int zeros = 1;
+    int ones = 1;
+    size_t i;
+    
+    for (i=_hash_shift - POINT_GRID_MARGIN_BITS; i<_hash_shift; i++) {
+        if (((key[i / GMP_NUMB_BITS] >> (i % GMP_NUMB_BITS)) & 1) != 0) {
+            zeros = 0;
+        } else {
+            ones = 0;
+        }
+    }
+    
+    return zeros ? -1 : (ones ? 1 : 0);
+}
+
+/*
+* Sets the sign bit of a hash key value, unless it's zero.
+*/
+static void _set_hash_sign(mp_limb_t* key, int sign) {
+    size_t i;
+    
+    // Values that round to zero have no sign, so there's only one zero.
+    for (i=0; i<_hash_coord_limbs; i++) {
+        if (key[i] != 0) {
+            if (sign < 0) {
+                key[_hash_coord_limbs - 1] |= (mp_limb_t)1 << (GMP_NUMB_BITS - 1);
+            }
+            return;
+        }
+    }
+}
+
+/*
+* Rounds a value to the nearest multiple of 2^-_hash_coord_bits, as a
+* fixed point number. This reads the mpf limbs directly, so nothing is
+* allocated and no scratch values are needed.
+*
+* @key: _hash_coord_limbs limbs to store the value, least significant first.
+* @v: Value to round.
+*
+* returns: direction of the neighboring cell to check, see point_t.hash_near.
+*/
+static signed char _set_hash_coord(mp_limb_t* key, mpf_t v) {
+    mp_size_t n = v->_mp_size < 0 ? -v->_mp_size : v->_mp_size;
+    mp_size_t i, j;
+    size_t shift = _hash_shift;
+    signed char near;
+    
+    memset(key, 0, sizeof(mp_limb_t) * _hash_coord_limbs);
+    
+    // Limb i of v has weight B^(exp - n + i), limb j of the key
+    // has weight B^(j - _hash_frac_limbs).
+    for (i=0; i<n; i++) {
+        j = i + v->_mp_exp - n + (mp_size_t)_hash_frac_limbs;
+        
+        if (j < 0) {
+            continue;
+        }
+        
+        if (j >= (mp_size_t)_hash_coord_limbs) {
+            global_error_printf("Point value is too large for the hash key.\n");
+            exit(1);
+        }
+        
+        key[j] = v->_mp_d[i];
+    }
+    
+    // Round half away from zero, the bits below the last kept bit
+    // are then the position in the cell. Clear them after checking
+    // if the value is near the edge of the cell.
+    mpn_add_1(
+        key + ((shift - 1) / GMP_NUMB_BITS),
+        key + ((shift - 1) / GMP_NUMB_BITS),
+        _hash_coord_limbs - ((shift - 1) / GMP_NUMB_BITS),
+        (mp_limb_t)1 << ((shift - 1) % GMP_NUMB_BITS));
+    
+    near = _near_edge(key);
+    
+    for (i=0; i<(mp_size_t)(shift / GMP_NUMB_BITS); i++) {
+        key[i] = 0;
+    }
+    if (shift % GMP_NUMB_BITS != 0) {
+        key[shift / GMP_NUMB_BITS] &= ~(((mp_limb_t)1 << (shift % GMP_NUMB_BITS)) - 1);
+    }
+    
+    if ((key[_hash_coord_limbs - 1] >> (GMP_NUMB_BITS - 1)) != 0) {
+        global_error_printf("Point value is too large for the hash key.\n");
+        exit(1);
+    }
+    
+    _set_hash_sign(key, v->_mp_size);
+    
+    return near;
+}
+
+/*
+* Sets a hash key value to the neighboring cell, one cell toward or
+* away from zero.
+*
+* @key: _hash_coord_limbs limbs of the value to change.
+* @sign: Sign of the original value.
+* @direction: -1 toward zero, 1 away from zero.
+*/
+static void _set_hash_neighbor(mp_limb_t* key, int sign, signed char direction) {
+    size_t index = _hash_shift / GMP_NUMB_BITS;
+    mp_limb_t bit = (mp_limb_t)1 << (_hash_shift % GMP_NUMB_BITS);
+    
+    // clear the sign, work with the magnitude.
+    key[_hash_coord_limbs - 1] &= ~((mp_limb_t)1 << (GMP_NUMB_BITS - 1));
+    
+    if (direction > 0) {
+        mpn_add_1(key + index, key + index, _hash_coord_limbs - index, bit);
+    } else {
+        // Values in the zero cell are never near the edge toward zero.
+        mpn_sub_1(key + index, key + index, _hash_coord_limbs - index, bit);
+    }
+    
+    _set_hash_sign(key, sign);
+}
+
+/*
+* Mixes the limbs of a hash key into a hash value.
+*
+* returns: hash value.
+*/
+static unsigned _hash_limbs(mp_limb_t* key, size_t count) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    size_t i;
+    
+    for (i=0; i<count; i++) {
+        h ^= (uint64_t)key[i];
+        h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 31;
+    }
+    
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    
+    return (unsigned)h;
+}
+
+/*
+* Sets the hash key for the point.
+*
+* @p: Point to set hash key.
+*/
+static void _set_hash_id(point_t* p) {
+    
+    if (p->hash_dirty == 0) {
+        return;
+    }
+    
+    if (p->hash_key == NULL) {
+        p->hash_key = malloc(sizeof(mp_limb_t) * 2 * _hash_coord_limbs);
+        global_exit_if_null(p->hash_key, "Fatal error calling malloc for point_t->hash_key.\n");
+    }
+    
+    p->hash_near[0] = _set_hash_coord(p->hash_key, p->x);
+    p->hash_near[1] = _set_hash_coord(p->hash_key + _hash_coord_limbs, p->y);
+    
+    p->hash_key_length = sizeof(mp_limb_t) * 2 * _hash_coord_limbs;
+    p->hash_value = _hash_limbs(p->hash_key, 2 * _hash_coord_limbs);
+    
+    p->hash_dirty = 0;
+}
+
+/*
+* Sets str_x and str_y for the point.
+*
+* @p: Point to set strings.
+*/
+static void _set_str(point_t* p) {
+    
+    if (p->str_dirty == 0) {
+        return;
+    }
+    
+    _set_zero_sign(p);
+    
+    if (p->str_x == NULL) {
+        p->str_x = malloc(sizeof(char)*(_str_point_digits+1));
+        global_exit_if_null(p->str_x, "Fatal error calling malloc for point_t->str_x.\n");
+        
+        p->str_y = malloc(sizeof(char)*(_str_point_digits+1));
+        global_exit_if_null(p->str_y, "Fatal error calling malloc for point_t->str_y.\n");
+    }
     
     memset(p->str_x, 0, (_str_point_digits+1));
     memset(p->str_y, 0, (_str_point_digits+1));
-    memset(p->hash_key, 0, (_hash_all_digits+1));
     
     gmp_snprintf(p->str_x, _str_point_digits, "%.*Ff", _str_point_digits, p->x);
     gmp_snprintf(p->str_y, _str_point_digits, "%.*Ff", _str_point_digits, p->y);
-    gmp_snprintf(p->hash_key, _hash_all_digits, "%.*Ff,%.*Ff", _hash_coord_digits, p->x, _hash_coord_digits, p->y);
     
-    p->hash_key_length = strlen(p->hash_key);
+    p->str_dirty = 0;
+}
+
+/*
+* Determines the squared distance between two points.
+* This is point_distance without the square root.
+*
+* @ctx: Context holding scratch values.
+* @rop: Calculated squared distance between the points.
+* @p1: First point.
+* @p2: Second point.
+*/
+void point_distance_squared(geometry_context_t* ctx, mpf_t rop, point_t* p1, point_t* p2) {
+    point_scratch_t* s = &ctx->point;
     
-    p->hash_dirty = 0;
+    assert(p1 != NULL);
+    assert(p2 != NULL);
+    assert(p1->is_init == IS_INIT);
+    assert(p2->is_init == IS_INIT);
+    
+    if (p1 == p2) {
+        mpf_set(rop, g_zero);
+        return;
+    }
+    
+    // t1 = p1.x - p2.x;
+    mpf_sub(s->t1, p1->x, p2->x);
+    // t2 = t1 * t1;
+    mpf_mul(s->t2, s->t1, s->t1);
+    
+    // t3 = p1.y - p2.y;
+    mpf_sub(s->t3, p1->y, p2->y);
+    // t4 = t3 * t3;
+    mpf_mul(s->t4, s->t3, s->t3);
+    
+    // rop = t2 + t4;
+    mpf_add(rop, s->t2, s->t4);
 }
 
 /*
 * Determines the distance between two points.
 * The distance is unrounded in that there is no comparison to g_epsilon.
 *
+* @ctx: Context holding scratch values.
 * @rop: Calculated distance between the points.
 * @p1: First point.
 * @p2: Second point.
 */
-void point_distance(mpf_t rop, point_t* p1, point_t* p2) {
+void point_distance(geometry_context_t* ctx, mpf_t rop, point_t* p1, point_t* p2) {
+    point_scratch_t* s = &ctx->point;
+    
     assert(p1 != NULL);
     assert(p2 != NULL);
     assert(p1->is_init == IS_INIT);
@@ -317,42 +1472,51 @@ void point_distance(mpf_t rop, point_t* p1, point_t* p2) {
         return;
     }
     
-    // _t1 = p1.x - p2.x;
-    mpf_sub(_t1, p1->x, p2->x);
-    // _t2 = _t1 * _t1;
-    mpf_mul(_t2, _t1, _t1);
+    // t1 = p1.x - p2.x;
+    mpf_sub(s->t1, p1->x, p2->x);
+    // t2 = t1 * t1;
+    mpf_mul(s->t2, s->t1, s->t1);
     
-    // _t3 = p1.y - p2.y;
-    mpf_sub(_t3, p1->y, p2->y);
-    // _t4 = _t3 * _t3;
-    mpf_mul(_t4, _t3, _t3);
+    // t3 = p1.y - p2.y;
+    mpf_sub(s->t3, p1->y, p2->y);
+    // t4 = t3 * t3;
+    mpf_mul(s->t4, s->t3, s->t3);
     
-    // _t5 = _t2 + _t4;
-    mpf_add(_t5, _t2, _t4);
+    // t5 = t2 + t4;
+    mpf_add(s->t5, s->t2, s->t4);
     
-    mpf_sqrt(rop, _t5);
+    mpf_sqrt(rop, s->t5);
 }
 
 /*
 * Checks if two points are sufficiently close together to 
 * be considered the same point.
 *
+* @ctx: Context holding scratch values.
 * @p1: First point.
 * @p2: Second point.
 *
 * returns: 1 if the distance between the two points is less 
-*     than g_epsilon, 0 otherwise.
+*     than g_epsilon, 0 otherwise. Two rational points are only
+*     the same point if they're equal.
 */
-int point_equals(point_t* p1, point_t* p2) {
+int point_equals(geometry_context_t* ctx, point_t* p1, point_t* p2) {
     assert(p1 != NULL);
     assert(p2 != NULL);
 
     if (p1 == p2) {
         return 1;
     }
+    
+    if (p1->is_rational && p2->is_rational) {
+        return mpq_equal(p1->qx, p2->qx) && mpq_equal(p1->qy, p2->qy) ? 1 : 0;
+    }
 
-    point_distance(_t1, p1, p2);
-    return global_is_zero(_t1);
+    point_scratch_t* s = &ctx->point;
+    
+    // t6 isn't used by point_distance.
+    point_distance(ctx, s->t6, p1, p2);
+    return global_is_zero(s->t6);
 }
 
 /*
@@ -425,6 +1589,8 @@ int point_y_snprintf(char* buffer, size_t buffer_len, point_t* p, size_t n_digit
 /*
 * Sort method for uthash. Points are compared using global_compare2,
 * which will round if the difference is less than g_epsilon.
+* uthash doesn't pass any state to the sort method, so this uses
+* a context private to point.c and is not thread safe.
 *
 * @a: First point.
 * @b: Second point.
@@ -437,9 +1603,9 @@ int point_sort_function(void *a, void *b) {
     point_t* p1 = (point_t*)a;
     point_t* p2 = (point_t*)b;
     
-    int xcmp = global_compare2(p1->x, p2->x);
+    int xcmp = global_compare2(_sort_context, p1->x, p2->x);
     if (xcmp == 0) {
-        int ycmp = global_compare2(p1->y, p2->y);
+        int ycmp = global_compare2(_sort_context, p1->y, p2->y);
         return ycmp;
     }
     return xcmp;
@@ -13,12 +13,16 @@
 #include <stdint.h>
 
 #include "global.h"
-#include "uthash.h"
+#include "geometry_context.h"
 
 typedef struct point {
     // database id for point.
     int64_t point_id;
     
+    // Iteration the point was added to the working set, from
+    // points_working.iteration_origin.
+    uint8_t iteration_origin;
+    
     // x coordinate.
     mpf_t x;
     
@@ -26,45 +30,180 @@ typedef struct point {
     mpf_t y;
     
     // x coordinate as character buffer.
+    // Only allocated and set by point_ensure_str.
     char *str_x;
     
     // y coordinate as character buffer.
+    // Only allocated and set by point_ensure_str.
     char *str_y;
     
     // Whether or not this object has been initialized.
     int is_init;
     
-    // makes this structure hashable
-    UT_hash_handle hh;
+    // Binary key of the x,y coords, each rounded to a multiple of
+    // 2^-POINT_HASH_COORD_DIGITS, see point_ensure_hash. Points with the
+    // same key are the same point, keys are compared with memcmp.
+    // With the hash grid this is the key of the grid cell, see
+    // point_hash_cells.
+    // Only allocated and set by point_ensure_hash.
+    mp_limb_t *hash_key;
+    
+    // Hash of hash_key, see point_hash_cells.
+    unsigned hash_value;
     
-    // will be concatentation of x,y coord
-    char *hash_key;
+    // With the hash grid, whether the point is close enough to the edge
+    // of its cell that a point within g_epsilon could be in the next
+    // cell, for x and y. -1 for the cell toward zero, 1 for the cell
+    // away from zero, 0 if only this cell needs to be checked.
+    signed char hash_near[2];
     
     // Whether or not the hash key needs to be updated.
     char hash_dirty;
     
+    // Whether or not str_x and str_y need to be updated.
+    char str_dirty;
+    
     size_t hash_key_length;
     
     // Whether the point has been written to the datastore.
     // 0 if this is only in memory, 1 if it has been written.
     int in_datastore;
     
+    // Whether x,y are exactly qx,qy, see point_set_q.
+    char is_rational;
+    
+    // Whether qx and qy have been initialized. They're only
+    // initialized the first time the point is set to a rational value.
+    char q_init;
+    
+    // Exact x,y values, only used if is_rational is set.
+    mpq_t qx;
+    mpq_t qy;
+    
 } point_t;
 
+// Compact, fixed size record of a known point, see point_table.
+// A point_t is several hundred bytes with its mpf limbs, strings and
+// hash key, a record is about 100, a rational record also keeps its
+// fractions. The record owns the full point until the point has been
+// written to the datastore, then only the record is kept, see
+// point_record_compact.
+//
+// point_record_t.flags bit, set if the point is rational. Two rational
+// points are compared with the record's fractions exactly, see
+// point_record_equals.
+#define POINT_RECORD_RATIONAL 1
+
+// point_record_t.flags bits, set while a point near the edge of its
+// cell is checked against the neighboring cells, and if it was dropped
+// for a point added at the same time. See point_table_add.
+#define POINT_RECORD_PENDING 2
+#define POINT_RECORD_DROPPED 4
+
+typedef struct point_record {
+    // Full point, or NULL once the record is compacted.
+    point_t* point;
+    
+    // x then y of a rational point as reduced fractions, or NULL if
+    // the point isn't rational. Kept after the record is compacted.
+    mpq_t* q;
+    
+    // database id for point.
+    int64_t point_id;
+    
+    // Hash of the key of the point's own cell, see point_t.hash_value.
+    unsigned hash_value;
+    
+    // Number of times the point was found in a point table, up to
+    // POINT_TABLE_CLOCK_MAX. Lowered by one each time the eviction
+    // hand passes, the record is evicted when it reaches 0.
+    // See point_table_evict.
+    unsigned char clock_count;
+    
+    // With the hash grid, the sign of x and y.
+    signed char sign[2];
+    
+    // POINT_RECORD_ bits.
+    unsigned char flags;
+    
+    // Without the hash grid, the point's hash key, which is all that's
+    // compared. With the hash grid, the magnitude of x then y as fixed
+    // point values, at least 64 bits finer than g_epsilon, so records
+    // can be compared with point_equals rules. See point_record_size.
+    mp_limb_t limbs[];
+} point_record_t;
+
+// Most points kept on a context's free list, see point_release.
+#define POINT_FREE_LIST_MAX 64
+
+// With the hash grid, the cells are at least 2^POINT_GRID_MARGIN_BITS
+// times g_epsilon wide. Only points that close to the edge of their
+// cell need to check the next cell.
+#define POINT_GRID_MARGIN_BITS 8
+
+// Most cells a point equal to p could be in, p's own cell and
+// three neighbors, see point_hash_cells.
+#define POINT_HASH_MAX_CELLS 4
+
+// Bits of the rounding of a value read from a string that must be left
+// over after a fraction is found in it, see point_set_str_rounded.
+// Two fractions with denominators of n bits are at least 2^-2n apart,
+// so this makes it unlikely that a value that isn't the fraction is
+// rounded close enough to it.
+#define POINT_RATIONAL_MARGIN_BITS 32
+
 /*
 * Initializes some static variables.
 *
 * @str_point_digits: number of digits to use for each axis when storing point as string.
-* @point_hash_coord_digits: number of digits to use to for each x/y digit
-*                           to store point in memory.
+* @point_hash_coord_bits: number of bits right of the binary point kept
+*                         for each x/y value in the hash key.
+* @use_hash_grid: 1 to use the hash grid, so points closer than g_epsilon
+*                 are found by point_hash_cells. This can lower the number
+*                 of bits used. Must be called after global_init.
 */
-void global_point_init(size_t str_point_digits, size_t point_hash_coord_digits);
+void global_point_init(size_t str_point_digits, size_t point_hash_coord_bits, int use_hash_grid);
 
 /*
 * Frees memory used by static variables.
 */
 void global_point_free();
 
+/*
+* Turns on exact rational points. Points set from integers or decimal
+* strings keep their exact value as a fraction, and intersections of
+* rational points that are rational are calculated exactly. Points
+* that are both rational are compared exactly instead of with g_epsilon.
+*
+* @max_denominator_bits: Most bits in the denominator of a fraction found
+*     by point_set_str_rounded. 0 to leave exact rational points off.
+*/
+void point_rational_init(size_t max_denominator_bits);
+
+/*
+* Most bits in the denominator of a fraction found by
+* point_set_str_rounded, see point_rational_init.
+*
+* returns: number of bits, 0 if exact rational points are off.
+*/
+size_t point_rational_bits();
+
+/*
+* Whether or not the hash grid is used, see global_point_init.
+*
+* returns: 1 if the hash grid is used, otherwise 0.
+*/
+int point_hash_grid();
+
+/*
+* Number of bits right of the binary point kept for each x/y value
+* in the hash key. With the hash grid this can be less than the
+* number given to global_point_init.
+*
+* returns: number of bits.
+*/
+size_t point_hash_coord_bits();
+
 /*
 * Allocates memory for a new point.
 *
@@ -87,8 +226,39 @@ void point_init(point_t* p);
 void point_free(point_t* p);
 
 /*
-* Copies the x,y values from one point to another.
-* This updates the point's hash key.
+* Takes a point from the context's free list, or allocates and
+* initializes a new point if the list is empty. The value of the
+* point is not set.
+*
+* @ctx: Context holding the free list.
+*
+* returns: initialized point.
+*/
+point_t* point_take(geometry_context_t* ctx);
+
+/*
+* Gives a point from point_take (or point_alloc) back to the context's
+* free list, to be reused by point_take. The point must not be in a hash.
+* If the list is full the point is freed.
+*
+* @ctx: Context holding the free list.
+* @p: Point to release.
+*/
+void point_release(geometry_context_t* ctx, point_t* p);
+
+/*
+* Clears the datastore fields of a point so it can hold a new value,
+* such as an intersection kernel result. The x,y values are left as is,
+* the hash key and strings are updated when next needed.
+*
+* @p: Point to reset.
+*/
+void point_reset(point_t* p);
+
+/*
+* Copies the x,y values from one point to another, and the exact
+* values if it's rational.
+* The hash key and strings are only updated when next needed.
 *
 * @copy_to: Point that will get new x,y values.
 * @copy_from: Point x,y values are copied from.
@@ -106,7 +276,7 @@ point_t* point_clone(point_t* p);
 
 /*
 * Sets a point's x,y values via GMP parameter.
-* This updates the point's hash key.
+* The hash key and strings are only updated when next needed.
 *
 * @p: Point that will get new x,y values.
 * @x: x value.
@@ -116,7 +286,8 @@ void point_set(point_t* p, mpf_t x, mpf_t y);
 
 /*
 * Sets a point's x,y values via int.
-* This updates the point's hash key.
+* The hash key and strings are only updated when next needed.
+* With exact rational points, the values are kept exactly.
 *
 * @p: Point that will get new x,y values.
 * @x: x value.
@@ -126,7 +297,8 @@ void point_set_si(point_t* p, intmax_t x, intmax_t y);
 
 /*
 * Sets a point's x,y values from string.
-* This updates the point's hash key.
+* The hash key and strings are only updated when next needed.
+* With exact rational points, the decimal values are kept exactly.
 *
 * @p: Point that will get new x,y values.
 * @x: x value.
@@ -134,6 +306,45 @@ void point_set_si(point_t* p, intmax_t x, intmax_t y);
 */
 void point_set_str(point_t* p, const char *x, const char *y);
 
+/*
+* Sets a point's x,y values from strings rounded to a number of
+* digits, such as the strings of point_ensure_str read back from the
+* datastore. With exact rational points, if both values are within
+* the rounding of a fraction with a small enough denominator, the
+* point is set to the fractions, see POINT_RATIONAL_MARGIN_BITS.
+* The hash key and strings are only updated when next needed.
+*
+* @p: Point that will get new x,y values.
+* @x: x value.
+* @y: y value.
+*/
+void point_set_str_rounded(point_t* p, const char *x, const char *y);
+
+/*
+* Sets a point to fractions, if both x,y values are within their
+* rounding at the default mpf precision of a fraction with a small
+* enough denominator, the same as point_set_str_rounded. Used for
+* values kept at the mpf precision, such as the records of
+* point_runs_t. The hash key and strings are only updated when next
+* needed.
+*
+* @p: Point with values rounded from fractions.
+*
+* returns: 1 if the point was set to fractions, otherwise 0.
+*/
+int point_find_rational(point_t* p);
+
+/*
+* Sets a point to exact rational x,y values. The mpf values are
+* set from the fractions, so equal fractions always have the same
+* hash key. The hash key and strings are only updated when next needed.
+*
+* @p: Point that will get new x,y values.
+* @x: x value.
+* @y: y value.
+*/
+void point_set_q(point_t* p, mpq_t x, mpq_t y);
+
 /*
 * Sets the point's hash key. This is required
 * to be called before using the hash key.
@@ -142,27 +353,188 @@ void point_set_str(point_t* p, const char *x, const char *y);
 */
 void point_ensure_hash(point_t* p);
 
+/*
+* Finds the hash keys of the cells a point equal to p could be in.
+* The first cell is always p's own key. Without the hash grid that's
+* the only cell. With the hash grid, the neighboring cells p is close
+* to are included, points in these are compared with point_equals.
+* This finds points within g_epsilon of p even when they round to a
+* different key.
+*
+* @ctx: Context holding scratch values. Neighbor keys are stored in
+*     the context and are only valid until the next call.
+* @p: Point to find.
+* @keys: Set to the key of each cell, POINT_HASH_MAX_CELLS long.
+* @hash_values: Set to the hash of each key, POINT_HASH_MAX_CELLS long.
+*
+* returns: Number of cells, from 1 to POINT_HASH_MAX_CELLS.
+*/
+int point_hash_cells(geometry_context_t* ctx, point_t* p, mp_limb_t** keys, unsigned* hash_values);
+
+/*
+* Hash of the tile a point is in. Tiles are the unit squares of the
+* plane, the sign and integer part of the x,y values in the hash key,
+* so points close together are almost always in the same tile.
+*
+* @p: Point, point_ensure_hash must have been called.
+*
+* returns: hash of the tile.
+*/
+unsigned point_hash_tile(point_t* p);
+
+/*
+* Hash of the tile of a hash key, see point_hash_tile. With the hash
+* grid this is the tile of the cell, so it can be used for the keys
+* of the neighboring cells from point_hash_cells.
+*
+* @key: Hash key.
+*
+* returns: hash of the tile.
+*/
+unsigned point_hash_tile_key(mp_limb_t* key);
+
+/*
+* Sets the point's str_x and str_y. This is required
+* to be called before using the strings.
+*
+* @p: Point to update strings.
+*/
+void point_ensure_str(point_t* p);
+
+/*
+* Allocates a record of a point. The record owns the point after this.
+*
+* @p: Point with the hash key set, see point_ensure_hash.
+*
+* returns: pointer to new record.
+*/
+point_record_t* point_record_alloc(point_t* p);
+
+/*
+* Frees the record, and the full point if it still has one.
+*
+* @r: Record to free.
+*/
+void point_record_free(point_record_t* r);
+
+/*
+* Frees the full point of a record, keeping only the record.
+* The point must have been written to the datastore.
+*
+* @r: Record to compact.
+*/
+void point_record_compact(point_record_t* r);
+
+/*
+* Compares a record to a point. A rational point is only the same as
+* a rational record if it has the record's fractions. Otherwise without
+* the hash grid the record is the same point if it has the key, and
+* with the hash grid the record's values are compared to the point as
+* in point_equals. The full point isn't used, so this is the same
+* before and after the record is compacted.
+*
+* @ctx: Context holding scratch values.
+* @r: Record.
+* @p: Point.
+* @key: Key of the cell being searched, p's key or a neighbor's.
+*
+* returns: 1 if they're the same point, otherwise 0.
+*/
+int point_record_equals(geometry_context_t* ctx, point_record_t* r, point_t* p, mp_limb_t* key);
+
+/*
+* Number of bytes in each record, including the limbs.
+*
+* returns: number of bytes.
+*/
+size_t point_record_size();
+
+/*
+* Sets a fixed point value to the magnitude of v, with one integer
+* limb and the rest fraction limbs. Bits below the last limb are
+* dropped.
+*
+* @limbs: Fixed point value, least significant limb first.
+* @limb_count: Number of limbs, at least 2.
+* @v: Value.
+*
+* returns: sign of v.
+*/
+signed char point_set_fixed(mp_limb_t* limbs, size_t limb_count, mpf_t v);
+
+/*
+* Sets an mpf value from a fixed point value, see point_set_fixed.
+*
+* @rop: Set to the value.
+* @limbs: Fixed point value.
+* @limb_count: Number of limbs.
+* @sign: Sign of the value.
+*/
+void point_get_fixed(mpf_t rop, mp_limb_t* limbs, size_t limb_count, signed char sign);
+
+/*
+* Number of limbs in the sort key of each x,y value, see point_sort_key.
+*
+* returns: number of limbs.
+*/
+size_t point_sort_key_limbs();
+
+/*
+* Sets the sort key of a point, the cell of x then the cell of y.
+* The hash key values are sign and magnitude, a sort key value is the
+* cell plus 2^(bits - 1) so that comparing values as unsigned numbers
+* (mpn_cmp) orders them the same as the cells.
+*
+* @p: Point.
+* @key: Sort key, 2 * point_sort_key_limbs long.
+*/
+void point_sort_key(point_t* p, mp_limb_t* key);
+
+/*
+* Number of cells from one sort key value to another.
+*
+* @a: Sort key value, point_sort_key_limbs long.
+* @b: Sort key value.
+*
+* returns: b - a in cells, -2 if it's -2 or less, 2 if it's 2 or more.
+*/
+int point_sort_key_step(mp_limb_t* a, mp_limb_t* b);
+
+/*
+* Determines the squared distance between two points.
+* This is point_distance without the square root.
+*
+* @ctx: Context holding scratch values.
+* @rop: Calculated squared distance between the points.
+* @p1: First point.
+* @p2: Second point.
+*/
+void point_distance_squared(geometry_context_t* ctx, mpf_t rop, point_t* p1, point_t* p2);
+
 /*
 * Determines the distance between two points.
 * The distance is unrounded in that there is no comparison to g_epsilon.
 *
+* @ctx: Context holding scratch values.
 * @rop: Calculated distance between the points.
 * @p1: First point.
 * @p2: Second point.
 */
-void point_distance(mpf_t rop, point_t* p1, point_t* p2);
+void point_distance(geometry_context_t* ctx, mpf_t rop, point_t* p1, point_t* p2);
 
 /*
 * Checks if two points are sufficiently close together to 
 * be considered the same point.
 *
+* @ctx: Context holding scratch values.
 * @p1: First point.
 * @p2: Second point.
 *
 * returns: 1 if the distance between the two points is less 
-*     than g_epsilon, 0 otherwise.
+*     than g_epsilon, 0 otherwise. Two rational points are only
+*     the same point if they're equal.
 */
-int point_equals(point_t* p1, point_t* p2);
+int point_equals(geometry_context_t* ctx, point_t* p1, point_t* p2);
 
 /*
 * Writes the point to stdout in "the usual way."
@@ -194,6 +566,8 @@ void point_fprintf(FILE* fp, point_t* p, size_t n_digits);
 /*
 * Sort method for uthash. Points are compared using global_compare2,
 * which will round if the difference is less than g_epsilon.
+* uthash doesn't pass any state to the sort method, so this uses
+* a context private to point.c and is not thread safe.
 *
 * @a: First point.
 * @b: Second point.
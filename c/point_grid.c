@@ -0,0 +1,345 @@
+/*
+* Grid of known points, used to tell if a point found by the low
+* precision pass of an intersection is already known.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "double_double.h"
+#include "point.h"
+#include "point_grid.h"
+
+// Cells are only found for points with a cell index less than this.
+#define POINT_GRID_MAX_CELL 4611686018427387904.0
+
+/*
+* Bucket of a cell.
+*/
+static size_t _bucket(point_grid_t* grid, int64_t cx, int64_t cy) {
+    uint64_t h = (uint64_t)cx * 0x9E3779B97F4A7C15ULL;
+    
+    h ^= (uint64_t)cy * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 29;
+    
+    return (size_t)h & (grid->bucket_count - 1);
+}
+
+/*
+* Rounding of a low precision point, from the larger of its coordinates.
+*/
+static double _rounding(point_grid_t* grid, dd_t* x, dd_t* y) {
+    double m = 1;
+    int e;
+    
+    if (fabs(x->hi) > m) {
+        m = fabs(x->hi);
+    }
+    
+    if (fabs(y->hi) > m) {
+        m = fabs(y->hi);
+    }
+    
+    // m < 2^e
+    frexp(m, &e);
+    
+    return ldexp(grid->rounding, e);
+}
+
+/*
+* Cell of a coordinate, floor(v / cell_width) of the double-double value.
+*/
+static int64_t _cell(point_grid_t* grid, dd_t* v) {
+    // Dividing by a power of 2 is exact.
+    double hi = v->hi / grid->cell_width;
+    double f = floor(hi);
+    
+    if (f == hi && v->lo < 0) {
+        f -= 1;
+    }
+    
+    return (int64_t)f;
+}
+
+/*
+* Searches the cells around a point for points in the grid within the
+* guard band of it.
+*
+* @x: Point x.
+* @y: Point y.
+* @radius: Distance to count points within, no more than the band.
+* @within_radius: Set to the number of points within radius.
+* @within_band: Set to the number of points within the band but
+*     further than radius.
+*
+* returns: 1 if the cells were searched, 0 if the point is too far
+*     from the origin to find its cells.
+*/
+static int _search(point_grid_t* grid, dd_t* x, dd_t* y, double radius, int* within_radius, int* within_band) {
+    dd_t reach;
+    int64_t low[2], high[2];
+    int64_t cx, cy;
+    point_grid_entry_t* entry;
+    dd_t dx, dy, d2, t;
+    
+    *within_radius = 0;
+    *within_band = 0;
+    
+    if (fabs(x->hi) / grid->cell_width >= POINT_GRID_MAX_CELL
+        || fabs(y->hi) / grid->cell_width >= POINT_GRID_MAX_CELL) {
+        return 0;
+    }
+    
+    // reach covers the rounding of x - band and x + band.
+    dd_set_d(&reach, grid->band + (fabs(x->hi) + fabs(y->hi) + grid->band) * ldexp(1, -100));
+    
+    dd_sub(&t, x, &reach);
+    low[0] = _cell(grid, &t);
+    dd_add(&t, x, &reach);
+    high[0] = _cell(grid, &t);
+    dd_sub(&t, y, &reach);
+    low[1] = _cell(grid, &t);
+    dd_add(&t, y, &reach);
+    high[1] = _cell(grid, &t);
+    
+    for (cx = low[0]; cx <= high[0]; cx++) {
+        for (cy = low[1]; cy <= high[1]; cy++) {
+            entry = __atomic_load_n(&grid->buckets[_bucket(grid, cx, cy)], __ATOMIC_ACQUIRE);
+    
+            for (; entry != NULL; entry = entry->next) {
+                if (entry->cell[0] != cx || entry->cell[1] != cy) {
+                    continue;
+                }
+    
+                // d2 => (x - entry.x)^2 + (y - entry.y)^2
+                dd_sub(&dx, x, &entry->x);
+                dd_sub(&dy, y, &entry->y);
+                dd_mul(&d2, &dx, &dx);
+                dd_mul(&t, &dy, &dy);
+                dd_add(&d2, &d2, &t);
+    
+                if (d2.hi <= radius * radius) {
+                    (*within_radius)++;
+                } else if (d2.hi <= grid->band_squared) {
+                    (*within_band)++;
+                }
+            }
+        }
+    }
+    
+    return 1;
+}
+
+/*
+* Allocates memory for a new point grid.
+*
+* returns: pointer to new point grid.
+*/
+point_grid_t* point_grid_alloc() {
+    point_grid_t* grid = malloc(sizeof(point_grid_t));
+    global_exit_if_null(grid, "Fatal error calling malloc for point_grid_t.\n");
+    memset(grid, 0, sizeof(point_grid_t));
+    
+    return grid;
+}
+
+/*
+* Initializes new point grid. Must be called before use. The guard
+* band should be checked with global_guard_band_valid.
+*
+* @grid: Point grid to initialize.
+* @capacity: Most points to hold, at least POINT_GRID_MIN_CAPACITY.
+* @precision: Precision in bits of the low precision pass.
+* @str_guard_band: Width of the guard band.
+*/
+void point_grid_init(point_grid_t* grid, size_t capacity, mp_bitcnt_t precision, char* str_guard_band) {
+    mpf_t band;
+    int e;
+    
+    if (grid->is_init == IS_INIT) {
+        return;
+    }
+    
+    if (capacity < POINT_GRID_MIN_CAPACITY) {
+        capacity = POINT_GRID_MIN_CAPACITY;
+    }
+    
+    if (precision > DD_PRECISION_BITS) {
+        precision = DD_PRECISION_BITS;
+    }
+    
+    // About one bucket per point.
+    grid->bucket_count = 1;
+    while (grid->bucket_count < capacity) {
+        grid->bucket_count <<= 1;
+    }
+    
+    // calloc, so the pages of an unused block are never touched.
+    grid->buckets = calloc(grid->bucket_count, sizeof(point_grid_entry_t*));
+    global_exit_if_null(grid->buckets, "Fatal error calling calloc for point grid buckets.\n");
+    
+    grid->entries = calloc(capacity, sizeof(point_grid_entry_t));
+    global_exit_if_null(grid->entries, "Fatal error calling calloc for point grid entries.\n");
+    
+    grid->capacity = capacity;
+    grid->count = 0;
+    
+    mpf_init_set_str(band, str_guard_band, 10);
+    grid->band = mpf_get_d(band);
+    mpf_clear(band);
+    
+    grid->band_squared = grid->band * grid->band;
+    
+    // cell_width => 2^e >= band
+    frexp(grid->band, &e);
+    grid->cell_width = ldexp(1, e);
+    if (grid->cell_width / 2 >= grid->band) {
+        grid->cell_width /= 2;
+    }
+    
+    grid->rounding = ldexp(1, GUARD_BAND_MARGIN_BITS - (int)precision);
+    
+    grid->is_init = IS_INIT;
+}
+
+/*
+* Frees the point grid and all the entries in it.
+*
+* @grid: Point grid to free.
+*/
+void point_grid_free(point_grid_t* grid) {
+    if (grid == NULL) {
+        return;
+    }
+    
+    if (grid->is_init == IS_INIT) {
+        free(grid->buckets);
+        grid->buckets = NULL;
+    
+        free(grid->entries);
+        grid->entries = NULL;
+    }
+    
+    free(grid);
+}
+
+/*
+* Number of points in the grid.
+*
+* @grid: Point grid.
+*
+* returns: number of points.
+*/
+size_t point_grid_count(point_grid_t* grid) {
+    size_t count = __atomic_load_n(&grid->count, __ATOMIC_ACQUIRE);
+    
+    return count < grid->capacity ? count : grid->capacity;
+}
+
+/*
+* Adds a point found at full precision, unless a point within the
+* low precision rounding of it is already in the grid. Safe to call
+* from several threads at once, two threads adding the same point at
+* the same time can both add it.
+*
+* @grid: Point grid to add to.
+* @p: Point to add, it isn't kept.
+*/
+void point_grid_add(point_grid_t* grid, point_t* p) {
+    point_grid_entry_t* entry;
+    point_grid_entry_t** bucket;
+    dd_t x, y;
+    double radius;
+    int within_radius, within_band;
+    size_t index;
+    
+    if (__atomic_load_n(&grid->count, __ATOMIC_ACQUIRE) >= grid->capacity) {
+        return;
+    }
+    
+    dd_set_mpf(&x, p->x);
+    dd_set_mpf(&y, p->y);
+    
+    // point_grid_known doesn't search for points this far from the origin.
+    radius = _rounding(grid, &x, &y);
+    if (radius >= grid->band) {
+        return;
+    }
+    
+    if (_search(grid, &x, &y, radius, &within_radius, &within_band) == 0
+        || within_radius > 0) {
+        return;
+    }
+    
+    index = __atomic_fetch_add(&grid->count, 1, __ATOMIC_ACQ_REL);
+    if (index >= grid->capacity) {
+        return;
+    }
+    
+    entry = &grid->entries[index];
+    entry->x = x;
+    entry->y = y;
+    entry->cell[0] = _cell(grid, &x);
+    entry->cell[1] = _cell(grid, &y);
+    
+    bucket = &grid->buckets[_bucket(grid, entry->cell[0], entry->cell[1])];
+    entry->next = __atomic_load_n(bucket, __ATOMIC_ACQUIRE);
+    
+    while (__atomic_compare_exchange_n(bucket, &entry->next, entry, 1, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE) == 0) {
+        // entry->next was set to the new front of the bucket, try again.
+    }
+}
+
+/*
+* Checks if points found by the low precision pass are already known.
+* A point is known if a point in the grid is within its rounding, and
+* every point in the grid within the guard band of it is also within
+* its rounding. Safe to call from several threads at once.
+*
+* @grid: Point grid to search.
+* @points: Points found at low precision.
+* @count: Number of points.
+*
+* returns: 1 if every point is known, -1 if any point is within the
+*     guard band of a point in the grid but not known, or if the
+*     rounding of a point is more than the guard band, otherwise 0.
+*/
+int point_grid_known(point_grid_t* grid, point_t** points, int count) {
+    dd_t x, y;
+    double radius;
+    int within_radius, within_band;
+    int result = 1;
+    int i;
+    
+    for (i = 0; i < count; i++) {
+        dd_set_mpf(&x, points[i]->x);
+        dd_set_mpf(&y, points[i]->y);
+    
+        radius = _rounding(grid, &x, &y);
+    
+        // Points this far from the origin can't be told apart from
+        // their neighbors at low precision.
+        if (radius >= grid->band) {
+            return -1;
+        }
+    
+        if (_search(grid, &x, &y, radius, &within_radius, &within_band) == 0
+            || within_band > 0) {
+            return -1;
+        }
+    
+        if (within_radius == 0) {
+            result = 0;
+        }
+    }
+    
+    return result;
+}
@@ -0,0 +1,131 @@
+/*
+* Grid of known points, used to tell if a point found by the low
+* precision pass of an intersection is already known.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __POINT_GRID_H__
+#define __POINT_GRID_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "double_double.h"
+#include "point.h"
+
+// Fewest points the grid is made to hold.
+#define POINT_GRID_MIN_CAPACITY 1024
+
+// Point in the grid, as double-double values.
+typedef struct point_grid_entry {
+    // Next entry in the same bucket.
+    struct point_grid_entry* next;
+    
+    // Cell of the point, floor(x / cell_width), floor(y / cell_width).
+    int64_t cell[2];
+    
+    dd_t x;
+    dd_t y;
+} point_grid_entry_t;
+
+// Known points, hashed by the square cell they're in. The cells are at
+// least as wide as the guard band, so the points within the band of a
+// point are in its cell or the cells around it.
+//
+// Entries are taken from one block and pushed onto the front of their
+// bucket with a compare and swap, so threads can add and search at the
+// same time without a lock. Entries are never removed. Once the block
+// is used up no more points are added, points that aren't in the grid
+// are only calculated again at full precision.
+typedef struct point_grid {
+    point_grid_entry_t** buckets;
+    
+    // Number of buckets, a power of 2.
+    size_t bucket_count;
+    
+    point_grid_entry_t* entries;
+    
+    // Number of entries in the block, and number used.
+    size_t capacity;
+    size_t count;
+    
+    // Width of the guard band, and its square.
+    double band;
+    double band_squared;
+    
+    // Width of a cell, the smallest power of 2 at least band.
+    double cell_width;
+    
+    // 2^(GUARD_BAND_MARGIN_BITS - precision). A low precision point
+    // with coordinates less than 2^e is within rounding * 2^e of its
+    // full precision value.
+    double rounding;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} point_grid_t;
+
+/*
+* Allocates memory for a new point grid.
+*
+* returns: pointer to new point grid.
+*/
+point_grid_t* point_grid_alloc();
+
+/*
+* Initializes new point grid. Must be called before use. The guard
+* band should be checked with global_guard_band_valid.
+*
+* @grid: Point grid to initialize.
+* @capacity: Most points to hold, at least POINT_GRID_MIN_CAPACITY.
+* @precision: Precision in bits of the low precision pass.
+* @str_guard_band: Width of the guard band.
+*/
+void point_grid_init(point_grid_t* grid, size_t capacity, mp_bitcnt_t precision, char* str_guard_band);
+
+/*
+* Frees the point grid and all the entries in it.
+*
+* @grid: Point grid to free.
+*/
+void point_grid_free(point_grid_t* grid);
+
+/*
+* Number of points in the grid.
+*
+* @grid: Point grid.
+*
+* returns: number of points.
+*/
+size_t point_grid_count(point_grid_t* grid);
+
+/*
+* Adds a point found at full precision, unless a point within the
+* low precision rounding of it is already in the grid. Safe to call
+* from several threads at once, two threads adding the same point at
+* the same time can both add it.
+*
+* @grid: Point grid to add to.
+* @p: Point to add, it isn't kept.
+*/
+void point_grid_add(point_grid_t* grid, point_t* p);
+
+/*
+* Checks if points found by the low precision pass are already known.
+* A point is known if a point in the grid is within its rounding, and
+* every point in the grid within the guard band of it is also within
+* its rounding. Safe to call from several threads at once.
+*
+* @grid: Point grid to search.
+* @points: Points found at low precision.
+* @count: Number of points.
+*
+* returns: 1 if every point is known, -1 if any point is within the
+*     guard band of a point in the grid but not known, or if the
+*     rounding of a point is more than the guard band, otherwise 0.
+*/
+int point_grid_known(point_grid_t* grid, point_t** points, int count);
+
+#endif
@@ -0,0 +1,706 @@
+/*
+* Candidate points sorted in run files on disk and merged into unique points.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "point.h"
+#include "point_runs.h"
+
+// Longest path of a file written by the runs.
+#define RUNS_PATH_MAX 4096
+
+// Layout of the records being sorted, qsort doesn't pass these to the
+// compare function. Every point_runs_t has the same layout, this is
+// set by point_runs_init.
+static size_t _sort_key_limbs = 0;
+static size_t _sort_record_limbs = 0;
+
+/*
+* Orders records by x cell, then y cell, then the rest of the record
+* so that sorting gives the same order every time.
+*/
+static int _record_cmp(const void* a, const void* b) {
+    const mp_limb_t* ra = (const mp_limb_t*)a;
+    const mp_limb_t* rb = (const mp_limb_t*)b;
+    int cmp;
+    
+    cmp = mpn_cmp(ra, rb, _sort_key_limbs);
+    if (cmp != 0) {
+        return cmp;
+    }
+    
+    cmp = mpn_cmp(ra + _sort_key_limbs, rb + _sort_key_limbs, _sort_key_limbs);
+    if (cmp != 0) {
+        return cmp;
+    }
+    
+    return memcmp(ra + 2 * _sort_key_limbs, rb + 2 * _sort_key_limbs, sizeof(mp_limb_t) * (_sort_record_limbs - 2 * _sort_key_limbs));
+}
+
+/*
+* Sets a record from a point.
+*/
+static void _record_set(point_runs_t* runs, mp_limb_t* record, point_t* p) {
+    mp_limb_t* values = record + 2 * runs->key_limbs;
+    signed char sign_x;
+    signed char sign_y;
+    
+    point_sort_key(p, record);
+    
+    sign_x = point_set_fixed(values, runs->value_limbs, p->x);
+    sign_y = point_set_fixed(values + runs->value_limbs, runs->value_limbs, p->y);
+    
+    // Signs are stored as 0, 1, 2 in the low two bytes of the last limb,
+    // and whether the point is rational in the third byte.
+    record[runs->record_limbs - 1] = (mp_limb_t)(sign_x + 1) | ((mp_limb_t)(sign_y + 1) << 8)
+        | ((mp_limb_t)(p->is_rational ? 1 : 0) << 16);
+}
+
+/*
+* Sets a point from a record. The fractions of a rational point aren't
+* in the record, they're found again from the values, see
+* point_find_rational.
+*/
+static void _record_get(point_runs_t* runs, mp_limb_t* record, point_t* p) {
+    mp_limb_t* values = record + 2 * runs->key_limbs;
+    mp_limb_t signs = record[runs->record_limbs - 1];
+    
+    point_get_fixed(p->x, values, runs->value_limbs, (signed char)(signs & 0xff) - 1);
+    point_get_fixed(p->y, values + runs->value_limbs, runs->value_limbs, (signed char)((signs >> 8) & 0xff) - 1);
+    
+    point_reset(p);
+    
+    if ((signs >> 16) & 1) {
+        point_find_rational(p);
+    }
+}
+
+/*
+* Sets the path of a run file, or of the unique points if index
+* is SIZE_MAX.
+*/
+static void _file_path(point_runs_t* runs, size_t index, char* path) {
+    int n;
+    
+    if (index == SIZE_MAX) {
+        n = snprintf(path, RUNS_PATH_MAX, "%s/unique.run", runs->directory);
+    } else {
+        n = snprintf(path, RUNS_PATH_MAX, "%s/run_%zu.run", runs->directory, index);
+    }
+    
+    if (n < 0 || n >= RUNS_PATH_MAX) {
+        global_error_printf("External dedup directory name is too long: %s\n", runs->directory);
+        exit(1);
+    }
+}
+
+/*
+* Opens a file, or exits with an error.
+*/
+static FILE* _file_open(const char* path, const char* mode) {
+    FILE* fp = fopen(path, mode);
+    
+    if (fp == NULL) {
+        global_error_printf("Fatal error opening external dedup file %s\n", path);
+        exit(1);
+    }
+    
+    return fp;
+}
+
+/*
+* Writes records to a file, or exits with an error.
+*/
+static void _file_write(point_runs_t* runs, FILE* fp, mp_limb_t* records, size_t count) {
+    if (fwrite(records, sizeof(mp_limb_t) * runs->record_limbs, count, fp) != count) {
+        global_error_printf("Fatal error writing external dedup file.\n");
+        exit(1);
+    }
+}
+
+/*
+* Opens a file of records to read, holding up to capacity records at a time.
+*/
+static void _reader_open(point_runs_t* runs, point_run_reader_t* reader, const char* path, size_t capacity) {
+    reader->fp = _file_open(path, "rb");
+    
+    reader->records = malloc(sizeof(mp_limb_t) * runs->record_limbs * capacity);
+    global_exit_if_null(reader->records, "Fatal error calling malloc for point_run_reader_t records.\n");
+    
+    reader->capacity = capacity;
+    reader->count = 0;
+    reader->position = 0;
+}
+
+/*
+* Closes the file, if open, and frees the records.
+*/
+static void _reader_close(point_run_reader_t* reader) {
+    if (reader->fp != NULL) {
+        fclose(reader->fp);
+        reader->fp = NULL;
+    }
+    
+    if (reader->records != NULL) {
+        free(reader->records);
+        reader->records = NULL;
+    }
+    
+    reader->count = 0;
+    reader->position = 0;
+}
+
+/*
+* Gets the current record, reading more from the file if needed.
+*
+* returns: current record, or NULL at the end of the file.
+*/
+static mp_limb_t* _reader_current(point_runs_t* runs, point_run_reader_t* reader) {
+    if (reader->position == reader->count) {
+        if (reader->fp == NULL) {
+            return NULL;
+        }
+        
+        reader->count = fread(reader->records, sizeof(mp_limb_t) * runs->record_limbs, reader->capacity, reader->fp);
+        reader->position = 0;
+        
+        if (reader->count == 0) {
+            if (ferror(reader->fp)) {
+                global_error_printf("Fatal error reading external dedup file.\n");
+                exit(1);
+            }
+            
+            return NULL;
+        }
+    }
+    
+    return reader->records + reader->position * runs->record_limbs;
+}
+
+/*
+* Sorts a producer's buffer and writes it as a run file.
+*/
+static void _write_run(point_runs_t* runs, size_t producer) {
+    char path[RUNS_PATH_MAX];
+    size_t count = runs->buffer_count[producer];
+    size_t index;
+    FILE* fp;
+    
+    if (count == 0) {
+        return;
+    }
+    
+    qsort(runs->buffers[producer], count, sizeof(mp_limb_t) * runs->record_limbs, _record_cmp);
+    
+    index = __atomic_fetch_add(&runs->run_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&runs->total_runs, 1, __ATOMIC_RELAXED);
+    
+    _file_path(runs, index, path);
+    fp = _file_open(path, "wb");
+    _file_write(runs, fp, runs->buffers[producer], count);
+    fclose(fp);
+    
+    runs->buffer_count[producer] = 0;
+}
+
+/*
+* Appends a record to the current column, growing it if needed.
+*/
+static void _column_add(point_runs_t* runs, mp_limb_t* record) {
+    if (runs->column_count == runs->column_capacity) {
+        runs->column_capacity = runs->column_capacity == 0 ? 64 : runs->column_capacity * 2;
+        runs->column = realloc(runs->column, sizeof(mp_limb_t) * runs->record_limbs * runs->column_capacity);
+        global_exit_if_null(runs->column, "Fatal error calling realloc for point_runs_t column.\n");
+    }
+    
+    memcpy(runs->column + runs->column_count * runs->record_limbs, record, sizeof(mp_limb_t) * runs->record_limbs);
+    runs->column_count++;
+}
+
+/*
+* Compares a column record to the record being merged, which is set
+* in p1 the first time it's needed. Points are compared as they're
+* read back, so two rational points are only the same if they have
+* the same fractions, as in point_record_equals.
+*/
+static int _record_equals(point_runs_t* runs, geometry_context_t* ctx, mp_limb_t* entry, mp_limb_t* record, int* is_set) {
+    if (*is_set == 0) {
+        _record_get(runs, record, runs->p1);
+        *is_set = 1;
+    }
+    
+    _record_get(runs, entry, runs->p2);
+    
+    return point_equals(ctx, runs->p1, runs->p2);
+}
+
+/*
+* Determines whether the record being merged is the same point as a
+* unique record already written. Records come in sorted order, so the
+* only records that can be within one cell are in the current column
+* or the one before it.
+*
+* returns: 1 if the record is a duplicate, otherwise 0.
+*/
+static int _is_duplicate(point_runs_t* runs, geometry_context_t* ctx, mp_limb_t* record) {
+    size_t key_limbs = runs->key_limbs;
+    size_t record_limbs = runs->record_limbs;
+    mp_limb_t* swap;
+    mp_limb_t* entry;
+    size_t capacity;
+    size_t i;
+    int step;
+    int is_set = 0;
+    
+    if (point_hash_grid() == 0) {
+        if (runs->column_count == 0 || memcmp(runs->column, record, sizeof(mp_limb_t) * 2 * key_limbs) != 0) {
+            return 0;
+        }
+        
+        // Rational points with the same key are only the same if they
+        // have the same fractions, as in point_record_equals.
+        if ((record[record_limbs - 1] >> 16) & (runs->column[record_limbs - 1] >> 16) & 1) {
+            _record_get(runs, record, runs->p1);
+            _record_get(runs, runs->column, runs->p2);
+            
+            if (runs->p1->is_rational && runs->p2->is_rational) {
+                return point_equals(ctx, runs->p1, runs->p2);
+            }
+        }
+        
+        return 1;
+    }
+    
+    // Move the columns along to the record's x cell.
+    step = runs->has_column ? point_sort_key_step(runs->column_key, record) : 2;
+    
+    if (step == 1) {
+        swap = runs->previous;
+        runs->previous = runs->column;
+        runs->column = swap;
+        
+        capacity = runs->previous_capacity;
+        runs->previous_capacity = runs->column_capacity;
+        runs->column_capacity = capacity;
+        
+        runs->previous_count = runs->column_count;
+        runs->previous_position = 0;
+        runs->column_count = 0;
+    } else if (step != 0) {
+        runs->previous_count = 0;
+        runs->previous_position = 0;
+        runs->column_count = 0;
+    }
+    
+    memcpy(runs->column_key, record, sizeof(mp_limb_t) * key_limbs);
+    runs->has_column = 1;
+    
+    // Same column, newest first, until the y cell is two or more below.
+    for (i=runs->column_count; i>0; i--) {
+        entry = runs->column + (i - 1) * record_limbs;
+        
+        if (point_sort_key_step(entry + key_limbs, record + key_limbs) >= 2) {
+            break;
+        }
+        
+        if (_record_equals(runs, ctx, entry, record, &is_set)) {
+            return 1;
+        }
+    }
+    
+    // Column before, y cells one below to one above. Records that are
+    // too far below can be skipped for the rest of the column.
+    while (runs->previous_position < runs->previous_count) {
+        entry = runs->previous + runs->previous_position * record_limbs;
+        
+        if (point_sort_key_step(entry + key_limbs, record + key_limbs) < 2) {
+            break;
+        }
+        
+        runs->previous_position++;
+    }
+    
+    for (i=runs->previous_position; i<runs->previous_count; i++) {
+        entry = runs->previous + i * record_limbs;
+        
+        if (point_sort_key_step(record + key_limbs, entry + key_limbs) >= 2) {
+            break;
+        }
+        
+        if (_record_equals(runs, ctx, entry, record, &is_set)) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/*
+* Moves a reader down the heap until it's in order.
+*/
+static void _heap_down(size_t* heap, mp_limb_t** heads, size_t count, size_t position) {
+    size_t child;
+    size_t reader;
+    
+    while (1) {
+        child = 2 * position + 1;
+        
+        if (child >= count) {
+            break;
+        }
+        
+        if (child + 1 < count && _record_cmp(heads[heap[child + 1]], heads[heap[child]]) < 0) {
+            child++;
+        }
+        
+        if (_record_cmp(heads[heap[child]], heads[heap[position]]) >= 0) {
+            break;
+        }
+        
+        reader = heap[position];
+        heap[position] = heap[child];
+        heap[child] = reader;
+        position = child;
+    }
+}
+
+/*
+* Allocates memory for new runs.
+*
+* returns: pointer to new runs.
+*/
+point_runs_t* point_runs_alloc() {
+    point_runs_t* runs = malloc(sizeof(point_runs_t));
+    global_exit_if_null(runs, "Fatal error calling malloc for point_runs_t.\n");
+    
+    memset(runs, 0, sizeof(point_runs_t));
+    
+    return runs;
+}
+
+/*
+* Initializes new runs. Must be called after global_point_init and
+* before use.
+*
+* @runs: Runs to initialize.
+* @directory: Existing directory to write files in.
+* @producer_count: Number of threads that add points.
+* @memory_bytes: Memory budget for buffered records.
+*/
+void point_runs_init(point_runs_t* runs, const char* directory, size_t producer_count, size_t memory_bytes) {
+    size_t record_bytes;
+    
+    if (runs->is_init == IS_INIT) {
+        return;
+    }
+    
+    assert(directory != NULL);
+    assert(producer_count > 0);
+    
+    runs->directory = strdup(directory);
+    global_exit_if_null(runs->directory, "Fatal error calling strdup for point_runs_t directory.\n");
+    
+    runs->producer_count = producer_count;
+    runs->memory_bytes = memory_bytes;
+    
+    // One integer limb, and one more fraction limb than the precision
+    // so values keep every bit mpf does.
+    runs->key_limbs = point_sort_key_limbs();
+    runs->value_limbs = (mpf_get_default_prec() + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS + 2;
+    runs->record_limbs = 2 * runs->key_limbs + 2 * runs->value_limbs + 1;
+    
+    _sort_key_limbs = runs->key_limbs;
+    _sort_record_limbs = runs->record_limbs;
+    
+    record_bytes = sizeof(mp_limb_t) * runs->record_limbs;
+    runs->buffer_capacity = memory_bytes / producer_count / record_bytes;
+    if (runs->buffer_capacity < 1) {
+        runs->buffer_capacity = 1;
+    }
+    
+    runs->buffers = calloc(producer_count, sizeof(mp_limb_t*));
+    global_exit_if_null(runs->buffers, "Fatal error calling calloc for point_runs_t buffers.\n");
+    
+    runs->buffer_count = calloc(producer_count, sizeof(size_t));
+    global_exit_if_null(runs->buffer_count, "Fatal error calling calloc for point_runs_t buffer_count.\n");
+    
+    runs->added = calloc(producer_count, sizeof(size_t));
+    global_exit_if_null(runs->added, "Fatal error calling calloc for point_runs_t added.\n");
+    
+    runs->column_key = malloc(sizeof(mp_limb_t) * runs->key_limbs);
+    global_exit_if_null(runs->column_key, "Fatal error calling malloc for point_runs_t column_key.\n");
+    
+    runs->p1 = point_alloc();
+    point_init(runs->p1);
+    
+    runs->p2 = point_alloc();
+    point_init(runs->p2);
+    
+    runs->is_init = IS_INIT;
+}
+
+/*
+* Frees resources used by the runs, and removes their files.
+*
+* @runs: Runs to free.
+*/
+void point_runs_free(point_runs_t* runs) {
+    char path[RUNS_PATH_MAX];
+    size_t i;
+    
+    if (runs == NULL) {
+        return;
+    }
+    
+    if (runs->is_init == IS_INIT) {
+        if (runs->unique.fp != NULL) {
+            _reader_close(&runs->unique);
+            _file_path(runs, SIZE_MAX, path);
+            remove(path);
+        }
+        
+        for (i=0; i<runs->run_count; i++) {
+            _file_path(runs, i, path);
+            remove(path);
+        }
+        
+        for (i=0; i<runs->producer_count; i++) {
+            free(runs->buffers[i]);
+        }
+        
+        free(runs->buffers);
+        free(runs->buffer_count);
+        free(runs->added);
+        free(runs->column_key);
+        free(runs->column);
+        free(runs->previous);
+        
+        point_free(runs->p1);
+        point_free(runs->p2);
+        
+        free(runs->directory);
+    }
+    
+    free(runs);
+}
+
+/*
+* Adds a candidate point. The caller keeps the point. Writes a run
+* file if the producer's buffer is full.
+* Each producer must only be used by one thread at a time.
+*
+* @runs: Runs.
+* @producer: Index of the producer.
+* @p: Point to add.
+*/
+void point_runs_add(point_runs_t* runs, size_t producer, point_t* p) {
+    assert(runs != NULL);
+    assert(runs->is_init == IS_INIT);
+    assert(producer < runs->producer_count);
+    assert(p != NULL);
+    
+    if (runs->buffers[producer] == NULL) {
+        runs->buffers[producer] = malloc(sizeof(mp_limb_t) * runs->record_limbs * runs->buffer_capacity);
+        global_exit_if_null(runs->buffers[producer], "Fatal error calling malloc for point_runs_t buffer.\n");
+    }
+    
+    _record_set(runs, runs->buffers[producer] + runs->buffer_count[producer] * runs->record_limbs, p);
+    runs->buffer_count[producer]++;
+    runs->added[producer]++;
+    
+    if (runs->buffer_count[producer] == runs->buffer_capacity) {
+        _write_run(runs, producer);
+    }
+}
+
+/*
+* Writes the points still in the buffers, then merges every run file
+* into one file of unique points, and removes the run files. Must not
+* be called while points are being added.
+*
+* @runs: Runs to merge.
+* @ctx: Context holding scratch values.
+*
+* returns: number of unique points.
+*/
+size_t point_runs_merge(point_runs_t* runs, geometry_context_t* ctx) {
+    char path[RUNS_PATH_MAX];
+    size_t record_bytes = sizeof(mp_limb_t) * runs->record_limbs;
+    point_run_reader_t* readers;
+    mp_limb_t** heads;
+    size_t* heap;
+    size_t heap_count = 0;
+    size_t reader_count;
+    size_t capacity;
+    size_t unique = 0;
+    size_t i;
+    FILE* fp;
+    
+    assert(runs != NULL);
+    assert(runs->is_init == IS_INIT);
+    
+    _reader_close(&runs->unique);
+    
+    // The buffers are written and freed so the readers can have their memory.
+    for (i=0; i<runs->producer_count; i++) {
+        _write_run(runs, i);
+        
+        free(runs->buffers[i]);
+        runs->buffers[i] = NULL;
+    }
+    
+    reader_count = runs->run_count;
+    if (reader_count > runs->max_merge_runs) {
+        runs->max_merge_runs = reader_count;
+    }
+    
+    // Each run file, and the unique points read afterwards, share the budget.
+    capacity = runs->memory_bytes / (reader_count + 1) / record_bytes;
+    if (capacity < POINT_RUNS_MIN_READ) {
+        capacity = POINT_RUNS_MIN_READ;
+    }
+    
+    readers = calloc(reader_count + 1, sizeof(point_run_reader_t));
+    global_exit_if_null(readers, "Fatal error calling calloc for point_runs_t readers.\n");
+    
+    heads = calloc(reader_count + 1, sizeof(mp_limb_t*));
+    global_exit_if_null(heads, "Fatal error calling calloc for point_runs_t heads.\n");
+    
+    heap = calloc(reader_count + 1, sizeof(size_t));
+    global_exit_if_null(heap, "Fatal error calling calloc for point_runs_t heap.\n");
+    
+    for (i=0; i<reader_count; i++) {
+        _file_path(runs, i, path);
+        _reader_open(runs, &readers[i], path, capacity);
+        
+        heads[i] = _reader_current(runs, &readers[i]);
+        if (heads[i] != NULL) {
+            heap[heap_count] = i;
+            heap_count++;
+        }
+    }
+    
+    for (i=heap_count; i>0; i--) {
+        _heap_down(heap, heads, heap_count, i - 1);
+    }
+    
+    _file_path(runs, SIZE_MAX, path);
+    fp = _file_open(path, "wb");
+    
+    runs->has_column = 0;
+    runs->column_count = 0;
+    runs->previous_count = 0;
+    runs->previous_position = 0;
+    
+    while (heap_count > 0) {
+        i = heap[0];
+        
+        if (_is_duplicate(runs, ctx, heads[i]) == 0) {
+            _file_write(runs, fp, heads[i], 1);
+            unique++;
+            
+            if (point_hash_grid() == 0) {
+                runs->column_count = 0;
+            }
+            
+            _column_add(runs, heads[i]);
+        }
+        
+        readers[i].position++;
+        heads[i] = _reader_current(runs, &readers[i]);
+        
+        if (heads[i] == NULL) {
+            heap_count--;
+            heap[0] = heap[heap_count];
+        }
+        
+        _heap_down(heap, heads, heap_count, 0);
+    }
+    
+    fclose(fp);
+    
+    for (i=0; i<reader_count; i++) {
+        _reader_close(&readers[i]);
+        
+        _file_path(runs, i, path);
+        remove(path);
+    }
+    
+    runs->run_count = 0;
+    runs->total_unique += unique;
+    
+    free(readers);
+    free(heads);
+    free(heap);
+    
+    // Drop the window, it can be as big as a whole column.
+    free(runs->column);
+    runs->column = NULL;
+    runs->column_capacity = 0;
+    runs->column_count = 0;
+    
+    free(runs->previous);
+    runs->previous = NULL;
+    runs->previous_capacity = 0;
+    runs->previous_count = 0;
+    
+    _file_path(runs, SIZE_MAX, path);
+    _reader_open(runs, &runs->unique, path, runs->memory_bytes / record_bytes > POINT_RUNS_MIN_READ ? runs->memory_bytes / record_bytes : POINT_RUNS_MIN_READ);
+    
+    return unique;
+}
+
+/*
+* Reads the next unique point from the last merge.
+*
+* @runs: Merged runs.
+* @p: Set to the next point, see point_reset.
+*
+* returns: 1 if p was set, 0 after the last point.
+*/
+int point_runs_next(point_runs_t* runs, point_t* p) {
+    mp_limb_t* record;
+    
+    assert(runs != NULL);
+    assert(p != NULL);
+    
+    record = _reader_current(runs, &runs->unique);
+    if (record == NULL) {
+        return 0;
+    }
+    
+    _record_get(runs, record, p);
+    runs->unique.position++;
+    
+    return 1;
+}
+
+/*
+* Prints the number of points added, run files written, and unique points.
+*
+* @runs: Runs to print.
+*/
+void point_runs_printf(point_runs_t* runs) {
+    size_t added = 0;
+    size_t i;
+    
+    for (i=0; i<runs->producer_count; i++) {
+        added += runs->added[i];
+    }
+    
+    printf("external dedup: points added %zu, runs written %zu, most runs merged %zu, unique points %zu\n",
+        added,
+        runs->total_runs,
+        runs->max_merge_runs,
+        runs->total_unique);
+}
@@ -0,0 +1,178 @@
+/*
+* Candidate points sorted in run files on disk and merged into unique points.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __POINT_RUNS_H__
+#define __POINT_RUNS_H__
+
+#include <stddef.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+
+#include "geometry_context.h"
+#include "point.h"
+
+// Records read from a file at a time, used when the memory budget is
+// too small to give each file more.
+#define POINT_RUNS_MIN_READ 16
+
+// Buffered reader of one file of records.
+typedef struct point_run_reader {
+    FILE* fp;
+    
+    // Records read from the file, and how many of those are left.
+    mp_limb_t* records;
+    size_t capacity;
+    size_t count;
+    size_t position;
+} point_run_reader_t;
+
+// Candidate points written to disk instead of being kept in memory.
+//
+// Each producer collects points as fixed size records in its own
+// buffer. When the buffer is full it's sorted and written as a run
+// file. Merging reads all the run files at once (a k-way merge) and
+// writes each point once to a file of unique points, sorted the same
+// way. Memory used by the buffers, or by the readers while merging,
+// is kept within the budget given to point_runs_init.
+//
+// A record is the point's sort key (see point_sort_key), then the x,y
+// values as fixed point numbers (see point_set_fixed) and their signs.
+// Records are sorted by x cell, then y cell, so points are merged the
+// same as in a point table. Points with the same key are the same, with
+// the hash grid points in the same or neighboring cells are compared
+// with point_equals. The first of several equal points in sort order
+// is kept, so the result doesn't depend on which producer added which
+// point.
+//
+// Records of rational points are marked, but don't hold the fractions.
+// When a record is read the fractions are found again from the values,
+// see point_find_rational, and two rational points are only the same if
+// they have the same fractions. A point whose fractions can't be found
+// again is read, and compared, like any other point.
+typedef struct point_runs {
+    // Directory the files are written in.
+    char* directory;
+    
+    // Number of threads that add points.
+    size_t producer_count;
+    
+    // Memory budget in bytes.
+    size_t memory_bytes;
+    
+    // Limbs in each sort key value, each x,y value, and each record.
+    size_t key_limbs;
+    size_t value_limbs;
+    size_t record_limbs;
+    
+    // Records collected by each producer, not yet written. A producer's
+    // buffer is allocated when it adds its first point, and freed when
+    // the runs are merged.
+    mp_limb_t** buffers;
+    size_t* buffer_count;
+    size_t buffer_capacity;
+    
+    // Number of points added by each producer since point_runs_init.
+    size_t* added;
+    
+    // Number of run files written and not yet merged.
+    size_t run_count;
+    
+    // Totals since point_runs_init.
+    size_t total_runs;
+    size_t total_unique;
+    size_t max_merge_runs;
+    
+    // Reader of the unique points from the last merge.
+    point_run_reader_t unique;
+    
+    // Records of the current column, and the column before it, while
+    // merging with the hash grid. Without the hash grid the column only
+    // holds the last unique record.
+    mp_limb_t* column_key;
+    int has_column;
+    mp_limb_t* column;
+    size_t column_count;
+    size_t column_capacity;
+    mp_limb_t* previous;
+    size_t previous_count;
+    size_t previous_capacity;
+    size_t previous_position;
+    
+    // Scratch points for comparing records.
+    point_t* p1;
+    point_t* p2;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} point_runs_t;
+
+/*
+* Allocates memory for new runs.
+*
+* returns: pointer to new runs.
+*/
+point_runs_t* point_runs_alloc();
+
+/*
+* Initializes new runs. Must be called after global_point_init and
+* before use.
+*
+* @runs: Runs to initialize.
+* @directory: Existing directory to write files in.
+* @producer_count: Number of threads that add points.
+* @memory_bytes: Memory budget for buffered records.
+*/
+void point_runs_init(point_runs_t* runs, const char* directory, size_t producer_count, size_t memory_bytes);
+
+/*
+* Frees resources used by the runs, and removes their files.
+*
+* @runs: Runs to free.
+*/
+void point_runs_free(point_runs_t* runs);
+
+/*
+* Adds a candidate point. The caller keeps the point. Writes a run
+* file if the producer's buffer is full.
+* Each producer must only be used by one thread at a time.
+*
+* @runs: Runs.
+* @producer: Index of the producer.
+* @p: Point to add.
+*/
+void point_runs_add(point_runs_t* runs, size_t producer, point_t* p);
+
+/*
+* Writes the points still in the buffers, then merges every run file
+* into one file of unique points, and removes the run files. Must not
+* be called while points are being added.
+*
+* @runs: Runs to merge.
+* @ctx: Context holding scratch values.
+*
+* returns: number of unique points.
+*/
+size_t point_runs_merge(point_runs_t* runs, geometry_context_t* ctx);
+
+/*
+* Reads the next unique point from the last merge.
+*
+* @runs: Merged runs.
+* @p: Set to the next point, see point_reset.
+*
+* returns: 1 if p was set, 0 after the last point.
+*/
+int point_runs_next(point_runs_t* runs, point_t* p);
+
+/*
+* Prints the number of points added, run files written, and unique points.
+*
+* @runs: Runs to print.
+*/
+void point_runs_printf(point_runs_t* runs);
+
+#endif
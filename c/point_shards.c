@@ -0,0 +1,533 @@
+/*
+* Known points split into shards, each owned by one thread.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "global.h"
+#include "point.h"
+#include "point_table.h"
+#include "point_shards.h"
+
+// Microseconds a shard thread sleeps when all its queues are empty.
+#define SHARD_IDLE_USEC 50
+
+/*
+* Initializes an empty queue.
+*/
+static void _queue_init(point_queue_t* q, size_t capacity) {
+    q->points = malloc(sizeof(point_t*) * capacity);
+    global_exit_if_null(q->points, "Fatal error calling malloc for point_queue_t points.\n");
+    
+    q->capacity = capacity;
+    q->head = 0;
+    q->tail = 0;
+    q->max_depth = 0;
+}
+
+/*
+* Frees the queue and any points still in it.
+*/
+static void _queue_free(point_queue_t* q) {
+    size_t i;
+    
+    for (i = q->head; i != q->tail; i++) {
+        point_free(q->points[i & (q->capacity - 1)]);
+    }
+    
+    free(q->points);
+    q->points = NULL;
+}
+
+/*
+* Adds points to the queue, waiting for the consumer to make room
+* if needed. Only called by the producer.
+*/
+static void _queue_push(point_queue_t* q, point_t** points, size_t count) {
+    size_t tail = q->tail;
+    size_t head;
+    size_t i;
+    
+    while (1) {
+        head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+        if (q->capacity - (tail - head) >= count) {
+            break;
+        }
+        
+        sched_yield();
+    }
+    
+    for (i=0; i<count; i++) {
+        q->points[(tail + i) & (q->capacity - 1)] = points[i];
+    }
+    
+    if (tail + count - head > q->max_depth) {
+        q->max_depth = tail + count - head;
+    }
+    
+    __atomic_store_n(&q->tail, tail + count, __ATOMIC_RELEASE);
+}
+
+/*
+* Adds a point to the queue if there's room. Only called by the producer.
+*
+* returns: 1 if the point was added, 0 if the queue is full.
+*/
+static int _queue_try_push(point_queue_t* q, point_t* p) {
+    size_t tail = q->tail;
+    size_t head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+    
+    if (tail - head == q->capacity) {
+        return 0;
+    }
+    
+    q->points[tail & (q->capacity - 1)] = p;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    
+    return 1;
+}
+
+/*
+* Takes points from the queue. Only called by the consumer.
+*
+* returns: number of points taken, at most max.
+*/
+static size_t _queue_pop(point_queue_t* q, point_t** points, size_t max) {
+    size_t head = q->head;
+    size_t tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+    size_t count = tail - head;
+    size_t i;
+    
+    if (count > max) {
+        count = max;
+    }
+    
+    for (i=0; i<count; i++) {
+        points[i] = q->points[(head + i) & (q->capacity - 1)];
+    }
+    
+    if (count > 0) {
+        __atomic_store_n(&q->head, head + count, __ATOMIC_RELEASE);
+    }
+    
+    return count;
+}
+
+/*
+* Gives the points the shards sent back to a producer to its context.
+*/
+static void _take_returns(point_shards_t* shards, size_t producer, geometry_context_t* ctx) {
+    point_t* points[POINT_SHARDS_BATCH];
+    size_t shard;
+    size_t count;
+    size_t i;
+    
+    for (shard=0; shard<shards->shard_count; shard++) {
+        while ((count = _queue_pop(&shards->returns[(shard * shards->producer_count) + producer], points, POINT_SHARDS_BATCH)) > 0) {
+            for (i=0; i<count; i++) {
+                point_release(ctx, points[i]);
+            }
+        }
+    }
+}
+
+/*
+* Main method of a shard thread. Adds the points in the shard's queues
+* to its table until the shards are stopped. Neighboring cells in other
+* shards are searched in their tables, which are safe to search while
+* their own threads add to them.
+*/
+static void* _owner_main(void* data) {
+    point_shard_owner_t* owner = (point_shard_owner_t*)data;
+    point_shards_t* shards = owner->shards;
+    point_t* points[POINT_SHARDS_BATCH];
+    point_queue_t* q;
+    size_t producer;
+    size_t count;
+    size_t total;
+    size_t i;
+    int stop;
+    
+    while (1) {
+        // Read before the queues, everything pushed before stop was
+        // set is found below.
+        stop = __atomic_load_n(&shards->stop, __ATOMIC_ACQUIRE);
+        total = 0;
+        
+        for (producer=0; producer<shards->producer_count; producer++) {
+            q = &shards->queues[(owner->index * shards->producer_count) + producer];
+            
+            while ((count = _queue_pop(q, points, POINT_SHARDS_BATCH)) > 0) {
+                total += count;
+                
+                for (i=0; i<count; i++) {
+                    if (point_shards_add(shards, owner->geometry, points[i]) == NULL) {
+                        owner->added++;
+                    } else if (_queue_try_push(&shards->returns[(owner->index * shards->producer_count) + producer], points[i]) == 0) {
+                        point_free(points[i]);
+                    }
+                }
+            }
+        }
+        
+        if (total == 0) {
+            if (stop == 1) {
+                break;
+            }
+            
+            usleep(SHARD_IDLE_USEC);
+        }
+    }
+    
+    return NULL;
+}
+
+/*
+* Allocates memory for new shards.
+*
+* returns: pointer to new shards.
+*/
+point_shards_t* point_shards_alloc() {
+    point_shards_t* shards = malloc(sizeof(point_shards_t));
+    global_exit_if_null(shards, "Fatal error calling malloc for point_shards_t.\n");
+    
+    memset(shards, 0, sizeof(point_shards_t));
+    
+    return shards;
+}
+
+/*
+* Initializes new shards. Must be called before use.
+*
+* @shards: Shards to initialize.
+* @tables: One point table for each shard, used by the shard threads
+*     while running. The caller still owns these.
+* @shard_count: Number of shards.
+* @producer_count: Number of threads that push points.
+* @routing: POINT_SHARDS_ROUTE_HASH or POINT_SHARDS_ROUTE_TILE.
+*/
+void point_shards_init(point_shards_t* shards, point_table_t** tables, size_t shard_count, size_t producer_count, int routing) {
+    size_t queue_count = shard_count * producer_count;
+    size_t i;
+    
+    if (shards->is_init == IS_INIT) {
+        return;
+    }
+    
+    assert(shard_count > 0);
+    assert(producer_count > 0);
+    
+    shards->shard_count = shard_count;
+    shards->producer_count = producer_count;
+    shards->routing = routing;
+    shards->tables = tables;
+    
+    // The queues are aligned so head and tail are on their own cache lines.
+    if (posix_memalign((void**)&shards->queues, 64, sizeof(point_queue_t) * queue_count) != 0) {
+        global_error_printf("Fatal error calling posix_memalign for shard queues.\n");
+        exit(1);
+    }
+    if (posix_memalign((void**)&shards->returns, 64, sizeof(point_queue_t) * queue_count) != 0) {
+        global_error_printf("Fatal error calling posix_memalign for shard return queues.\n");
+        exit(1);
+    }
+    
+    for (i=0; i<queue_count; i++) {
+        _queue_init(&shards->queues[i], POINT_SHARDS_QUEUE_CAPACITY);
+        _queue_init(&shards->returns[i], POINT_SHARDS_QUEUE_CAPACITY);
+    }
+    
+    shards->pending = malloc(sizeof(point_t*) * queue_count * POINT_SHARDS_BATCH);
+    global_exit_if_null(shards->pending, "Fatal error calling malloc for shard pending points.\n");
+    shards->pending_count = malloc(sizeof(size_t) * queue_count);
+    global_exit_if_null(shards->pending_count, "Fatal error calling malloc for shard pending count.\n");
+    memset(shards->pending_count, 0, sizeof(size_t) * queue_count);
+    
+    shards->threads = malloc(sizeof(pthread_t) * shard_count);
+    global_exit_if_null(shards->threads, "Fatal error calling malloc for shard threads.\n");
+    shards->owners = malloc(sizeof(point_shard_owner_t) * shard_count);
+    global_exit_if_null(shards->owners, "Fatal error calling malloc for point_shard_owner_t.\n");
+    
+    for (i=0; i<shard_count; i++) {
+        shards->owners[i].shards = shards;
+        shards->owners[i].index = i;
+        shards->owners[i].added = 0;
+        shards->owners[i].geometry = geometry_context_alloc();
+        geometry_context_init(shards->owners[i].geometry);
+    }
+    
+    shards->stop = 0;
+    shards->is_running = 0;
+    
+    shards->is_init = IS_INIT;
+}
+
+/*
+* Frees resources used by the shards. Must not be running.
+*
+* @shards: Shards to free.
+*/
+void point_shards_free(point_shards_t* shards) {
+    size_t queue_count;
+    size_t i;
+    size_t j;
+    
+    if (shards == NULL) {
+        return;
+    }
+    
+    if (shards->is_init == IS_INIT) {
+        assert(shards->is_running == 0);
+        
+        queue_count = shards->shard_count * shards->producer_count;
+        
+        for (i=0; i<queue_count; i++) {
+            _queue_free(&shards->queues[i]);
+            _queue_free(&shards->returns[i]);
+            
+            for (j=0; j<shards->pending_count[i]; j++) {
+                point_free(shards->pending[(i * POINT_SHARDS_BATCH) + j]);
+            }
+        }
+        
+        for (i=0; i<shards->shard_count; i++) {
+            geometry_context_free(shards->owners[i].geometry);
+        }
+        
+        free(shards->queues);
+        free(shards->returns);
+        free(shards->pending);
+        free(shards->pending_count);
+        free(shards->threads);
+        free(shards->owners);
+        
+        shards->is_init = 0;
+    }
+    
+    free(shards);
+}
+
+/*
+* Finds the shard a point belongs in.
+*
+* @shards: Shards.
+* @p: Point, the hash key is set if needed.
+*
+* returns: index of the shard.
+*/
+size_t point_shards_route(point_shards_t* shards, point_t* p) {
+    point_ensure_hash(p);
+    
+    return point_shards_route_cell(shards, p->hash_key, p->hash_value);
+}
+
+/*
+* Finds the shard a grid cell belongs in, see point_hash_cells.
+*
+* @shards: Shards.
+* @key: Key of the cell.
+* @hash_value: Hash of key.
+*
+* returns: index of the shard.
+*/
+size_t point_shards_route_cell(point_shards_t* shards, mp_limb_t* key, unsigned hash_value) {
+    if (shards->routing == POINT_SHARDS_ROUTE_TILE) {
+        hash_value = point_hash_tile_key(key);
+    }
+    
+    // The tables use the low bits of hash_value for the slot,
+    // use the high bits for the shard.
+    return (size_t)(((uint64_t)hash_value * shards->shard_count) >> 32);
+}
+
+/*
+* Adds a point to the table of its shard, see point_table_add. With
+* the hash grid, the neighboring cells are searched in the tables of
+* the shards they belong in. Safe to call from several threads at
+* once, the shard threads use this while running.
+*
+* @shards: Shards.
+* @ctx: Context holding scratch values, one per thread.
+* @p: Point to add. If added, the record owns the point.
+*
+* returns: NULL if the point was added, otherwise the record equal to p.
+*/
+point_record_t* point_shards_add(point_shards_t* shards, geometry_context_t* ctx, point_t* p) {
+    mp_limb_t* keys[POINT_HASH_MAX_CELLS];
+    unsigned hash_values[POINT_HASH_MAX_CELLS];
+    point_table_t* tables[POINT_HASH_MAX_CELLS];
+    int cell_count;
+    int i;
+    
+    cell_count = point_hash_cells(ctx, p, keys, hash_values);
+    for (i=0; i<cell_count; i++) {
+        tables[i] = shards->tables[point_shards_route_cell(shards, keys[i], hash_values[i])];
+    }
+    
+    return point_table_add_cells(ctx, tables, p, keys, hash_values, cell_count);
+}
+
+/*
+* Finds a point equal to p in the shards, see point_shards_add.
+*
+* @shards: Shards.
+* @ctx: Context holding scratch values, one per thread.
+* @p: Point to find.
+*
+* returns: Record equal to p, or NULL.
+*/
+point_record_t* point_shards_find(point_shards_t* shards, geometry_context_t* ctx, point_t* p) {
+    mp_limb_t* keys[POINT_HASH_MAX_CELLS];
+    unsigned hash_values[POINT_HASH_MAX_CELLS];
+    point_table_t* tables[POINT_HASH_MAX_CELLS];
+    int cell_count;
+    int i;
+    
+    cell_count = point_hash_cells(ctx, p, keys, hash_values);
+    for (i=0; i<cell_count; i++) {
+        tables[i] = shards->tables[point_shards_route_cell(shards, keys[i], hash_values[i])];
+    }
+    
+    return point_table_find_cells(ctx, tables, p, keys, hash_values, cell_count);
+}
+
+/*
+* Starts a thread for each shard.
+*
+* @shards: Shards to start.
+*/
+void point_shards_start(point_shards_t* shards) {
+    size_t i;
+    
+    assert(shards->is_init == IS_INIT);
+    assert(shards->is_running == 0);
+    
+    shards->stop = 0;
+    
+    for (i=0; i<shards->shard_count; i++) {
+        shards->owners[i].added = 0;
+        
+        if (pthread_create(&shards->threads[i], NULL, _owner_main, &shards->owners[i]) != 0) {
+            global_error_printf("Could not create shard thread %zu.\n", i);
+            exit(1);
+        }
+    }
+    
+    shards->is_running = 1;
+}
+
+/*
+* Sends a point to its shard, to be added if it's new. The point is
+* owned by the shards after this. Points sent back as duplicates are
+* given to the producer's context, see point_take.
+* Each producer must only be used by one thread at a time.
+*
+* @shards: Running shards.
+* @producer: Index of the producer.
+* @ctx: Producer's context.
+* @p: Point to add.
+*/
+void point_shards_push(point_shards_t* shards, size_t producer, geometry_context_t* ctx, point_t* p) {
+    size_t shard = point_shards_route(shards, p);
+    size_t index = (producer * shards->shard_count) + shard;
+    point_t** pending = &shards->pending[index * POINT_SHARDS_BATCH];
+    
+    assert(producer < shards->producer_count);
+    
+    pending[shards->pending_count[index]] = p;
+    shards->pending_count[index]++;
+    
+    if (shards->pending_count[index] == POINT_SHARDS_BATCH) {
+        _queue_push(&shards->queues[(shard * shards->producer_count) + producer], pending, POINT_SHARDS_BATCH);
+        shards->pending_count[index] = 0;
+        
+        _take_returns(shards, producer, ctx);
+    }
+}
+
+/*
+* Pushes the points the producers have collected, waits for the shard
+* threads to add every queued point, and stops them. Must be called
+* after the producers are done.
+*
+* @shards: Running shards.
+* @ctx: Context to give points sent back as duplicates to.
+*
+* returns: number of points added to the tables since point_shards_start.
+*/
+size_t point_shards_stop(point_shards_t* shards, geometry_context_t* ctx) {
+    size_t producer;
+    size_t shard;
+    size_t index;
+    size_t added = 0;
+    
+    assert(shards->is_running == 1);
+    
+    for (producer=0; producer<shards->producer_count; producer++) {
+        for (shard=0; shard<shards->shard_count; shard++) {
+            index = (producer * shards->shard_count) + shard;
+            
+            if (shards->pending_count[index] > 0) {
+                _queue_push(&shards->queues[(shard * shards->producer_count) + producer],
+                    &shards->pending[index * POINT_SHARDS_BATCH],
+                    shards->pending_count[index]);
+                shards->pending_count[index] = 0;
+            }
+        }
+    }
+    
+    __atomic_store_n(&shards->stop, 1, __ATOMIC_RELEASE);
+    
+    for (shard=0; shard<shards->shard_count; shard++) {
+        pthread_join(shards->threads[shard], NULL);
+        added += shards->owners[shard].added;
+    }
+    
+    shards->is_running = 0;
+    
+    for (producer=0; producer<shards->producer_count; producer++) {
+        _take_returns(shards, producer, ctx);
+    }
+    
+    return added;
+}
+
+/*
+* Prints the number of points in each shard, and the most points
+* that were waiting in its queues.
+*
+* @shards: Shards to print.
+*/
+void point_shards_printf(point_shards_t* shards) {
+    size_t shard;
+    size_t producer;
+    size_t max_depth;
+    point_queue_t* q;
+    
+    for (shard=0; shard<shards->shard_count; shard++) {
+        max_depth = 0;
+        
+        for (producer=0; producer<shards->producer_count; producer++) {
+            q = &shards->queues[(shard * shards->producer_count) + producer];
+            if (q->max_depth > max_depth) {
+                max_depth = q->max_depth;
+            }
+        }
+        
+        printf("shard %zu: points %zu, max queue depth %zu\n",
+            shard,
+            point_table_count(shards->tables[shard]),
+            max_depth);
+    }
+}
@@ -0,0 +1,223 @@
+/*
+* Known points split into shards, each owned by one thread.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __POINT_SHARDS_H__
+#define __POINT_SHARDS_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "geometry_context.h"
+#include "point.h"
+#include "point_table.h"
+
+// Ways to pick the shard for a point, see DEDUP_ROUTING.
+#define POINT_SHARDS_ROUTE_HASH 0
+#define POINT_SHARDS_ROUTE_TILE 1
+
+// Number of points a producer collects for a shard before pushing
+// them to the shard's queue.
+#define POINT_SHARDS_BATCH 32
+
+// Number of points each queue can hold.
+#define POINT_SHARDS_QUEUE_CAPACITY 4096
+
+// Ring buffer of points with one producer thread and one consumer
+// thread. The producer only writes tail, the consumer only writes
+// head, these are kept on separate cache lines.
+typedef struct point_queue {
+    point_t** points;
+    
+    // Number of points the queue can hold, a power of 2.
+    size_t capacity;
+    
+    // Position of the next point to take, written by the consumer.
+    size_t head __attribute__((aligned(64)));
+    
+    // Position of the next point to add, written by the producer.
+    size_t tail __attribute__((aligned(64)));
+    
+    // Most points waiting in the queue seen by the producer.
+    size_t max_depth;
+} point_queue_t;
+
+struct point_shards;
+
+// Argument given to each shard thread.
+typedef struct point_shard_owner {
+    struct point_shards* shards;
+    
+    // Index of the shard the thread owns.
+    size_t index;
+    
+    // Scratch values for comparing points, see point_hash_cells.
+    geometry_context_t* geometry;
+    
+    // Number of points added to the shard's table.
+    size_t added;
+} point_shard_owner_t;
+
+// Known points split by key hash or tile into shards. While running,
+// only the thread that owns a shard adds points to its table, and
+// the producer threads (enumerate workers) push points to the shards
+// through a queue for each producer and shard. Duplicate points are
+// sent back to the producer on a second queue, to be reused.
+//
+// With the hash grid, each neighboring cell of a point is searched in
+// the shard it belongs in, see point_shards_add, so points are merged
+// the same as in one table. With tile routing the cells are almost
+// always in the point's own shard, with hash routing they usually
+// aren't, and the search reads another shard's table.
+typedef struct point_shards {
+    // Number of shards and producers.
+    size_t shard_count;
+    size_t producer_count;
+    
+    // POINT_SHARDS_ROUTE_HASH or POINT_SHARDS_ROUTE_TILE.
+    int routing;
+    
+    // One table of points for each shard. Not owned by point_shards.
+    point_table_t** tables;
+    
+    // Queues from producer to shard, and back from shard to producer,
+    // at [shard * producer_count + producer].
+    point_queue_t* queues;
+    point_queue_t* returns;
+    
+    // Points each producer has collected but not pushed, for each shard,
+    // POINT_SHARDS_BATCH at [(producer * shard_count + shard) * POINT_SHARDS_BATCH].
+    point_t** pending;
+    size_t* pending_count;
+    
+    // One thread for each shard.
+    pthread_t* threads;
+    point_shard_owner_t* owners;
+    
+    // Set once the producers are done, the shard threads stop when
+    // their queues are empty.
+    int stop;
+    
+    // Whether or not the shard threads are running.
+    int is_running;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} point_shards_t;
+
+/*
+* Allocates memory for new shards.
+*
+* returns: pointer to new shards.
+*/
+point_shards_t* point_shards_alloc();
+
+/*
+* Initializes new shards. Must be called before use.
+*
+* @shards: Shards to initialize.
+* @tables: One point table for each shard, used by the shard threads
+*     while running. The caller still owns these.
+* @shard_count: Number of shards.
+* @producer_count: Number of threads that push points.
+* @routing: POINT_SHARDS_ROUTE_HASH or POINT_SHARDS_ROUTE_TILE.
+*/
+void point_shards_init(point_shards_t* shards, point_table_t** tables, size_t shard_count, size_t producer_count, int routing);
+
+/*
+* Frees resources used by the shards. Must not be running.
+*
+* @shards: Shards to free.
+*/
+void point_shards_free(point_shards_t* shards);
+
+/*
+* Finds the shard a point belongs in.
+*
+* @shards: Shards.
+* @p: Point, the hash key is set if needed.
+*
+* returns: index of the shard.
+*/
+size_t point_shards_route(point_shards_t* shards, point_t* p);
+
+/*
+* Finds the shard a grid cell belongs in, see point_hash_cells.
+*
+* @shards: Shards.
+* @key: Key of the cell.
+* @hash_value: Hash of key.
+*
+* returns: index of the shard.
+*/
+size_t point_shards_route_cell(point_shards_t* shards, mp_limb_t* key, unsigned hash_value);
+
+/*
+* Adds a point to the table of its shard, see point_table_add. With
+* the hash grid, the neighboring cells are searched in the tables of
+* the shards they belong in. Safe to call from several threads at
+* once, the shard threads use this while running.
+*
+* @shards: Shards.
+* @ctx: Context holding scratch values, one per thread.
+* @p: Point to add. If added, the record owns the point.
+*
+* returns: NULL if the point was added, otherwise the record equal to p.
+*/
+point_record_t* point_shards_add(point_shards_t* shards, geometry_context_t* ctx, point_t* p);
+
+/*
+* Finds a point equal to p in the shards, see point_shards_add.
+*
+* @shards: Shards.
+* @ctx: Context holding scratch values, one per thread.
+* @p: Point to find.
+*
+* returns: Record equal to p, or NULL.
+*/
+point_record_t* point_shards_find(point_shards_t* shards, geometry_context_t* ctx, point_t* p);
+
+/*
+* Starts a thread for each shard.
+*
+* @shards: Shards to start.
+*/
+void point_shards_start(point_shards_t* shards);
+
+/*
+* Sends a point to its shard, to be added if it's new. The point is
+* owned by the shards after this. Points sent back as duplicates are
+* given to the producer's context, see point_take.
+* Each producer must only be used by one thread at a time.
+*
+* @shards: Running shards.
+* @producer: Index of the producer.
+* @ctx: Producer's context.
+* @p: Point to add.
+*/
+void point_shards_push(point_shards_t* shards, size_t producer, geometry_context_t* ctx, point_t* p);
+
+/*
+* Pushes the points the producers have collected, waits for the shard
+* threads to add every queued point, and stops them. Must be called
+* after the producers are done.
+*
+* @shards: Running shards.
+* @ctx: Context to give points sent back as duplicates to.
+*
+* returns: number of points added to the tables since point_shards_start.
+*/
+size_t point_shards_stop(point_shards_t* shards, geometry_context_t* ctx);
+
+/*
+* Prints the number of points in each shard, and the most points
+* that were waiting in its queues.
+*
+* @shards: Shards to print.
+*/
+void point_shards_printf(point_shards_t* shards);
+
+#endif
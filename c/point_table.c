@@ -0,0 +1,857 @@
+/*
+* Open addressing hash table of distinct points, shared by threads.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <assert.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "point.h"
+#include "point_table.h"
+
+// Empty slot that has been frozen, see point_table_slots_t.
+#define POINT_TABLE_MOVED ((point_record_t*)1)
+
+// Results of adding to one table.
+#define ADD_RESULT_ADDED 0
+#define ADD_RESULT_FOUND 1
+#define ADD_RESULT_MOVED 2
+
+/*
+* Reads a slot.
+*/
+static point_record_t* _load(point_record_t** slot) {
+    return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+}
+
+/*
+* Removes the frozen bit from a slot value.
+*
+* returns: Record in the slot, or NULL if the slot is empty.
+*/
+static point_record_t* _unfreeze(point_record_t* value) {
+    return (point_record_t*)((uintptr_t)value & ~(uintptr_t)1);
+}
+
+/*
+* Allocates a table with every slot empty.
+*
+* returns: pointer to new table.
+*/
+static point_table_slots_t* _slots_alloc(size_t capacity) {
+    point_table_slots_t* s = malloc(sizeof(point_table_slots_t));
+    global_exit_if_null(s, "Fatal error calling malloc for point_table_slots_t.\n");
+    memset(s, 0, sizeof(point_table_slots_t));
+    
+    s->slots = malloc(sizeof(point_record_t*) * capacity);
+    global_exit_if_null(s->slots, "Fatal error calling malloc for point table slots.\n");
+    memset(s->slots, 0, sizeof(point_record_t*) * capacity);
+    
+    s->capacity = capacity;
+    
+    return s;
+}
+
+/*
+* Frees a table. The records in it are not freed.
+*/
+static void _slots_free(point_table_slots_t* s) {
+    free(s->slots);
+    free(s);
+}
+
+/*
+* Counts a hit for a record found in the table, and raises its
+* clock_count so eviction passes over it.
+*/
+static void _touch(geometry_context_t* ctx, point_record_t* found) {
+    unsigned char clock_count = __atomic_load_n(&found->clock_count, __ATOMIC_RELAXED);
+    
+    ctx->point_table_hits++;
+    
+    // Only written when it changes, so threads finding the same point
+    // don't keep taking its cache line from each other.
+    if (clock_count < POINT_TABLE_CLOCK_MAX) {
+        __atomic_store_n(&found->clock_count, clock_count + 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+* Whether a record in the table is the point being looked for.
+*
+* @ctx: Context holding scratch values.
+* @entry: Record in the table.
+* @p: Point being looked for.
+* @key: Key of the cell being searched.
+* @hash_value: Hash of key.
+*
+* returns: 1 if the points are the same, otherwise 0.
+*/
+static int _matches(geometry_context_t* ctx, point_record_t* entry, point_t* p, mp_limb_t* key, unsigned hash_value) {
+    if (entry->hash_value != hash_value) {
+        return 0;
+    }
+    
+    if (__atomic_load_n(&entry->flags, __ATOMIC_ACQUIRE) & POINT_RECORD_DROPPED) {
+        return 0;
+    }
+    
+    return point_record_equals(ctx, entry, p, key);
+}
+
+/*
+* Finds a record equal to p with the given key in one table.
+*
+* returns: Record in the table equal to p, or NULL.
+*/
+static point_record_t* _find_in_slots(geometry_context_t* ctx, point_table_slots_t* s, point_t* p, mp_limb_t* key, unsigned hash_value) {
+    size_t mask = s->capacity - 1;
+    size_t i = hash_value & mask;
+    size_t n;
+    point_record_t* entry;
+    
+    for (n=0; n<s->capacity; n++) {
+        entry = _unfreeze(_load(&s->slots[i]));
+        
+        // An empty slot, frozen or not, ends the probe.
+        if (entry == NULL) {
+            return NULL;
+        }
+        
+        if (_matches(ctx, entry, p, key, hash_value) == 1) {
+            return entry;
+        }
+        
+        i = (i + 1) & mask;
+    }
+    
+    return NULL;
+}
+
+/*
+* Finds a record equal to p with the given key, in the current table
+* and any table it is being moved to.
+*
+* returns: Record in the table equal to p, or NULL.
+*/
+static point_record_t* _find(geometry_context_t* ctx, point_table_t* table, point_t* p, mp_limb_t* key, unsigned hash_value) {
+    point_table_slots_t* s;
+    point_record_t* found;
+    
+    for (s = __atomic_load_n(&table->slots, __ATOMIC_ACQUIRE); s != NULL; s = __atomic_load_n(&s->next, __ATOMIC_ACQUIRE)) {
+        found = _find_in_slots(ctx, s, p, key, hash_value);
+        if (found != NULL) {
+            return found;
+        }
+    }
+    
+    return NULL;
+}
+
+/*
+* Waits for a record that is still being checked against the
+* neighboring cells, see _settle.
+*
+* returns: 1 if the record was kept, 0 if it was dropped.
+*/
+static int _wait_settled(point_record_t* r) {
+    unsigned char flags;
+    
+    while ((flags = __atomic_load_n(&r->flags, __ATOMIC_ACQUIRE)) & POINT_RECORD_PENDING) {
+        sched_yield();
+    }
+    
+    return (flags & POINT_RECORD_DROPPED) ? 0 : 1;
+}
+
+/*
+* Same as _find, but only returns a record once it has been kept.
+*
+* returns: Record in the table equal to p, or NULL.
+*/
+static point_record_t* _find_settled(geometry_context_t* ctx, point_table_t* table, point_t* p, mp_limb_t* key, unsigned hash_value) {
+    point_record_t* found;
+    
+    // A dropped record isn't matched, so the search goes on past it.
+    while ((found = _find(ctx, table, p, key, hash_value)) != NULL) {
+        if (_wait_settled(found) == 1) {
+            return found;
+        }
+    }
+    
+    return NULL;
+}
+
+/*
+* Searches the neighboring cells again after p's record was added to
+* its own cell. A thread adding a point within g_epsilon of p in a
+* neighboring cell at the same time can miss p's record, as p missed
+* its record when the neighboring cells were first searched. Both
+* threads add their record before the fence and search after it, so
+* at least one of them finds the other's record.
+*
+* A record that was already kept is kept, p's record is dropped. If
+* both are pending, the record in the cell with the lower key is kept:
+* the thread with the higher key drops its record, the thread with the
+* lower key waits for it to. Threads only wait on higher keys, so they
+* can't wait on each other.
+*
+* @tables: Table of each cell.
+* @record: p's record, added to its own cell as POINT_RECORD_PENDING.
+*
+* returns: NULL if p's record is kept, otherwise the record kept
+*     instead. p's record is dropped, and p is owned by the caller.
+*/
+static point_record_t* _settle(geometry_context_t* ctx, point_table_t** tables, point_t* p, point_record_t* record, mp_limb_t** keys, unsigned* hash_values, int cell_count) {
+    point_record_t* found;
+    unsigned char flags;
+    int i;
+    
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    
+    for (i=1; i<cell_count; i++) {
+        while ((found = _find(ctx, tables[i], p, keys[i], hash_values[i])) != NULL && found != record) {
+            flags = __atomic_load_n(&found->flags, __ATOMIC_ACQUIRE);
+            
+            // Dropped after it was found, search again.
+            if (flags & POINT_RECORD_DROPPED) {
+                continue;
+            }
+            
+            if ((flags & POINT_RECORD_PENDING)
+                    && memcmp(keys[0], keys[i], p->hash_key_length) < 0) {
+                sched_yield();
+                continue;
+            }
+            
+            // Records don't read their point while they're compared, so
+            // the point can be handed back while other threads search.
+            record->point = NULL;
+            __atomic_store_n(&record->flags, (record->flags & ~POINT_RECORD_PENDING) | POINT_RECORD_DROPPED, __ATOMIC_RELEASE);
+            __atomic_add_fetch(&tables[0]->dropped, 1, __ATOMIC_ACQ_REL);
+            
+            return found;
+        }
+    }
+    
+    __atomic_and_fetch(&record->flags, (unsigned char)~POINT_RECORD_PENDING, __ATOMIC_RELEASE);
+    
+    return NULL;
+}
+
+/*
+* Adds p to one table, unless a point equal to p is in its cell.
+*
+* @record: Record of p to add. Made when the first empty slot is
+*     reached, so nothing is allocated for points already known.
+* @flags: POINT_RECORD_ bits to set in the record.
+* @found: Set to the record equal to p, if there is one.
+*
+* returns: ADD_RESULT_ADDED if p was added, ADD_RESULT_FOUND if an equal
+*     point was found, or ADD_RESULT_MOVED if the probe reached a frozen
+*     slot and p needs to be added to the next table.
+*/
+static int _add_to_slots(geometry_context_t* ctx, point_table_slots_t* s, point_t* p, point_record_t** record, unsigned char flags, point_record_t** found) {
+    size_t mask = s->capacity - 1;
+    size_t i = p->hash_value & mask;
+    size_t n = 0;
+    point_record_t* value;
+    point_record_t* entry;
+    
+    while (n < s->capacity) {
+        value = _load(&s->slots[i]);
+        
+        if (value == NULL) {
+            if (*record == NULL) {
+                *record = point_record_alloc(p);
+                (*record)->flags |= flags;
+            }
+            
+            if (__atomic_compare_exchange_n(&s->slots[i], &value, *record, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return ADD_RESULT_ADDED;
+            }
+            
+            // Another thread took the slot, check what it put there.
+            continue;
+        }
+        
+        if (value == POINT_TABLE_MOVED) {
+            return ADD_RESULT_MOVED;
+        }
+        
+        entry = _unfreeze(value);
+        if (_matches(ctx, entry, p, p->hash_key, p->hash_value) == 1) {
+            *found = entry;
+            return ADD_RESULT_FOUND;
+        }
+        
+        i = (i + 1) & mask;
+        n++;
+    }
+    
+    global_error_printf("Fatal error: point table is full.\n");
+    exit(1);
+}
+
+/*
+* Adds a record being moved from the old table. The record can't already
+* be in the new table, so this takes the first empty slot.
+*/
+static void _move_into(point_table_slots_t* s, point_record_t* r) {
+    size_t mask = s->capacity - 1;
+    size_t i = r->hash_value & mask;
+    point_record_t* value;
+    
+    while (1) {
+        value = _load(&s->slots[i]);
+        
+        if (value == NULL
+                && __atomic_compare_exchange_n(&s->slots[i], &value, r, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+        
+        if (value != NULL) {
+            i = (i + 1) & mask;
+        }
+    }
+}
+
+/*
+* Moves the next chunk of slots from a table to the table it's being
+* moved to. The thread that moves the last chunk makes the new table
+* current, and puts the old one on the retired list.
+*
+* returns: 1 if a chunk was moved, 0 if every chunk has been taken.
+*/
+static int _move_chunk(point_table_t* table, point_table_slots_t* s) {
+    point_table_slots_t* next = __atomic_load_n(&s->next, __ATOMIC_ACQUIRE);
+    size_t chunks = s->capacity / POINT_TABLE_MOVE_CHUNK;
+    size_t chunk;
+    size_t done;
+    size_t i;
+    point_record_t* value;
+    point_table_slots_t* expected;
+    
+    chunk = __atomic_fetch_add(&s->move_position, 1, __ATOMIC_ACQ_REL);
+    if (chunk >= chunks) {
+        return 0;
+    }
+    
+    for (i = chunk * POINT_TABLE_MOVE_CHUNK; i < (chunk + 1) * POINT_TABLE_MOVE_CHUNK; i++) {
+        value = _load(&s->slots[i]);
+        
+        // Only a thread adding a point can change the slot, and only
+        // from empty.
+        while (!__atomic_compare_exchange_n(&s->slots[i], &value, (point_record_t*)((uintptr_t)value | 1), 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        }
+        
+        if (value != NULL) {
+            _move_into(next, value);
+        }
+    }
+    
+    done = __atomic_add_fetch(&s->move_done, 1, __ATOMIC_ACQ_REL);
+    if (done == chunks) {
+        expected = s;
+        __atomic_compare_exchange_n(&table->slots, &expected, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        
+        s->retired = __atomic_load_n(&table->retired, __ATOMIC_ACQUIRE);
+        while (!__atomic_compare_exchange_n(&table->retired, &s->retired, s, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        }
+    }
+    
+    return 1;
+}
+
+/*
+* Moves a chunk of the table to the bigger one, as every thread adding
+* a point does while a move is going on. If the bigger table is already
+* 3/4 full, which only happens when a thread moving a chunk is stalled,
+* this waits for the move to finish so the bigger table can't fill up.
+*/
+static void _help_move(point_table_t* table, point_table_slots_t* s, point_table_slots_t* next) {
+    size_t chunks = s->capacity / POINT_TABLE_MOVE_CHUNK;
+    
+    _move_chunk(table, s);
+    
+    if (__atomic_load_n(&table->count, __ATOMIC_ACQUIRE) * 4 <= next->capacity * 3) {
+        return;
+    }
+    
+    while (__atomic_load_n(&s->move_done, __ATOMIC_ACQUIRE) < chunks) {
+        if (_move_chunk(table, s) == 0) {
+            sched_yield();
+        }
+    }
+}
+
+/*
+* Starts moving to a table twice the size, if the table is more than
+* half full and a move isn't already started.
+*/
+static void _grow_if_needed(point_table_t* table, point_table_slots_t* s, size_t count) {
+    point_table_slots_t* next;
+    point_table_slots_t* expected = NULL;
+    
+    if (count * 2 <= s->capacity
+            || __atomic_load_n(&s->next, __ATOMIC_ACQUIRE) != NULL
+            || __atomic_load_n(&table->slots, __ATOMIC_ACQUIRE) != s) {
+        return;
+    }
+    
+    next = _slots_alloc(s->capacity * 2);
+    
+    if (!__atomic_compare_exchange_n(&s->next, &expected, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        _slots_free(next);
+    }
+}
+
+/*
+* Allocates memory for a new point table.
+*
+* returns: pointer to new point table.
+*/
+point_table_t* point_table_alloc() {
+    point_table_t* table = malloc(sizeof(point_table_t));
+    global_exit_if_null(table, "Fatal error calling malloc for point_table_t.\n");
+    
+    memset(table, 0, sizeof(point_table_t));
+    
+    return table;
+}
+
+/*
+* Initializes new point table. Must be called before use.
+*
+* @table: Point table to initialize.
+* @capacity: Number of slots to start with, rounded up to a power of 2.
+*     The table grows as needed, this only saves resizing.
+*/
+void point_table_init(point_table_t* table, size_t capacity) {
+    size_t size = POINT_TABLE_MOVE_CHUNK;
+    
+    if (table->is_init == IS_INIT) {
+        return;
+    }
+    
+    while (size < capacity) {
+        size *= 2;
+    }
+    
+    table->slots = _slots_alloc(size);
+    table->count = 0;
+    table->dropped = 0;
+    table->retired = NULL;
+    table->clock_hand = 0;
+    table->evicted = 0;
+    
+    table->is_init = IS_INIT;
+}
+
+/*
+* Frees the point table and all the records and points in it.
+*
+* @table: Point table to free.
+*/
+void point_table_free(point_table_t* table) {
+    if (table == NULL) {
+        return;
+    }
+    
+    if (table->is_init == IS_INIT) {
+        point_table_clear(table);
+        _slots_free(table->slots);
+        table->slots = NULL;
+        
+        table->is_init = 0;
+    }
+    
+    free(table);
+}
+
+/*
+* Removes and frees all the records and points in the table. Must not be called
+* while other threads are using the table.
+*
+* @table: Point table to clear.
+*/
+void point_table_clear(point_table_t* table) {
+    size_t i;
+    point_table_slots_t* s;
+    
+    assert(table->is_init == IS_INIT);
+    
+    point_table_reclaim(table);
+    s = table->slots;
+    
+    for (i=0; i<s->capacity; i++) {
+        point_record_free(s->slots[i]);
+    }
+    
+    memset(s->slots, 0, sizeof(point_record_t*) * s->capacity);
+    table->count = 0;
+    table->dropped = 0;
+}
+
+/*
+* Number of points in the table.
+*
+* @table: Point table.
+*
+* returns: number of points.
+*/
+size_t point_table_count(point_table_t* table) {
+    return __atomic_load_n(&table->count, __ATOMIC_ACQUIRE) - __atomic_load_n(&table->dropped, __ATOMIC_ACQUIRE);
+}
+
+/*
+* Adds a point to the table, unless an equal point is already there.
+* Safe to call from several threads at once. Counts a hit or miss
+* in the context. If another thread adds a point equal to p in a
+* neighboring cell at the same time, only one of the points is kept,
+* the other thread gets the record of the point that was kept. The
+* record of the other point stays in the table as POINT_RECORD_DROPPED,
+* it isn't matched or counted, and is freed by point_table_evict.
+*
+* @ctx: Context holding scratch values, one per thread.
+* @table: Point table to add to.
+* @p: Point to add. If added, a record of the point is made, which
+*     owns the point.
+*
+* returns: NULL if the point was added, otherwise the record already
+*     in the table that is equal to p.
+*/
+point_record_t* point_table_add(geometry_context_t* ctx, point_table_t* table, point_t* p) {
+    mp_limb_t* keys[POINT_HASH_MAX_CELLS];
+    unsigned hash_values[POINT_HASH_MAX_CELLS];
+    point_table_t* tables[POINT_HASH_MAX_CELLS];
+    int cell_count;
+    int i;
+    
+    assert(table->is_init == IS_INIT);
+    
+    cell_count = point_hash_cells(ctx, p, keys, hash_values);
+    for (i=0; i<cell_count; i++) {
+        tables[i] = table;
+    }
+    
+    return point_table_add_cells(ctx, tables, p, keys, hash_values, cell_count);
+}
+
+/*
+* Same as point_table_add, with a table for each cell. The tables are
+* split so each cell is in one table, see point_shards_add.
+*
+* @ctx: Context holding scratch values, one per thread.
+* @tables: Table of each cell, p is added to the first.
+* @p: Point to add.
+* @keys: Key of each cell, p's own first, see point_hash_cells.
+* @hash_values: Hash of each key.
+* @cell_count: Number of cells.
+*
+* returns: NULL if the point was added, otherwise the record equal to p.
+*/
+point_record_t* point_table_add_cells(geometry_context_t* ctx, point_table_t** tables, point_t* p, mp_limb_t** keys, unsigned* hash_values, int cell_count) {
+    point_table_t* table = tables[0];
+    int i;
+    point_table_slots_t* s;
+    point_table_slots_t* next;
+    point_record_t* record;
+    point_record_t* found = NULL;
+    int result;
+    size_t count;
+    
+    assert(table->is_init == IS_INIT);
+    
+    while (1) {
+        // Neighboring cells can only be searched. p goes in its own cell,
+        // which is searched as it's added.
+        for (i=1; i<cell_count; i++) {
+            found = _find_settled(ctx, tables[i], p, keys[i], hash_values[i]);
+            if (found != NULL) {
+                _touch(ctx, found);
+                return found;
+            }
+        }
+        
+        s = __atomic_load_n(&table->slots, __ATOMIC_ACQUIRE);
+        record = NULL;
+        
+        while (1) {
+            next = __atomic_load_n(&s->next, __ATOMIC_ACQUIRE);
+            if (next != NULL) {
+                _help_move(table, s, next);
+            }
+            
+            result = _add_to_slots(ctx, s, p, &record, cell_count > 1 ? POINT_RECORD_PENDING : 0, &found);
+            if (result != ADD_RESULT_MOVED) {
+                break;
+            }
+            
+            s = __atomic_load_n(&s->next, __ATOMIC_ACQUIRE);
+        }
+        
+        if (result == ADD_RESULT_ADDED) {
+            break;
+        }
+        
+        // Another thread added the point after the record was made.
+        if (record != NULL) {
+            record->point = NULL;
+            point_record_free(record);
+        }
+        
+        // If the point found is dropped, p is searched for again.
+        if (_wait_settled(found) == 1) {
+            _touch(ctx, found);
+            return found;
+        }
+    }
+    
+    count = __atomic_add_fetch(&table->count, 1, __ATOMIC_ACQ_REL);
+    _grow_if_needed(table, s, count);
+    
+    if (cell_count > 1) {
+        found = _settle(ctx, tables, p, record, keys, hash_values, cell_count);
+        if (found != NULL) {
+            _touch(ctx, found);
+            return found;
+        }
+    }
+    
+    ctx->point_table_misses++;
+    
+    return NULL;
+}
+
+/*
+* Finds a point in the table equal to p.
+* Safe to call from several threads at once. Counts a hit in the
+* context if the point is found.
+*
+* @ctx: Context holding scratch values, one per thread.
+* @table: Point table to search.
+* @p: Point to find.
+*
+* returns: Record in the table equal to p, or NULL.
+*/
+point_record_t* point_table_find(geometry_context_t* ctx, point_table_t* table, point_t* p) {
+    mp_limb_t* keys[POINT_HASH_MAX_CELLS];
+    unsigned hash_values[POINT_HASH_MAX_CELLS];
+    point_table_t* tables[POINT_HASH_MAX_CELLS];
+    int cell_count;
+    int i;
+    
+    assert(table->is_init == IS_INIT);
+    
+    cell_count = point_hash_cells(ctx, p, keys, hash_values);
+    for (i=0; i<cell_count; i++) {
+        tables[i] = table;
+    }
+    
+    return point_table_find_cells(ctx, tables, p, keys, hash_values, cell_count);
+}
+
+/*
+* Same as point_table_find, with a table for each cell, see
+* point_table_add_cells.
+*
+* @ctx: Context holding scratch values, one per thread.
+* @tables: Table of each cell.
+* @p: Point to find.
+* @keys: Key of each cell, p's own first, see point_hash_cells.
+* @hash_values: Hash of each key.
+* @cell_count: Number of cells.
+*
+* returns: Record equal to p, or NULL.
+*/
+point_record_t* point_table_find_cells(geometry_context_t* ctx, point_table_t** tables, point_t* p, mp_limb_t** keys, unsigned* hash_values, int cell_count) {
+    int i;
+    point_record_t* found;
+    
+    for (i=0; i<cell_count; i++) {
+        found = _find_settled(ctx, tables[i], p, keys[i], hash_values[i]);
+        if (found != NULL) {
+            _touch(ctx, found);
+            return found;
+        }
+    }
+    
+    return NULL;
+}
+
+/*
+* Sets the hash keys of several points and prefetches their slots,
+* so the slots are in cache when the points are added or found.
+*
+* @table: Point table the points will be looked up in.
+* @points: Points to look up.
+* @count: Number of points.
+*/
+void point_table_prefetch(point_table_t* table, point_t** points, size_t count) {
+    point_table_slots_t* s = __atomic_load_n(&table->slots, __ATOMIC_ACQUIRE);
+    size_t mask = s->capacity - 1;
+    size_t i;
+    
+    for (i=0; i<count; i++) {
+        point_ensure_hash(points[i]);
+        __builtin_prefetch(&s->slots[points[i]->hash_value & mask], 0, 1);
+    }
+}
+
+/*
+* Finishes moving to a bigger table if that was started, and frees the
+* old tables. Must not be called while other threads are using the table.
+*
+* @table: Point table.
+*/
+void point_table_reclaim(point_table_t* table) {
+    point_table_slots_t* s;
+    
+    assert(table->is_init == IS_INIT);
+    
+    // The last chunk moved makes the bigger table current, the chunks
+    // are taken from the table being moved.
+    while ((s = table->slots)->next != NULL) {
+        while (_move_chunk(table, s) == 1) {
+        }
+    }
+    
+    while (table->retired != NULL) {
+        s = table->retired;
+        table->retired = s->retired;
+        _slots_free(s);
+    }
+}
+
+/*
+* Iterates the records in the table, skipping dropped records. Must
+* not be called while other threads are using the table.
+*
+* @table: Point table.
+* @position: Set to 0 before the first call, updated by each call.
+*
+* returns: Next record, or NULL after the last record.
+*/
+point_record_t* point_table_next(point_table_t* table, size_t* position) {
+    point_table_slots_t* s;
+    point_record_t* entry;
+    
+    assert(table->is_init == IS_INIT);
+    
+    if (*position == 0) {
+        point_table_reclaim(table);
+    }
+    
+    s = table->slots;
+    
+    while (*position < s->capacity) {
+        entry = s->slots[*position];
+        (*position)++;
+        
+        if (entry != NULL && (entry->flags & POINT_RECORD_DROPPED) == 0) {
+            return entry;
+        }
+    }
+    
+    return NULL;
+}
+
+/*
+* Evicts records until no more than keep are left. The eviction hand
+* moves over the slots from where it last stopped. A record with a
+* clock_count of 0 is evicted and freed, otherwise its clock_count is
+* lowered by one. Only compacted records are evicted, if there aren't
+* enough this stops after every count has reached 0. Dropped records
+* are freed too, they aren't counted as evicted.
+* Must not be called while other threads are using the table.
+*
+* @table: Point table.
+* @keep: Number of points to keep.
+*
+* returns: number of points evicted.
+*/
+size_t point_table_evict(point_table_t* table, size_t keep) {
+    point_table_slots_t* s;
+    point_table_slots_t* kept;
+    size_t evicted = 0;
+    size_t steps;
+    size_t max_steps;
+    size_t i;
+    point_record_t* entry;
+    
+    assert(table->is_init == IS_INIT);
+    
+    point_table_reclaim(table);
+    s = table->slots;
+    
+    // A record at POINT_TABLE_CLOCK_MAX is evicted on the hand's last
+    // pass, if it comes to that.
+    max_steps = s->capacity * (POINT_TABLE_CLOCK_MAX + 2);
+    
+    for (steps=0; steps<max_steps && table->count - table->dropped > keep; steps++) {
+        i = table->clock_hand & (s->capacity - 1);
+        table->clock_hand = i + 1;
+        entry = s->slots[i];
+        
+        if (entry == NULL || entry->point != NULL || (entry->flags & POINT_RECORD_DROPPED)) {
+            continue;
+        }
+        
+        if (entry->clock_count > 0) {
+            entry->clock_count--;
+            continue;
+        }
+        
+        point_record_free(entry);
+        s->slots[i] = NULL;
+        table->count--;
+        evicted++;
+    }
+    
+    if (evicted == 0 && table->dropped == 0) {
+        return 0;
+    }
+    
+    // An emptied slot would end the probe for records after it, so the
+    // records left are moved to a new table of the same size.
+    // Records dropped while adding are freed here too.
+    kept = _slots_alloc(s->capacity);
+    for (i=0; i<s->capacity; i++) {
+        if (s->slots[i] == NULL) {
+            continue;
+        }
+        
+        if (s->slots[i]->flags & POINT_RECORD_DROPPED) {
+            point_record_free(s->slots[i]);
+            table->count--;
+            table->dropped--;
+        } else {
+            _move_into(kept, s->slots[i]);
+        }
+    }
+    
+    _slots_free(s);
+    table->slots = kept;
+    table->evicted += evicted;
+    
+    return evicted;
+}
+
+/*
+* Estimates the memory used by one compacted record in a table,
+* including its share of the slots.
+*
+* returns: number of bytes.
+*/
+size_t point_table_point_bytes() {
+    return point_record_size() + POINT_TABLE_SLOTS_PER_POINT * sizeof(point_record_t*);
+}
@@ -0,0 +1,253 @@
+/*
+* Open addressing hash table of distinct points, shared by threads.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __POINT_TABLE_H__
+#define __POINT_TABLE_H__
+
+#include <stddef.h>
+
+#include "geometry_context.h"
+#include "point.h"
+
+// Starting number of slots, if the caller doesn't ask for more.
+#define POINT_TABLE_START_CAPACITY 1024
+
+// Number of slots moved at a time while the table is resized.
+#define POINT_TABLE_MOVE_CHUNK 256
+
+// Highest point_record_t.clock_count. A point found this many times
+// survives this many passes of the eviction hand without being found
+// again.
+#define POINT_TABLE_CLOCK_MAX 3
+
+// Slots counted for each point when sizing the table to a memory
+// budget. The table is between a quarter and half full.
+#define POINT_TABLE_SLOTS_PER_POINT 3
+
+// Slots in one table. Records are placed at hash_value modulo capacity,
+// or the next empty slot after that (linear probing). Slots only ever
+// change from empty to a record, so threads can add points with a
+// compare and swap on the slot and read without a lock.
+//
+// While the table is being moved to a bigger one, each slot is frozen.
+// An empty slot becomes POINT_TABLE_MOVED, and a record gets its
+// lowest bit set. Nothing can be added to a frozen slot, a thread that
+// finds one adds to the next table instead.
+typedef struct point_table_slots {
+    struct point_record** slots;
+    
+    // Number of slots, a power of 2.
+    size_t capacity;
+    
+    // Bigger table the points are being moved to, or NULL.
+    struct point_table_slots* next;
+    
+    // Next chunk of slots to move, and number of chunks moved.
+    size_t move_position;
+    size_t move_done;
+    
+    // Link in the list of retired tables, see point_table_reclaim.
+    struct point_table_slots* retired;
+} point_table_slots_t;
+
+// Set of distinct points, kept as point records. Threads can add and
+// find points at the same time. When the table gets half full a bigger one is started, and
+// every thread adding a point moves a chunk of the old one across, so
+// no thread has to wait for the whole table to be copied.
+//
+// Points are the same if they have the same hash key. With the hash
+// grid, points in the same or neighboring cells are also compared with
+// point_equals, see point_hash_cells. A point near the edge of its
+// cell is added as POINT_RECORD_PENDING, and the neighboring cells are
+// searched again once it's added, so of two threads adding points within
+// g_epsilon of each other in different cells at the same time only one
+// keeps its point. The other record is dropped, see point_table_add.
+//
+// Once a point has been written to the datastore its record can be
+// compacted, dropping the full point. To keep the table within a
+// budget, compacted records are evicted with the CLOCK algorithm, see
+// point_table_evict, so the points found most often stay in memory.
+typedef struct point_table {
+    // Table points are added to.
+    point_table_slots_t* slots;
+    
+    // Number of records in the table, including dropped records.
+    size_t count;
+    
+    // Number of dropped records, freed by point_table_evict. See
+    // point_table_add.
+    size_t dropped;
+    
+    // Old tables, kept until no thread can be reading them.
+    point_table_slots_t* retired;
+    
+    // Slot the next eviction starts at.
+    size_t clock_hand;
+    
+    // Number of points evicted since the table was initialized.
+    size_t evicted;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} point_table_t;
+
+/*
+* Allocates memory for a new point table.
+*
+* returns: pointer to new point table.
+*/
+point_table_t* point_table_alloc();
+
+/*
+* Initializes new point table. Must be called before use.
+*
+* @table: Point table to initialize.
+* @capacity: Number of slots to start with, rounded up to a power of 2.
+*     The table grows as needed, this only saves resizing.
+*/
+void point_table_init(point_table_t* table, size_t capacity);
+
+/*
+* Frees the point table and all the records and points in it.
+*
+* @table: Point table to free.
+*/
+void point_table_free(point_table_t* table);
+
+/*
+* Removes and frees all the records and points in the table. Must not be called
+* while other threads are using the table.
+*
+* @table: Point table to clear.
+*/
+void point_table_clear(point_table_t* table);
+
+/*
+* Number of points in the table.
+*
+* @table: Point table.
+*
+* returns: number of points.
+*/
+size_t point_table_count(point_table_t* table);
+
+/*
+* Adds a point to the table, unless an equal point is already there.
+* Safe to call from several threads at once. Counts a hit or miss
+* in the context. If another thread adds a point equal to p in a
+* neighboring cell at the same time, only one of the points is kept,
+* the other thread gets the record of the point that was kept. The
+* record of the other point stays in the table as POINT_RECORD_DROPPED,
+* it isn't matched or counted, and is freed by point_table_evict.
+*
+* @ctx: Context holding scratch values, one per thread.
+* @table: Point table to add to.
+* @p: Point to add. If added, a record of the point is made, which
+*     owns the point.
+*
+* returns: NULL if the point was added, otherwise the record already
+*     in the table that is equal to p.
+*/
+point_record_t* point_table_add(geometry_context_t* ctx, point_table_t* table, point_t* p);
+
+/*
+* Same as point_table_add, with a table for each cell. The tables are
+* split so each cell is in one table, see point_shards_add.
+*
+* @ctx: Context holding scratch values, one per thread.
+* @tables: Table of each cell, p is added to the first.
+* @p: Point to add.
+* @keys: Key of each cell, p's own first, see point_hash_cells.
+* @hash_values: Hash of each key.
+* @cell_count: Number of cells.
+*
+* returns: NULL if the point was added, otherwise the record equal to p.
+*/
+point_record_t* point_table_add_cells(geometry_context_t* ctx, point_table_t** tables, point_t* p, mp_limb_t** keys, unsigned* hash_values, int cell_count);
+
+/*
+* Finds a point in the table equal to p.
+* Safe to call from several threads at once. Counts a hit in the
+* context if the point is found.
+*
+* @ctx: Context holding scratch values, one per thread.
+* @table: Point table to search.
+* @p: Point to find.
+*
+* returns: Record in the table equal to p, or NULL.
+*/
+point_record_t* point_table_find(geometry_context_t* ctx, point_table_t* table, point_t* p);
+
+/*
+* Same as point_table_find, with a table for each cell, see
+* point_table_add_cells.
+*
+* @ctx: Context holding scratch values, one per thread.
+* @tables: Table of each cell.
+* @p: Point to find.
+* @keys: Key of each cell, p's own first, see point_hash_cells.
+* @hash_values: Hash of each key.
+* @cell_count: Number of cells.
+*
+* returns: Record equal to p, or NULL.
+*/
+point_record_t* point_table_find_cells(geometry_context_t* ctx, point_table_t** tables, point_t* p, mp_limb_t** keys, unsigned* hash_values, int cell_count);
+
+/*
+* Sets the hash keys of several points and prefetches their slots,
+* so the slots are in cache when the points are added or found.
+*
+* @table: Point table the points will be looked up in.
+* @points: Points to look up.
+* @count: Number of points.
+*/
+void point_table_prefetch(point_table_t* table, point_t** points, size_t count);
+
+/*
+* Finishes moving to a bigger table if that was started, and frees the
+* old tables. Must not be called while other threads are using the table.
+*
+* @table: Point table.
+*/
+void point_table_reclaim(point_table_t* table);
+
+/*
+* Iterates the records in the table, skipping dropped records. Must
+* not be called while other threads are using the table.
+*
+* @table: Point table.
+* @position: Set to 0 before the first call, updated by each call.
+*
+* returns: Next record, or NULL after the last record.
+*/
+point_record_t* point_table_next(point_table_t* table, size_t* position);
+
+/*
+* Evicts records until no more than keep are left. The eviction hand
+* moves over the slots from where it last stopped. A record with a
+* clock_count of 0 is evicted and freed, otherwise its clock_count is
+* lowered by one. Only compacted records are evicted, if there aren't
+* enough this stops after every count has reached 0. Dropped records
+* are freed too, they aren't counted as evicted.
+* Must not be called while other threads are using the table.
+*
+* @table: Point table.
+* @keep: Number of points to keep.
+*
+* returns: number of points evicted.
+*/
+size_t point_table_evict(point_table_t* table, size_t keep);
+
+/*
+* Estimates the memory used by one compacted record in a table,
+* including its share of the slots.
+*
+* returns: number of bytes.
+*/
+size_t point_table_point_bytes();
+
+#endif
@@ -0,0 +1,986 @@
+/*
+* Exact values in a tower of quadratic extensions of the rationals.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <assert.h>
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "quadratic.h"
+
+// Number of coefficients of an element with n levels.
+#define QUAD_COUNT(n) ((size_t)1 << (n))
+
+/*
+* Allocates and initializes an array of rationals, set to zero.
+*
+* @count: Number of values.
+*
+* returns: pointer to the array.
+*/
+static mpq_t* _alloc_array(size_t count) {
+    mpq_t* a = malloc(sizeof(mpq_t) * count);
+    size_t i;
+    global_exit_if_null(a, "Fatal error calling malloc for quadratic coefficients.\n");
+    
+    for (i=0; i<count; i++) {
+        mpq_init(a[i]);
+    }
+    
+    return a;
+}
+
+/*
+* Clears and frees an array of rationals.
+*
+* @a: Array.
+* @count: Number of values.
+*/
+static void _free_array(mpq_t* a, size_t count) {
+    size_t i;
+    
+    if (a == NULL) {
+        return;
+    }
+    
+    for (i=0; i<count; i++) {
+        mpq_clear(a[i]);
+    }
+    
+    free(a);
+}
+
+/*
+* Whether or not every value of an array is zero.
+*/
+static int _is_zero(mpq_t* x, size_t count) {
+    size_t i;
+    
+    for (i=0; i<count; i++) {
+        if (mpq_sgn(x[i]) != 0) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/*
+* Sets every value of an array to zero.
+*/
+static void _set_zero(mpq_t* x, size_t count) {
+    size_t i;
+    
+    for (i=0; i<count; i++) {
+        mpq_set_ui(x[i], 0, 1);
+    }
+}
+
+/*
+* Copies the values of one array to another.
+*/
+static void _copy(mpq_t* r, mpq_t* x, size_t count) {
+    size_t i;
+    
+    for (i=0; i<count; i++) {
+        mpq_set(r[i], x[i]);
+    }
+}
+
+/*
+* Changes the number of levels of an element, new coefficients are zero.
+* Dropped coefficients are lost, outputs are resized with this.
+*
+* @x: Element.
+* @depth: Number of levels.
+*/
+static void _resize(quad_number_t* x, int depth) {
+    size_t old_count = QUAD_COUNT(x->depth);
+    size_t count = QUAD_COUNT(depth);
+    size_t i;
+    
+    if (depth == x->depth) {
+        return;
+    }
+    
+    for (i=count; i<old_count; i++) {
+        mpq_clear(x->c[i]);
+    }
+    
+    // The mpq_t values only point to their limbs, so they can be moved.
+    x->c = realloc(x->c, sizeof(mpq_t) * count);
+    global_exit_if_null(x->c, "Fatal error calling realloc for quadratic coefficients.\n");
+    
+    for (i=old_count; i<count; i++) {
+        mpq_init(x->c[i]);
+    }
+    
+    x->depth = depth;
+}
+
+/*
+* Product of two elements with n levels. r can be x or y.
+*
+* @ctx: Context holding temporary values, level n is used.
+* @t: Tower.
+* @n: Number of levels.
+* @r: Set to x * y.
+* @x: First element.
+* @y: Second element.
+*/
+static void _mul(quad_context_t* ctx, quad_tower_t* t, int n, mpq_t* r, mpq_t* x, mpq_t* y) {
+    mpq_t** s;
+    size_t h;
+    int xb_zero, yb_zero;
+    size_t i;
+    
+    if (n == 0) {
+        mpq_mul(r[0], x[0], y[0]);
+        return;
+    }
+    
+    s = ctx->t[n];
+    h = QUAD_COUNT(n - 1);
+    
+    xb_zero = _is_zero(x + h, h);
+    yb_zero = _is_zero(y + h, h);
+    
+    // Elements padded to the tower are mostly from lower levels,
+    // without the sqrt(a) product.
+    if (xb_zero || yb_zero) {
+        _mul(ctx, t, n - 1, s[0], x, y);
+    
+        if (xb_zero) {
+            _mul(ctx, t, n - 1, s[2], x, y + h);
+        } else {
+            _mul(ctx, t, n - 1, s[2], x + h, y);
+        }
+    
+        _copy(r, s[0], h);
+        _copy(r + h, s[2], h);
+        return;
+    }
+    
+    // (xa + xb * sqrt(a)) * (ya + yb * sqrt(a))
+    //     = (xa * ya + xb * yb * a) + (xa * yb + xb * ya) * sqrt(a)
+    _mul(ctx, t, n - 1, s[0], x, y);
+    _mul(ctx, t, n - 1, s[1], x + h, y + h);
+    _mul(ctx, t, n - 1, s[1], s[1], t->radicands[n - 1]);
+    _mul(ctx, t, n - 1, s[2], x, y + h);
+    _mul(ctx, t, n - 1, s[3], x + h, y);
+    
+    for (i=0; i<h; i++) {
+        mpq_add(r[i], s[0][i], s[1][i]);
+        mpq_add(r[h + i], s[2][i], s[3][i]);
+    }
+}
+
+/*
+* Inverse of an element with n levels. r can be x.
+*
+* @ctx: Context holding temporary values, level n is used.
+* @t: Tower.
+* @n: Number of levels.
+* @r: Set to 1 / x.
+* @x: Element, must not be zero.
+*/
+static void _inv(quad_context_t* ctx, quad_tower_t* t, int n, mpq_t* r, mpq_t* x) {
+    mpq_t** s;
+    size_t h;
+    size_t i;
+    
+    if (n == 0) {
+        mpq_inv(r[0], x[0]);
+        return;
+    }
+    
+    s = ctx->t[n];
+    h = QUAD_COUNT(n - 1);
+    
+    if (_is_zero(x + h, h)) {
+        _inv(ctx, t, n - 1, r, x);
+        _set_zero(r + h, h);
+        return;
+    }
+    
+    // 1 / (xa + xb * sqrt(a)) = (xa - xb * sqrt(a)) / (xa^2 - xb^2 * a)
+    // The norm xa^2 - xb^2 * a isn't zero, since a isn't a square.
+    _mul(ctx, t, n - 1, s[0], x, x);
+    _mul(ctx, t, n - 1, s[1], x + h, x + h);
+    _mul(ctx, t, n - 1, s[1], s[1], t->radicands[n - 1]);
+    for (i=0; i<h; i++) {
+        mpq_sub(s[0][i], s[0][i], s[1][i]);
+    }
+    
+    _inv(ctx, t, n - 1, s[1], s[0]);
+    _mul(ctx, t, n - 1, s[2], x, s[1]);
+    _mul(ctx, t, n - 1, s[3], x + h, s[1]);
+    
+    for (i=0; i<h; i++) {
+        mpq_set(r[i], s[2][i]);
+        mpq_neg(r[h + i], s[3][i]);
+    }
+}
+
+/*
+* Value of an element with n levels.
+*
+* @ctx: Context holding temporary values, level n is used.
+* @t: Tower.
+* @n: Number of levels.
+* @rop: Set to the value.
+* @x: Element.
+*/
+static void _eval(quad_context_t* ctx, quad_tower_t* t, int n, mpf_t rop, mpq_t* x) {
+    size_t h;
+    
+    if (n == 0) {
+        mpf_set_q(rop, x[0]);
+        return;
+    }
+    
+    h = QUAD_COUNT(n - 1);
+    
+    _eval(ctx, t, n - 1, ctx->e[n][0], x);
+    
+    if (_is_zero(x + h, h)) {
+        mpf_set(rop, ctx->e[n][0]);
+        return;
+    }
+    
+    _eval(ctx, t, n - 1, ctx->e[n][1], x + h);
+    mpf_mul(ctx->e[n][1], ctx->e[n][1], t->roots[n - 1]);
+    mpf_add(rop, ctx->e[n][0], ctx->e[n][1]);
+}
+
+/*
+* Finds the non negative square root of an element with n levels,
+* if it's a square in the tower. r can be x.
+*
+* @ctx: Context holding temporary values, level n is used.
+* @t: Tower.
+* @n: Number of levels.
+* @r: Set to the square root, if found.
+* @x: Element.
+*
+* returns: 1 if x is a square, otherwise 0.
+*/
+static int _sqrt(quad_context_t* ctx, quad_tower_t* t, int n, mpq_t* r, mpq_t* x) {
+    mpq_t** s;
+    size_t h, i;
+    int sign;
+    
+    if (n == 0) {
+        if (mpq_sgn(x[0]) < 0
+            || mpz_perfect_square_p(mpq_numref(x[0])) == 0
+            || mpz_perfect_square_p(mpq_denref(x[0])) == 0) {
+            return 0;
+        }
+    
+        // The roots of a numerator and denominator with no common
+        // factor have no common factor, so this is still canonical.
+        mpz_sqrt(mpq_numref(r[0]), mpq_numref(x[0]));
+        mpz_sqrt(mpq_denref(r[0]), mpq_denref(x[0]));
+        return 1;
+    }
+    
+    s = ctx->t[n];
+    h = QUAD_COUNT(n - 1);
+    
+    // (c + d * sqrt(a))^2 = c^2 + d^2 * a + 2 * c * d * sqrt(a)
+    
+    if (_is_zero(x + h, h)) {
+        // c = 0 or d = 0, x = c^2 or x = d^2 * a.
+        if (_sqrt(ctx, t, n - 1, s[0], x)) {
+            _copy(r, s[0], h);
+            _set_zero(r + h, h);
+            return 1;
+        }
+    
+        _inv(ctx, t, n - 1, s[1], t->radicands[n - 1]);
+        _mul(ctx, t, n - 1, s[1], s[1], x);
+    
+        if (_sqrt(ctx, t, n - 1, s[0], s[1])) {
+            _set_zero(r, h);
+            _copy(r + h, s[0], h);
+            return 1;
+        }
+    
+        return 0;
+    }
+    
+    // c^2 = (xa +/- sqrt(xa^2 - xb^2 * a)) / 2, d = xb / (2 * c)
+    _mul(ctx, t, n - 1, s[0], x, x);
+    _mul(ctx, t, n - 1, s[1], x + h, x + h);
+    _mul(ctx, t, n - 1, s[1], s[1], t->radicands[n - 1]);
+    for (i=0; i<h; i++) {
+        mpq_sub(s[0][i], s[0][i], s[1][i]);
+    }
+    
+    if (_sqrt(ctx, t, n - 1, s[1], s[0]) == 0) {
+        return 0;
+    }
+    
+    for (sign=1; sign>=-1; sign-=2) {
+        for (i=0; i<h; i++) {
+            if (sign > 0) {
+                mpq_add(s[2][i], x[i], s[1][i]);
+            } else {
+                mpq_sub(s[2][i], x[i], s[1][i]);
+            }
+            mpq_div_2exp(s[2][i], s[2][i], 1);
+        }
+    
+        if (_is_zero(s[2], h) || _sqrt(ctx, t, n - 1, s[3], s[2]) == 0) {
+            continue;
+        }
+    
+        _inv(ctx, t, n - 1, s[2], s[3]);
+        _mul(ctx, t, n - 1, s[2], s[2], x + h);
+        for (i=0; i<h; i++) {
+            mpq_div_2exp(s[2][i], s[2][i], 1);
+        }
+    
+        _copy(r, s[3], h);
+        _copy(r + h, s[2], h);
+    
+        // c + d * sqrt(a) can be the negative root.
+        _eval(ctx, t, n, ctx->value, r);
+        if (mpf_sgn(ctx->value) < 0) {
+            for (i=0; i<QUAD_COUNT(n); i++) {
+                mpq_neg(r[i], r[i]);
+            }
+        }
+    
+        return 1;
+    }
+    
+    return 0;
+}
+
+/*
+* Adds a level to a tower.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower, must have less than QUAD_MAX_DEPTH levels.
+* @radicand: Radicand of the new level, with t->depth levels.
+*     Must not be a square in t, and must be positive.
+*/
+static void _extend(quad_context_t* ctx, quad_tower_t* t, mpq_t* radicand) {
+    int n = t->depth;
+    
+    assert(n < QUAD_MAX_DEPTH);
+    
+    t->radicands[n] = _alloc_array(QUAD_COUNT(n));
+    _copy(t->radicands[n], radicand, QUAD_COUNT(n));
+    
+    mpf_init(t->roots[n]);
+    _eval(ctx, t, n, t->roots[n], radicand);
+    mpf_sqrt(t->roots[n], t->roots[n]);
+    
+    t->depth++;
+}
+
+/*
+* Allocates memory for a new context.
+*
+* returns: pointer to new context.
+*/
+quad_context_t* quad_context_alloc() {
+    quad_context_t* ctx = malloc(sizeof(quad_context_t));
+    global_exit_if_null(ctx, "Fatal error calling malloc for quad_context_t.\n");
+    memset(ctx, 0, sizeof(quad_context_t));
+    
+    return ctx;
+}
+
+/*
+* Initializes new context. Must be called before use, and
+* after global_init.
+*
+* @ctx: Context to initialize.
+*/
+void quad_context_init(quad_context_t* ctx) {
+    int n, k;
+    
+    if (ctx->is_init == IS_INIT) {
+        return;
+    }
+    
+    for (n=0; n<=QUAD_MAX_DEPTH; n++) {
+        if (n > 0) {
+            for (k=0; k<QUAD_LEVEL_TEMPS; k++) {
+                ctx->t[n][k] = _alloc_array(QUAD_COUNT(n - 1));
+            }
+        }
+    
+        mpf_init(ctx->e[n][0]);
+        mpf_init(ctx->e[n][1]);
+    }
+    
+    ctx->full = _alloc_array(QUAD_COUNT(QUAD_MAX_DEPTH));
+    mpf_init(ctx->value);
+    mpz_init(ctx->z1);
+    mpz_init(ctx->z2);
+    
+    ctx->is_init = IS_INIT;
+}
+
+/*
+* Frees resources used by the context.
+*
+* @ctx: Context to free.
+*/
+void quad_context_free(quad_context_t* ctx) {
+    int n, k;
+    
+    if (ctx == NULL) {
+        return;
+    }
+    
+    if (ctx->is_init == IS_INIT) {
+        for (n=0; n<=QUAD_MAX_DEPTH; n++) {
+            if (n > 0) {
+                for (k=0; k<QUAD_LEVEL_TEMPS; k++) {
+                    _free_array(ctx->t[n][k], QUAD_COUNT(n - 1));
+                }
+            }
+    
+            mpf_clear(ctx->e[n][0]);
+            mpf_clear(ctx->e[n][1]);
+        }
+    
+        _free_array(ctx->full, QUAD_COUNT(QUAD_MAX_DEPTH));
+        mpf_clear(ctx->value);
+        mpz_clear(ctx->z1);
+        mpz_clear(ctx->z2);
+    
+        ctx->is_init = 0;
+    }
+    
+    free(ctx);
+}
+
+/*
+* Allocates memory for a new tower.
+*
+* returns: pointer to new tower.
+*/
+quad_tower_t* quad_tower_alloc() {
+    quad_tower_t* t = malloc(sizeof(quad_tower_t));
+    global_exit_if_null(t, "Fatal error calling malloc for quad_tower_t.\n");
+    memset(t, 0, sizeof(quad_tower_t));
+    
+    return t;
+}
+
+/*
+* Initializes new tower, the rationals with no levels. Must be called
+* before use, and after global_init.
+*
+* @t: Tower to initialize.
+*/
+void quad_tower_init(quad_tower_t* t) {
+    if (t->is_init == IS_INIT) {
+        return;
+    }
+    
+    t->depth = 0;
+    t->is_init = IS_INIT;
+}
+
+/*
+* Removes every level of a tower.
+*
+* @t: Tower.
+*/
+static void _tower_clear(quad_tower_t* t) {
+    int n;
+    
+    for (n=0; n<t->depth; n++) {
+        _free_array(t->radicands[n], QUAD_COUNT(n));
+        t->radicands[n] = NULL;
+        mpf_clear(t->roots[n]);
+    }
+    
+    t->depth = 0;
+}
+
+/*
+* Frees resources used by the tower.
+*
+* @t: Tower to free.
+*/
+void quad_tower_free(quad_tower_t* t) {
+    if (t == NULL) {
+        return;
+    }
+    
+    if (t->is_init == IS_INIT) {
+        _tower_clear(t);
+        t->is_init = 0;
+    }
+    
+    free(t);
+}
+
+/*
+* Copies the levels of one tower to another.
+*
+* @copy_to: Tower that will get the levels.
+* @copy_from: Tower levels are copied from.
+*/
+void quad_tower_copy(quad_tower_t* copy_to, quad_tower_t* copy_from) {
+    int n;
+    
+    assert(copy_to->is_init == IS_INIT);
+    assert(copy_from->is_init == IS_INIT);
+    
+    if (copy_to == copy_from) {
+        return;
+    }
+    
+    _tower_clear(copy_to);
+    
+    for (n=0; n<copy_from->depth; n++) {
+        copy_to->radicands[n] = _alloc_array(QUAD_COUNT(n));
+        _copy(copy_to->radicands[n], copy_from->radicands[n], QUAD_COUNT(n));
+    
+        mpf_init(copy_to->roots[n]);
+        mpf_set(copy_to->roots[n], copy_from->roots[n]);
+    }
+    
+    copy_to->depth = copy_from->depth;
+}
+
+/*
+* Checks if two towers have the same levels, so their elements can be
+* compared without merging them.
+*
+* @t1: First tower.
+* @t2: Second tower.
+*
+* returns: 1 if the towers are the same, otherwise 0.
+*/
+int quad_tower_equal(quad_tower_t* t1, quad_tower_t* t2) {
+    int n;
+    size_t i;
+    
+    if (t1 == t2) {
+        return 1;
+    }
+    
+    if (t1->depth != t2->depth) {
+        return 0;
+    }
+    
+    for (n=0; n<t1->depth; n++) {
+        for (i=0; i<QUAD_COUNT(n); i++) {
+            if (mpq_equal(t1->radicands[n][i], t2->radicands[n][i]) == 0) {
+                return 0;
+            }
+        }
+    }
+    
+    return 1;
+}
+
+/*
+* Finds the non negative square root of x, adding a level to the tower
+* if x isn't a square in the tower. Rational radicands are made into
+* integers with the squares of primes up to QUAD_SQUARE_FREE_PRIME_MAX
+* divided out, so Q(sqrt(3)) and Q(sqrt(12)) are the same tower.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower.
+* @r: Set to the square root.
+* @x: Value, must not be negative.
+*
+* returns: 1 if the square root was found, 0 if the tower already has
+*     QUAD_MAX_DEPTH levels and x isn't a square in it.
+*/
+int quad_tower_sqrt(quad_context_t* ctx, quad_tower_t* t, quad_number_t* r, quad_number_t* x) {
+    int n = t->depth;
+    unsigned long p;
+    
+    quad_resize(x, n);
+    _resize(r, n);
+    
+    if (_sqrt(ctx, t, n, r->c, x->c)) {
+        return 1;
+    }
+    
+    if (n == QUAD_MAX_DEPTH) {
+        return 0;
+    }
+    
+    if (_is_zero(x->c + 1, QUAD_COUNT(n) - 1) == 0) {
+        _extend(ctx, t, x->c);
+    
+        _resize(r, n + 1);
+        _set_zero(r->c, QUAD_COUNT(n + 1));
+        mpq_set_ui(r->c[QUAD_COUNT(n)], 1, 1);
+    
+        return 1;
+    }
+    
+    // sqrt(p / q) = sqrt(p * q) / q, and p * q = s^2 * m
+    // z1 => m, z2 => s
+    mpz_mul(ctx->z1, mpq_numref(x->c[0]), mpq_denref(x->c[0]));
+    mpz_set_ui(ctx->z2, 1);
+    
+    // Composite numbers never divide, their primes are already out.
+    for (p=2; p<=QUAD_SQUARE_FREE_PRIME_MAX; p++) {
+        while (mpz_divisible_ui_p(ctx->z1, p * p)) {
+            mpz_divexact_ui(ctx->z1, ctx->z1, p * p);
+            mpz_mul_ui(ctx->z2, ctx->z2, p);
+        }
+    }
+    
+    _set_zero(ctx->full, QUAD_COUNT(n));
+    mpq_set_z(ctx->full[0], ctx->z1);
+    _extend(ctx, t, ctx->full);
+    
+    _resize(r, n + 1);
+    _set_zero(r->c, QUAD_COUNT(n + 1));
+    mpq_set_z(r->c[QUAD_COUNT(n)], ctx->z2);
+    mpz_set(ctx->z1, mpq_denref(x->c[0]));
+    mpq_set_z(r->c[0], ctx->z1);
+    mpq_div(r->c[QUAD_COUNT(n)], r->c[QUAD_COUNT(n)], r->c[0]);
+    mpq_set_ui(r->c[0], 0, 1);
+    
+    return 1;
+}
+
+/*
+* Adds the levels of another tower to a tower, except levels whose
+* square root is already in the tower. Elements of the other tower
+* are then moved to the tower with quad_map.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower to add levels to.
+* @from: Tower to add.
+* @map: Array of from->depth initialized elements, set to the square
+*     root of each level of from as an element of t.
+*
+* returns: 1 if the towers were merged, 0 if the merged tower would
+*     have more than QUAD_MAX_DEPTH levels.
+*/
+int quad_tower_merge(quad_context_t* ctx, quad_tower_t* t, quad_tower_t* from, quad_number_t* map) {
+    quad_number_t radicand;
+    quad_number_t y;
+    int result = 1;
+    int n;
+    
+    quad_init(&y);
+    
+    for (n=0; n<from->depth; n++) {
+        // Level n of from as an element of t, the levels below
+        // are already in map.
+        radicand.depth = n;
+        radicand.c = from->radicands[n];
+        quad_map(ctx, t, &y, &radicand, map);
+    
+        if (quad_tower_sqrt(ctx, t, &map[n], &y) == 0) {
+            result = 0;
+            break;
+        }
+    }
+    
+    quad_clear(&y);
+    
+    return result;
+}
+
+/*
+* Moves an element of one tower to another, see quad_tower_merge.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower the element is moved to.
+* @r: Set to the element in t. Must not be x.
+* @x: Element of the tower that was merged into t.
+* @map: Square roots of the levels of x's tower, from quad_tower_merge.
+*/
+void quad_map(quad_context_t* ctx, quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* map) {
+    quad_number_t term;
+    size_t i;
+    int n;
+    
+    assert(r != x);
+    
+    quad_init(&term);
+    _resize(r, t->depth);
+    _set_zero(r->c, QUAD_COUNT(t->depth));
+    
+    // x = sum of c[i] * product of the roots of the levels set in i
+    for (i=0; i<QUAD_COUNT(x->depth); i++) {
+        if (mpq_sgn(x->c[i]) == 0) {
+            continue;
+        }
+    
+        quad_set_q(&term, x->c[i]);
+    
+        for (n=0; n<x->depth; n++) {
+            if (i & QUAD_COUNT(n)) {
+                quad_mul(ctx, t, &term, &term, &map[n]);
+            }
+        }
+    
+        quad_add(t, r, r, &term);
+    }
+    
+    quad_clear(&term);
+}
+
+/*
+* Initializes new element, set to zero.
+*
+* @x: Element to initialize.
+*/
+void quad_init(quad_number_t* x) {
+    x->depth = 0;
+    x->c = _alloc_array(1);
+}
+
+/*
+* Frees resources used by the element.
+*
+* @x: Element to clear.
+*/
+void quad_clear(quad_number_t* x) {
+    _free_array(x->c, QUAD_COUNT(x->depth));
+    x->c = NULL;
+    x->depth = 0;
+}
+
+/*
+* Pads an element with zero coefficients, or drops coefficients, to
+* the number of levels. Coefficients that are dropped must be zero.
+*
+* @x: Element.
+* @depth: Number of levels.
+*/
+void quad_resize(quad_number_t* x, int depth) {
+    if (depth < x->depth) {
+        assert(_is_zero(x->c + QUAD_COUNT(depth), QUAD_COUNT(x->depth) - QUAD_COUNT(depth)));
+    }
+    
+    _resize(x, depth);
+}
+
+/*
+* Sets r to x.
+*/
+void quad_set(quad_number_t* r, quad_number_t* x) {
+    if (r == x) {
+        return;
+    }
+    
+    if (r->depth < x->depth) {
+        quad_resize(r, x->depth);
+    }
+    
+    _copy(r->c, x->c, QUAD_COUNT(x->depth));
+    _set_zero(r->c + QUAD_COUNT(x->depth), QUAD_COUNT(r->depth) - QUAD_COUNT(x->depth));
+}
+
+/*
+* Sets r to a rational value.
+*/
+void quad_set_q(quad_number_t* r, mpq_t q) {
+    _set_zero(r->c, QUAD_COUNT(r->depth));
+    mpq_set(r->c[0], q);
+}
+
+/*
+* Sets r to an integer value.
+*/
+void quad_set_si(quad_number_t* r, long v) {
+    _set_zero(r->c, QUAD_COUNT(r->depth));
+    mpq_set_si(r->c[0], v, 1);
+}
+
+/*
+* r = x + y
+*/
+void quad_add(quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* y) {
+    size_t i;
+    
+    _resize(r, t->depth);
+    quad_resize(x, t->depth);
+    quad_resize(y, t->depth);
+    
+    for (i=0; i<QUAD_COUNT(t->depth); i++) {
+        mpq_add(r->c[i], x->c[i], y->c[i]);
+    }
+}
+
+/*
+* r = x - y
+*/
+void quad_sub(quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* y) {
+    size_t i;
+    
+    _resize(r, t->depth);
+    quad_resize(x, t->depth);
+    quad_resize(y, t->depth);
+    
+    for (i=0; i<QUAD_COUNT(t->depth); i++) {
+        mpq_sub(r->c[i], x->c[i], y->c[i]);
+    }
+}
+
+/*
+* r = -x
+*/
+void quad_neg(quad_tower_t* t, quad_number_t* r, quad_number_t* x) {
+    size_t i;
+    
+    _resize(r, t->depth);
+    quad_resize(x, t->depth);
+    
+    for (i=0; i<QUAD_COUNT(t->depth); i++) {
+        mpq_neg(r->c[i], x->c[i]);
+    }
+}
+
+/*
+* r = x * y
+*/
+void quad_mul(quad_context_t* ctx, quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* y) {
+    _resize(r, t->depth);
+    quad_resize(x, t->depth);
+    quad_resize(y, t->depth);
+    
+    _mul(ctx, t, t->depth, r->c, x->c, y->c);
+}
+
+/*
+* r = x / y, y must not be zero.
+*/
+void quad_div(quad_context_t* ctx, quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* y) {
+    assert(quad_is_zero(y) == 0);
+    
+    _resize(r, t->depth);
+    quad_resize(x, t->depth);
+    quad_resize(y, t->depth);
+    
+    _inv(ctx, t, t->depth, ctx->full, y->c);
+    _mul(ctx, t, t->depth, r->c, x->c, ctx->full);
+}
+
+/*
+* Multiplies an element by a rational value.
+*/
+void quad_mul_q(quad_tower_t* t, quad_number_t* r, quad_number_t* x, mpq_t q) {
+    size_t i;
+    
+    _resize(r, t->depth);
+    quad_resize(x, t->depth);
+    
+    for (i=0; i<QUAD_COUNT(t->depth); i++) {
+        mpq_mul(r->c[i], x->c[i], q);
+    }
+}
+
+/*
+* Finds the value of an element, with the positive square root
+* of each level.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower.
+* @rop: Set to the value.
+* @x: Element.
+*/
+void quad_get_mpf(quad_context_t* ctx, quad_tower_t* t, mpf_t rop, quad_number_t* x) {
+    quad_resize(x, t->depth);
+    
+    _eval(ctx, t, t->depth, rop, x->c);
+}
+
+/*
+* Whether or not an element is zero. This is exact.
+*
+* returns: 1 if every coefficient is zero, otherwise 0.
+*/
+int quad_is_zero(quad_number_t* x) {
+    return _is_zero(x->c, QUAD_COUNT(x->depth));
+}
+
+/*
+* Sign of an element. Zero is exact, the sign of other values is the
+* sign of their mpf value.
+*
+* returns: -1, 0, or 1.
+*/
+int quad_sgn(quad_context_t* ctx, quad_tower_t* t, quad_number_t* x) {
+    if (quad_is_zero(x)) {
+        return 0;
+    }
+    
+    quad_get_mpf(ctx, t, ctx->value, x);
+    
+    return mpf_sgn(ctx->value);
+}
+
+/*
+* Compares two elements of the same tower.
+*
+* returns: 1 if they're equal, otherwise 0.
+*/
+int quad_equal(quad_tower_t* t, quad_number_t* x, quad_number_t* y) {
+    size_t i;
+    
+    quad_resize(x, t->depth);
+    quad_resize(y, t->depth);
+    
+    for (i=0; i<QUAD_COUNT(t->depth); i++) {
+        if (mpq_equal(x->c[i], y->c[i]) == 0) {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/*
+* Writes an array of coefficients to stdout.
+*/
+static void _printf_array(mpq_t* x, size_t count) {
+    size_t i;
+    
+    printf("{");
+    for (i=0; i<count; i++) {
+        gmp_printf(i == 0 ? "%Qd" : ", %Qd", x[i]);
+    }
+    printf("}");
+}
+
+/*
+* Writes an element to stdout, as the coefficients and the
+* radicands of the tower.
+*
+* @t: Tower.
+* @x: Element.
+*/
+void quad_printf(quad_tower_t* t, quad_number_t* x) {
+    int n;
+    
+    _printf_array(x->c, QUAD_COUNT(x->depth));
+    
+    for (n=0; n<t->depth; n++) {
+        printf(n == 0 ? " in Q(sqrt(" : ", sqrt(");
+        _printf_array(t->radicands[n], QUAD_COUNT(n));
+        printf(")");
+    }
+    
+    if (t->depth > 0) {
+        printf(")");
+    }
+}
@@ -0,0 +1,293 @@
+/*
+* Exact values in a tower of quadratic extensions of the rationals.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __QUADRATIC_H__
+#define __QUADRATIC_H__
+
+#include <stdio.h> // recommended to include stdio before gmp
+#include <gmp.h>
+
+// Most levels in a tower. Each level doubles the number of
+// coefficients of an element.
+#define QUAD_MAX_DEPTH 8
+
+// Temporary elements kept for each level, see quad_context_t.
+#define QUAD_LEVEL_TEMPS 4
+
+// Primes up to this are divided out of rational radicands,
+// see quad_tower_sqrt.
+#define QUAD_SQUARE_FREE_PRIME_MAX 1000
+
+// Tower Q(sqrt(r0))(sqrt(r1))...(sqrt(r(depth - 1))). Each radicand
+// r_i is an element of the tower of the levels below i, and is not a
+// square there, so every value in the tower has exactly one set of
+// coefficients. Values from different towers are compared by merging
+// one tower into the other, see quad_tower_merge.
+typedef struct quad_tower {
+    // Number of levels.
+    int depth;
+    
+    // Radicand of each level, radicands[i] has 2^i coefficients.
+    mpq_t* radicands[QUAD_MAX_DEPTH];
+    
+    // Positive square root of each radicand, for the value of
+    // an element, see quad_get_mpf.
+    mpf_t roots[QUAD_MAX_DEPTH];
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} quad_tower_t;
+
+// Element of a tower. Coefficient i is the coefficient of the product
+// of the square roots of the levels set in the bits of i, so c[0] is
+// the rational part. Elements are padded with zero coefficients to the
+// depth of the tower they're used with.
+typedef struct quad_number {
+    // Number of levels, there are 2^depth coefficients.
+    int depth;
+    
+    mpq_t* c;
+} quad_number_t;
+
+// Temporary values used by the tower calculations. Level n has
+// QUAD_LEVEL_TEMPS elements of 2^(n - 1) coefficients, the halves of an
+// element of depth n. A calculation at level n only calls calculations
+// at level n - 1, so the levels don't overwrite each other.
+//
+// A context must only be used by one thread at a time.
+typedef struct quad_context {
+    mpq_t* t[QUAD_MAX_DEPTH + 1][QUAD_LEVEL_TEMPS];
+    mpf_t e[QUAD_MAX_DEPTH + 1][2];
+    
+    // Element with QUAD_MAX_DEPTH levels, for quad_div.
+    mpq_t* full;
+    
+    mpf_t value;
+    mpz_t z1;
+    mpz_t z2;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} quad_context_t;
+
+/*
+* Allocates memory for a new context.
+*
+* returns: pointer to new context.
+*/
+quad_context_t* quad_context_alloc();
+
+/*
+* Initializes new context. Must be called before use, and
+* after global_init.
+*
+* @ctx: Context to initialize.
+*/
+void quad_context_init(quad_context_t* ctx);
+
+/*
+* Frees resources used by the context.
+*
+* @ctx: Context to free.
+*/
+void quad_context_free(quad_context_t* ctx);
+
+/*
+* Allocates memory for a new tower.
+*
+* returns: pointer to new tower.
+*/
+quad_tower_t* quad_tower_alloc();
+
+/*
+* Initializes new tower, the rationals with no levels. Must be called
+* before use, and after global_init.
+*
+* @t: Tower to initialize.
+*/
+void quad_tower_init(quad_tower_t* t);
+
+/*
+* Frees resources used by the tower.
+*
+* @t: Tower to free.
+*/
+void quad_tower_free(quad_tower_t* t);
+
+/*
+* Copies the levels of one tower to another.
+*
+* @copy_to: Tower that will get the levels.
+* @copy_from: Tower levels are copied from.
+*/
+void quad_tower_copy(quad_tower_t* copy_to, quad_tower_t* copy_from);
+
+/*
+* Checks if two towers have the same levels, so their elements can be
+* compared without merging them.
+*
+* @t1: First tower.
+* @t2: Second tower.
+*
+* returns: 1 if the towers are the same, otherwise 0.
+*/
+int quad_tower_equal(quad_tower_t* t1, quad_tower_t* t2);
+
+/*
+* Finds the non negative square root of x, adding a level to the tower
+* if x isn't a square in the tower. Rational radicands are made into
+* integers with the squares of primes up to QUAD_SQUARE_FREE_PRIME_MAX
+* divided out, so Q(sqrt(3)) and Q(sqrt(12)) are the same tower.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower.
+* @r: Set to the square root.
+* @x: Value, must not be negative.
+*
+* returns: 1 if the square root was found, 0 if the tower already has
+*     QUAD_MAX_DEPTH levels and x isn't a square in it.
+*/
+int quad_tower_sqrt(quad_context_t* ctx, quad_tower_t* t, quad_number_t* r, quad_number_t* x);
+
+/*
+* Adds the levels of another tower to a tower, except levels whose
+* square root is already in the tower. Elements of the other tower
+* are then moved to the tower with quad_map.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower to add levels to.
+* @from: Tower to add.
+* @map: Array of from->depth initialized elements, set to the square
+*     root of each level of from as an element of t.
+*
+* returns: 1 if the towers were merged, 0 if the merged tower would
+*     have more than QUAD_MAX_DEPTH levels.
+*/
+int quad_tower_merge(quad_context_t* ctx, quad_tower_t* t, quad_tower_t* from, quad_number_t* map);
+
+/*
+* Moves an element of one tower to another, see quad_tower_merge.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower the element is moved to.
+* @r: Set to the element in t. Must not be x.
+* @x: Element of the tower that was merged into t.
+* @map: Square roots of the levels of x's tower, from quad_tower_merge.
+*/
+void quad_map(quad_context_t* ctx, quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* map);
+
+/*
+* Initializes new element, set to zero.
+*
+* @x: Element to initialize.
+*/
+void quad_init(quad_number_t* x);
+
+/*
+* Frees resources used by the element.
+*
+* @x: Element to clear.
+*/
+void quad_clear(quad_number_t* x);
+
+/*
+* Pads an element with zero coefficients, or drops coefficients, to
+* the number of levels. Coefficients that are dropped must be zero.
+*
+* @x: Element.
+* @depth: Number of levels.
+*/
+void quad_resize(quad_number_t* x, int depth);
+
+/*
+* Sets r to x.
+*/
+void quad_set(quad_number_t* r, quad_number_t* x);
+
+/*
+* Sets r to a rational value.
+*/
+void quad_set_q(quad_number_t* r, mpq_t q);
+
+/*
+* Sets r to an integer value.
+*/
+void quad_set_si(quad_number_t* r, long v);
+
+/*
+* r = x + y
+*/
+void quad_add(quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* y);
+
+/*
+* r = x - y
+*/
+void quad_sub(quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* y);
+
+/*
+* r = -x
+*/
+void quad_neg(quad_tower_t* t, quad_number_t* r, quad_number_t* x);
+
+/*
+* r = x * y
+*/
+void quad_mul(quad_context_t* ctx, quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* y);
+
+/*
+* r = x / y, y must not be zero.
+*/
+void quad_div(quad_context_t* ctx, quad_tower_t* t, quad_number_t* r, quad_number_t* x, quad_number_t* y);
+
+/*
+* Multiplies an element by a rational value.
+*/
+void quad_mul_q(quad_tower_t* t, quad_number_t* r, quad_number_t* x, mpq_t q);
+
+/*
+* Finds the value of an element, with the positive square root
+* of each level.
+*
+* @ctx: Context holding temporary values.
+* @t: Tower.
+* @rop: Set to the value.
+* @x: Element.
+*/
+void quad_get_mpf(quad_context_t* ctx, quad_tower_t* t, mpf_t rop, quad_number_t* x);
+
+/*
+* Whether or not an element is zero. This is exact.
+*
+* returns: 1 if every coefficient is zero, otherwise 0.
+*/
+int quad_is_zero(quad_number_t* x);
+
+/*
+* Sign of an element. Zero is exact, the sign of other values is the
+* sign of their mpf value.
+*
+* returns: -1, 0, or 1.
+*/
+int quad_sgn(quad_context_t* ctx, quad_tower_t* t, quad_number_t* x);
+
+/*
+* Compares two elements of the same tower.
+*
+* returns: 1 if they're equal, otherwise 0.
+*/
+int quad_equal(quad_tower_t* t, quad_number_t* x, quad_number_t* y);
+
+/*
+* Writes an element to stdout, as the coefficients and the
+* radicands of the tower.
+*
+* @t: Tower.
+* @x: Element.
+*/
+void quad_printf(quad_tower_t* t, quad_number_t* x);
+
+#endif
@@ -8,17 +8,33 @@
 #include <stdio.h> // recommended to include stdio before gmp
 #include <gmp.h>
 #include <assert.h>
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
 
 #include "global.h"
+#include "geometry_context.h"
 #include "point.h"
 #include "line.h"
 #include "circle.h"
+#include "fixed.h"
+#include "double_double.h"
+#include "numeric.h"
+#include "interval.h"
+#include "pair.h"
+#include "object_table.h"
+#include "point_table.h"
+#include "point_shards.h"
+#include "point_runs.h"
+#include "point_grid.h"
+#include "quadratic.h"
 
 // internal variables use for calculation.
+static geometry_context_t* _ctx;
 static point_t* _p1;
 static point_t* _p2;
-static point_t* _pa = NULL; // to be alloc by call
-static point_t* _pb = NULL; // to be alloc by call
+static point_t* _pa; // intersection results
+static point_t* _pb; // intersection results
 static line_t* _n1;
 static line_t* _n2;
 static circle_t* _c1;
@@ -41,6 +57,238 @@ static mpf_t _m_root_two_over_two;
 static mpf_t _root_three_over_two;
 static mpf_t _m_root_three_over_two;
 
+// Number of points each thread adds in the point table test.
+#define TEST_TABLE_POINTS 3000
+
+/*
+* Adds the points (i, -i) to a point table, run by several threads
+* at once.
+*
+* @data: Point table to add to.
+*
+* returns: NULL.
+*/
+static void* _add_table_points(void* data) {
+    point_table_t* table = (point_table_t*)data;
+    geometry_context_t* ctx = geometry_context_alloc();
+    point_t* p = NULL;
+    int i;
+    
+    geometry_context_init(ctx);
+    
+    for (i=0; i<TEST_TABLE_POINTS; i++) {
+        if (p == NULL) {
+            p = point_alloc();
+            point_init(p);
+        }
+        
+        point_set_si(p, i, -i);
+        if (point_table_add(ctx, table, p) == NULL) {
+            p = NULL;
+        }
+    }
+    
+    point_free(p);
+    geometry_context_free(ctx);
+    
+    return NULL;
+}
+
+// Point table the edge points are added to, see _add_edge_points.
+static point_table_t* _edge_table;
+
+/*
+* Adds points g_epsilon / 4 to one side of the edges between the
+* grid cells along the x axis, run by a thread adding the other side
+* at the same time.
+*
+* @data: Side of the edges, pointer to -1 or 1.
+*
+* returns: NULL.
+*/
+static void* _add_edge_points(void* data) {
+    int side = *(int*)data;
+    geometry_context_t* ctx = geometry_context_alloc();
+    point_t* p = NULL;
+    mpf_t half_cell, offset, x;
+    int i;
+    
+    geometry_context_init(ctx);
+    mpf_init(half_cell);
+    mpf_init(offset);
+    mpf_init(x);
+    
+    mpf_div_2exp(half_cell, g_one, point_hash_coord_bits() + 1);
+    mpf_div_ui(offset, g_epsilon, 4);
+    if (side < 0) {
+        mpf_neg(offset, offset);
+    }
+    
+    for (i=0; i<TEST_TABLE_POINTS; i++) {
+        if (p == NULL) {
+            p = point_alloc();
+            point_init(p);
+        }
+        
+        mpf_mul_ui(x, half_cell, 2 * i + 1);
+        mpf_add(x, x, offset);
+        point_set(p, x, g_zero);
+        if (point_table_add(ctx, _edge_table, p) == NULL) {
+            p = NULL;
+        }
+    }
+    
+    point_free(p);
+    mpf_clear(half_cell);
+    mpf_clear(offset);
+    mpf_clear(x);
+    geometry_context_free(ctx);
+    
+    return NULL;
+}
+
+#ifndef NUMERIC_KERNELS
+/*
+* Checks low precision points against a point grid, see
+* geometry_context_t.low_known.
+*
+* @data: Point grid.
+*/
+static int _low_known(void* data, point_t** points, int count) {
+    return point_grid_known((point_grid_t*)data, points, count);
+}
+
+/*
+* Adds intersections found to a point table, and to a point grid.
+*/
+static void _add_found(geometry_context_t* ctx, point_table_t* table, point_grid_t* grid, point_t** found, int count) {
+    point_t* p;
+    int i;
+    
+    for (i=0; i<count; i++) {
+        if (grid != NULL) {
+            point_grid_add(grid, found[i]);
+        }
+        
+        p = point_clone(found[i]);
+        if (point_table_add(ctx, table, p) != NULL) {
+            point_free(p);
+        }
+    }
+}
+
+/*
+* Runs iterations from (0,0) and (1,0), intersecting every line and
+* circle through two of the points found so far.
+*
+* @ctx: Context to calculate intersections with.
+* @grid: Grid the points found are added to, or NULL.
+* @iterations: Number of iterations.
+*
+* returns: number of distinct points after the last iteration.
+*/
+static size_t _count_iterations(geometry_context_t* ctx, point_grid_t* grid, int iterations) {
+    point_table_t* table = point_table_alloc();
+    point_t** points = NULL;
+    line_t** lines;
+    circle_t** circles;
+    point_t* found[2];
+    point_record_t* record;
+    size_t point_count, line_count, circle_count, position, count;
+    size_t i, j;
+    int iteration, result;
+    mpf_t d2;
+    
+    point_table_init(table, 0);
+    mpf_init(d2);
+    
+    for (i=0; i<2; i++) {
+        found[i] = point_alloc();
+        point_init(found[i]);
+    }
+    
+    point_set_si(found[0], 0, 0);
+    point_set_si(found[1], 1, 0);
+    _add_found(ctx, table, grid, found, 2);
+    
+    for (iteration=0; iteration<iterations; iteration++) {
+        point_count = point_table_count(table);
+        points = realloc(points, sizeof(point_t*) * point_count);
+        position = 0;
+        i = 0;
+        while ((record = point_table_next(table, &position)) != NULL) {
+            points[i++] = record->point;
+        }
+        
+        lines = malloc(sizeof(line_t*) * point_count * point_count);
+        circles = malloc(sizeof(circle_t*) * point_count * point_count);
+        line_count = 0;
+        circle_count = 0;
+        
+        for (i=0; i<point_count; i++) {
+            for (j=i+1; j<point_count; j++) {
+                lines[line_count] = line_alloc();
+                line_init(lines[line_count]);
+                line_set(ctx, lines[line_count], points[i], points[j]);
+                line_count++;
+                
+                point_distance_squared(ctx, d2, points[i], points[j]);
+                
+                circles[circle_count] = circle_alloc();
+                circle_init(circles[circle_count]);
+                circle_set_radius_squared(circles[circle_count], points[i], d2);
+                circle_count++;
+                
+                circles[circle_count] = circle_alloc();
+                circle_init(circles[circle_count]);
+                circle_set_radius_squared(circles[circle_count], points[j], d2);
+                circle_count++;
+            }
+        }
+        
+        for (i=0; i<line_count; i++) {
+            for (j=i+1; j<line_count; j++) {
+                result = line_intersection_line(ctx, lines[i], lines[j], found[0]);
+                _add_found(ctx, table, grid, found, result);
+            }
+            
+            for (j=0; j<circle_count; j++) {
+                result = circle_intersection_line(ctx, circles[j], lines[i], found[0], found[1]);
+                _add_found(ctx, table, grid, found, result);
+            }
+        }
+        
+        for (i=0; i<circle_count; i++) {
+            for (j=i+1; j<circle_count; j++) {
+                result = circle_intersection_circle(ctx, circles[i], circles[j], found[0], found[1]);
+                _add_found(ctx, table, grid, found, result);
+            }
+        }
+        
+        for (i=0; i<line_count; i++) {
+            line_free(lines[i]);
+        }
+        
+        for (i=0; i<circle_count; i++) {
+            circle_free(circles[i]);
+        }
+        
+        free(lines);
+        free(circles);
+    }
+    
+    count = point_table_count(table);
+    
+    point_free(found[0]);
+    point_free(found[1]);
+    free(points);
+    mpf_clear(d2);
+    point_table_free(table);
+    
+    return count;
+}
+#endif
+
 void test_run() {
     
     // General outline of the methods here:
@@ -49,6 +297,9 @@ void test_run() {
     // - line x circle intersection
     // - circle x circle intersection
     
+    _ctx = geometry_context_alloc();
+    geometry_context_init(_ctx);
+    
     mpf_init(_t1);
     mpf_init(_t2);
     mpf_init(_t3);
@@ -77,6 +328,8 @@ void test_run() {
     
     _p1 = point_alloc();
     _p2 = point_alloc();
+    _pa = point_alloc();
+    _pb = point_alloc();
     _n1 = line_alloc();
     _n2 = line_alloc();
     _c1 = circle_alloc();
@@ -84,6 +337,8 @@ void test_run() {
     
     point_init(_p1);
     point_init(_p2);
+    point_init(_pa);
+    point_init(_pb);
     
     line_init(_n1);
     line_init(_n2);
@@ -94,138 +349,116 @@ void test_run() {
     // point
     
     // uninitialized, but address is the same
-    _result = point_equals(_p1, _p1);
+    _result = point_equals(_ctx, _p1, _p1);
     assert(_result == 1); // same
     
     // exact same values
     point_set(_p1, g_one, g_one);
     point_set(_p2, g_one, g_one);
-    _result = point_equals(_p1, _p2);
+    _result = point_equals(_ctx, _p1, _p2);
     assert(_result == 1);
     
     // barely same values
     // _p1.x = 1 + (g_epsilon / 10);
     mpf_div_ui(_t1, g_epsilon, 10);
     mpf_add_ui(_p1->x, _t1, _x1);
-    _result = point_equals(_p1, _p2);
+    _result = point_equals(_ctx, _p1, _p2);
     assert(_result == 1);
     
     // barely different values
     // _p1.x = 1 + (g_epsilon * 10);
     mpf_mul_ui(_t1, g_epsilon, 10);
     mpf_add_ui(_p1->x, _t1, _x1);
-    _result = point_equals(_p1, _p2);
+    _result = point_equals(_ctx, _p1, _p2);
     assert(_result == 0);
     
     // distance({0,0}, {0,1}) == 1
     point_set(_p1, g_zero, g_zero);
     point_set(_p2, g_zero, g_one);
-    point_distance(_t1, _p1, _p2);
-    assert(global_compare2(_t1, g_one) == 0);
-    point_distance(_t1, _p2, _p1);
-    assert(global_compare2(_t1, g_one) == 0);
+    point_distance(_ctx, _t1, _p1, _p2);
+    assert(global_compare2(_ctx, _t1, g_one) == 0);
+    point_distance(_ctx, _t1, _p2, _p1);
+    assert(global_compare2(_ctx, _t1, g_one) == 0);
     
     // distance({0,1}, {1,1}) == 1
     point_set(_p1, g_zero, g_one);
     point_set(_p2, g_one, g_one);
-    point_distance(_t1, _p1, _p2);
-    assert(global_compare2(_t1, g_one) == 0);
-    point_distance(_t1, _p2, _p1);
-    assert(global_compare2(_t1, g_one) == 0);
+    point_distance(_ctx, _t1, _p1, _p2);
+    assert(global_compare2(_ctx, _t1, g_one) == 0);
+    point_distance(_ctx, _t1, _p2, _p1);
+    assert(global_compare2(_ctx, _t1, g_one) == 0);
     
     // distance({1,1}, {1,0}) == 1
     point_set(_p1, g_one, g_one);
     point_set(_p2, g_one, g_zero);
-    point_distance(_t1, _p1, _p2);
-    assert(global_compare2(_t1, g_one) == 0);
-    point_distance(_t1, _p2, _p1);
-    assert(global_compare2(_t1, g_one) == 0);
+    point_distance(_ctx, _t1, _p1, _p2);
+    assert(global_compare2(_ctx, _t1, g_one) == 0);
+    point_distance(_ctx, _t1, _p2, _p1);
+    assert(global_compare2(_ctx, _t1, g_one) == 0);
     
     // distance({0,0}, {1,0}) == 1
     point_set(_p1, g_zero, g_zero);
     point_set(_p2, g_one, g_zero);
-    point_distance(_t1, _p1, _p2);
-    assert(global_compare2(_t1, g_one) == 0);
-    point_distance(_t1, _p2, _p1);
-    assert(global_compare2(_t1, g_one) == 0);
+    point_distance(_ctx, _t1, _p1, _p2);
+    assert(global_compare2(_ctx, _t1, g_one) == 0);
+    point_distance(_ctx, _t1, _p2, _p1);
+    assert(global_compare2(_ctx, _t1, g_one) == 0);
     
     // line x line
     // note: calculate intersection twice, but with parameter order swapped
     
     // parallel lines: y = x and y = x - 1
-    line_set_si(_n1, 0, 0, 1, 1);
-    line_set_si(_n2, 0, -1, 1, 0);
-    _result = line_intersection_line(_n1, _n2, &_pa);
+    line_set_si(_ctx, _n1, 0, 0, 1, 1);
+    line_set_si(_ctx, _n2, 0, -1, 1, 0);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 0);
-    assert(_pa == NULL);
-    _result = line_intersection_line(_n2, _n1, &_pa);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 0);
-    assert(_pa == NULL);
     
     // parallel lines: y = (2/3)x and y = (2/3)x + 7
-    line_set_si(_n1, 0, 0, 3, 2);
-    line_set_si(_n2, 0, 7, 3, 9);
-    _result = line_intersection_line(_n1, _n2, &_pa);
+    line_set_si(_ctx, _n1, 0, 0, 3, 2);
+    line_set_si(_ctx, _n2, 0, 7, 3, 9);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 0);
-    assert(_pa == NULL);
-    _result = line_intersection_line(_n2, _n1, &_pa);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 0);
-    assert(_pa == NULL);
     
     // y = x and y = -x + 1 => {5,5}
-    line_set_si(_n1, 0, 0, 1, 1);
-    line_set_si(_n2, 0, 10, 10, 0);
+    line_set_si(_ctx, _n1, 0, 0, 1, 1);
+    line_set_si(_ctx, _n2, 0, 10, 10, 0);
     point_set_si(_p1, 5, 5);
-    _result = line_intersection_line(_n1, _n2, &_pa);
-    assert(_pa != NULL);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
-    _result = line_intersection_line(_n2, _n1, &_pa);
-    assert(_pa != NULL);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // y = 1 and x = 0 => {0, 1}
-    line_set_si(_n1, 0, 10, 0, 0);
-    line_set_si(_n2, 0, 1, 1, 1);
+    line_set_si(_ctx, _n1, 0, 10, 0, 0);
+    line_set_si(_ctx, _n2, 0, 1, 1, 1);
     point_set_si(_p1, 0, 1);
-    _result = line_intersection_line(_n1, _n2, &_pa);
-    assert(_pa != NULL);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
-    _result = line_intersection_line(_n2, _n1, &_pa);
-    assert(_pa != NULL);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // y = 2x + 2 and y = -2x -2 => {-1, 0}
-    line_set_si(_n1, 0, 2, 1, 4);
-    line_set_si(_n2, 0, -2, 1, -4);
+    line_set_si(_ctx, _n1, 0, 2, 1, 4);
+    line_set_si(_ctx, _n2, 0, -2, 1, -4);
     point_set_si(_p1, -1, 0);
-    _result = line_intersection_line(_n1, _n2, &_pa);
-    assert(_pa != NULL);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
-    _result = line_intersection_line(_n2, _n1, &_pa);
-    assert(_pa != NULL);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // y = 0.01x + 5 and y = 0.0001x + 15 => {(double)100000 / (double)99, (double)1495 / (double)99)}
-    line_set_si(_n1, 0, 5, 10000, 105);
-    line_set_si(_n2, 0, 15, 10000, 16);
+    line_set_si(_ctx, _n1, 0, 5, 10000, 105);
+    line_set_si(_ctx, _n2, 0, 15, 10000, 16);
     mpf_set_si(_t1, 100000);
     mpf_set_si(_t2, 99);
     mpf_set_si(_t3, 1495);
@@ -233,262 +466,170 @@ void test_run() {
     mpf_div(_t5, _t1, _t2);
     mpf_div(_t6, _t3, _t4);
     point_set(_p1, _t5, _t6);
-    _result = line_intersection_line(_n1, _n2, &_pa);
-    assert(_pa != NULL);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
-    _result = line_intersection_line(_n2, _n1, &_pa);
-    assert(_pa != NULL);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // y = 5 and y = 0.0001x + 15 => {-100000, 5}
-    line_set_si(_n1, 0, 5, 10, 5);
-    line_set_si(_n2, 0, 15, 10000, 16);
+    line_set_si(_ctx, _n1, 0, 5, 10, 5);
+    line_set_si(_ctx, _n2, 0, 15, 10000, 16);
     point_set_si(_p1, -100000, 5);
-    _result = line_intersection_line(_n1, _n2, &_pa);
-    assert(_pa != NULL);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
-    _result = line_intersection_line(_n2, _n1, &_pa);
-    assert(_pa != NULL);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // x = 5 and y = 0.0001x + 15 => {5, 15.0005}
-    line_set_si(_n1, 5, 10, 5, 0);
-    line_set_si(_n2, 0, 15, 10000, 16);
+    line_set_si(_ctx, _n1, 5, 10, 5, 0);
+    line_set_si(_ctx, _n2, 0, 15, 10000, 16);
     mpf_set_si(_t1, 5);
     mpf_set_str(_t2, "15.0005", 10);
     point_set(_p1, _t1, _t2);
-    _result = line_intersection_line(_n1, _n2, &_pa);
-    assert(_pa != NULL);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
-    _result = line_intersection_line(_n2, _n1, &_pa);
-    assert(_pa != NULL);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // y = (2/3)x + 17/3 and y = (3/2)x => {6.8, 10.2}
-    line_set_si(_n1, 5, 9, 8, 11);
-    line_set_si(_n2, 2, 3, 4, 6);
+    line_set_si(_ctx, _n1, 5, 9, 8, 11);
+    line_set_si(_ctx, _n2, 2, 3, 4, 6);
     mpf_set_str(_t1, "6.8", 10);
     mpf_set_str(_t2, "10.2", 10);
     point_set(_p1, _t1, _t2);
-    _result = line_intersection_line(_n1, _n2, &_pa);
-    assert(_pa != NULL);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
-    _result = line_intersection_line(_n2, _n1, &_pa);
-    assert(_pa != NULL);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
+    assert(point_equals(_ctx, _pa, _p1) == 1);
 
     // same origin
-    line_set_si(_n1, 0, 0, 1, 1);
-    line_set_si(_n2, 0, 0, 1, 10);
+    line_set_si(_ctx, _n1, 0, 0, 1, 1);
+    line_set_si(_ctx, _n2, 0, 0, 1, 10);
     point_set_si(_p1, 0, 0);
-    _result = line_intersection_line(_n1, _n2, &_pa);
-    assert(_pa != NULL);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
-    _result = line_intersection_line(_n2, _n1, &_pa);
-    assert(_pa != NULL);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    _result = line_intersection_line(_ctx, _n2, _n1, _pa);
     assert(_result == 1);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    _pa = NULL;
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // circle x line
     
     // no intersection
     circle_set_si(_c1, 0, 5, 1);
-    line_set_si(_n1, 0, 0, 1, 1);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
-    assert(_pa == NULL);
-    assert(_pb == NULL);
+    line_set_si(_ctx, _n1, 0, 0, 1, 1);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 0);
     
     // circle at origin, horizontal line tangent above => {0,1}
     circle_set_si(_c1, 0, 0, 1);
-    line_set_si(_n1, -1, 1, 1, 1);
+    line_set_si(_ctx, _n1, -1, 1, 1, 1);
     point_set_si(_p1, 0, 1);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // circle at origin, vertical line tangent on right => {1, 0}
     circle_set_si(_c1, 0, 0, 1);
-    line_set_si(_n1, 1, 1, 1, -1);
+    line_set_si(_ctx, _n1, 1, 1, 1, -1);
     point_set_si(_p1, 1, 0);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // circle at origin, horizontal line tangent below => {0, -1}
     circle_set_si(_c1, 0, 0, 1);
-    line_set_si(_n1, -1, -1, 1, -1);
+    line_set_si(_ctx, _n1, -1, -1, 1, -1);
     point_set_si(_p1, 0, -1);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // circle at origin, vertical line tangent on left => {-1, 0}
     circle_set_si(_c1, 0, 0, 1);
-    line_set_si(_n1, -1, 1, -1, -1);
+    line_set_si(_ctx, _n1, -1, 1, -1, -1);
     point_set_si(_p1, -1, 0);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
     
     // tanget at root two over two #1
     circle_set_si(_c1, 0, 0, 1);
-    point_set(_n1->p1, g_zero, _root_two);
-    point_set(_n1->p2, _root_two, g_zero);
+    point_set(_p1, g_zero, _root_two);
+    point_set(_p2, _root_two, g_zero);
+    line_set(_ctx, _n1, _p1, _p2);
     point_set(_p1, _root_two_over_two, _root_two_over_two);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // tanget at root two over two #2
     circle_set_si(_c1, 0, 0, 1);
-    point_set(_n1->p1, g_zero, _m_root_two);
-    point_set(_n1->p2, _root_two, g_zero);
+    point_set(_p1, g_zero, _m_root_two);
+    point_set(_p2, _root_two, g_zero);
+    line_set(_ctx, _n1, _p1, _p2);
     point_set(_p1, _root_two_over_two, _m_root_two_over_two);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // tanget at root two over two #3
     circle_set_si(_c1, 0, 0, 1);
-    point_set(_n1->p1, _m_root_two, g_zero);
-    point_set(_n1->p2, g_zero, _root_two);
+    point_set(_p1, _m_root_two, g_zero);
+    point_set(_p2, g_zero, _root_two);
+    line_set(_ctx, _n1, _p1, _p2);
     point_set(_p1, _m_root_two_over_two, _root_two_over_two);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // tanget at root two over two #4
     circle_set_si(_c1, 0, 0, 1);
-    point_set(_n1->p1, _m_root_two, g_zero);
-    point_set(_n1->p2, g_zero, _m_root_two);
+    point_set(_p1, _m_root_two, g_zero);
+    point_set(_p2, g_zero, _m_root_two);
+    line_set(_ctx, _n1, _p1, _p2);
     point_set(_p1, _m_root_two_over_two, _m_root_two_over_two);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // circle at origin and y = x => { Math.Sqrt(2) / 2, Math.Sqrt(2) / 2} and { -Math.Sqrt(2) / 2, -Math.Sqrt(2) / 2}
     circle_set_si(_c1, 0, 0, 1);
-    line_set_si(_n1, 0, 0, 1, 1);
+    line_set_si(_ctx, _n1, 0, 0, 1, 1);
     point_set(_p1, _root_two_over_two, _root_two_over_two);
     point_set(_p2, _m_root_two_over_two, _m_root_two_over_two);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // circle at origin and vertical line through origin
     circle_set_si(_c1, 0, 0, 1);
-    line_set_si(_n1, 0, 0, 0, 10);
+    line_set_si(_ctx, _n1, 0, 0, 0, 10);
     point_set_si(_p1, 0, 1);
     point_set_si(_p2, 0, -1);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // circle at origin and horizontal line through origin
     circle_set_si(_c1, 0, 0, 1);
-    line_set_si(_n1, 0, 0, 10, 0);
+    line_set_si(_ctx, _n1, 0, 0, 10, 0);
     point_set_si(_p1, 1, 0);
     point_set_si(_p2, -1, 0);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_line(_c1, _n1, &_pa, &_pb);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // circle x circle
     // note: calculate intersection twice, but with parameter order swapped
@@ -496,239 +637,129 @@ void test_run() {
     // no intersection, one outside the other
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, 9, 9, 1);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 0);
-    assert(_pa == NULL);
-    assert(_pb == NULL);
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 0);
-    assert(_pa == NULL);
-    assert(_pb == NULL);
     
     // no intersection, one inside the other
     circle_set_si(_c1, 0, 0, 10);
     circle_set_si(_c2, 2, 2, 1);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 0);
-    assert(_pa == NULL);
-    assert(_pb == NULL);
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 0);
-    assert(_pa == NULL);
-    assert(_pb == NULL);
     
     // one intersection => {0,1}
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, 0, 2, 1);
     point_set_si(_p1, 0, 1);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1));
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // one intersection => {1,0}
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, 2, 0, 1);
     point_set_si(_p1, 1, 0);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1));
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // one intersection => {0, -1}
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, 0, -2, 1);
     point_set_si(_p1, 0, -1);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1));
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // one intersection => {-1,0}
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, -2, 0, 1);
     point_set_si(_p1, -1, 0);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1));
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // one intersection => {10,0}
     circle_set_si(_c1, 0, 0, 10);
     circle_set_si(_c2, 11, 0, 1);
     point_set_si(_p1, 10, 0);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1));
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 1);
-    assert(_pa != NULL);
-    assert(_pb == NULL);
-    assert(point_equals(_pa, _p1));
-    point_free(_pa);
+    assert(point_equals(_ctx, _pa, _p1));
     
     // two intersections => {Math.Sqrt(3) / 2, 1/2} and {-Math.Sqrt(3) / 2, 1/2}
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, 0, 1, 1);
     point_set(_p1, _root_three_over_two, _one_half);
     point_set(_p2, _m_root_three_over_two, _one_half);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // two intersections => {Math.Sqrt(3) / 2, -1/2} and {-Math.Sqrt(3) / 2, -1/2}
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, 0, -1, 1);
     point_set(_p1, _root_three_over_two, _m_one_half);
     point_set(_p2, _m_root_three_over_two, _m_one_half);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // two intersections => {1/2, Math.Sqrt(3) / 2} and {1/2, -Math.Sqrt(3) / 2}
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, 1, 0, 1);
     point_set(_p1, _one_half, _root_three_over_two);
     point_set(_p2, _one_half, _m_root_three_over_two);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // two intersections => {-1/2, Math.Sqrt(3) / 2} and {-1/2, -Math.Sqrt(3) / 2}
     circle_set_si(_c1, 0, 0, 1);
     circle_set_si(_c2, -1, 0, 1);
     point_set(_p1, _m_one_half, _root_three_over_two);
     point_set(_p2, _m_one_half, _m_root_three_over_two);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     mpf_add_ui(_t1, _root_three_over_two, 3);
     mpf_add_ui(_t2, _one_half, 3);
@@ -740,109 +771,1036 @@ void test_run() {
     circle_set_si(_c2, 3, 4, 1);
     point_set(_p1, _t1, _t2);
     point_set(_p2, _t3, _t2);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // two intersections => {3+Math.Sqrt(3) / 2, 3-1/2} and {3-Math.Sqrt(3) / 2, 3-1/2}
     circle_set_si(_c1, 3, 3, 1);
     circle_set_si(_c2, 3, 2, 1);
     point_set(_p1, _t1, _t4);
     point_set(_p2, _t3, _t4);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // two intersections => {3+1/2, 3+Math.Sqrt(3) / 2} and {3+1/2, 3-Math.Sqrt(3) / 2}
     circle_set_si(_c1, 3, 3, 1);
     circle_set_si(_c2, 4, 3, 1);
     point_set(_p1, _t2, _t1);
     point_set(_p2, _t2, _t3);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
     
     // two intersections => {3-1/2, 3+Math.Sqrt(3) / 2} and {3-1/2, 3-Math.Sqrt(3) / 2}
     circle_set_si(_c1, 3, 3, 1);
     circle_set_si(_c2, 2, 3, 1);
     point_set(_p1, _t4, _t1);
     point_set(_p2, _t4, _t3);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c1, _c2, &_pa, &_pb);
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
-    _pa = NULL;
-    _pb = NULL;
-    _result = circle_intersection_circle(_c2, _c1, &_pa, &_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    _result = circle_intersection_circle(_ctx, _c2, _c1, _pa, _pb);
     assert(_result == 2);
-    assert(_pa != NULL);
-    assert(_pb != NULL);
-    assert(point_equals(_pa, _p1) == 1 || point_equals(_pb, _p1) == 1);
-    assert(point_equals(_pa, _p2) == 1 || point_equals(_pb, _p2) == 1);
-    point_free(_pa);
-    point_free(_pb);
+    assert(point_equals(_ctx, _pa, _p1) == 1 || point_equals(_ctx, _pb, _p1) == 1);
+    assert(point_equals(_ctx, _pa, _p2) == 1 || point_equals(_ctx, _pb, _p2) == 1);
+    
+    // prepared coefficients
+    
+    // line through {0,0} and {3,4} => 4/5 x - 3/5 y = 0
+    line_set_si(_ctx, _n1, 0, 0, 3, 4);
+    mpf_set_str(_t5, "0.8", 10);
+    assert(global_compare2(_ctx, _n1->a, _t5) == 0);
+    mpf_set_str(_t5, "-0.6", 10);
+    assert(global_compare2(_ctx, _n1->b, _t5) == 0);
+    assert(global_is_zero(_n1->c) == 1);
+    
+    // circle from a squared distance is the same as from the distance
+    point_set_si(_p1, 0, 0);
+    point_set_si(_p2, 1, 1);
+    point_distance_squared(_ctx, _t5, _p1, _p2);
+    circle_set_radius_squared(_c1, _p1, _t5);
+    point_distance(_ctx, _t6, _p1, _p2);
+    circle_set(_c2, _p1, _t6);
+    assert(global_compare2(_ctx, _c1->radius_squared, _c2->radius_squared) == 0);
+    
+    // two intersections => {1,1} and {-1,-1}
+    // (_c1 borrows _p1 as its origin, so _p1 is only changed after)
+    line_set_si(_ctx, _n1, 0, 0, 1, 1);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
+    point_set_si(_p1, 1, 1);
+    point_set_si(_p2, -1, -1);
+    assert(_result == 2);
+    assert(point_equals(_ctx, _pa, _p1) == 1);
+    assert(point_equals(_ctx, _pb, _p2) == 1);
+    
+    // fused pair kernel finds the same points as the separate kernels
+    
+    pair_t* _left = pair_alloc();
+    pair_t* _right = pair_alloc();
+    pair_init(_left);
+    pair_init(_right);
+    point_t* _fused[PAIR_INTERSECTION_MAX];
+    point_t* _separate[PAIR_INTERSECTION_MAX + 1];
+    int _separate_count = 0;
+    for (int i=0; i<PAIR_INTERSECTION_MAX + 1; i++) {
+        if (i < PAIR_INTERSECTION_MAX) {
+            _fused[i] = point_alloc();
+            point_init(_fused[i]);
+        }
+        _separate[i] = point_alloc();
+        point_init(_separate[i]);
+    }
+    
+    // the circles borrow their origins, so each pair gets its own points
+    point_t* _p3 = point_alloc();
+    point_t* _p4 = point_alloc();
+    point_init(_p3);
+    point_init(_p4);
+    
+    point_set_si(_p1, 0, 0);
+    point_set_si(_p2, 1, 0);
+    point_distance_squared(_ctx, _t5, _p1, _p2);
+    pair_set(_ctx, _left, _p1, _p2, _t5);
+    point_set_si(_p3, 0, 1);
+    point_set_si(_p4, 2, 2);
+    point_distance_squared(_ctx, _t5, _p3, _p4);
+    pair_set(_ctx, _right, _p3, _p4, _t5);
+    
+    _separate_count += line_intersection_line(_ctx, _left->line, _right->line, _separate[_separate_count]);
+    _separate_count += circle_intersection_line(_ctx, _right->circle1, _left->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_line(_ctx, _right->circle2, _left->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_line(_ctx, _left->circle1, _right->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_line(_ctx, _left->circle2, _right->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle1, _right->circle1, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle1, _right->circle2, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle2, _right->circle1, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle2, _right->circle2, _separate[_separate_count], _separate[_separate_count + 1]);
+    
+    _result = pair_intersection_pair(_ctx, _left, _right, PAIR_SHARED_NONE, _fused);
+    assert(_result == _separate_count);
+    assert(_result > 0);
+    for (int i=0; i<_result; i++) {
+        int found = 0;
+        for (int j=0; j<_separate_count; j++) {
+            if (point_equals(_ctx, _fused[i], _separate[j]) == 1) {
+                found = 1;
+            }
+        }
+        assert(found == 1);
+    }
+    point_free(_p3);
+    point_free(_p4);
+    
+    // pairs sharing a point find the same points, except the shared point
+    point_t* _shared = point_alloc();
+    point_init(_shared);
+    point_set_si(_shared, 1, 1);
+    point_set_si(_p1, 3, 2);
+    point_distance_squared(_ctx, _t5, _p1, _shared);
+    pair_set(_ctx, _left, _p1, _shared, _t5);
+    point_set_si(_p2, 0, 4);
+    point_distance_squared(_ctx, _t5, _shared, _p2);
+    pair_set(_ctx, _right, _shared, _p2, _t5);
+    
+    _separate_count = 0;
+    _separate_count += line_intersection_line(_ctx, _left->line, _right->line, _separate[_separate_count]);
+    _separate_count += circle_intersection_line(_ctx, _right->circle1, _left->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_line(_ctx, _right->circle2, _left->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_line(_ctx, _left->circle1, _right->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_line(_ctx, _left->circle2, _right->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle1, _right->circle1, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle1, _right->circle2, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle2, _right->circle1, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle2, _right->circle2, _separate[_separate_count], _separate[_separate_count + 1]);
+    
+    _result = pair_intersection_pair(_ctx, _left, _right, PAIR_SHARED_INDEX(1, 0), _fused);
+    for (int i=0; i<_result; i++) {
+        assert(point_equals(_ctx, _fused[i], _shared) == 0);
+    }
+    for (int j=0; j<_separate_count; j++) {
+        int found = point_equals(_ctx, _separate[j], _shared);
+        for (int i=0; i<_result; i++) {
+            if (point_equals(_ctx, _fused[i], _separate[j]) == 1) {
+                found = 1;
+            }
+        }
+        assert(found == 1);
+    }
+    point_free(_shared);
+    
+    // closed form self intersections are the same as the separate kernels
+    point_set_si(_p1, 1, 2);
+    point_set_si(_p2, 4, -3);
+    point_distance_squared(_ctx, _t5, _p1, _p2);
+    pair_set(_ctx, _left, _p1, _p2, _t5);
+    
+    _separate_count = 0;
+    _separate_count += circle_intersection_line(_ctx, _left->circle1, _left->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_line(_ctx, _left->circle2, _left->line, _separate[_separate_count], _separate[_separate_count + 1]);
+    _separate_count += circle_intersection_circle(_ctx, _left->circle1, _left->circle2, _separate[_separate_count], _separate[_separate_count + 1]);
+    
+    _result = pair_self_intersection(_ctx, _left, _fused);
+    assert(_result == PAIR_SELF_INTERSECTION_COUNT);
+    assert(_result == _separate_count);
+    for (int i=0; i<_result; i++) {
+        int found = 0;
+        for (int j=0; j<_separate_count; j++) {
+            if (point_equals(_ctx, _fused[i], _separate[j]) == 1) {
+                found = 1;
+            }
+        }
+        assert(found == 1);
+    }
+    for (int i=0; i<PAIR_INTERSECTION_MAX + 1; i++) {
+        if (i < PAIR_INTERSECTION_MAX) {
+            point_free(_fused[i]);
+        }
+        point_free(_separate[i]);
+    }
+    
+    pair_free(_left);
+    pair_free(_right);
+    
+    // object table
+    
+    // (0,0), (1,0), (2,0) are collinear, the three pairs give one line.
+    // The six pairs give 4 distinct lines and 10 distinct circles.
+    point_t* _points[4];
+    object_table_t* _objects = object_table_alloc();
+    object_table_init(_objects, 40);
+    for (int i=0; i<4; i++) {
+        _points[i] = point_alloc();
+        point_init(_points[i]);
+        _points[i]->point_id = i + 1;
+    }
+    point_set_si(_points[0], 0, 0);
+    point_set_si(_points[1], 1, 0);
+    point_set_si(_points[2], 2, 0);
+    point_set_si(_points[3], 0, 1);
+    for (int i=0; i<4; i++) {
+        for (int j=i+1; j<4; j++) {
+            point_distance_squared(_ctx, _t5, _points[i], _points[j]);
+            object_table_add_pair(_ctx, _objects, _points[i], _points[j], _t5);
+        }
+    }
+    assert(_objects->line_count == 4);
+    assert(_objects->circle_count == 10);
+    assert(_objects->count == 14);
+    assert(object_table_pair_count(_objects) == 91);
+    
+    // same line with the points reversed
+    _result = object_table_add_line(_ctx, _objects, _points[2], _points[0]);
+    assert(_result == 0);
+    
+    // same radius, but a different origin
+    mpf_set_ui(_t5, 4);
+    _result = object_table_add_circle(_objects, _points[1], _t5);
+    assert(_result == 1);
+    _result = object_table_add_circle(_objects, _points[1], _t5);
+    assert(_result == 0);
+    
+    // pairs are ordered by the second object, then the first
+    size_t _i, _j;
+    object_table_pair_at(_objects, 0, &_i, &_j);
+    assert(_i == 0 && _j == 1);
+    object_table_pair_at(_objects, 2, &_i, &_j);
+    assert(_i == 1 && _j == 2);
+    object_table_pair_at(_objects, object_table_pair_count(_objects) - 1, &_i, &_j);
+    assert(_i == 13 && _j == 14);
+    
+    // after a mark, only pairs with a new object are counted
+    object_table_mark(_objects);
+    assert(object_table_pair_count(_objects) == 0);
+    mpf_set_ui(_t5, 9);
+    object_table_add_circle(_objects, _points[0], _t5);
+    object_table_add_circle(_objects, _points[1], _t5);
+    assert(object_table_pair_count(_objects) == 15 + 16);
+    object_table_pair_at(_objects, 0, &_i, &_j);
+    assert(_i == 0 && _j == 15);
+    object_table_pair_at(_objects, 15, &_i, &_j);
+    assert(_i == 0 && _j == 16);
+    object_table_pair_at(_objects, 30, &_i, &_j);
+    assert(_i == 15 && _j == 16);
+    
+    object_table_free(_objects);
+    for (int i=0; i<4; i++) {
+        point_free(_points[i]);
+    }
+    
+    // released points are reused by point_take
+    point_t* _taken = point_take(_ctx);
+    point_set_si(_taken, 5, 5);
+    point_release(_ctx, _taken);
+    assert(point_take(_ctx) == _taken);
+    point_release(_ctx, _taken);
+    
+    // strings are only written when needed
+    point_t* _lazy = point_alloc();
+    point_init(_lazy);
+    point_set_si(_lazy, -2, 3);
+    assert(_lazy->str_x == NULL);
+    assert(_lazy->hash_key == NULL);
+    point_ensure_str(_lazy);
+    assert(strncmp(_lazy->str_x, "-2.000", 6) == 0);
+    assert(strncmp(_lazy->str_y, "3.000", 5) == 0);
+    assert(_lazy->hash_key == NULL);
+    point_ensure_hash(_lazy);
+    assert(_lazy->hash_key != NULL);
+    point_set_si(_lazy, 4, 3);
+    point_ensure_str(_lazy);
+    assert(strncmp(_lazy->str_x, "4.000", 5) == 0);
+    point_free(_lazy);
+    
+    // hash keys round each value to the grid, and there's only one zero
+    point_t* _k1 = point_alloc();
+    point_t* _k2 = point_alloc();
+    point_init(_k1);
+    point_init(_k2);
+    point_set_si(_k1, 3, 0);
+    mpf_set_str(_t5, "-0.0000000000000000000000000000000000000000000000000000000000001", 10);
+    mpf_add_ui(_t6, _t5, 3);
+    point_set(_k2, _t6, _t5);
+    point_ensure_hash(_k1);
+    point_ensure_hash(_k2);
+    assert(_k1->hash_key_length == _k2->hash_key_length);
+    assert(_k1->hash_value == _k2->hash_value);
+    assert(memcmp(_k1->hash_key, _k2->hash_key, _k1->hash_key_length) == 0);
+    point_set_si(_k2, 3, 1);
+    point_ensure_hash(_k2);
+    assert(memcmp(_k1->hash_key, _k2->hash_key, _k1->hash_key_length) != 0);
+    point_set_si(_k2, -3, 0);
+    point_ensure_hash(_k2);
+    assert(memcmp(_k1->hash_key, _k2->hash_key, _k1->hash_key_length) != 0);
+    
+    // with the hash grid, points within g_epsilon on either side of a
+    // cell edge are found in the neighboring cell, for x, y, or both.
+    point_table_t* _table = point_table_alloc();
+    point_table_init(_table, 0);
+    point_t* _kept;
+    if (point_hash_grid() == 1) {
+        // t4 => edge between the zero cell and the next one
+        mpf_div_2exp(_t4, g_one, point_hash_coord_bits() + 1);
+        mpf_div_ui(_t3, g_epsilon, 4);
+        
+        mpf_sub(_t5, _t4, _t3);
+        mpf_add(_t6, _t4, _t3);
+        point_set(_k1, _t5, g_zero);
+        point_ensure_hash(_k1);
+        _kept = point_clone(_k1);
+        assert(point_table_add(_ctx, _table, _kept) == NULL);
+        
+        point_set(_k2, _t6, g_zero);
+        point_ensure_hash(_k2);
+        assert(memcmp(_k1->hash_key, _k2->hash_key, _k1->hash_key_length) != 0);
+        assert(point_table_find(_ctx, _table, _k2)->point == _kept);
+        assert(point_table_add(_ctx, _table, _k2)->point == _kept);
+        
+        // the compacted record is compared the same way
+        _kept->in_datastore = 1;
+        point_record_compact(point_table_find(_ctx, _table, _k2));
+        assert(point_table_find(_ctx, _table, _k2)->point == NULL);
+        assert(point_table_find(_ctx, _table, _k1) != NULL);
+        point_set_si(_k2, 1, 0);
+        assert(point_table_find(_ctx, _table, _k2) == NULL);
+        point_table_clear(_table);
+        
+        // (edge - e, -edge + e) and (edge + e, -edge - e) are in diagonal cells
+        mpf_sub(_t5, _t4, _t3);
+        mpf_neg(_t6, _t5);
+        point_set(_k1, _t5, _t6);
+        _kept = point_clone(_k1);
+        assert(point_table_add(_ctx, _table, _kept) == NULL);
+        mpf_add(_t5, _t4, _t3);
+        mpf_neg(_t6, _t5);
+        point_set(_k2, _t5, _t6);
+        assert(point_table_find(_ctx, _table, _k2)->point == _kept);
+        
+        point_set_si(_k2, 1, 0);
+        assert(point_table_find(_ctx, _table, _k2) == NULL);
+        point_table_clear(_table);
+    }
+    point_free(_k1);
+    point_free(_k2);
+    
+    // point table keeps one of each point while threads add the same
+    // points at once, and grows well past its starting size
+    pthread_t _threads[4];
+    size_t _thread_index;
+    size_t _position = 0;
+    size_t _table_count = 0;
+    for (_thread_index = 0; _thread_index < 4; _thread_index++) {
+        _result = pthread_create(&_threads[_thread_index], NULL, _add_table_points, _table);
+        assert(_result == 0);
+    }
+    for (_thread_index = 0; _thread_index < 4; _thread_index++) {
+        pthread_join(_threads[_thread_index], NULL);
+    }
+    assert(point_table_count(_table) == TEST_TABLE_POINTS);
+    while (point_table_next(_table, &_position) != NULL) {
+        _table_count++;
+    }
+    assert(_table_count == TEST_TABLE_POINTS);
+    point_set_si(_pa, TEST_TABLE_POINTS - 1, 1 - TEST_TABLE_POINTS);
+    assert(point_table_find(_ctx, _table, _pa) != NULL);
+    point_set_si(_pa, TEST_TABLE_POINTS, -TEST_TABLE_POINTS);
+    assert(point_table_find(_ctx, _table, _pa) == NULL);
+    point_table_free(_table);
+    
+    // with the hash grid, threads adding points within g_epsilon of
+    // each other on either side of a cell edge keep one of each
+    if (point_hash_grid() == 1) {
+        int _sides[2] = { -1, 1 };
+        _edge_table = point_table_alloc();
+        point_table_init(_edge_table, 0);
+        for (_thread_index = 0; _thread_index < 2; _thread_index++) {
+            _result = pthread_create(&_threads[_thread_index], NULL, _add_edge_points, &_sides[_thread_index]);
+            assert(_result == 0);
+        }
+        for (_thread_index = 0; _thread_index < 2; _thread_index++) {
+            pthread_join(_threads[_thread_index], NULL);
+        }
+        assert(point_table_count(_edge_table) == TEST_TABLE_POINTS);
+        _position = 0;
+        _table_count = 0;
+        while (point_table_next(_edge_table, &_position) != NULL) {
+            _table_count++;
+        }
+        assert(_table_count == TEST_TABLE_POINTS);
+        point_table_free(_edge_table);
+    }
+    
+    // shards keep one of each point pushed by two producers, split
+    // over the shard tables
+    point_table_t* _shard_tables[3];
+    point_shards_t* _shards = point_shards_alloc();
+    point_t* _shard_point;
+    int _shard_i;
+    for (_thread_index = 0; _thread_index < 3; _thread_index++) {
+        _shard_tables[_thread_index] = point_table_alloc();
+        point_table_init(_shard_tables[_thread_index], 0);
+    }
+    point_shards_init(_shards, _shard_tables, 3, 2, POINT_SHARDS_ROUTE_HASH);
+    point_shards_start(_shards);
+    for (_shard_i = 0; _shard_i < TEST_TABLE_POINTS; _shard_i++) {
+        for (_thread_index = 0; _thread_index < 2; _thread_index++) {
+            _shard_point = point_take(_ctx);
+            point_set_si(_shard_point, _shard_i, -_shard_i);
+            point_shards_push(_shards, _thread_index, _ctx, _shard_point);
+        }
+    }
+    assert(point_shards_stop(_shards, _ctx) == TEST_TABLE_POINTS);
+    _table_count = 0;
+    for (_thread_index = 0; _thread_index < 3; _thread_index++) {
+        assert(point_table_count(_shard_tables[_thread_index]) > 0);
+        _table_count += point_table_count(_shard_tables[_thread_index]);
+    }
+    assert(_table_count == TEST_TABLE_POINTS);
+    point_set_si(_pa, 7, -7);
+    assert(point_table_find(_ctx, _shard_tables[point_shards_route(_shards, _pa)], _pa) != NULL);
+    assert(point_shards_find(_shards, _ctx, _pa) != NULL);
+    point_shards_free(_shards);
+    for (_thread_index = 0; _thread_index < 3; _thread_index++) {
+        point_table_free(_shard_tables[_thread_index]);
+    }
+    
+    // with the hash grid, points within g_epsilon on either side of a
+    // cell edge are merged though the cells are in different shards
+    if (point_hash_grid() == 1) {
+        for (_thread_index = 0; _thread_index < 3; _thread_index++) {
+            _shard_tables[_thread_index] = point_table_alloc();
+            point_table_init(_shard_tables[_thread_index], 0);
+        }
+        _shards = point_shards_alloc();
+        point_shards_init(_shards, _shard_tables, 3, 2, POINT_SHARDS_ROUTE_HASH);
+        point_shards_start(_shards);
+        mpf_div_2exp(_t4, g_one, point_hash_coord_bits() + 1);
+        mpf_div_ui(_t3, g_epsilon, 4);
+        for (_shard_i = 0; _shard_i < TEST_TABLE_POINTS; _shard_i++) {
+            mpf_mul_ui(_t5, _t4, 2 * _shard_i + 1);
+            for (_thread_index = 0; _thread_index < 2; _thread_index++) {
+                if (_thread_index == 0) {
+                    mpf_sub(_t6, _t5, _t3);
+                } else {
+                    mpf_add(_t6, _t5, _t3);
+                }
+                _shard_point = point_take(_ctx);
+                point_set(_shard_point, _t6, g_zero);
+                point_shards_push(_shards, _thread_index, _ctx, _shard_point);
+            }
+        }
+        assert(point_shards_stop(_shards, _ctx) == TEST_TABLE_POINTS);
+        point_shards_free(_shards);
+        for (_thread_index = 0; _thread_index < 3; _thread_index++) {
+            point_table_free(_shard_tables[_thread_index]);
+        }
+    }
+    
+    // eviction keeps points that were found, and points not yet in
+    // the datastore, which aren't compacted
+    _table = point_table_alloc();
+    point_table_init(_table, 0);
+    for (_shard_i = 0; _shard_i < 100; _shard_i++) {
+        _shard_point = point_alloc();
+        point_init(_shard_point);
+        point_set_si(_shard_point, _shard_i, -_shard_i);
+        _shard_point->in_datastore = _shard_i == 9 ? 0 : 1;
+        assert(point_table_add(_ctx, _table, _shard_point) == NULL);
+    }
+    point_record_t* _record;
+    _position = 0;
+    while ((_record = point_table_next(_table, &_position)) != NULL) {
+        if (_record->point->in_datastore == 1) {
+            point_record_compact(_record);
+        }
+    }
+    _ctx->point_table_hits = 0;
+    point_set_si(_pa, 5, -5);
+    assert(point_table_find(_ctx, _table, _pa) != NULL);
+    assert(_ctx->point_table_hits == 1);
+    assert(point_table_evict(_table, 50) == 50);
+    assert(point_table_count(_table) == 50);
+    assert(point_table_find(_ctx, _table, _pa)->point == NULL);
+    point_set_si(_pa, 9, -9);
+    assert(point_table_find(_ctx, _table, _pa)->point != NULL);
+    assert(point_table_evict(_table, 0) == 49);
+    assert(point_table_count(_table) == 1);
+    assert(_table->evicted == 99);
+    assert(point_table_find(_ctx, _table, _pa) != NULL);
+    point_table_free(_table);
+    
+    // runs keep one of each point added by two producers, with small
+    // buffers so there are several run files to merge. With the hash
+    // grid, points within g_epsilon on either side of a cell edge are
+    // merged too. Unique points come back in sort key order.
+    point_runs_t* _runs = point_runs_alloc();
+    size_t _key_limbs = 2 * point_sort_key_limbs();
+    mp_limb_t* _key_previous = malloc(sizeof(mp_limb_t) * _key_limbs);
+    mp_limb_t* _key_next = malloc(sizeof(mp_limb_t) * _key_limbs);
+    int _found_runs_point = 0;
+    assert(_key_previous != NULL && _key_next != NULL);
+    point_runs_init(_runs, ".", 2, 16384);
+    for (_shard_i = 0; _shard_i < TEST_TABLE_POINTS; _shard_i++) {
+        for (_thread_index = 0; _thread_index < 2; _thread_index++) {
+            point_set_si(_pa, _shard_i % 100, -_shard_i);
+            point_runs_add(_runs, _thread_index, _pa);
+        }
+    }
+    mpf_div_2exp(_t4, g_one, point_hash_coord_bits() + 1);
+    mpf_div_ui(_t3, g_epsilon, 4);
+    mpf_sub(_t5, _t4, _t3);
+    point_set(_pa, _t5, g_one);
+    point_runs_add(_runs, 0, _pa);
+    mpf_add(_t5, _t4, _t3);
+    point_set(_pa, _t5, g_one);
+    point_runs_add(_runs, 1, _pa);
+    assert(_runs->total_runs > 2);
+    assert(point_runs_merge(_runs, _ctx) == TEST_TABLE_POINTS + (point_hash_grid() == 1 ? 1 : 2));
+    assert(_runs->run_count == 0);
+    _table_count = 0;
+    while (point_runs_next(_runs, _pa) == 1) {
+        point_sort_key(_pa, _key_next);
+        if (_table_count > 0) {
+            assert(mpn_cmp(_key_previous, _key_next, _key_limbs / 2) <= 0);
+        }
+        memcpy(_key_previous, _key_next, sizeof(mp_limb_t) * _key_limbs);
+        if (mpf_cmp_si(_pa->x, 7) == 0 && mpf_cmp_si(_pa->y, -1907) == 0) {
+            _found_runs_point = 1;
+        }
+        _table_count++;
+    }
+    assert(_table_count == TEST_TABLE_POINTS + (point_hash_grid() == 1 ? 1 : 2));
+    assert(_found_runs_point == 1);
+    assert(point_runs_merge(_runs, _ctx) == 0);
+    assert(point_runs_next(_runs, _pa) == 0);
+    point_runs_free(_runs);
+    free(_key_previous);
+    free(_key_next);
+    
+    // interval filter
+    
+    // interval contains the mpf value
+    interval_t _i1;
+    mpf_sqrt_ui(_t5, 2);
+    interval_set_mpf(&_i1, _t5);
+    assert(mpf_cmp_d(_t5, _i1.lo) > 0);
+    assert(mpf_cmp_d(_t5, _i1.hi) < 0);
+    mpf_set_si(_t5, -3);
+    interval_set_mpf(&_i1, _t5);
+    assert(_i1.lo == -3 && _i1.hi == -3);
+    
+    // circles far apart are decided by the filter
+    circle_set_si(_c1, 0, 0, 1);
+    circle_set_si(_c2, 9, 9, 1);
+    _ctx->filter_resolved = 0;
+    _ctx->filter_fallback = 0;
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
+    assert(_result == 0);
+    assert(_ctx->filter_resolved == 1);
+    assert(_ctx->filter_fallback == 0);
+    
+    // line missing the circle is decided by the filter
+    line_set_si(_ctx, _n1, 0, 5, 1, 5);
+    _ctx->filter_resolved = 0;
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
+    assert(_result == 0);
+    assert(_ctx->filter_resolved == 1);
+    
+    // parallel lines are decided by the filter
+    line_set_si(_ctx, _n1, 0, 0, 1, 0);
+    line_set_si(_ctx, _n2, 0, 1, 1, 1);
+    _ctx->filter_resolved = 0;
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
+    assert(_result == 0);
+    assert(_ctx->filter_resolved == 1);
+    
+    // tangent line and circles need mpf
+    line_set_si(_ctx, _n1, 0, 1, 1, 1);
+    _ctx->filter_resolved = 0;
+    _ctx->filter_fallback = 0;
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
+    assert(_result == 1);
+    assert(_ctx->filter_resolved == 0);
+    assert(_ctx->filter_fallback == 1);
+    
+    // circles closer than g_epsilon to touching need mpf, and get
+    // the same answer as without the filter.
+    mpf_set_str(_t5, "2.000000000000000000001", 10);
+    point_set(_p1, _t5, g_zero);
+    circle_set(_c2, _p1, g_one);
+    _ctx->filter_resolved = 0;
+    _result = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
+    assert(_ctx->filter_resolved == 0);
+    _ctx->use_interval_filter = 0;
+    int _result_unfiltered = circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
+    _ctx->use_interval_filter = 1;
+    assert(_result == _result_unfiltered);
+    
+#ifndef NUMERIC_KERNELS
+    // low precision pass at 64 bits, the guard band must be well over
+    // the rounding at the low precision
+    assert(global_guard_band_valid(64, "0.000000000001") == 1);
+    assert(global_guard_band_valid(40, "0.000000000001") == 0);
+    point_grid_t* _grid = point_grid_alloc();
+    point_grid_init(_grid, 0, 64, "0.000000000001");
+    geometry_context_init_low(_ctx, 64, "0.000000000001");
+    _ctx->low_known = _low_known;
+    _ctx->low_known_data = _grid;
+    _ctx->use_interval_filter = 0;
+    
+    // a line clearly missing the circle is only calculated at low precision
+    line_set_si(_ctx, _n1, 0, 2, 1, 2);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
+    assert(_result == 0);
+    assert(_ctx->low_precision_count == 1);
+    assert(_ctx->low_precision_flagged == 0);
+    
+    // a line where r^2 - dist^2 is about g_epsilon is calculated again,
+    // and gets the same answer as without the low precision pass.
+    mpf_set_str(_t5, "1.000000000000000000005", 10);
+    point_set(_p1, g_zero, _t5);
+    point_set(_p2, g_one, _t5);
+    line_set(_ctx, _n1, _p1, _p2);
+    _result = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
+    assert(_ctx->low_precision_count == 2);
+    assert(_ctx->low_precision_flagged == 1);
+    
+    // circles this big have terms too large for their rounding at
+    // 64 bits to stay within the guard band, so they're calculated again
+    circle_set_si(_c1, 0, 0, 1000);
+    circle_set_si(_c2, 1500, 300, 700);
+    assert(circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb) == 2);
+    assert(_ctx->low_precision_count == 3);
+    assert(_ctx->low_precision_flagged == 2);
+    mpf_set(_t3, _pa->y);
+    
+    // new points are calculated again, so the points have every bit
+    // of the full precision
+    circle_set_si(_c1, 0, 0, 1);
+    circle_set_si(_c2, 1, 0, 1);
+    assert(circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb) == 2);
+    assert(_ctx->low_precision_new == 1);
+    mpf_set(_t4, _pa->y);
+    point_grid_add(_grid, _pa);
+    point_grid_add(_grid, _pb);
+    assert(point_grid_count(_grid) == 2);
+    
+    // once the points are known, the low precision result is used,
+    // and the known points are skipped
+    assert(circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb) == 0);
+    assert(_ctx->low_precision_count == 5);
+    assert(_ctx->low_precision_new == 1);
+    
+    // points within the guard band of a known point, that aren't
+    // within the rounding of it, are calculated again
+    mpf_set_str(_t5, "1.0000000000002", 10);
+    point_set(_p1, _t5, g_zero);
+    circle_set(_c2, _p1, g_one);
+    assert(circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb) == 2);
+    assert(_ctx->low_precision_near == 1);
+    
+    _ctx->low_known = NULL;
+    _ctx->low_known_data = NULL;
+    geometry_context_free(_ctx->low);
+    _ctx->low = NULL;
+    circle_set_si(_c1, 0, 0, 1000);
+    circle_set_si(_c2, 1500, 300, 700);
+    circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
+    assert(mpf_cmp(_t3, _pa->y) == 0);
+    circle_set_si(_c1, 0, 0, 1);
+    circle_set_si(_c2, 1, 0, 1);
+    circle_intersection_circle(_ctx, _c1, _c2, _pa, _pb);
+    assert(mpf_cmp(_t4, _pa->y) == 0);
+    _result_unfiltered = circle_intersection_line(_ctx, _c1, _n1, _pa, _pb);
+    assert(_result == _result_unfiltered);
+    point_grid_free(_grid);
+    
+    // two iterations find the same points with the low precision pass
+    size_t _full_count = _count_iterations(_ctx, NULL, 2);
+    _grid = point_grid_alloc();
+    point_grid_init(_grid, 0, 64, "0.000000000001");
+    geometry_context_init_low(_ctx, 64, "0.000000000001");
+    _ctx->low_known = _low_known;
+    _ctx->low_known_data = _grid;
+    assert(_count_iterations(_ctx, _grid, 2) == _full_count);
+    assert(_ctx->low_precision_count > _ctx->low_precision_flagged + _ctx->low_precision_near + _ctx->low_precision_new);
+    if (point_hash_grid()) {
+        assert(_full_count == 203);
+    }
+    
+    _ctx->low_known = NULL;
+    _ctx->low_known_data = NULL;
+    geometry_context_free(_ctx->low);
+    _ctx->low = NULL;
+    point_grid_free(_grid);
+    _ctx->use_interval_filter = 1;
+#endif
+    
+    // exact rational points
+    size_t _rational_bits = point_rational_bits();
+    point_rational_init(64);
+    mpq_t _q1;
+    mpq_init(_q1);
+    
+    // decimal strings are kept exactly
+    point_set_str(_p1, "0.5", "-1.25");
+    assert(_p1->is_rational == 1);
+    mpq_set_si(_q1, 1, 2);
+    assert(mpq_equal(_p1->qx, _q1));
+    mpq_set_si(_q1, -5, 4);
+    assert(mpq_equal(_p1->qy, _q1));
+    
+    // rounded strings are read as the fraction they're rounded from,
+    // but only if the fraction is small enough
+    point_set_str_rounded(_p1,
+        "0.333333333333333333333333333333333333333333333333333333333333333333333333333333",
+        "-2.142857142857142857142857142857142857142857142857142857142857142857142857142857");
+    assert(_p1->is_rational == 1);
+    mpq_set_si(_q1, 1, 3);
+    assert(mpq_equal(_p1->qx, _q1));
+    mpq_set_si(_q1, -15, 7);
+    assert(mpq_equal(_p1->qy, _q1));
+    point_set_str_rounded(_p1,
+        "1.414213562373095048801688724209698078569671875376948073176679737990732478462107",
+        "0");
+    assert(_p1->is_rational == 0);
+    point_set_str_rounded(_p1, "0.33", "0");
+    assert(_p1->is_rational == 0);
+    
+    // rational points read back from runs keep their fractions, and
+    // are merged only with the same fractions
+    _runs = point_runs_alloc();
+    point_runs_init(_runs, ".", 1, 16384);
+    mpq_set_si(_q1, 1, 3);
+    point_set_q(_pa, _q1, _q1);
+    point_runs_add(_runs, 0, _pa);
+    point_runs_add(_runs, 0, _pa);
+    point_set(_pb, _root_two, _root_two);
+    point_runs_add(_runs, 0, _pb);
+    assert(point_runs_merge(_runs, _ctx) == 2);
+    _table_count = 0;
+    while (point_runs_next(_runs, _pa) == 1) {
+        if (mpf_cmp(_pa->x, _root_two) == 0) {
+            assert(_pa->is_rational == 0);
+        } else {
+            assert(_pa->is_rational == 1);
+            assert(mpq_equal(_pa->qx, _q1));
+            assert(mpq_equal(_pa->qy, _q1));
+        }
+        _table_count++;
+    }
+    assert(_table_count == 2);
+    point_runs_free(_runs);
+    
+    // lines through rational points meet at an exact point,
+    // y = x / 3 and x + y = 1 at {3/4, 1/4}
+    line_set_si(_ctx, _n1, 0, 0, 3, 1);
+    line_set_si(_ctx, _n2, 0, 1, 1, 0);
+    assert(_n1->is_rational == 1);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
+    assert(_result == 1);
+    assert(_pa->is_rational == 1);
+    mpq_set_si(_q1, 3, 4);
+    assert(mpq_equal(_pa->qx, _q1));
+    mpq_set_si(_q1, 1, 4);
+    assert(mpq_equal(_pa->qy, _q1));
+    mpf_set_str(_t5, "0.75", 10);
+    assert(mpf_cmp(_pa->x, _t5) == 0);
+    
+    // parallel lines are still parallel
+    line_set_si(_ctx, _n2, 0, 1, 3, 2);
+    _result = line_intersection_line(_ctx, _n1, _n2, _pa);
+    assert(_result == 0);
+    
+    // rational points closer than g_epsilon are only the same point if equal,
+    // and equal fractions have the same hash key
+    point_set_str(_p1, "0.1", "0");
+    point_set_str(_p2, "0.1000000000000000000000000000001", "0");
+    assert(point_equals(_ctx, _p1, _p2) == 0);
+    point_set_str(_p2, "0.10", "0");
+    assert(point_equals(_ctx, _p1, _p2) == 1);
+    point_ensure_hash(_p1);
+    point_ensure_hash(_p2);
+    assert(memcmp(_p1->hash_key, _p2->hash_key, _p1->hash_key_length) == 0);
+    
+    // a rational point and one that isn't are compared with g_epsilon
+    mpf_set_str(_t5, "0.1000000000000000000000000000001", 10);
+    point_set(_p2, _t5, g_zero);
+    assert(point_equals(_ctx, _p1, _p2) == 1);
+    
+    // rational records are compared the same way, before and after
+    // the record is compacted
+    _table = point_table_alloc();
+    point_table_init(_table, 0);
+    _kept = point_clone(_p1);
+    assert(point_table_add(_ctx, _table, _kept) == NULL);
+    point_set_str(_p2, "0.1000000000000000000000000000001", "0");
+    assert(point_table_find(_ctx, _table, _p2) == NULL);
+    point_set_str(_p2, "0.10", "0");
+    assert(point_table_find(_ctx, _table, _p2)->point == _kept);
+    _kept->in_datastore = 1;
+    point_record_compact(point_table_find(_ctx, _table, _p2));
+    assert(point_table_find(_ctx, _table, _p2) != NULL);
+    point_set_str(_p2, "0.1000000000000000000000000000001", "0");
+    assert(point_table_find(_ctx, _table, _p2) == NULL);
+    
+    // closer than the record's fixed point values can tell apart
+    point_set_str(_p2, "0.10000000000000000000000000000000000000000000000000000000000001", "0");
+    assert(point_table_find(_ctx, _table, _p2) == NULL);
+    point_table_free(_table);
+    
+    // copies of lines keep the exact values
+    point_set_si(_p1, 1, 2);
+    point_set_si(_p2, 4, -3);
+    line_set(_ctx, _n1, _p1, _p2);
+    assert(_n1->is_rational == 1);
+    
+    mpq_clear(_q1);
+    point_rational_init(_rational_bits);
+
+    // quadratic towers
+    quad_context_t* _qctx = quad_context_alloc();
+    quad_context_init(_qctx);
+    quad_tower_t* _qt1 = quad_tower_alloc();
+    quad_tower_init(_qt1);
+    quad_tower_t* _qt2 = quad_tower_alloc();
+    quad_tower_init(_qt2);
+    quad_number_t _qn1, _qn2, _qn3, _qn4, _qmap[QUAD_MAX_DEPTH];
+    int _qi;
+    quad_init(&_qn1);
+    quad_init(&_qn2);
+    quad_init(&_qn3);
+    quad_init(&_qn4);
+    for (_qi=0; _qi<QUAD_MAX_DEPTH; _qi++) {
+        quad_init(&_qmap[_qi]);
+    }
+
+    // sqrt(12) = 2 * sqrt(3), the tower is Q(sqrt(3))
+    quad_set_si(&_qn1, 12);
+    assert(quad_tower_sqrt(_qctx, _qt1, &_qn2, &_qn1) == 1);
+    assert(_qt1->depth == 1);
+    assert(mpq_cmp_si(_qt1->radicands[0][0], 3, 1) == 0);
+    assert(mpq_sgn(_qn2.c[0]) == 0);
+    assert(mpq_cmp_si(_qn2.c[1], 2, 1) == 0);
+
+    // sqrt(27) = 3 * sqrt(3) is already in the tower
+    quad_set_si(&_qn1, 27);
+    assert(quad_tower_sqrt(_qctx, _qt1, &_qn2, &_qn1) == 1);
+    assert(_qt1->depth == 1);
+    assert(mpq_cmp_si(_qn2.c[1], 3, 1) == 0);
+
+    // sqrt(3) - 2 is negative, and 1 / (sqrt(3) - 2) = -2 - sqrt(3)
+    quad_set_si(&_qn1, 1);
+    quad_set_si(&_qn3, 2);
+    quad_set_si(&_qn2, 0);
+    mpq_set_si(_qn2.c[1], 1, 1);
+    quad_sub(_qt1, &_qn2, &_qn2, &_qn3);
+    assert(quad_sgn(_qctx, _qt1, &_qn2) < 0);
+    quad_div(_qctx, _qt1, &_qn3, &_qn1, &_qn2);
+    assert(mpq_cmp_si(_qn3.c[0], -2, 1) == 0);
+    assert(mpq_cmp_si(_qn3.c[1], -1, 1) == 0);
+    quad_mul(_qctx, _qt1, &_qn3, &_qn3, &_qn2);
+    assert(quad_equal(_qt1, &_qn3, &_qn1) == 1);
+
+    // sqrt(2 + sqrt(3)) adds a level
+    quad_set_si(&_qn1, 2);
+    mpq_set_si(_qn1.c[1], 1, 1);
+    assert(quad_tower_sqrt(_qctx, _qt1, &_qn2, &_qn1) == 1);
+    assert(_qt1->depth == 2);
+    quad_get_mpf(_qctx, _qt1, _t5, &_qn2);
+    mpf_set_d(_t6, 1.9318516525781366);
+    mpf_sub(_t6, _t6, _t5);
+    assert(fabs(mpf_get_d(_t6)) < 1e-15);
+
+    // (sqrt(2) + sqrt(3))^2 = 5 + 2 * sqrt(6) is a square in Q(sqrt(2), sqrt(6))
+    quad_set_si(&_qn1, 2);
+    assert(quad_tower_sqrt(_qctx, _qt2, &_qn3, &_qn1) == 1);
+    quad_set_si(&_qn1, 6);
+    assert(quad_tower_sqrt(_qctx, _qt2, &_qn3, &_qn1) == 1);
+    assert(_qt2->depth == 2);
+    quad_set_si(&_qn1, 5);
+    quad_add(_qt2, &_qn1, &_qn1, &_qn3);
+    quad_add(_qt2, &_qn1, &_qn1, &_qn3);
+    assert(quad_tower_sqrt(_qctx, _qt2, &_qn4, &_qn1) == 1);
+    assert(_qt2->depth == 2);
+    quad_mul(_qctx, _qt2, &_qn3, &_qn4, &_qn4);
+    assert(quad_equal(_qt2, &_qn3, &_qn1) == 1);
+
+    // sqrt(2 + sqrt(3)) = (sqrt(6) + sqrt(2)) / 2 in the merged towers
+    quad_set_si(&_qn1, 0);
+    mpq_set_si(_qn1.c[1], 1, 2);
+    mpq_set_si(_qn1.c[2], 1, 2);
+    assert(quad_tower_merge(_qctx, _qt1, _qt2, _qmap) == 1);
+    assert(_qt1->depth == 2);
+    quad_map(_qctx, _qt1, &_qn3, &_qn1, _qmap);
+    assert(quad_equal(_qt1, &_qn3, &_qn2) == 1);
+    assert(quad_tower_equal(_qt1, _qt2) == 0);
+
+    quad_clear(&_qn1);
+    quad_clear(&_qn2);
+    quad_clear(&_qn3);
+    quad_clear(&_qn4);
+    for (_qi=0; _qi<QUAD_MAX_DEPTH; _qi++) {
+        quad_clear(&_qmap[_qi]);
+    }
+    quad_tower_free(_qt1);
+    quad_tower_free(_qt2);
+    quad_context_free(_qctx);
+
+    // fixed point values
+    
+    // round trip through mpf, and products and quotients of negative values
+    fixed_t _f1, _f2, _f3;
+    mpf_sqrt_ui(_t5, 2);
+    fixed_set_mpf(&_f1, _t5);
+    fixed_get_mpf(_t6, &_f1);
+    assert(global_compare2(_ctx, _t5, _t6) == 0);
+    fixed_set_si(&_f2, -3);
+    fixed_mul(&_f3, &_f1, &_f2);
+    fixed_get_mpf(_t6, &_f3);
+    mpf_mul_ui(_t4, _t5, 3);
+    mpf_neg(_t4, _t4);
+    assert(global_compare2(_ctx, _t4, _t6) == 0);
+    fixed_div(&_f3, &_f3, &_f2);
+    fixed_sub(&_f3, &_f3, &_f1);
+    assert(fixed_is_zero(&_f3) == 1);
+    fixed_mul(&_f3, &_f2, &_f2);
+    assert(fixed_get_d(&_f3) == 9.0);
+    
+    // square root is as close as mpf's
+    fixed_set_si(&_f2, 2);
+    fixed_sqrt(&_f3, &_f2);
+    fixed_sub(&_f3, &_f3, &_f1);
+    assert(fixed_is_zero(&_f3) == 1);
+    fixed_set_d(&_f2, -0.5);
+    assert(fixed_compare_zero(&_f2) == -1);
+    assert(fixed_compare_zero(&g_fixed_epsilon) == 0);
+    
+    // double-double values, same as above
+    dd_t _d1, _d2, _d3;
+    dd_set_mpf(&_d1, _t5);
+    dd_get_mpf(_t6, &_d1);
+    assert(global_compare2(_ctx, _t5, _t6) == 0);
+    dd_set_si(&_d2, -3);
+    dd_mul(&_d3, &_d1, &_d2);
+    dd_get_mpf(_t6, &_d3);
+    assert(global_compare2(_ctx, _t4, _t6) == 0);
+    dd_div(&_d3, &_d3, &_d2);
+    dd_sub(&_d3, &_d3, &_d1);
+    assert(dd_is_zero(&_d3) == 1);
+    dd_mul(&_d3, &_d2, &_d2);
+    assert(dd_get_d(&_d3) == 9.0);
+    dd_set_si(&_d2, 2);
+    dd_sqrt(&_d3, &_d2);
+    dd_sub(&_d3, &_d3, &_d1);
+    assert(dd_is_zero(&_d3) == 1);
+    dd_set_d(&_d2, -0.5);
+    assert(dd_compare_zero(&_d2) == -1);
+    assert(dd_compare_zero(&g_dd_epsilon) == 0);
+    
+    // the 106 bits are kept, 1 + 2^-80 isn't 1.
+    mpf_set_ui(_t6, 1);
+    mpf_div_2exp(_t6, _t6, 80);
+    mpf_add_ui(_t6, _t6, 1);
+    dd_set_mpf(&_d2, _t6);
+    dd_set_si(&_d3, 1);
+    dd_sub(&_d3, &_d2, &_d3);
+    assert(dd_get_d(&_d3) == ldexp(1.0, -80));
+    
+#ifdef NUMERIC_KERNELS
+    // the numeric backend of this build, same as above
+    num_t _v1, _v2, _v3;
+    num_set_mpf(&_v1, _t5);
+    num_get_mpf(_t6, &_v1);
+    assert(global_compare2(_ctx, _t5, _t6) == 0);
+    num_set_si(&_v2, -3);
+    num_mul(&_v3, &_v1, &_v2);
+    num_get_mpf(_t6, &_v3);
+    assert(global_compare2(_ctx, _t4, _t6) == 0);
+    num_div(&_v3, &_v3, &_v2);
+    num_sub(&_v3, &_v3, &_v1);
+    assert(num_is_zero(&_v3) == 1);
+    num_mul_ui(&_v3, &_v2, 3);
+    num_neg(&_v3, &_v3);
+    assert(num_get_d(&_v3) == 9.0);
+    num_set_si(&_v2, 2);
+    num_sqrt(&_v3, &_v2);
+    num_sub(&_v3, &_v3, &_v1);
+    assert(num_is_zero(&_v3) == 1);
+    num_set_d(&_v2, -0.5);
+    assert(num_compare_zero(&_v2) == -1);
+    assert(num_sgn(&_v2) == -1);
+    num_mul(&_v3, &_v2, &_v2);
+    assert(num_is_zero_squared(&_v3) == 0);
+    num_set_mpf(&_v3, g_epsilon_squared);
+    assert(num_is_zero_squared(&_v3) == 1);
+    num_set_mpf(&_v3, g_m_epsilon);
+    assert(num_compare_zero(&_v3) == 0);
+#endif
     
     // done
     
     point_free(_p1);
     point_free(_p2);
+    point_free(_pa);
+    point_free(_pb);
     
     line_free(_n1);
     line_free(_n2);
@@ -850,6 +1808,8 @@ void test_run() {
     circle_free(_c1);
     circle_free(_c2);
     
+    geometry_context_free(_ctx);
+    
     mpf_clear(_t1);
     mpf_clear(_t2);
     mpf_clear(_t3);
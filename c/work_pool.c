@@ -0,0 +1,340 @@
+/*
+* Work stealing thread pool.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "global.h"
+#include "work_pool.h"
+
+/*
+* Takes the next chunk from the tail of the worker's own deque.
+*
+* @d: Deque to take from.
+* @chunk: Chunk that was removed.
+*
+* returns: 1 if a chunk was found, otherwise 0.
+*/
+static int _deque_pop(work_pool_deque_t* d, work_chunk_t* chunk) {
+    int found = 0;
+    
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        d->tail--;
+        *chunk = d->chunks[d->tail];
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    
+    return found;
+}
+
+/*
+* Takes the next chunk from the head of another worker's deque.
+*
+* @d: Deque to take from.
+* @chunk: Chunk that was removed.
+*
+* returns: 1 if a chunk was found, otherwise 0.
+*/
+static int _deque_steal(work_pool_deque_t* d, work_chunk_t* chunk) {
+    int found = 0;
+    
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        *chunk = d->chunks[d->head];
+        d->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    
+    return found;
+}
+
+/*
+* Gets the next chunk for a worker, stealing from the other
+* workers once its own deque is empty.
+*
+* @w: Worker looking for work.
+* @chunk: Next chunk to run.
+*
+* returns: 1 if a chunk was found, 0 if there is no work left.
+*/
+static int _next_chunk(work_pool_worker_t* w, work_chunk_t* chunk) {
+    work_pool_t* pool = w->pool;
+    size_t i;
+    
+    if (_deque_pop(&pool->deques[w->index], chunk)) {
+        return 1;
+    }
+    
+    for (i=1; i<pool->thread_count; i++) {
+        if (_deque_steal(&pool->deques[(w->index + i) % pool->thread_count], chunk)) {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/*
+* Entry point for worker threads.
+*/
+static void* _worker_main(void* arg) {
+    work_pool_worker_t* w = (work_pool_worker_t*)arg;
+    work_pool_t* pool = w->pool;
+    work_chunk_t chunk;
+    int stop;
+    
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        stop = pool->stop;
+        pthread_mutex_unlock(&pool->lock);
+        
+        if (stop || _next_chunk(w, &chunk) == 0) {
+            break;
+        }
+        
+        pool->func(w->data, &chunk);
+        
+        pthread_mutex_lock(&pool->lock);
+        pool->chunk_done++;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    
+    pthread_mutex_lock(&pool->lock);
+    pool->running--;
+    pthread_mutex_unlock(&pool->lock);
+    
+    return NULL;
+}
+
+/*
+* Allocates memory for a new pool.
+*
+* returns: pointer to new pool.
+*/
+work_pool_t* work_pool_alloc() {
+    work_pool_t* pool = malloc(sizeof(work_pool_t));
+    global_exit_if_null(pool, "Fatal error calling malloc for work_pool_t.\n");
+    memset(pool, 0, sizeof(work_pool_t));
+    
+    return pool;
+}
+
+/*
+* Initializes new pool. Must be called before use.
+*
+* @pool: Pool to initialize.
+* @thread_count: Number of worker threads to use.
+*/
+void work_pool_init(work_pool_t* pool, size_t thread_count) {
+    size_t i;
+    
+    if (pool->is_init == IS_INIT) {
+        return;
+    }
+    
+    if (thread_count < 1) {
+        thread_count = 1;
+    }
+    
+    pool->thread_count = thread_count;
+    
+    pool->deques = malloc(sizeof(work_pool_deque_t) * thread_count);
+    global_exit_if_null(pool->deques, "Fatal error calling malloc for work_pool_t->deques.\n");
+    memset(pool->deques, 0, sizeof(work_pool_deque_t) * thread_count);
+    
+    pool->threads = malloc(sizeof(pthread_t) * thread_count);
+    global_exit_if_null(pool->threads, "Fatal error calling malloc for work_pool_t->threads.\n");
+    
+    pool->workers = malloc(sizeof(work_pool_worker_t) * thread_count);
+    global_exit_if_null(pool->workers, "Fatal error calling malloc for work_pool_t->workers.\n");
+    memset(pool->workers, 0, sizeof(work_pool_worker_t) * thread_count);
+    
+    for (i=0; i<thread_count; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+    
+    pthread_mutex_init(&pool->lock, NULL);
+    
+    pool->is_init = IS_INIT;
+}
+
+/*
+* Frees resources used by the pool. The pool must not be running.
+*
+* @pool: Pool to free.
+*/
+void work_pool_free(work_pool_t* pool) {
+    size_t i;
+    
+    if (pool == NULL) {
+        return;
+    }
+    
+    if (pool->is_init == IS_INIT) {
+        for (i=0; i<pool->thread_count; i++) {
+            pthread_mutex_destroy(&pool->deques[i].lock);
+            free(pool->deques[i].chunks);
+        }
+        
+        pthread_mutex_destroy(&pool->lock);
+        
+        free(pool->deques);
+        free(pool->threads);
+        free(pool->workers);
+        free(pool->pending);
+        pool->is_init = 0;
+    }
+    
+    free(pool);
+}
+
+/*
+* Queues a chunk of work. Chunks are handed out to the workers when
+* work_pool_run is called. Not thread safe, must be called before
+* work_pool_run.
+*
+* @pool: Pool to add work to.
+* @a: First chunk value.
+* @b: Second chunk value.
+*/
+void work_pool_add(work_pool_t* pool, size_t a, size_t b) {
+    if (pool->pending_count == pool->pending_capacity) {
+        pool->pending_capacity = pool->pending_capacity == 0 ? 256 : pool->pending_capacity * 2;
+        pool->pending = realloc(pool->pending, sizeof(work_chunk_t) * pool->pending_capacity);
+        global_exit_if_null(pool->pending, "Fatal error calling realloc for work_pool_t->pending.\n");
+    }
+    
+    pool->pending[pool->pending_count].a = a;
+    pool->pending[pool->pending_count].b = b;
+    pool->pending_count++;
+}
+
+/*
+* Starts the worker threads. The queued chunks are split into
+* contiguous blocks, one per worker. A worker that runs out of work
+* steals from the other workers. Returns without waiting on the
+* workers, see work_pool_join.
+*
+* @pool: Pool to start.
+* @func: Method called for each chunk.
+* @worker_data: Array of thread_count values, one is passed to
+*     each worker for every chunk it runs.
+*/
+void work_pool_run(work_pool_t* pool, work_pool_func_t func, void** worker_data) {
+    size_t i;
+    size_t start, end;
+    
+    pool->func = func;
+    pool->chunk_total = pool->pending_count;
+    pool->chunk_done = 0;
+    pool->stop = 0;
+    pool->running = pool->thread_count;
+    
+    for (i=0; i<pool->thread_count; i++) {
+        work_pool_deque_t* d = &pool->deques[i];
+        
+        start = (pool->pending_count * i) / pool->thread_count;
+        end = (pool->pending_count * (i + 1)) / pool->thread_count;
+        
+        // Owner takes from the tail, so reverse the block to have the
+        // owner run its chunks in the order they were added.
+        free(d->chunks);
+        d->chunks = malloc(sizeof(work_chunk_t) * (end - start + 1));
+        global_exit_if_null(d->chunks, "Fatal error calling malloc for work_pool_deque_t->chunks.\n");
+        
+        d->head = 0;
+        d->tail = 0;
+        while (end > start) {
+            end--;
+            d->chunks[d->tail] = pool->pending[end];
+            d->tail++;
+        }
+        
+        pool->workers[i].data = worker_data[i];
+    }
+    
+    pool->pending_count = 0;
+    
+    for (i=0; i<pool->thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, _worker_main, &pool->workers[i]) != 0) {
+            global_error_printf("Could not create worker thread %zu.\n", i);
+            exit(1);
+        }
+    }
+}
+
+/*
+* Checks if all workers have finished.
+*
+* @pool: Pool to check.
+*
+* returns: 1 if there are no workers running, otherwise 0.
+*/
+int work_pool_is_done(work_pool_t* pool) {
+    int done;
+    
+    pthread_mutex_lock(&pool->lock);
+    done = pool->running == 0;
+    pthread_mutex_unlock(&pool->lock);
+    
+    return done;
+}
+
+/*
+* Gets the number of chunks that have finished.
+*
+* @pool: Pool to check.
+*
+* returns: number of finished chunks.
+*/
+size_t work_pool_chunk_done(work_pool_t* pool) {
+    size_t done;
+    
+    pthread_mutex_lock(&pool->lock);
+    done = pool->chunk_done;
+    pthread_mutex_unlock(&pool->lock);
+    
+    return done;
+}
+
+/*
+* Tells the workers to stop. Chunks currently running will finish,
+* no new chunks are started.
+*
+* @pool: Pool to stop.
+*/
+void work_pool_stop(work_pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+* Waits for the worker threads to exit. Any chunks that didn't run
+* are discarded, the pool can be reused by calling work_pool_add.
+*
+* @pool: Pool to wait on.
+*/
+void work_pool_join(work_pool_t* pool) {
+    size_t i;
+    
+    for (i=0; i<pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    
+    for (i=0; i<pool->thread_count; i++) {
+        pool->deques[i].head = 0;
+        pool->deques[i].tail = 0;
+    }
+}
@@ -0,0 +1,168 @@
+/*
+* Work stealing thread pool.
+*
+* Copyright (C) 2018 Ben Burns.
+*
+* MIT License, see /LICENSE for details.
+*/
+#ifndef __WORK_POOL_H__
+#define __WORK_POOL_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Unit of work handed to a worker. The meaning of the two
+// values is up to the caller (e.g., index of p2 and p3).
+typedef struct work_chunk {
+    size_t a;
+    size_t b;
+} work_chunk_t;
+
+// Method called by a worker thread for each chunk of work.
+// worker_data is the value given to work_pool_run for this worker.
+typedef void (*work_pool_func_t)(void* worker_data, work_chunk_t* chunk);
+
+// Double ended queue of chunks owned by one worker. The owner
+// takes chunks from the tail, other workers steal from the head.
+typedef struct work_pool_deque {
+    work_chunk_t* chunks;
+    size_t head;
+    size_t tail;
+    pthread_mutex_t lock;
+} work_pool_deque_t;
+
+struct work_pool;
+
+// Argument given to each worker thread.
+typedef struct work_pool_worker {
+    // Pool the worker belongs to.
+    struct work_pool* pool;
+    
+    // Index of the worker, this is also the index of the deque it owns.
+    size_t index;
+    
+    // Caller supplied value passed to func.
+    void* data;
+} work_pool_worker_t;
+
+// Container for the worker threads and the work to be done.
+typedef struct work_pool {
+    // Number of worker threads.
+    size_t thread_count;
+    
+    // Chunks added with work_pool_add, not yet given to a worker.
+    work_chunk_t* pending;
+    size_t pending_count;
+    size_t pending_capacity;
+    
+    // One deque per worker.
+    work_pool_deque_t* deques;
+    
+    pthread_t* threads;
+    
+    // Per thread argument passed to the worker threads.
+    work_pool_worker_t* workers;
+    
+    // Method to call for each chunk.
+    work_pool_func_t func;
+    
+    // Protects the following values.
+    pthread_mutex_t lock;
+    
+    // Total number of chunks given to the workers in work_pool_run.
+    size_t chunk_total;
+    
+    // Number of chunks that have finished.
+    size_t chunk_done;
+    
+    // Number of workers still running.
+    size_t running;
+    
+    // Set to stop workers before they take the next chunk.
+    int stop;
+    
+    // Whether or not this object has been initialized.
+    int is_init;
+} work_pool_t;
+
+/*
+* Allocates memory for a new pool.
+*
+* returns: pointer to new pool.
+*/
+work_pool_t* work_pool_alloc();
+
+/*
+* Initializes new pool. Must be called before use.
+*
+* @pool: Pool to initialize.
+* @thread_count: Number of worker threads to use.
+*/
+void work_pool_init(work_pool_t* pool, size_t thread_count);
+
+/*
+* Frees resources used by the pool. The pool must not be running.
+*
+* @pool: Pool to free.
+*/
+void work_pool_free(work_pool_t* pool);
+
+/*
+* Queues a chunk of work. Chunks are handed out to the workers when
+* work_pool_run is called. Not thread safe, must be called before
+* work_pool_run.
+*
+* @pool: Pool to add work to.
+* @a: First chunk value.
+* @b: Second chunk value.
+*/
+void work_pool_add(work_pool_t* pool, size_t a, size_t b);
+
+/*
+* Starts the worker threads. The queued chunks are split into
+* contiguous blocks, one per worker. A worker that runs out of work
+* steals from the other workers. Returns without waiting on the
+* workers, see work_pool_join.
+*
+* @pool: Pool to start.
+* @func: Method called for each chunk.
+* @worker_data: Array of thread_count values, one is passed to
+*     each worker for every chunk it runs.
+*/
+void work_pool_run(work_pool_t* pool, work_pool_func_t func, void** worker_data);
+
+/*
+* Checks if all workers have finished.
+*
+* @pool: Pool to check.
+*
+* returns: 1 if there are no workers running, otherwise 0.
+*/
+int work_pool_is_done(work_pool_t* pool);
+
+/*
+* Gets the number of chunks that have finished.
+*
+* @pool: Pool to check.
+*
+* returns: number of finished chunks.
+*/
+size_t work_pool_chunk_done(work_pool_t* pool);
+
+/*
+* Tells the workers to stop. Chunks currently running will finish,
+* no new chunks are started.
+*
+* @pool: Pool to stop.
+*/
+void work_pool_stop(work_pool_t* pool);
+
+/*
+* Waits for the worker threads to exit. Any chunks that didn't run
+* are discarded, the pool can be reused by calling work_pool_add.
+*
+* @pool: Pool to wait on.
+*/
+void work_pool_join(work_pool_t* pool);
+
+#endif